@@ -168,6 +168,41 @@
 #  endif
 #endif
 
+/**
+ * \def SOLARUS_TILE_CACHE_SIZE
+ * \brief Maximum memory in kilobytes used to keep pre-rendered tiles of the
+ * current map.
+ */
+#ifndef SOLARUS_TILE_CACHE_SIZE
+#  define SOLARUS_TILE_CACHE_SIZE 16384
+#endif
+
+/**
+ * \def SOLARUS_MUSIC_NUM_BUFFERS
+ * \brief Number of OpenAL buffers used to stream a music. The same number of
+ * decoded chunks can wait in advance in the decoding thread.
+ */
+#ifndef SOLARUS_MUSIC_NUM_BUFFERS
+#  define SOLARUS_MUSIC_NUM_BUFFERS 8
+#endif
+
+/**
+ * \def SOLARUS_TEXTURE_ATLAS_SIZE
+ * \brief Width and height of the textures where small images are packed
+ * together (0 to disable).
+ */
+#ifndef SOLARUS_TEXTURE_ATLAS_SIZE
+#  define SOLARUS_TEXTURE_ATLAS_SIZE 1024
+#endif
+
+/**
+ * \def SOLARUS_MUSIC_BUFFER_SIZE
+ * \brief Number of samples decoded at once into each music buffer.
+ */
+#ifndef SOLARUS_MUSIC_BUFFER_SIZE
+#  define SOLARUS_MUSIC_BUFFER_SIZE 4096
+#endif
+
 #include "Types.h"
 
 #endif
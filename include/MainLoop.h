@@ -45,6 +45,13 @@ class MainLoop {
 
     LuaContext& get_lua_context();
 
+    int get_num_input_events() const;
+    uint32_t get_input_latency() const;
+
+    bool is_headless() const;
+    bool is_throttling() const;
+    uint32_t get_num_ticks() const;
+
   private:
 
     void check_input();
@@ -54,10 +61,20 @@ class MainLoop {
     bool exiting;               /**< indicates that the program is about to stop */
     Game* game;                 /**< The current game if any, NULL otherwise. */
     Game* next_game;            /**< The game to start at next cycle (NULL means resetting the game). */
+    int num_input_events;       /**< Number of input events handled at the last cycle. */
+    uint32_t input_latency;     /**< Time between the first input event handled at the last cycle
+                                 * and the end of its handling, in milliseconds. */
+    bool headless;              /**< Whether there is no window and no audio (-headless option). */
+    bool throttling;            /**< Whether the simulation is slowed down to real time
+                                 * (false with the -no-throttle or -headless options). */
+    uint32_t num_ticks;         /**< Number of updates done since the beginning. */
+    uint32_t max_ticks;         /**< Stop the program after this number of updates
+                                 * (-max-ticks option, 0 means no limit). */
 
     void notify_input(const InputEvent& event);
     void draw();
     void update();
+    void run_unthrottled();
 };
 
 }
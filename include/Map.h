@@ -24,6 +24,7 @@
 #include "entities/Ground.h"
 #include "lowlevel/Rectangle.h"
 #include "lua/ExportableToLua.h"
+#include "movements/PathFindingCache.h"
 
 namespace solarus {
 
@@ -85,6 +86,7 @@ class Map: public ExportableToLua {
     // entities
     MapEntities& get_entities();
     const MapEntities& get_entities() const;
+    PathFindingCache& get_path_finding_cache();
 
     // presence of the hero
     bool is_started() const;
@@ -106,6 +108,10 @@ class Map: public ExportableToLua {
         int y,
         const MapEntity& entity_to_check,
         bool& found_diagonal_wall) const;
+    bool test_collision_with_tiles_ground(
+        Layer layer,
+        const Rectangle& collision_box,
+        bool& collision) const;
     bool test_collision_with_entities(
         Layer layer,
         const Rectangle& collision_box,
@@ -153,6 +159,9 @@ class Map: public ExportableToLua {
     void draw_foreground();
 
     static MapLoader map_loader;  /**< the map file parser */
+    static const int
+        detector_search_margin = 8; /**< distance around an entity where detectors
+                                   * may still collide with it (e.g. facing points) */
 
     // map properties
 
@@ -199,6 +208,8 @@ class Map: public ExportableToLua {
                                    * or an empty string to use the one saved. */
 
     MapEntities* entities;        /**< the entities on the map */
+    PathFindingCache
+        path_finding_cache;       /**< paths recently computed by entities of this map */
     bool suspended;               /**< indicates whether the game is suspended */
 };
 
@@ -18,6 +18,8 @@
 #define SOLARUS_MAP_LOADER_H
 
 #include "Common.h"
+#include <string>
+#include <vector>
 
 struct lua_State;
 
@@ -27,6 +29,15 @@ namespace solarus {
  * \brief Parses a map file.
  *
  * This class loads a map and its content from a map file.
+ *
+ * The map data file is a Lua script that is executed once to record its
+ * content in a compact binary form. This binary form is saved in the quest
+ * write directory if any, together with a hash of the data file, so that
+ * next loadings don't need to parse and execute the data file anymore:
+ * tiles are then created directly and other entities with their recorded
+ * properties, in the order of the data file.
+ * Saving this binary form is best-effort: if it fails, the data file will
+ * simply be executed again next time.
  */
 class MapLoader {
 
@@ -39,7 +50,71 @@ class MapLoader {
 
   private:
 
+    friend class MapPreloader;  // reads map data files in the background
+
+    /**
+     * \brief A field of the table passed to an entity creation function.
+     */
+    struct Field {
+      std::string key;          /**< Name of the field. */
+      int type;                 /**< LUA_TNUMBER, LUA_TSTRING or LUA_TBOOLEAN. */
+      double number;            /**< Value if this is a number or a boolean. */
+      std::string string;       /**< Value if this is a string. */
+    };
+
+    /**
+     * \brief A call to an entity creation function of the data file.
+     */
+    struct EntityData {
+      std::string type;             /**< Name of the function (like "chest"). */
+      std::vector<Field> fields;    /**< Properties of the entity. */
+      uint32_t num_tiles_before;    /**< Number of tiles declared before this entity. */
+    };
+
+    /**
+     * \brief A call to tile() in the data file.
+     */
+    struct TileData {
+      int layer;                /**< Layer of the tile. */
+      int x;                    /**< X coordinate of the tile. */
+      int y;                    /**< Y coordinate of the tile. */
+      int width;                /**< Width of the tile (multiple of 8). */
+      int height;               /**< Height of the tile (multiple of 8). */
+      int pattern_id;           /**< Tile pattern in the tileset. */
+    };
+
+    /**
+     * \brief Everything declared by a map data file.
+     */
+    struct MapData {
+      EntityData properties;             /**< Arguments of properties(). */
+      std::vector<TileData> tiles;       /**< All tiles, in declaration order. */
+      std::vector<EntityData> entities;  /**< Other entities, in declaration order
+                                          * (tiles are declared in between). */
+    };
+
+    static void read_map_data(const std::string& map_id, MapData& map_data);
+    static void parse_map_data(const std::string& file_name,
+        const char* buffer, size_t size, MapData& map_data);
+    static void save_map_data(const MapData& map_data, uint64_t source_hash,
+        std::string& output);
+    static bool load_map_data(const char* buffer, size_t size,
+        uint64_t source_hash, MapData& map_data);
+    static void create_map(Map& map, const std::string& file_name,
+        const MapData& map_data);
+    static void create_tiles(Map& map, const MapData& map_data,
+        unsigned int first, unsigned int end);
+    static uint64_t get_hash(const char* buffer, size_t size);
+
+    static MapData& get_map_data(lua_State* l);
+    static void record_fields(lua_State* l, EntityData& entity_data);
+    static int l_record_properties(lua_State* l);
+    static int l_record_tile(lua_State* l);
+    static int l_record_entity(lua_State* l);
     static int l_properties(lua_State* l);
+
+    static const uint32_t format_version;   /**< Version of the binary format,
+                                             * to be increased when it changes. */
 };
 
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_MAP_PRELOADER_H
+#define SOLARUS_MAP_PRELOADER_H
+
+#include "Common.h"
+#include "MapLoader.h"
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+namespace solarus {
+
+/**
+ * \brief Loads the data of a map in the background before it is needed.
+ *
+ * The map data file, the tileset and the sprite animation sets used by
+ * entities of the map are loaded by a worker thread.
+ * When the map is then actually loaded by MapLoader, this data is taken
+ * if ready, and the main thread only has to create the entities.
+ *
+ * Only one map is preloaded at a time. When another map is requested,
+ * the previous one is cancelled without waiting for its worker thread:
+ * the result is discarded when the thread finishes, unless the map is
+ * requested again in the meantime.
+ * Nothing loaded by a worker thread is shared with the main thread until
+ * the worker has finished.
+ */
+class MapPreloader {
+
+  public:
+
+    static void initialize();
+    static void quit();
+
+    static void preload(const std::string& map_id);
+    static const std::string& get_map_id();
+    static bool is_ready();
+
+  private:
+
+    friend class MapLoader;  // takes the preloaded data
+
+    /**
+     * \brief A map preloaded by a worker thread.
+     */
+    struct Job {
+      std::string map_id;                 /**< Map being preloaded. */
+      SDL_Thread* thread;                 /**< The worker thread. */
+      SDL_atomic_t finished;              /**< Whether the worker thread has finished. */
+      MapLoader::MapData* map_data;       /**< Content of its map data file. */
+      Tileset* tileset;                   /**< Its tileset, loaded. */
+      std::vector<SpriteAnimationSet*>
+          animation_sets;                 /**< Animation sets used by its entities. */
+    };
+
+    static MapLoader::MapData* take(const std::string& map_id,
+        Tileset*& tileset);
+    static void cancel();
+    static void delete_job(Job* job);
+    static void delete_finished_jobs();
+    static int run(void* data);
+
+    static Job* current_job;                /**< The map preloaded or being preloaded,
+                                             * or NULL. */
+    static std::vector<Job*> cancelled_jobs;
+                                            /**< Maps no longer wanted whose results
+                                             * were not deleted yet. */
+
+};
+
+}
+
+#endif
+
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_RESOURCE_PRELOADER_H
+#define SOLARUS_RESOURCE_PRELOADER_H
+
+#include "Common.h"
+#include <vector>
+
+namespace solarus {
+
+/**
+ * \brief Loads in advance the resources declared in the quest resource list.
+ *
+ * Sprite animation sets, tileset images and sounds are decoded in parallel
+ * by the worker pool, while fonts are loaded by the main thread.
+ * Sprites, sounds and fonts stay in memory, so that no such file is decoded
+ * later during the game. Tileset images are only kept if requested:
+ * otherwise they stay in the image cache until the next map change.
+ */
+class ResourcePreloader {
+
+  public:
+
+    static uint32_t preload_all(bool keep_tileset_images);
+    static void quit();
+
+  private:
+
+    class SpriteJob;
+    class TilesetJob;
+
+    static bool preloaded;                       /**< Whether preload_all() was called. */
+    static std::vector<Surface*> tileset_images; /**< Images of all tilesets, if they are kept. */
+
+};
+
+}
+
+#endif
+
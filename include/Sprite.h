@@ -43,6 +43,8 @@ class Sprite: public Drawable {
     // initialization
     static void initialize();
     static void quit();
+    static bool has_animation_set(const std::string& id);
+    static void add_animation_set(SpriteAnimationSet* animation_set);
 
     // creation and destruction
     Sprite(const std::string& id);
@@ -149,6 +151,10 @@ class Sprite: public Drawable {
     // effects
     mutable Surface*
         intermediate_surface;          /**< an intermediate surface used to show transitions and other effects */
+    bool intermediate_surface_needed;  /**< true if a transition was drawn on the intermediate surface:
+                                        * the sprite is then drawn through it */
+    int opacity;                       /**< opacity applied to each drawing of the sprite (0 to 255),
+                                        * changed by fade transitions */
     uint32_t blink_delay;              /**< blink delay of the sprite, or zero if the sprite is not blinking */
     bool blink_is_sprite_visible;      /**< when blinking, true if the sprite is visible or false if it is invisible */
     uint32_t blink_next_change_date;   /**< date of the next change when blinking: visible or not */
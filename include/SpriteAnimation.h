@@ -44,7 +44,10 @@ class SpriteAnimation {
 
     int get_next_frame(int current_direction, int current_frame) const;
     void draw(Surface& dst_surface, const Rectangle& dst_position,
-        int current_direction, int current_frame);
+        int current_direction, int current_frame, int opacity);
+    void draw_region(const Rectangle& region,
+        Surface& dst_surface, const Rectangle& dst_position,
+        int current_direction, int current_frame, int opacity);
 
     int get_nb_directions() const;
     const SpriteAnimationDirection* get_direction(int direction) const;
@@ -56,6 +59,7 @@ class SpriteAnimation {
 
   private:
 
+    void check_direction(int current_direction) const;
     void do_enable_pixel_collisions();
     void disable_pixel_collisions();
 
@@ -48,7 +48,10 @@ class SpriteAnimationDirection {
     int get_nb_frames() const;
     const Rectangle& get_frame(int frame) const;
     void draw(Surface& dst_surface, const Rectangle& dst_position,
-        int current_frame, Surface& src_image);
+        int current_frame, Surface& src_image, int opacity);
+    void draw_region(const Rectangle& region,
+        Surface& dst_surface, const Rectangle& dst_position,
+        int current_frame, Surface& src_image, int opacity);
 
     // pixel collisions
     void enable_pixel_collisions(Surface* src_image);
@@ -40,6 +40,7 @@ class SpriteAnimationSet {
     SpriteAnimationSet(const std::string& id);
     ~SpriteAnimationSet();
 
+    const std::string& get_id() const;
     void set_tileset(Tileset& tileset);
 
     bool has_animation(const std::string& animation_name) const;
@@ -52,13 +52,14 @@ class Transition {
     static Transition* create(
         Style style,
         Direction direction,
-        Surface& dst_surface,
         Game* game = NULL);
 
     Game* get_game() const;
     Direction get_direction() const;
     void set_previous_surface(Surface* previous_surface);
     virtual bool needs_previous_surface() const;
+    virtual bool is_opacity_only() const;
+    virtual int get_opacity() const;
 
     bool is_suspended() const;
     void set_suspended(bool suspended);
@@ -29,7 +29,7 @@ class TransitionFade: public Transition {
 
   public:
 
-    TransitionFade(Direction direction, Surface& dst_surface);
+    explicit TransitionFade(Direction direction);
     ~TransitionFade();
 
     void set_delay(uint32_t delay);
@@ -37,6 +37,8 @@ class TransitionFade: public Transition {
     void start();
     const Color* get_color();
     void set_color(Color* color);
+    bool is_opacity_only() const;
+    int get_opacity() const;
     bool is_started() const;
     bool is_finished() const;
     void notify_suspended(bool suspended);
@@ -54,7 +56,6 @@ class TransitionFade: public Transition {
     uint32_t next_frame_date;
     uint32_t delay;
 
-    Surface* dst_surface;
     Color* transition_color;
 
 };
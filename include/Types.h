@@ -102,6 +102,7 @@ class TransitionScrolling;
 // map entities
 class MapEntities;
 class MapEntity;
+class NonAnimatedRegions;
 class Hero;
 class HeroSprites;
 class Tile;
@@ -156,6 +157,7 @@ class PathMovement;
 class RandomPathMovement;
 class PathFindingMovement;
 class PathFinding;
+class PathFindingCache;
 class RandomMovement;
 class FollowMovement;
 class TargetMovement;
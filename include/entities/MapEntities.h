@@ -23,6 +23,7 @@
 #include "entities/Layer.h"
 #include "entities/EntityType.h"
 #include "entities/Enemy.h"
+#include "lowlevel/Grid.h"
 #include <vector>
 #include <list>
 
@@ -47,15 +48,26 @@ class MapEntities {
     // entities
     Hero& get_hero();
     Ground get_tile_ground(Layer layer, int x, int y) const;
-    const std::list<MapEntity*>& get_obstacle_entities(Layer layer);
-    const std::list<MapEntity*>& get_ground_observers(Layer layer);
-    const std::list<MapEntity*>& get_ground_modifiers(Layer layer);
-    const std::list<Detector*>& get_detectors();
-    const std::list<Stairs*>& get_stairs(Layer layer);
-    const std::list<CrystalBlock*>& get_crystal_blocks(Layer layer);
-    const std::list<const Separator*>& get_separators() const;
+    const std::vector<MapEntity*>& get_obstacle_entities(Layer layer);
+    const std::vector<MapEntity*>& get_ground_observers(Layer layer);
+    const std::vector<MapEntity*>& get_ground_modifiers(Layer layer);
+    const std::vector<Detector*>& get_detectors();
+    const std::vector<Stairs*>& get_stairs(Layer layer);
+    const std::vector<CrystalBlock*>& get_crystal_blocks(Layer layer);
+    const std::vector<const Separator*>& get_separators() const;
     Destination* get_default_destination();
 
+    void get_obstacle_entities_near(Layer layer, const Rectangle& where,
+        std::vector<MapEntity*>& obstacles) const;
+    void get_ground_modifiers_near(Layer layer, const Rectangle& where,
+        std::vector<MapEntity*>& ground_modifiers) const;
+    bool has_ground_modifiers_near(Layer layer, const Rectangle& where) const;
+    void get_detectors_near(const Rectangle& where,
+        std::vector<Detector*>& detectors) const;
+    int get_detectors_sprite_margin() const;
+    static Rectangle get_grid_box(const MapEntity& entity);
+    static int get_sprite_margin(MapEntity& entity);
+
     MapEntity* get_entity(const std::string& name);
     MapEntity* find_entity(const std::string& name);
     std::list<MapEntity*> get_entities_with_prefix(const std::string& prefix);
@@ -70,8 +82,8 @@ class MapEntities {
     void bring_to_front(MapEntity* entity);
     void destroy_all_entities();
     void destroy_entity(MapEntity* entity);
-    static bool compare_y(MapEntity* first, MapEntity* second);
     void set_entity_layer(MapEntity& entity, Layer layer);
+    void notify_entity_bounding_box_changed(MapEntity& entity);
 
     // specific to some entity types
     bool overlaps_raised_blocks(Layer layer, const Rectangle& rectangle);
@@ -93,12 +105,13 @@ class MapEntities {
 
     friend class MapLoader;            /**< the map loader initializes the private fields of MapEntities */
 
+    void initialize_grids();
     void add_tile(Tile* tile);
     void set_tile_ground(Layer layer, int x8, int y8, Ground ground);
-    void build_non_animated_tiles();
-    void redraw_non_animated_tiles();
-    bool overlaps_animated_tile(Tile& tile);
     void remove_marked_entities();
+    void add_entity_drawn_y_order(MapEntity& entity, Layer layer);
+    void update_entity_drawn_y_order(MapEntity& entity);
+    void update_entities_drawn_y_order();
     void update_crystal_blocks();
 
     // map
@@ -109,56 +122,69 @@ class MapEntities {
 
     // tiles
     std::vector<Tile*> tiles[LAYER_NB];             /**< All tiles of the map (a vector for each layer).
-                                                     * Note: the only reason why we keep them at runtime
-                                                     * is in case the tileset changes. Otherwise, they are
-                                                     * optimized and never used individually.*/
+                                                     * Note: they are drawn through non_animated_regions,
+                                                     * which pre-renders them by chunks when needed. */
     int tiles_grid_size;                            /**< number of 8x8 squares in the map
                                                      * (tiles_grid_size = map_width8 * map_height8) */
     Ground* tiles_ground[LAYER_NB];                 /**< array of size tiles_grid_size representing the ground property
                                                      * of each 8x8 square. */
-    bool* animated_tiles[LAYER_NB];                 /**< array of size tiles_grid_size that remembers which squares
-                                                     * have animated tiles */
-    Surface* non_animated_tiles_surfaces[LAYER_NB]; /**< all non-animated tiles are rendered once for all on these surfaces
-                                                     * for performance */
-    std::vector<Tile*>
-        tiles_in_animated_regions[LAYER_NB];        /**< animated tiles and tiles overlapping them */
+    NonAnimatedRegions*
+        non_animated_regions[LAYER_NB];             /**< optimized drawing of the tiles of each layer */
 
     // dynamic entities
     Hero& hero;                                     /**< the hero (also stored in Game because it is kept when changing maps) */
 
     std::map<std::string, MapEntity*>
       named_entities;                               /**< entities identified by a name */
-    std::list<MapEntity*> all_entities;             /**< all map entities except the tiles and the hero;
+    std::vector<MapEntity*> all_entities;           /**< all map entities except the tiles and the hero;
                                                      * this vector is used to delete the entities
                                                      * when the map is unloaded */
-    std::list<MapEntity*> entities_to_remove;       /**< list of entities that need to be removed right now */
+    std::vector<MapEntity*> entities_to_remove;     /**< list of entities that need to be removed right now */
 
-    std::list<MapEntity*>
+    std::vector<MapEntity*>
       entities_drawn_first[LAYER_NB];               /**< all map entities that are drawn in the normal order */
 
-    std::list<MapEntity*>
+    std::vector<MapEntity*>
       entities_drawn_y_order[LAYER_NB];             /**< all map entities that are drawn in the order
-                                                     * defined by their y position, including the hero */
-
-    std::list<Detector*> detectors;                 /**< all entities able to detect other entities
+                                                     * defined by their y position, including the hero
+                                                     * (sorted by entities_drawn_y) */
+    std::map<const MapEntity*, int>
+      entities_drawn_y;                             /**< y coordinate of the bottom of each entity of
+                                                     * entities_drawn_y_order when it was last placed there */
+    std::vector<MapEntity*> entities_moved_y_order; /**< entities drawn in y order that moved since
+                                                     * they were last placed (may contain duplicates) */
+
+    std::vector<Detector*> detectors;               /**< all entities able to detect other entities
                                                      * on this map.
                                                      * TODO store them by layer like obstacle_entities */
-    std::list<MapEntity*>
+    std::vector<MapEntity*>
       ground_observers[LAYER_NB];                   /**< all dynamic entities sensible to the ground
                                                      * below them */
-    std::list<MapEntity*>
+    std::vector<MapEntity*>
       ground_modifiers[LAYER_NB];                   /**< all dynamic entities that may change the ground of
                                                      * the map where they are placed */
     Destination* default_destination;               /**< the default destination of this map */
 
-    std::list<MapEntity*>
+    std::vector<MapEntity*>
       obstacle_entities[LAYER_NB];                  /**< all entities that might be obstacle for other
                                                      * entities on this map, including the hero */
 
-    std::list<Stairs*> stairs[LAYER_NB];            /**< all stairs of the map */
-    std::list<CrystalBlock*>
+    static const int grid_cell_size = 64;           /**< Size of a cell of the spatial indexes below, in pixels. */
+    Grid<MapEntity*>
+      obstacle_entities_grid[LAYER_NB];             /**< obstacle entities indexed by position,
+                                                     * except the hero (who is kept across maps) */
+    Grid<Detector*> detectors_grid;                 /**< detectors of all layers indexed by position */
+    int detectors_sprite_margin;                    /**< how far the sprites of detectors may go
+                                                     * from their bounding box (never decreases) */
+    Grid<MapEntity*>
+      ground_modifiers_grid[LAYER_NB];              /**< ground modifiers indexed by position */
+    Grid<CrystalBlock*>
+      crystal_blocks_grid[LAYER_NB];                /**< crystal blocks indexed by position */
+
+    std::vector<Stairs*> stairs[LAYER_NB];          /**< all stairs of the map */
+    std::vector<CrystalBlock*>
       crystal_blocks[LAYER_NB];                     /**< all crystal blocks of the map */
-    std::list<const Separator*> separators;         /**< all separators of the map */
+    std::vector<const Separator*> separators;       /**< all separators of the map */
 
     Boomerang* boomerang;                           /**< the boomerang if present on the map, NULL otherwise */
     std::string music_before_miniboss;              /**< the music that was played before starting a miniboss fight */
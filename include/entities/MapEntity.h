@@ -276,6 +276,7 @@ class MapEntity: public ExportableToLua {
 
     void update_ground_observers();
     void update_ground_below();
+    void notify_bounding_box_changed();
 
     // easy access to various game objects
     LuaContext& get_lua_context();
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_NON_ANIMATED_REGIONS_H
+#define SOLARUS_NON_ANIMATED_REGIONS_H
+
+#include "Common.h"
+#include "entities/Layer.h"
+#include "lowlevel/Grid.h"
+#include <vector>
+
+namespace solarus {
+
+/**
+ * \brief Optimizes the drawing of the tiles of a layer of a map.
+ *
+ * Non-animated tiles are pre-rendered on intermediate surfaces.
+ * The map is divided into square chunks, and the surface of a chunk is only
+ * created when the chunk gets close to the visible area.
+ * Chunks that were not visible for a while are freed when the number of
+ * chunks exceeds the memory budget of SOLARUS_TILE_CACHE_SIZE.
+ *
+ * Regions containing animated tiles are left transparent in chunks.
+ * Their tiles are drawn at each frame, but only if they are near the
+ * visible area.
+ */
+class NonAnimatedRegions {
+
+  public:
+
+    NonAnimatedRegions(Map& map, Layer layer);
+    ~NonAnimatedRegions();
+
+    void clear();
+    void build(const std::vector<Tile*>& tiles);
+    void notify_tileset_changed();
+    void draw_on_map();
+
+    static const int chunk_size = 256;           /**< Width and height of a chunk in pixels. */
+
+  private:
+
+    bool overlaps_animated_tile(const Tile& tile) const;
+    Rectangle get_chunk_rectangle(int index) const;
+    void build_chunk(int index);
+    void free_chunk(int index);
+    void free_old_chunks();
+
+    Map& map;                                    /**< The map. */
+    Layer layer;                                 /**< Layer of the tiles handled. */
+    int map_width8;                              /**< Number of 8x8 squares on a row of the map. */
+    int map_height8;                             /**< Number of 8x8 squares on a column of the map. */
+    std::vector<bool> animated_squares;          /**< Whether each 8x8 square of the map
+                                                  * contains an animated tile. */
+    Grid<Tile*> non_animated_tiles;              /**< Tiles to pre-render on chunks. */
+    Grid<Tile*> tiles_in_animated_regions;       /**< Animated tiles and tiles overlapping
+                                                  * them, drawn at each frame. */
+
+    int num_columns;                             /**< Number of columns of chunks. */
+    int num_rows;                                /**< Number of rows of chunks. */
+    std::vector<Surface*> chunks;                /**< Surface of each chunk, or NULL if it
+                                                  * is not built or has no tile. */
+    std::vector<bool> chunks_built;              /**< Whether each chunk is built. */
+    std::vector<uint32_t> chunks_last_used;      /**< Frame when each chunk was last
+                                                  * near the visible area. */
+    int num_chunks_built;                        /**< Number of chunks with a surface. */
+    int max_chunks_built;                        /**< Budget of chunks with a surface. */
+    uint32_t frame_number;                       /**< Number of calls to draw_on_map(). */
+
+};
+
+}
+
+#endif
+
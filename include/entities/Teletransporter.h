@@ -50,6 +50,11 @@ class Teletransporter: public Detector {
                                            * direction of destination_side). */
     bool transporting_hero;               /**< indicates that the hero is currently being transported
                                            * by this teletransporter */
+    bool hero_nearby;                     /**< indicates that the hero is close enough to this
+                                           * teletransporter to preload the destination map */
+
+    static const int preloading_distance = 64;  /**< distance in pixels where the hero
+                                                 * triggers the preloading of the destination map */
 
   public:
 
@@ -69,6 +74,7 @@ class Teletransporter: public Detector {
 
     EntityType get_type() const;
     void set_map(Map& map);
+    void update();
 
     bool is_obstacle_for(const MapEntity& other) const;
     bool test_collision_custom(MapEntity& entity);
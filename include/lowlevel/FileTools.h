@@ -50,6 +50,19 @@ class FileTools {
       LOCATION_WRITE_DIRECTORY,
     };
 
+    /**
+     * \brief Read-only view of the whole content of a data file.
+     *
+     * When possible, the file is mapped in memory instead of being copied.
+     * The content remains valid until data_file_close_view() is called.
+     */
+    struct DataFileView {
+      const char* data;         /**< content of the file */
+      size_t size;              /**< size of the content in bytes */
+      bool mapped;              /**< true if data is mapped from the file,
+                                 * false if it is a copy read by PhysFS */
+    };
+
     // Initialization.
     static void initialize(const CommandLine& args);
     static void quit();
@@ -67,7 +80,12 @@ class FileTools {
         char** buffer, size_t* size, bool language_specific = false);
     static void data_file_save_buffer(const std::string& file_name,
         const char* buffer, size_t size);
+    static bool data_file_try_save_buffer(const std::string& file_name,
+        const char* buffer, size_t size);
     static void data_file_close_buffer(char* buffer);
+    static DataFileView data_file_open_view(const std::string& file_name,
+        bool language_specific = false);
+    static void data_file_close_view(DataFileView& view);
     static bool data_file_delete(const std::string& file_name);
     static bool data_file_mkdir(const std::string& dir_name);
     static std::vector<std::string> data_files_enumerate(
@@ -94,6 +112,8 @@ class FileTools {
   private:
 
     static void set_solarus_write_dir(const std::string& solarus_write_dir);
+    static std::string get_full_file_name(const std::string& file_name,
+        bool language_specific);
 
     static std::string quest_path;                       /**< Path of the data/ directory, the data.solarus archive
                                                           * or the data.solarus.zip archive,
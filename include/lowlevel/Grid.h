@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_GRID_H
+#define SOLARUS_GRID_H
+
+#include "Common.h"
+#include "lowlevel/Rectangle.h"
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdint.h>
+
+namespace solarus {
+
+/**
+ * \brief A uniform grid that indexes elements by their bounding box.
+ *
+ * The space is divided into square cells of fixed size.
+ * Each element is stored in every cell its bounding box overlaps,
+ * so that finding the elements near a rectangle only costs the few cells
+ * touched by this rectangle instead of a traversal of all elements.
+ * Elements partially or totally outside the grid are stored in the nearest
+ * cells of the border.
+ *
+ * Elements are returned in the order in which they were added, exactly like
+ * a list would, because callers may rely on this order
+ * (for example, the last ground modifier added wins).
+ *
+ * \param T Type of elements. It must be copyable and comparable with
+ * operator< (typically a pointer).
+ */
+template<typename T>
+class Grid {
+
+  public:
+
+    Grid();
+
+    void initialize(int width, int height, int cell_size);
+    void clear();
+
+    int get_num_elements() const;
+    bool has_element(const T& element) const;
+    void add(const T& element, const Rectangle& bounding_box);
+    void remove(const T& element);
+    void move(const T& element, const Rectangle& bounding_box);
+
+    void get_elements(const Rectangle& where, std::vector<T>& elements) const;
+    bool has_elements(const Rectangle& where) const;
+
+  private:
+
+    /**
+     * \brief An element stored in a cell.
+     */
+    struct Entry {
+      uint32_t order;            /**< Rank of the element in the insertion order. */
+      T element;                 /**< The element. */
+    };
+
+    /**
+     * \brief The cells currently occupied by an element.
+     */
+    struct Location {
+      uint32_t order;            /**< Rank of the element in the insertion order. */
+      int x1, y1, x2, y2;        /**< Range of cells (inclusive). */
+    };
+
+    void get_cell_range(const Rectangle& rectangle,
+        int& x1, int& y1, int& x2, int& y2) const;
+    void add_to_cells(const Entry& entry, const Location& location);
+    void remove_from_cells(const Location& location);
+    static bool compare_order(const Entry& first, const Entry& second);
+    static bool same_order(const Entry& first, const Entry& second);
+
+    int cell_size;                               /**< Width and height of a cell in pixels. */
+    int num_columns;                             /**< Number of columns of cells. */
+    int num_rows;                                /**< Number of rows of cells. */
+    std::vector<std::vector<Entry> > cells;      /**< Elements stored in each cell,
+                                                  * row by row. */
+    std::map<T, Location> locations;             /**< Cells occupied by each element. */
+    uint32_t next_order;                         /**< Rank of the next element added. */
+
+};
+
+/**
+ * \brief Creates an empty grid with a single cell.
+ *
+ * Call initialize() to set the actual size of the grid.
+ */
+template<typename T>
+Grid<T>::Grid():
+  cell_size(1),
+  num_columns(1),
+  num_rows(1),
+  cells(1),
+  next_order(0) {
+
+}
+
+/**
+ * \brief Sets the size of the grid and removes all elements.
+ * \param width Width of the area to index in pixels.
+ * \param height Height of the area to index in pixels.
+ * \param cell_size Width and height of a cell in pixels.
+ */
+template<typename T>
+void Grid<T>::initialize(int width, int height, int cell_size) {
+
+  this->cell_size = std::max(cell_size, 1);
+  num_columns = std::max((width + this->cell_size - 1) / this->cell_size, 1);
+  num_rows = std::max((height + this->cell_size - 1) / this->cell_size, 1);
+
+  cells.clear();
+  cells.resize(num_columns * num_rows);
+  locations.clear();
+  next_order = 0;
+}
+
+/**
+ * \brief Removes all elements from the grid.
+ */
+template<typename T>
+void Grid<T>::clear() {
+
+  for (unsigned int i = 0; i < cells.size(); ++i) {
+    cells[i].clear();
+  }
+  locations.clear();
+  next_order = 0;
+}
+
+/**
+ * \brief Returns the number of elements in the grid.
+ * \return The number of elements.
+ */
+template<typename T>
+int Grid<T>::get_num_elements() const {
+  return locations.size();
+}
+
+/**
+ * \brief Returns whether an element is in the grid.
+ * \param element The element to look for.
+ * \return \c true if this element was added and not removed.
+ */
+template<typename T>
+bool Grid<T>::has_element(const T& element) const {
+  return locations.find(element) != locations.end();
+}
+
+/**
+ * \brief Adds an element to the grid.
+ *
+ * Nothing happens if the element is already in the grid.
+ *
+ * \param element The element to add.
+ * \param bounding_box Rectangle occupied by this element.
+ */
+template<typename T>
+void Grid<T>::add(const T& element, const Rectangle& bounding_box) {
+
+  if (has_element(element)) {
+    return;
+  }
+
+  Location location;
+  location.order = next_order++;
+  get_cell_range(bounding_box, location.x1, location.y1, location.x2, location.y2);
+  locations[element] = location;
+
+  Entry entry;
+  entry.order = location.order;
+  entry.element = element;
+  add_to_cells(entry, location);
+}
+
+/**
+ * \brief Removes an element from the grid.
+ *
+ * Nothing happens if the element is not in the grid.
+ *
+ * \param element The element to remove.
+ */
+template<typename T>
+void Grid<T>::remove(const T& element) {
+
+  typename std::map<T, Location>::iterator it = locations.find(element);
+  if (it == locations.end()) {
+    return;
+  }
+
+  remove_from_cells(it->second);
+  locations.erase(it);
+}
+
+/**
+ * \brief Updates the position of an element already in the grid.
+ *
+ * Nothing happens if the element is not in the grid.
+ * Moving an element does not change its rank in the insertion order.
+ * This is cheap when the element stays in the same cells, which is the case
+ * of most moves.
+ *
+ * \param element The element that has moved.
+ * \param bounding_box The new rectangle occupied by this element.
+ */
+template<typename T>
+void Grid<T>::move(const T& element, const Rectangle& bounding_box) {
+
+  typename std::map<T, Location>::iterator it = locations.find(element);
+  if (it == locations.end()) {
+    return;
+  }
+
+  Location& location = it->second;
+  int x1, y1, x2, y2;
+  get_cell_range(bounding_box, x1, y1, x2, y2);
+  if (x1 == location.x1 && y1 == location.y1
+      && x2 == location.x2 && y2 == location.y2) {
+    // Still in the same cells.
+    return;
+  }
+
+  remove_from_cells(location);
+  location.x1 = x1;
+  location.y1 = y1;
+  location.x2 = x2;
+  location.y2 = y2;
+
+  Entry entry;
+  entry.order = location.order;
+  entry.element = element;
+  add_to_cells(entry, location);
+}
+
+/**
+ * \brief Returns the elements that may overlap a rectangle.
+ *
+ * All elements stored in the cells touched by the rectangle are returned,
+ * so some of them may actually not overlap it: the caller still has to do
+ * its own precise test.
+ *
+ * \param where The rectangle to test.
+ * \param[out] elements The candidate elements are appended to this vector,
+ * each one once and in insertion order.
+ */
+template<typename T>
+void Grid<T>::get_elements(const Rectangle& where, std::vector<T>& elements) const {
+
+  int x1, y1, x2, y2;
+  get_cell_range(where, x1, y1, x2, y2);
+
+  if (x1 == x2 && y1 == y2) {
+    // Single cell: no duplicates are possible.
+    const std::vector<Entry>& cell = cells[y1 * num_columns + x1];
+    if (cell.empty()) {
+      return;
+    }
+    std::vector<Entry> found(cell);
+    std::sort(found.begin(), found.end(), compare_order);
+    for (unsigned int i = 0; i < found.size(); ++i) {
+      elements.push_back(found[i].element);
+    }
+    return;
+  }
+
+  std::vector<Entry> found;
+  for (int y = y1; y <= y2; ++y) {
+    for (int x = x1; x <= x2; ++x) {
+      const std::vector<Entry>& cell = cells[y * num_columns + x];
+      found.insert(found.end(), cell.begin(), cell.end());
+    }
+  }
+
+  std::sort(found.begin(), found.end(), compare_order);
+  typename std::vector<Entry>::iterator end =
+      std::unique(found.begin(), found.end(), same_order);
+  typename std::vector<Entry>::iterator it;
+  for (it = found.begin(); it != end; ++it) {
+    elements.push_back(it->element);
+  }
+}
+
+/**
+ * \brief Returns whether some elements may overlap a rectangle.
+ *
+ * This is a cheap test that does not build the list of elements.
+ * Like get_elements(), it may return \c true for elements that are near
+ * the rectangle but do not actually overlap it.
+ *
+ * \param where The rectangle to test.
+ * \return \c false if no element overlaps this rectangle.
+ */
+template<typename T>
+bool Grid<T>::has_elements(const Rectangle& where) const {
+
+  int x1, y1, x2, y2;
+  get_cell_range(where, x1, y1, x2, y2);
+
+  for (int y = y1; y <= y2; ++y) {
+    for (int x = x1; x <= x2; ++x) {
+      if (!cells[y * num_columns + x].empty()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief Computes the range of cells overlapped by a rectangle.
+ *
+ * Coordinates outside the grid are clamped to the border cells.
+ *
+ * \param rectangle A rectangle.
+ * \param[out] x1 Column of the first cell.
+ * \param[out] y1 Row of the first cell.
+ * \param[out] x2 Column of the last cell.
+ * \param[out] y2 Row of the last cell.
+ */
+template<typename T>
+void Grid<T>::get_cell_range(const Rectangle& rectangle,
+    int& x1, int& y1, int& x2, int& y2) const {
+
+  const int width = std::max(rectangle.get_width(), 1);
+  const int height = std::max(rectangle.get_height(), 1);
+
+  x1 = std::min(std::max(rectangle.get_x() / cell_size, 0), num_columns - 1);
+  y1 = std::min(std::max(rectangle.get_y() / cell_size, 0), num_rows - 1);
+  x2 = std::min(std::max((rectangle.get_x() + width - 1) / cell_size, 0), num_columns - 1);
+  y2 = std::min(std::max((rectangle.get_y() + height - 1) / cell_size, 0), num_rows - 1);
+}
+
+/**
+ * \brief Stores an entry in a range of cells.
+ * \param entry The entry to store.
+ * \param location The range of cells.
+ */
+template<typename T>
+void Grid<T>::add_to_cells(const Entry& entry, const Location& location) {
+
+  for (int y = location.y1; y <= location.y2; ++y) {
+    for (int x = location.x1; x <= location.x2; ++x) {
+      cells[y * num_columns + x].push_back(entry);
+    }
+  }
+}
+
+/**
+ * \brief Removes an element from the range of cells where it is stored.
+ * \param location Location of the element to remove.
+ */
+template<typename T>
+void Grid<T>::remove_from_cells(const Location& location) {
+
+  for (int y = location.y1; y <= location.y2; ++y) {
+    for (int x = location.x1; x <= location.x2; ++x) {
+      std::vector<Entry>& cell = cells[y * num_columns + x];
+      typename std::vector<Entry>::iterator it;
+      for (it = cell.begin(); it != cell.end(); ++it) {
+        if (it->order == location.order) {
+          cell.erase(it);
+          break;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * \brief Compares two entries by insertion order.
+ * \param first An entry.
+ * \param second Another entry.
+ * \return \c true if the first one was added before the second one.
+ */
+template<typename T>
+bool Grid<T>::compare_order(const Entry& first, const Entry& second) {
+  return first.order < second.order;
+}
+
+/**
+ * \brief Returns whether two entries represent the same element.
+ * \param first An entry.
+ * \param second Another entry.
+ * \return \c true if they have the same insertion order.
+ */
+template<typename T>
+bool Grid<T>::same_order(const Entry& first, const Entry& second) {
+  return first.order == second.order;
+}
+
+}
+
+#endif
+
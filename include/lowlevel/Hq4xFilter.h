@@ -37,7 +37,9 @@ class Hq4xFilter: public PixelFilter {
         const uint32_t* src,
         int src_width,
         int src_height,
-        uint32_t* dst) const;
+        int src_pitch,
+        uint32_t* dst,
+        int dst_pitch) const;
 
     static void initialize_hqx();
 };
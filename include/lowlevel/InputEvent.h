@@ -249,6 +249,9 @@ class InputEvent {
     // window event
     bool is_window_closing() const;
 
+    // date
+    uint32_t get_date() const;
+
   private:
 
     InputEvent(const SDL_Event& event);
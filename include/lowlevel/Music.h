@@ -19,6 +19,7 @@
 
 #include "Common.h"
 #include "lowlevel/Sound.h"
+#include <SDL.h>
 
 namespace solarus {
 
@@ -31,6 +32,10 @@ namespace solarus {
  * Before using this class, the audio system should have been
  * initialized, by calling Sound::initialize().
  * Sound and Music are the only classes that depends on audio libraries.
+ *
+ * The music is decoded by a dedicated thread into a ring of chunks.
+ * The main loop only moves decoded chunks into the OpenAL buffers,
+ * so a slow frame never makes the game thread decode audio.
  */
 class Music { // TODO make a subclass for each format, or at least make a better separation between them
 
@@ -76,14 +81,31 @@ class Music { // TODO make a subclass for each format, or at least make a better
 
   private:
 
+    /**
+     * \brief A chunk of decoded PCM data waiting to be given to OpenAL.
+     *
+     * The data vector is allocated once and reused for every chunk.
+     */
+    struct DecodedChunk {
+      std::vector<char> data;                    /**< decoded samples */
+      ALsizei size;                              /**< number of bytes actually decoded */
+      ALenum format;                             /**< OpenAL format of the samples */
+      ALsizei sample_rate;                       /**< sample rate in Hz */
+    };
+
     bool start();
     void stop();
     bool is_paused();
     void set_paused(bool pause);
 
-    void decode_spc(ALuint destination_buffer, ALsizei nb_samples);
-    void decode_it(ALuint destination_buffer, ALsizei nb_samples);
-    void decode_ogg(ALuint destination_buffer, ALsizei nb_samples);
+    bool decode_chunk(DecodedChunk& chunk);
+    bool decode_spc(DecodedChunk& chunk, ALsizei nb_samples);
+    bool decode_it(DecodedChunk& chunk, ALsizei nb_samples);
+    bool decode_ogg(DecodedChunk& chunk, ALsizei nb_samples);
+
+    void start_decoding_thread();
+    void stop_decoding_thread();
+    static int decoding_thread_main(void* music);
 
     void update_playing();
 
@@ -95,10 +117,21 @@ class Music { // TODO make a subclass for each format, or at least make a better
     OggVorbis_File ogg_file;                     /**< the file used by the vorbisfile lib */
     Sound::SoundFromMemory ogg_mem;              /**< the encoded music loaded in memory, passed to the vorbisfile lib as user data */
 
-    static const int nb_buffers = 8;
+    static const int nb_buffers = SOLARUS_MUSIC_NUM_BUFFERS;
+    static const int buffer_size = SOLARUS_MUSIC_BUFFER_SIZE;
     ALuint buffers[nb_buffers];                  /**< multiple buffers used to stream the music */
+    std::vector<ALuint> free_buffers;            /**< buffers unqueued and waiting for decoded data */
     ALuint source;                               /**< the OpenAL source streaming the buffers */
 
+    // Single producer, single consumer ring between the decoding thread and
+    // the main thread. Only the indices are shared, and they are atomic.
+    static DecodedChunk decoded_chunks[nb_buffers];  /**< the ring of decoded chunks */
+    static SDL_atomic_t nb_chunks_written;       /**< total number of chunks produced by the decoding thread */
+    static SDL_atomic_t nb_chunks_read;          /**< total number of chunks consumed by the main thread */
+    static SDL_atomic_t decoding_stopped;        /**< tells the decoding thread to finish */
+    static SDL_Thread* decoding_thread;          /**< the thread decoding the current music */
+    static SDL_mutex* decoder_mutex;             /**< protects the decoders when changing their settings */
+
     static SpcDecoder* spc_decoder;              /**< the SPC decoder */
     static ItDecoder* it_decoder;                /**< the IT decoder */
     static float volume;                         /**< volume of musics (0.0 to 1.0) */
@@ -18,19 +18,37 @@
 #define SOLARUS_PIXEL_FILTER_H
 
 #include "Common.h"
+#include <SDL.h>
+#include <vector>
 
 namespace solarus {
 
 /**
  * \brief Abstract class for pixel filtering algorithms.
+ *
+ * Whole frames can be split into horizontal bands filtered in parallel by
+ * the main thread and the workers of WorkerPool.
  */
 class PixelFilter {
 
   public:
 
+    static void quit();
+
+    static int get_num_threads();
+    static void set_num_threads(int num_threads);
+
     PixelFilter();
     virtual ~PixelFilter();
 
+    void filter_in_bands(
+        const uint32_t* src,
+        int src_width,
+        int src_height,
+        int src_pitch,
+        uint32_t* dst,
+        int dst_pitch) const;
+
     /**
      * \brief Returns the scaling factor of this algorithm.
      * \return The scaling factor.
@@ -39,19 +57,34 @@ class PixelFilter {
 
     /**
      * \brief Applies the algorithm on a rectangle of pixels.
-     * \param src The rectangle of pixels in RGBA format.
-     * Must be a buffer of size src_width * dst_width.
+     *
+     * The rectangle may be part of a bigger image: pixels outside the
+     * rectangle are never read.
+     *
+     * \param src The first pixel of the rectangle, in RGBA format.
      * \param src_width Width of the rectangle.
-     * \param dst_width Height of the rectangle.
-     * \param dst The destination rectangle to write.
-     * Must be a buffer of size
-     * src_width * dst_width * get_scaling_factor().
+     * \param src_height Height of the rectangle.
+     * \param src_pitch Number of pixels between two rows of the source.
+     * \param dst The destination rectangle to write. Its size is the source
+     * size multiplied by get_scaling_factor().
+     * \param dst_pitch Number of pixels between two rows of the destination.
      */
     virtual void filter(
         const uint32_t* src,
         int src_width,
         int src_height,
-        uint32_t* dst) const = 0;
+        int src_pitch,
+        uint32_t* dst,
+        int dst_pitch) const = 0;
+
+  private:
+
+    class Band;
+
+    static std::vector<Band*> bands;  /**< bands of the last frame filtered, kept
+                                       * to reuse their buffers */
+    static int num_threads;           /**< maximum number of bands of a frame,
+                                       * or 0 to use all workers */
 };
 
 }
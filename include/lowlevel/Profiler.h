@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_PROFILER_H
+#define SOLARUS_PROFILER_H
+
+#include "Common.h"
+#include <string>
+#include <vector>
+
+#ifdef SOLARUS_PROFILING
+#define SOLARUS_PROFILE(section) \
+  Profiler::ScopedTimer profiler_scoped_timer(Profiler::section)
+#define SOLARUS_PROFILE_FRAME_FINISHED() Profiler::notify_frame_finished()
+#else
+#define SOLARUS_PROFILE(section)
+#define SOLARUS_PROFILE_FRAME_FINISHED()
+#endif
+
+namespace solarus {
+
+/**
+ * \brief Measures the time spent in the main parts of the engine.
+ *
+ * Timers are placed around hot paths with the SOLARUS_PROFILE() macro.
+ * The time measured is accumulated during each cycle of the main loop and
+ * the last cycles are kept to compute rolling statistics.
+ *
+ * The profiler only exists if the engine is compiled with
+ * SOLARUS_PROFILING defined (CMake option PROFILING).
+ * Otherwise, the macros expand to nothing and there is no cost at all.
+ */
+class Profiler {
+
+  public:
+
+    /**
+     * \brief The parts of the engine that are measured.
+     *
+     * Sections may be nested: for example, the time of SECTION_ENTITIES_UPDATE
+     * is also counted in SECTION_GAME_UPDATE.
+     */
+    enum Section {
+      SECTION_FRAME,              /**< a whole cycle of the main loop, sleep included */
+      SECTION_INPUT,              /**< MainLoop::check_input() */
+      SECTION_GAME_UPDATE,        /**< Game::update() */
+      SECTION_ENTITIES_UPDATE,    /**< MapEntities::update() */
+      SECTION_LUA_UPDATE,         /**< LuaContext::update() (timers, menus) */
+      SECTION_MUSIC_UPDATE,       /**< Music::update() */
+      SECTION_DRAW,               /**< MainLoop::draw() */
+      SECTION_MAP_DRAW,           /**< Map::draw() */
+      SECTION_MAP_LOAD,           /**< Map::load() */
+      SECTION_VIDEO_RENDER,       /**< Video::render() */
+      SECTION_NB
+    };
+
+    /**
+     * \brief Statistics of a section over the last cycles.
+     *
+     * All durations are in milliseconds.
+     */
+    struct Statistics {
+      double min;                 /**< shortest cycle */
+      double average;             /**< average cycle */
+      double max;                 /**< longest cycle */
+      double p99;                 /**< 99th percentile */
+    };
+
+    /**
+     * \brief Measures the time spent until the end of the current scope.
+     */
+    class ScopedTimer {
+
+      public:
+
+        explicit ScopedTimer(Section section);
+        ~ScopedTimer();
+
+      private:
+
+        Section section;          /**< the section measured */
+        uint64_t start_counter;   /**< value of the performance counter when created */
+    };
+
+    static bool is_enabled();
+    static const std::string& get_section_name(Section section);
+
+    static void add_time(Section section, uint64_t counter_ticks);
+    static void notify_frame_finished();
+
+    static int get_num_frames();
+    static Statistics get_statistics(Section section);
+    static bool save(const std::string& file_name);
+
+    static const int max_frames = 600;  /**< number of cycles kept for statistics */
+
+  private:
+
+    Profiler();    // don't instantiate this class
+
+    static uint64_t current_frame[SECTION_NB];        /**< time spent so far in the current cycle
+                                                       * (in performance counter ticks) */
+    static std::vector<uint32_t> frames[SECTION_NB];  /**< time spent in the last cycles in microseconds
+                                                       * (circular buffer) */
+    static int next_frame;                            /**< index where the next cycle will be stored */
+    static const std::string section_names[];         /**< Lua names of sections */
+};
+
+}
+
+#endif
+
@@ -21,6 +21,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <al.h>
 #include <alc.h>
 #include <vorbis/vorbisfile.h>
@@ -35,6 +36,10 @@ namespace solarus {
  * rather than calling directly the constructor of Sound.
  * This class is the only one that depends on the sound decoding library (libsndfile).
  * This class and the Music class are the only ones that depend on the audio mixer library (OpenAL).
+ *
+ * Sound effects are played by a fixed pool of OpenAL sources (voices)
+ * created once. When all voices are busy, the least important sound
+ * is stopped to play a new one, or the new one is not played at all.
  */
 class Sound {
 
@@ -56,6 +61,16 @@ class Sound {
     static ov_callbacks ogg_callbacks;           /**< vorbisfile object used to load the encoded sound from memory */
     static size_t cb_read(void* ptr, size_t size, size_t nmemb, void* datasource);
 
+    /**
+     * \brief Counters about the voices playing sound effects.
+     */
+    struct VoiceStatistics {
+      int num_voices;                            /**< number of OpenAL sources in the pool */
+      int num_active_voices;                     /**< number of sources currently playing a sound */
+      int num_steals;                            /**< number of sounds stopped to play another one */
+      int num_rejected_plays;                    /**< number of sounds not played because all voices were more important */
+    };
+
     Sound(const std::string& sound_id = "");
     ~Sound();
     void load();
@@ -64,6 +79,9 @@ class Sound {
     static void load_all();
     static bool exists(const std::string& sound_id);
     static void play(const std::string& sound_id);
+    static void set_priority(const std::string& sound_id, int priority);
+    static void set_max_instances(const std::string& sound_id, int max_instances);
+    static VoiceStatistics get_voice_statistics();
 
     static void initialize(const CommandLine& args);
     static void quit();
@@ -75,21 +93,45 @@ class Sound {
 
   private:
 
+    /**
+     * \brief An OpenAL source of the pool, possibly playing a sound.
+     */
+    struct Voice {
+      ALuint source;                             /**< the preallocated OpenAL source */
+      Sound* sound;                              /**< the sound playing, or NULL if the voice is free */
+      uint32_t play_index;                       /**< when the sound was started (to find the oldest one) */
+    };
+
     static ALCdevice* device;
     static ALCcontext* context;
 
     std::string id;                              /**< id of this sound */
     ALuint buffer;                               /**< the OpenAL buffer containing the PCM decoded data of this sound */
-    std::list<ALuint> sources;                   /**< the sources currently playing this sound */
-    static std::list<Sound*> current_sounds;     /**< the sounds currently playing */
+    int priority;                                /**< a sound can only stop sounds with a lower or equal priority */
+    int max_instances;                           /**< maximum number of voices playing this sound at the same time (0 means no limit) */
+    int num_instances;                           /**< number of voices currently playing this sound */
     static std::map<std::string, Sound> all_sounds;   /**< all sounds created before */
 
+    static std::vector<Voice> voices;            /**< the pool of sources for sound effects */
+    static uint32_t num_plays;                   /**< number of sounds started so far */
+    static VoiceStatistics statistics;           /**< steal and rejection counters */
+
     static bool initialized;                     /**< indicates that the audio system is initialized */
     static bool sounds_preloaded;                /**< true if load_all() was called */
     static float volume;                         /**< the volume of sound effects (0.0 to 1.0) */
 
+    class DecodingJob;
+
+    std::string get_file_name() const;
     ALuint decode_file(const std::string &file_name);
-    bool update_playing();
+    static bool decode_samples(const std::string& file_name,
+        std::vector<char>& samples, ALsizei& sample_rate);
+    static ALuint create_buffer(const std::string& file_name,
+        const std::vector<char>& samples, ALsizei sample_rate);
+    static Sound& get(const std::string& sound_id);
+    Voice* get_voice();
+    static bool is_finished(const Voice& voice);
+    static void release_voice(Voice& voice);
 
 };
 
@@ -21,10 +21,13 @@
 #include "Drawable.h"
 #include "lowlevel/Rectangle.h"
 #include "lowlevel/PixelBits.h"
+#include <map>
+#include <string>
 #include <vector>
 
 typedef struct SDL_Surface SDL_Surface;
 typedef struct SDL_Texture SDL_Texture;
+typedef struct SDL_mutex SDL_mutex;
 
 namespace solarus {
 
@@ -52,6 +55,34 @@ class Surface: public Drawable {
       DIR_LANGUAGE     /**< the language-specific image directory of the data package, for the current language */
     };
 
+    /**
+     * \brief Statistics of the cache of images loaded from files.
+     */
+    struct ImageCacheStatistics {
+      int num_images;                     /**< number of images in the cache */
+      int num_unused_images;              /**< images not used by any surface anymore */
+      uint64_t num_bytes;                 /**< size of the pixels of all images in the cache */
+      int num_hits;                       /**< number of images found in the cache */
+      int num_misses;                     /**< number of images decoded from a file */
+    };
+
+    /**
+     * \brief Statistics of the drawing operations recorded for the GPU.
+     */
+    struct DrawStatistics {
+      int num_commands;                   /**< drawing commands recorded during the last frame */
+      uint64_t num_bytes;                 /**< memory used by these commands */
+      int num_draw_calls;                 /**< calls submitted to the renderer during the last frame */
+      int num_texture_switches;           /**< changes of texture between these calls */
+    };
+
+    static void initialize();
+    static void quit();
+    static ImageCacheStatistics get_image_cache_statistics();
+    static void purge_image_cache();
+    static DrawStatistics get_draw_statistics();
+    static void finish_frame();
+
     ~Surface();
 
     // Constructors are private so that surfaces are only created on the heap.
@@ -72,7 +103,19 @@ class Surface: public Drawable {
     void fill_with_color(Color& color);
     void fill_with_color(Color& color, const Rectangle& where);
 
+    void draw_region_with_opacity(
+        const Rectangle& region,
+        Surface& dst_surface,
+        const Rectangle& dst_position,
+        int opacity);
+    void draw_region_with_color(
+        const Rectangle& region,
+        Surface& dst_surface,
+        const Rectangle& dst_position,
+        const Color& color);
+
     void apply_pixel_filter(const PixelFilter& pixel_filter, Surface& dst_surface);
+    void copy_pixels(std::vector<uint32_t>& pixels) const;
 
     void render(SDL_Renderer* renderer);
 
@@ -93,7 +136,46 @@ class Surface: public Drawable {
 
   private:
 
-    class SubSurfaceNode;
+    class SharedImage;
+    class AtlasPage;
+
+    /**
+     * \brief A drawing operation onto a GPU surface, executed at rendering
+     * time.
+     *
+     * When a surface is drawn onto a GPU surface, its own commands are
+     * copied into the destination, so that each surface has a flat list of
+     * commands to execute.
+     */
+    struct DrawCommand {
+      Surface* src_surface;               /**< surface whose texture is drawn, or NULL to fill a color */
+      Rectangle src_position;             /**< region of the source surface to draw */
+      Rectangle dst_position;             /**< where to draw it on the destination surface */
+      Rectangle clip;                     /**< the drawing is restricted to this rectangle */
+      uint8_t opacity;                    /**< opacity of the drawing (0 to 255) */
+      uint8_t color[4];                   /**< red, green, blue and alpha components of the color to fill,
+                                           * or to multiply the source surface with */
+    };
+
+    /**
+     * \brief A draw command ready to be submitted to the renderer.
+     */
+    struct RenderItem {
+      SDL_Texture* texture;               /**< texture to draw, or NULL to fill a color */
+      Rectangle src_position;             /**< region of the texture to draw */
+      Rectangle dst_position;             /**< where to draw it, already clipped */
+      uint8_t color[4];                   /**< color to fill or to modulate the texture with */
+    };
+
+    /**
+     * \brief Consecutive render items using the same texture, submitted at once.
+     */
+    struct RenderBatch {
+      SDL_Texture* texture;               /**< texture of all items, or NULL for color fillings */
+      Rectangle bounds;                   /**< area covered by the items */
+      int first;                          /**< index of the first item in the render order */
+      int num_items;                      /**< number of items */
+    };
 
     Surface(int width, int height);
     explicit Surface(SDL_Surface* internal_surface);
@@ -106,29 +188,76 @@ class Surface: public Drawable {
         ImageDirectory base_directory);
 
     void create_software_surface();
+    void make_image_private();
+    void release_shared_image();
     void convert_software_surface();
     void create_texture_from_surface();
-    void add_subsurface(Surface& src_surface, const Rectangle& region, const Rectangle& dst_position);
-    void clear_subsurfaces();
-    void render(
-        SDL_Renderer* renderer,
-        const Rectangle& src_rect,
-        const Rectangle& dst_rect,
-        const Rectangle& clip_rect,
-        int opacity,
-        const std::vector<SubSurfaceNode*>& subsurfaces
-    );
-
-    std::vector<SubSurfaceNode*> subsurfaces;      /**< Source Subsurfaces not in the tree yet */
+    bool update_texture();
+    void set_modified();
+    void add_damaged_region(const Rectangle& region);
+    void apply_pixel_filter_region(const PixelFilter& pixel_filter,
+        Surface& dst_surface, const Rectangle& region);
+    Rectangle get_texture_position(const Rectangle& region) const;
+    void draw_region_modulated(const Rectangle& region, Surface& dst_surface,
+        const Rectangle& dst_position, const uint8_t modulation[4]);
+    void add_draw_commands(Surface& src_surface, const Rectangle& region,
+        const Rectangle& dst_position, const uint8_t modulation[4]);
+    void add_draw_command(const DrawCommand& command);
+    void prepare_draw_commands();
+    void clear_draw_commands();
+    void execute_draw_commands_in_software();
+
+    static void pack_in_atlas(SharedImage& image);
+    static void purge_atlas_pages();
+    static void add_render_item(const RenderItem& item);
+    static void submit_render_batch(SDL_Renderer* renderer, const RenderBatch& batch);
 
     bool software_destination;            /**< indicates that this surface is modified on software side
                                            * (and therefore immediately) when used as a destination */
     SDL_Surface* internal_surface;        /**< the SDL_Surface encapsulated, if any. */
     SDL_Texture* internal_texture;        /**< the SDL_Texture encapsulated, if any. */
-    Color* internal_color;                /**< the background color to use, if any. */
-    bool is_rendered;                     /**< indicates if the current surface has been rendered. Set to false when drawing a surface on this one. */
+    bool is_rendered;                     /**< indicates if the current surface has been rendered since its pixels last changed. Set to false when drawing a surface on this one. */
     int internal_opacity;                 /**< opacity to apply to all subtexture. */
     int width, height;                    /**< size of the texture, avoid to use SDL_QueryTexture. */
+    SharedImage* shared_image;            /**< image loaded from a file that internal_surface and
+                                           * internal_texture belong to, if they are shared with
+                                           * other surfaces. */
+    std::vector<DrawCommand> draw_commands;   /**< Drawings to perform at rendering time (the buffer is reused) */
+    std::vector<Surface*> retained_surfaces;  /**< Sources of the draw commands, kept alive until the commands are cleared */
+    uint32_t draw_commands_generation;    /**< incremented each time the draw commands are cleared */
+    uint32_t draw_commands_drawn_frame;   /**< last frame when this surface was drawn or rendered with its
+                                           * draw commands (0 if never): drawing on it in a later frame
+                                           * starts a new list */
+    Surface* retained_by;                 /**< last surface whose draw commands retained this surface */
+    uint32_t retained_generation;         /**< generation of these draw commands */
+    std::vector<Rectangle>
+        damaged_regions;                  /**< parts of the software surface modified since the texture
+                                           * was updated (empty with is_rendered false: everything) */
+    const PixelFilter* pixel_filter;      /**< pixel filter that produced the current pixels, if any */
+    std::vector<uint32_t>
+        pixel_filter_source;              /**< copy of the pixels that pixel_filter was applied to */
+
+    static std::map<std::string, SharedImage*>
+        image_cache;                      /**< images loaded from files, indexed by file */
+    static SDL_mutex* image_cache_mutex;  /**< protects the image cache from concurrent accesses */
+    static int image_cache_hits;          /**< number of images found in the cache */
+    static int image_cache_misses;        /**< number of images decoded from a file */
+    static std::vector<AtlasPage*>
+        atlas_pages;                      /**< textures where small images are packed together */
+
+    static uint32_t current_frame;        /**< number of the frame being drawn, starting at 1 */
+    static int num_draw_commands;         /**< draw commands recorded during the current frame */
+    static int num_draw_calls;            /**< calls submitted to the renderer during the current frame */
+    static int num_texture_switches;      /**< texture changes between these calls */
+    static std::vector<RenderItem>
+        render_items;                     /**< items of the surface being rendered, in drawing order */
+    static std::vector<int>
+        render_item_batches;              /**< batch of each render item */
+    static std::vector<int> render_order; /**< indexes of the render items, grouped by batch */
+    static std::vector<RenderBatch>
+        render_batches;                   /**< batches of the surface being rendered */
+    static DrawStatistics
+        last_frame_draw_statistics;       /**< draw commands recorded during the previous frame */
 };
 
 }
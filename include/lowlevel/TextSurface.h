@@ -23,6 +23,7 @@
 #include "lowlevel/Rectangle.h"
 #include <SDL_ttf.h>
 #include <map>
+#include <vector>
 
 struct lua_State;
 
@@ -38,6 +39,15 @@ namespace solarus {
  * Two types of fonts are supported:
  * - usual fonts (TTF and other formats are supported),
  * - an image containing characters drawn.
+ *
+ * The text is not rendered into a surface of its own: it is drawn glyph by
+ * glyph from an image that contains the characters.
+ * For bitmap fonts, this is the font image itself.
+ * For usual fonts, glyphs are rendered in white on demand into an atlas
+ * shared by all texts with the same font and rendering mode, and they are
+ * drawn multiplied by the color of the text.
+ * Therefore, changing the text only computes the position of each glyph,
+ * and changing the color computes nothing.
  */
 class TextSurface: public Drawable {
 
@@ -80,6 +90,7 @@ class TextSurface: public Drawable {
     ~TextSurface();
 
     static bool has_font(const std::string& font_id);
+    static void load_fonts_if_needed();
     const std::string& get_font() const;
     void set_font(const std::string& font_id);
     HorizontalAlignment get_horizontal_alignment() const;
@@ -118,6 +129,17 @@ class TextSurface: public Drawable {
 
   private:
 
+    class GlyphAtlas;
+
+    /**
+     * \brief A character of the text, drawn from an image of glyphs.
+     */
+    struct GlyphQuad {
+      Surface* src_surface;                           /**< image containing the glyph (atlas page or bitmap font) */
+      Rectangle src_position;                         /**< the glyph in this image */
+      Rectangle dst_position;                         /**< where to draw it, relative to the top-left corner of the text */
+    };
+
     /**
      * This structures stores the data of a font.
      */
@@ -136,11 +158,17 @@ class TextSurface: public Drawable {
     void rebuild();
     void rebuild_bitmap();
     void rebuild_ttf();
+    void draw_glyphs(const Rectangle& region,
+        Surface& dst_surface, const Rectangle& dst_position);
+    Surface& get_intermediate_surface();
 
     static bool fonts_loaded;                         /**< Whether fonts.dat was read. */
     static std::map<std::string, FontData> fonts;     /**< the data of each font, loaded from the file text/fonts.dat
                                                        * (fond id -> font data) */
     static std::string default_font_id;               /**< id of the default font to use */
+    static std::map<std::string, GlyphAtlas*>
+        glyph_atlases;                                /**< glyphs already rendered for each font
+                                                       * and rendering mode */
 
     std::string font_id;                              /**< id of the font of the current text surface */
     HorizontalAlignment horizontal_alignment;         /**< horizontal alignment of the current text surface */
@@ -150,8 +178,13 @@ class TextSurface: public Drawable {
 
     int x;                                            /**< x coordinate of where the text is aligned */
     int y;                                            /**< y coordinate of where the text is aligned */
-    Surface* surface;                                 /**< the surface to draw */
-    Rectangle text_position;                          /**< position of the top-left corner of the surface on the screen */
+    std::vector<GlyphQuad> glyphs;                    /**< layout of the current text, computed when it changes */
+    int width;                                        /**< width of the current text in pixels */
+    int height;                                       /**< height of the current text in pixels */
+    Surface* intermediate_surface;                    /**< the text drawn on a surface, only used for transitions */
+    Surface* text_surface;                            /**< the whole text rendered by SDL_ttf, only used when
+                                                       * it cannot apply kerning between two glyphs */
+    Rectangle text_position;                          /**< position of the top-left corner of the text on the screen */
 
     std::string text;                                 /**< the string to draw (only one line) */
 
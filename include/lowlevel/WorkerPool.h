@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_WORKER_POOL_H
+#define SOLARUS_WORKER_POOL_H
+
+#include "Common.h"
+#include <SDL.h>
+#include <deque>
+#include <vector>
+
+namespace solarus {
+
+/**
+ * \brief A fixed set of threads that execute jobs in parallel.
+ *
+ * Loading jobs are added with add_job(). Each one has a part executed by
+ * any worker thread, that must not touch anything shared (like decoding a
+ * file), and a part executed later by the main thread (like creating an
+ * OpenAL buffer or a texture).
+ *
+ * Short jobs that the main thread needs right now, like the bands of a
+ * frame to filter, are executed with execute_now() before loading jobs.
+ *
+ * The number of workers is set with the -workers=N command-line option.
+ * With zero workers, jobs are executed immediately by the main thread.
+ */
+class WorkerPool {
+
+  public:
+
+    /**
+     * \brief A unit of work executed by the pool.
+     */
+    class Job {
+
+      public:
+
+        virtual ~Job();
+
+        /**
+         * \brief Does the work that can be done in any thread.
+         */
+        virtual void execute() = 0;
+
+        virtual void finish();
+    };
+
+    static void initialize(const CommandLine& args);
+    static void quit();
+
+    static int get_num_workers();
+    static void add_job(Job* job);
+    static void wait_all();
+    static void execute_now(const std::vector<Job*>& jobs);
+
+  private:
+
+    static int run(void* data);
+
+    static std::vector<SDL_Thread*> threads;     /**< The worker threads. */
+    static SDL_mutex* mutex;                     /**< Protects the fields below. */
+    static SDL_cond* job_added;                  /**< Signaled when a job is added or when quitting. */
+    static SDL_cond* job_executed;               /**< Signaled when a job is executed. */
+    static std::deque<Job*> pending_jobs;        /**< Jobs not executed yet. */
+    static int num_jobs_executing;               /**< Number of jobs being executed by workers. */
+    static bool quitting;                        /**< Whether workers should stop. */
+    static std::vector<Job*> jobs;               /**< All jobs added since the last wait_all(),
+                                                  * in the order they were added. */
+    static std::deque<Job*> urgent_jobs;         /**< Jobs of execute_now() not executed yet. */
+    static int num_urgent_jobs_left;             /**< Jobs of execute_now() not finished yet. */
+
+};
+
+}
+
+#endif
+
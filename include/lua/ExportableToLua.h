@@ -20,6 +20,7 @@
 #include "Common.h"
 #include "RefCountable.h"
 #include <string>
+#include <bitset>
 
 namespace solarus {
 
@@ -52,6 +53,13 @@ class ExportableToLua: public RefCountable {
     void set_known_to_lua(bool known_to_lua);
     bool is_with_lua_table() const;
     void set_with_lua_table(bool with_lua_table);
+    int get_lua_userdata_ref() const;
+    void set_lua_userdata_ref(int lua_userdata_ref);
+    bool has_lua_event(int event) const;
+    void set_lua_event(int event, bool defined);
+
+    static const int max_lua_events = 128;  /**< Maximum number of distinct
+                                             * events known by LuaContext. */
 
     /**
      * \brief Returns the name identifying this type in Lua.
@@ -65,6 +73,12 @@ class ExportableToLua: public RefCountable {
                                   * at least once. */
     bool with_lua_table;         /**< Whether a Lua table was created to make
                                   * this userdata indexable like a table. */
+    int lua_userdata_ref;        /**< Index of the full userdata in the Lua
+                                  * table of all userdata, or LUA_NOREF. It may
+                                  * be obsolete if the userdata was collected. */
+    std::bitset<max_lua_events>
+        lua_events;              /**< Events of LuaContext defined as fields
+                                  * of this userdata, like on_update. */
 
 };
 
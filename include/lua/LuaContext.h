@@ -27,6 +27,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <queue>
 #include <lua.hpp>
 
 namespace solarus {
@@ -190,6 +191,7 @@ class LuaContext {
     void destroy_timers();
     void update_timers();
     void notify_timers_map_suspended(bool suspended);
+    void reschedule_timer(Timer* timer);
 
     // Menus.
     void add_menu(int menu_ref, int context_index, bool on_top);
@@ -214,6 +216,10 @@ class LuaContext {
     static Map& get_entity_creation_map(lua_State* l);
     static Map* get_entity_implicit_creation_map(lua_State* l);
     static void set_entity_implicit_creation_map(lua_State* l, Map* map);
+    static void check_tile_fields(lua_State* l, int table_index,
+        int& layer, int& x, int& y, int& width, int& height, int& pattern_id);
+    static void create_tiles(Map& map, int layer, int x, int y,
+        int width, int height, int pattern_id);
 
     // Main loop events (sol.main).
     void main_on_started();
@@ -370,12 +376,20 @@ class LuaContext {
       main_api_save_settings,
       main_api_get_distance,  // TODO remove?
       main_api_get_angle,     // TODO remove?
+      main_api_get_input_stats,
+      main_api_preload_resources,
+      main_api_get_elapsed_time,
+      main_api_get_profile,
+      main_api_save_profile,
 
       // Audio API.
       audio_api_get_sound_volume,
       audio_api_set_sound_volume,
       audio_api_play_sound,
       audio_api_preload_sounds,
+      audio_api_set_sound_priority,
+      audio_api_set_sound_max_instances,
+      audio_api_get_sound_statistics,
       audio_api_get_music_volume,
       audio_api_set_music_volume,
       audio_api_play_music,
@@ -457,6 +471,8 @@ class LuaContext {
 
       // Surface API.
       surface_api_create,
+      surface_api_get_cache_statistics,
+      surface_api_get_draw_statistics,
       surface_api_get_size,
       surface_api_fill_color,
       surface_api_set_opacity,
@@ -536,6 +552,8 @@ class LuaContext {
       path_finding_movement_api_set_target,
       path_finding_movement_api_get_speed,
       path_finding_movement_api_set_speed,
+      path_finding_movement_api_get_max_distance,
+      path_finding_movement_api_set_max_distance,
       circle_movement_api_set_center,
       circle_movement_api_get_radius,
       circle_movement_api_set_radius,
@@ -668,6 +686,7 @@ class LuaContext {
       map_api_get_location,
       map_api_get_tileset,
       map_api_set_tileset,
+      map_api_preload,
       map_api_get_music,
       map_api_get_camera_position,
       map_api_move_camera,  // TODO set any movement to the camera instead
@@ -853,11 +872,118 @@ class LuaContext {
     struct LuaTimerData {
       int callback_ref;     /**< Lua ref of the function to call after the timer. */
       const void* context;  /**< Lua table or userdata the timer is attached to. */
+      uint32_t schedule_id; /**< Id of the valid entry of this timer in the
+                             * schedule, or 0 if the timer is not scheduled
+                             * (because it is suspended). */
+    };
+
+    /**
+     * \brief Entry of the schedule of timers.
+     *
+     * Entries are ordered by date first and by creation order next, so that
+     * the top of a priority queue is the earliest one.
+     * An entry is obsolete if its id is no longer the schedule id of its timer.
+     */
+    struct ScheduledTimer {
+
+      uint32_t date;        /**< Date when the timer needs to be updated. */
+      uint32_t id;          /**< Unique id of this entry. */
+      Timer* timer;         /**< The timer to update. */
+
+      ScheduledTimer(uint32_t date, uint32_t id, Timer* timer):
+        date(date),
+        id(id),
+        timer(timer) {
+      }
+
+      bool operator<(const ScheduledTimer& other) const {
+        return date > other.date || (date == other.date && id > other.id);
+      }
+    };
+
+    /**
+     * \brief Event callbacks that can be defined as fields of userdata.
+     *
+     * Their existence is stored as bits in each userdata, so that checking
+     * whether a callback is defined is fast.
+     */
+    enum UserdataEvent {
+      EVENT_ON_ABILITY_USED,
+      EVENT_ON_ACTIVATED,
+      EVENT_ON_ACTIVATED_REPEAT,
+      EVENT_ON_ACTIVATING,
+      EVENT_ON_AMOUNT_CHANGED,
+      EVENT_ON_ANIMATION_CHANGED,
+      EVENT_ON_ANIMATION_FINISHED,
+      EVENT_ON_BOUGHT,
+      EVENT_ON_BUYING,
+      EVENT_ON_CAMERA_BACK,
+      EVENT_ON_CHANGED,
+      EVENT_ON_CLOSED,
+      EVENT_ON_COLLISION_ENEMY,
+      EVENT_ON_COLLISION_EXPLOSION,
+      EVENT_ON_COLLISION_FIRE,
+      EVENT_ON_COMMAND_PRESSED,
+      EVENT_ON_COMMAND_RELEASED,
+      EVENT_ON_CREATED,
+      EVENT_ON_CUSTOM_ATTACK_RECEIVED,
+      EVENT_ON_DEAD,
+      EVENT_ON_DIALOG_FINISHED,
+      EVENT_ON_DIALOG_STARTED,
+      EVENT_ON_DIRECTION_CHANGED,
+      EVENT_ON_DISABLED,
+      EVENT_ON_DRAW,
+      EVENT_ON_DYING,
+      EVENT_ON_EMPTY,
+      EVENT_ON_ENABLED,
+      EVENT_ON_FINISHED,
+      EVENT_ON_FRAME_CHANGED,
+      EVENT_ON_GAME_OVER_FINISHED,
+      EVENT_ON_GAME_OVER_STARTED,
+      EVENT_ON_HURT,
+      EVENT_ON_IMMOBILIZED,
+      EVENT_ON_INACTIVATED,
+      EVENT_ON_INTERACTION,
+      EVENT_ON_INTERACTION_ITEM,
+      EVENT_ON_LEFT,
+      EVENT_ON_MAP_CHANGED,
+      EVENT_ON_MOVED,
+      EVENT_ON_MOVEMENT_CHANGED,
+      EVENT_ON_MOVEMENT_FINISHED,
+      EVENT_ON_MOVING,
+      EVENT_ON_NPC_COLLISION_FIRE,
+      EVENT_ON_NPC_INTERACTION,
+      EVENT_ON_NPC_INTERACTION_ITEM,
+      EVENT_ON_OBSTACLE_REACHED,
+      EVENT_ON_OBTAINED,
+      EVENT_ON_OBTAINED_TREASURE,
+      EVENT_ON_OBTAINING,
+      EVENT_ON_OBTAINING_TREASURE,
+      EVENT_ON_OPENED,
+      EVENT_ON_OPENING_TRANSITION_FINISHED,
+      EVENT_ON_PAUSED,
+      EVENT_ON_PICKABLE_CREATED,
+      EVENT_ON_PICKABLE_MOVEMENT_CHANGED,
+      EVENT_ON_POSITION_CHANGED,
+      EVENT_ON_POST_DRAW,
+      EVENT_ON_PRE_DRAW,
+      EVENT_ON_REMOVED,
+      EVENT_ON_RESTARTED,
+      EVENT_ON_STARTED,
+      EVENT_ON_STATE_CHANGED,
+      EVENT_ON_SUSPENDED,
+      EVENT_ON_UNPAUSED,
+      EVENT_ON_UPDATE,
+      EVENT_ON_USING,
+      EVENT_ON_VARIANT_CHANGED,
+      EVENT_NB
     };
 
     // Executing Lua code.
     bool userdata_has_field(ExportableToLua& userdata, const char* key) const;
     bool userdata_has_field(ExportableToLua& userdata, const std::string& key) const;
+    bool userdata_has_event(ExportableToLua& userdata, UserdataEvent event) const;
+    static UserdataEvent get_userdata_event(const char* key);
     bool find_method(int index, const char* function_name);
     bool find_method(const char* function_name);
     bool call_function(
@@ -1095,6 +1221,11 @@ class LuaContext {
                                      * their context and callback. */
     std::list<Timer*>
         timers_to_remove;           /**< Timers to be removed at the next cycle. */
+    std::priority_queue<ScheduledTimer>
+        timers_schedule;            /**< Timers ordered by the next date when
+                                     * they need an update. */
+    uint32_t
+        next_timer_schedule_id;     /**< Id of the next entry of the schedule. */
 
     std::set<Drawable*> drawables;  /**< All drawable objects created by
                                      * this script. */
@@ -1110,11 +1241,14 @@ class LuaContext {
     static std::map<lua_State*, LuaContext*>
         lua_contexts;               /**< Mapping to get the encapsulating object
                                      * from the lua_State pointer. */
+    static int all_userdata_ref;    /**< Lua ref in the registry of the weak
+                                     * table of all userdata. */
 
     static const std::string enemy_attack_names[];
     static const std::string enemy_hurt_style_names[];
     static const std::string enemy_obstacle_behavior_names[];
     static const std::string transition_style_names[];
+    static const std::string userdata_event_names[];
 };
 
 /**
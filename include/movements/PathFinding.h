@@ -19,8 +19,8 @@
 
 #include "Common.h"
 #include "lowlevel/Rectangle.h"
-#include <list>
-#include <map>
+#include <queue>
+#include <vector>
 
 namespace solarus {
 
@@ -30,61 +30,110 @@ namespace solarus {
  * In the current implementation, the computed path always corresponds to a
  * shape of 16*16. If the entity to move is bigger, some obstacles may prevent
  * it from following the computed path.
+ *
+ * Nodes are stored in a flat array covering the squares of the map that are
+ * close enough to the target, and the open list is a binary heap.
+ * Results are shared with other entities of the map through its
+ * PathFindingCache.
  */
 class PathFinding {
 
   public:
 
+    static const int default_max_distance = 200;  /**< default value of max_distance */
+
     PathFinding(
-        const Map& map,
+        Map& map,
         const MapEntity& source_entity,
-        const MapEntity& target_entity);
+        const MapEntity& target_entity,
+        int max_distance = default_max_distance);
     ~PathFinding();
 
     std::string compute_path();
 
   private:
 
+    /**
+     * \brief State of a node with respect to the A* lists.
+     */
+    enum NodeState {
+      NODE_UNKNOWN,       /**< the node was not reached yet */
+      NODE_OPEN,          /**< the node is in the open list */
+      NODE_CLOSED         /**< the node is in the closed list */
+    };
+
     /**
      * \brief Represents a node in the path to compute.
      *
      * A node is the location of a 16*16 square of the map.
      * The algorithm tries to find the best sequence of nodes leading to the target.
+     * Its location is given by its index in the array of nodes.
+     * The array is shared by all searches: a node whose search number is not
+     * the current one was not reached yet by this search.
      */
     class Node {
 
      public:
 
-      Rectangle location; /**< location of this node on the map */
-      int index;          /**< index of this node's square on the map (depends on the location) */
+      Node();
 
       // total_cost = previous_cost + heuristic
       int previous_cost;  /**< cost of the best path that leads to this node */
       int heuristic;      /**< estimation of the remaining cost to the target */
-      int total_cost;     /**< total cost of this node */
 
-      int parent_index;   /**< index of the square containing the best node leading to this node */
-      char direction;     /**< direction from the parent node to this node (0 to 7) */
+      int parent_index;   /**< index of the node leading to this node with the best path */
+      char direction;     /**< direction from the parent node to this node ('0' to '7') */
+      NodeState state;    /**< whether this node is in the open list or in the closed list */
+      uint32_t search;    /**< number of the last search that reached this node */
+    };
+
+    /**
+     * \brief An element of the open list.
+     *
+     * When the cost of a node already in the open list improves,
+     * the node is pushed again and the old element is ignored when popped.
+     */
+    class OpenNode {
+
+     public:
+
+      OpenNode(int total_cost, int order, int index);
 
-      bool operator<(const Node& other) const;
+      int total_cost;     /**< total cost of the node when it was pushed */
+      int order;          /**< sequence number: among equal costs, the last node pushed is explored first */
+      int index;          /**< index of the node */
+
+      bool operator<(const OpenNode& other) const;
     };
 
+    std::string search_path(const Rectangle& source, const Rectangle& target,
+        int total_mdistance);
+    Node& get_node(int index);
     int get_square_index(const Rectangle& location) const;
+    Rectangle get_square_location(int index) const;
     int get_manhattan_distance(const Rectangle& point1, const Rectangle& point2) const;
-    bool is_node_transition_valid(const Node& node, int direction) const;
-    void add_index_sorted(Node* node);
-    std::string rebuild_path(const Node* final_node);
+    bool is_node_transition_valid(const Rectangle& initial_location, int direction) const;
+    std::string rebuild_path(int final_index) const;
 
     static const Rectangle neighbours_locations[];
     static const Rectangle transition_collision_boxes[];
 
-    const Map& map;                    /**< the map */
+    Map& map;                          /**< the map */
     const MapEntity& source_entity;    /**< the entity to move */
     const MapEntity& target_entity;    /**< the target point */
-
-    std::map<int, Node> closed_list;   /**< the closed list, indexed by the node locations on the map */
-    std::map<int, Node> open_list;     /**< the open list, indexed by the node locations on the map */
-    std::list<int> open_list_indices;  /**< indices of the open list elements, sorted by priority */
+    int max_distance;                  /**< maximum Manhattan distance to the target
+                                        * of the nodes explored, in pixels */
+
+    int squares_x8;                    /**< x coordinate of the first square of the nodes array, divided by 8 */
+    int squares_y8;                    /**< y coordinate of the first square of the nodes array, divided by 8 */
+    int squares_width8;                /**< number of squares on a row of the nodes array */
+    int squares_height8;               /**< number of squares on a column of the nodes array */
+    std::priority_queue<OpenNode>
+        open_list;                     /**< the open list, sorted by priority */
+
+    static std::vector<Node> nodes;    /**< all nodes that may be explored, indexed by square,
+                                        * only reset when a search reaches them */
+    static uint32_t current_search;    /**< number of the current search */
 
 };
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_PATH_FINDING_CACHE_H
+#define SOLARUS_PATH_FINDING_CACHE_H
+
+#include "Common.h"
+#include "entities/Layer.h"
+#include "lowlevel/Rectangle.h"
+#include <list>
+#include <string>
+
+namespace solarus {
+
+/**
+ * \brief Remembers the paths recently computed on a map.
+ *
+ * When several entities chase the same target, they often search the same
+ * path at almost the same time.
+ * This cache keeps the last paths found for a short time so that they can be
+ * shared. The cache is small and least recently used paths are forgotten
+ * first.
+ *
+ * Failed searches are not remembered: a door that opens or an entity that
+ * moves away may create a path at any time, and the entity should find it
+ * immediately.
+ *
+ * Two searches are considered identical if they start from the same square,
+ * go to the same square with the same maximum distance, and if the entities
+ * have the same type and the same obstacle grounds.
+ * Other obstacle entities may have moved in the meantime: a path is only a
+ * hint and the movement computes a new one if it gets blocked.
+ */
+class PathFindingCache {
+
+  public:
+
+    PathFindingCache();
+    ~PathFindingCache();
+
+    bool get_path(const MapEntity& source_entity, const Rectangle& target,
+        int max_distance, std::string& path);
+    void add_path(const MapEntity& source_entity, const Rectangle& target,
+        int max_distance, const std::string& path);
+    void clear();
+
+  private:
+
+    /**
+     * \brief A path computed recently.
+     */
+    class Entry {
+
+      public:
+
+        Entry(const MapEntity& source_entity, const Rectangle& target,
+            int max_distance);
+
+        bool is_same_search(const Entry& other) const;
+
+        Layer layer;                /**< layer of the search */
+        int source_x;               /**< x coordinate of the starting node */
+        int source_y;               /**< y coordinate of the starting node */
+        int target_x;               /**< x coordinate of the target node */
+        int target_y;               /**< y coordinate of the target node */
+        int max_distance;           /**< maximum distance of the search */
+        int obstacle_profile;       /**< type and obstacle grounds of the entity to move */
+        std::string path;           /**< the path found */
+        uint32_t expiration_date;   /**< date when this path becomes obsolete */
+    };
+
+    static int get_obstacle_profile(const MapEntity& entity);
+
+    static const unsigned int
+        capacity = 32;              /**< maximum number of paths remembered */
+    static const uint32_t
+        path_lifetime = 200;        /**< duration in milliseconds a path found is kept */
+
+    std::list<Entry> entries;       /**< recent paths, the most recently used first */
+
+};
+
+}
+
+#endif
+
@@ -38,6 +38,8 @@ class PathFindingMovement: public PathMovement {
     ~PathFindingMovement();
 
     void set_target(MapEntity& target);
+    int get_max_distance() const;
+    void set_max_distance(int max_distance);
     bool is_finished() const;
 
     virtual const std::string& get_lua_type_name() const;
@@ -50,6 +52,8 @@ class PathFindingMovement: public PathMovement {
   private:
 
     MapEntity* target;              /**< the entity targeted by this movement (usually the hero) */
+    int max_distance;               /**< no path is searched if the target is farther than this
+                                     * Manhattan distance in pixels */
     uint32_t next_recomputation_date;
 
 };
@@ -0,0 +1,84 @@
+-- Collision benchmark.
+-- Adds waves of moving custom entities, sensors and dynamic tiles to a big
+-- map and prints the average time spent per frame for each wave.
+-- Run the engine with -no-throttle and this map as starting location and read
+-- the output.
+
+local map = ...
+
+-- Total number of entities of each wave.
+local waves = { 100, 200, 500, 1000, 2000, 5000 }
+local wave_duration = 5000
+local num_entities = 0
+local num_frames = 0
+local wave_start_time = 0
+
+local function random_position()
+  local width, height = map:get_size()
+  return math.random(0, width / 8 - 2) * 8, math.random(0, height / 8 - 2) * 8
+end
+
+local function add_entities(count)
+
+  for i = 1, count do
+    local x, y = random_position()
+    local entity = map:create_custom_entity{
+      layer = 0,
+      x = x,
+      y = y,
+      width = 16,
+      height = 16,
+    }
+    sol.movement.create("random"):start(entity)
+
+    x, y = random_position()
+    map:create_sensor{
+      layer = 0,
+      x = x,
+      y = y,
+      width = 16,
+      height = 16,
+    }
+
+    x, y = random_position()
+    map:create_dynamic_tile{
+      layer = 0,
+      x = x,
+      y = y,
+      width = 16,
+      height = 16,
+      pattern = 3,
+      enabled_at_start = true,
+    }
+  end
+  num_entities = num_entities + count * 3
+end
+
+local function start_wave(index)
+
+  if index > #waves then
+    print("Collision benchmark finished")
+    return
+  end
+
+  add_entities(math.floor((waves[index] - num_entities) / 3))
+  num_frames = 0
+  wave_start_time = sol.main.get_elapsed_time()
+  sol.timer.start(map, wave_duration, function()
+    -- Real time, not CPU time nor simulated time.
+    local elapsed = sol.main.get_elapsed_time() - wave_start_time
+    print(string.format("%d entities: %.3f ms/frame",
+        num_entities, elapsed / math.max(num_frames, 1)))
+    start_wave(index + 1)
+  end)
+end
+
+function map:on_started()
+  math.randomseed(0)
+  start_wave(1)
+end
+
+function map:on_update()
+  num_frames = num_frames + 1
+end
+
@@ -0,0 +1,78 @@
+-- Entities benchmark.
+-- Adds waves of moving custom entities and of dynamic tiles visible on the
+-- screen and prints the time spent per frame to update and to draw the
+-- entities for each wave.
+-- Run the engine with -no-throttle and this map as starting location and read
+-- the output. Compile with the PROFILING option to get the update and draw
+-- times separately.
+
+local map = ...
+
+-- Total number of entities of each wave.
+local waves = { 100, 1000, 5000 }
+local wave_duration = 10000
+local num_entities = 0
+local num_frames = 0
+local wave_start_time = 0
+
+local function add_entities(count)
+
+  local width, height = map:get_size()
+  for i = 1, count, 2 do
+    local entity = map:create_custom_entity{
+      layer = 0,
+      x = math.random(0, width / 8 - 2) * 8,
+      y = math.random(0, height / 8 - 2) * 8,
+      width = 16,
+      height = 16,
+    }
+    sol.movement.create("random"):start(entity)
+
+    -- Keep dynamic tiles in the visible area so that they are all drawn.
+    local hero_x, hero_y = map:get_hero():get_position()
+    map:create_dynamic_tile{
+      layer = 0,
+      x = hero_x - 160 + math.random(0, 38) * 8,
+      y = hero_y - 120 + math.random(0, 28) * 8,
+      width = 16,
+      height = 16,
+      pattern = 3,
+      enabled_at_start = true,
+    }
+  end
+  num_entities = num_entities + count
+end
+
+local function start_wave(index)
+
+  if index > #waves then
+    print("Entities benchmark finished")
+    return
+  end
+
+  add_entities(waves[index] - num_entities)
+  num_frames = 0
+  wave_start_time = sol.main.get_elapsed_time()
+  sol.timer.start(map, wave_duration, function()
+    local elapsed = sol.main.get_elapsed_time() - wave_start_time
+    local profile = sol.main.get_profile()
+    if profile ~= nil then
+      print(string.format("%d entities: %.3f ms/frame (update: %.3f ms, draw: %.3f ms)",
+          num_entities, elapsed / math.max(num_frames, 1),
+          profile.entities_update.average, profile.map_draw.average))
+    else
+      print(string.format("%d entities: %.3f ms/frame",
+          num_entities, elapsed / math.max(num_frames, 1)))
+    end
+    start_wave(index + 1)
+  end)
+end
+
+function map:on_started()
+  math.randomseed(0)
+  start_wave(1)
+end
+
+function map:on_update()
+  num_frames = num_frames + 1
+end
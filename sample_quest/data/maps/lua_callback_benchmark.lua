@@ -0,0 +1,62 @@
+-- Lua callback benchmark.
+-- Adds waves of moving custom entities that define on_position_changed()
+-- and prints the number of Lua callbacks called per second for each wave.
+-- Run the engine with -no-throttle (or -headless) and this map as starting
+-- location and read the output. Without it, the simulation runs at its
+-- normal speed and the number of callbacks only reflects the fixed update
+-- rate of movements, not the cost of the callbacks.
+
+local map = ...
+
+-- Total number of entities of each wave.
+local waves = { 100, 200, 500, 1000, 2000 }
+local wave_duration = 5000
+local num_entities = 0
+local num_callbacks = 0
+local wave_start_time = 0
+
+local function on_position_changed(entity)
+  num_callbacks = num_callbacks + 1
+end
+
+local function add_entities(count)
+
+  local width, height = map:get_size()
+  for i = 1, count do
+    local entity = map:create_custom_entity{
+      layer = 0,
+      x = math.random(0, width / 8 - 2) * 8,
+      y = math.random(0, height / 8 - 2) * 8,
+      width = 16,
+      height = 16,
+    }
+    entity.on_position_changed = on_position_changed
+    sol.movement.create("random"):start(entity)
+  end
+  num_entities = num_entities + count
+end
+
+local function start_wave(index)
+
+  if index > #waves then
+    print("Lua callback benchmark finished")
+    return
+  end
+
+  add_entities(waves[index] - num_entities)
+  num_callbacks = 0
+  wave_start_time = sol.main.get_elapsed_time()
+  sol.timer.start(map, wave_duration, function()
+    -- Real time, not CPU time nor simulated time.
+    local elapsed = sol.main.get_elapsed_time() - wave_start_time
+    print(string.format("%d entities: %d callbacks, %.0f callbacks/s",
+        num_entities, num_callbacks, num_callbacks * 1000 / math.max(elapsed, 1)))
+    start_wave(index + 1)
+  end)
+end
+
+function map:on_started()
+  print("Lua callback benchmark: only meaningful with -no-throttle or -headless")
+  math.randomseed(0)
+  start_wave(1)
+end
@@ -0,0 +1,35 @@
+-- Map loading benchmark.
+-- Goes back and forth to a big map, alternately with and without
+-- preloading it first with map:preload(), and prints the time the game
+-- was stalled by each transition.
+-- Run the engine with this map as starting location and read the output.
+
+local map = ...
+local game = map:get_game()
+
+local large_map_id = "map_loading_benchmark_large"
+local num_rounds = 10
+local wait_delay = 2000
+
+function map:on_started()
+
+  local round = game:get_value("map_loading_benchmark_round") or 0
+  if round >= num_rounds then
+    print("Map loading benchmark finished")
+    return
+  end
+
+  local preloading = round % 2 == 1
+  if preloading then
+    map:preload(large_map_id)
+  end
+
+  -- Let the preloading finish before leaving.
+  sol.timer.start(map, wait_delay, function()
+    game:set_value("map_loading_benchmark_preloading", preloading)
+    -- Real time: CPU time would not see the main thread waiting for the
+    -- preloading thread.
+    game:set_value("map_loading_benchmark_time", sol.main.get_elapsed_time())
+    map:get_hero():teleport(large_map_id, "start", "immediate")
+  end)
+end
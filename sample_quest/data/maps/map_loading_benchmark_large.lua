@@ -0,0 +1,20 @@
+-- Destination of the map loading benchmark.
+-- See map_loading_benchmark.lua.
+
+local map = ...
+local game = map:get_game()
+
+function map:on_started()
+
+  local round = game:get_value("map_loading_benchmark_round") or 0
+  local start_time = game:get_value("map_loading_benchmark_time")
+  local preloading = game:get_value("map_loading_benchmark_preloading")
+  local stall = sol.main.get_elapsed_time() - start_time
+  print(string.format("Round %d (%s): transition stalled %d ms",
+      round + 1, preloading and "preloaded" or "not preloaded", stall))
+  game:set_value("map_loading_benchmark_round", round + 1)
+
+  sol.timer.start(map, 500, function()
+    map:get_hero():teleport("map_loading_benchmark", "start", "immediate")
+  end)
+end
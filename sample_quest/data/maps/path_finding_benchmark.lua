@@ -0,0 +1,60 @@
+-- Path finding benchmark.
+-- Adds waves of entities that search a path to the hero through a maze of
+-- walls and prints the average time spent per frame for each wave.
+-- Run the engine with -no-throttle and this map as starting location and read
+-- the output.
+
+local map = ...
+
+-- Total number of path finding entities of each wave.
+local waves = { 10, 25, 50, 100, 200 }
+local wave_duration = 10000
+local num_entities = 0
+local num_frames = 0
+local wave_start_time = 0
+
+local function add_entities(count)
+
+  for i = 1, count do
+    local entity = map:create_custom_entity{
+      layer = 0,
+      x = math.random(0, 8) * 16,
+      y = math.random(1, 40) * 16,
+      width = 16,
+      height = 16,
+    }
+    local movement = sol.movement.create("path_finding")
+    movement:set_max_distance(2000)
+    movement:start(entity)
+  end
+  num_entities = num_entities + count
+end
+
+local function start_wave(index)
+
+  if index > #waves then
+    print("Path finding benchmark finished")
+    return
+  end
+
+  add_entities(waves[index] - num_entities)
+  num_frames = 0
+  wave_start_time = sol.main.get_elapsed_time()
+  sol.timer.start(map, wave_duration, function()
+    -- Real time, not CPU time nor simulated time.
+    local elapsed = sol.main.get_elapsed_time() - wave_start_time
+    print(string.format("%d entities: %.3f ms/frame",
+        num_entities, elapsed / math.max(num_frames, 1)))
+    start_wave(index + 1)
+  end)
+end
+
+function map:on_started()
+  math.randomseed(0)
+  start_wave(1)
+end
+
+function map:on_update()
+  num_frames = num_frames + 1
+end
+
@@ -0,0 +1,51 @@
+-- Timer benchmark.
+-- Keeps 10000 concurrent timers running with random delays, restarting
+-- each one when it expires, and prints the average time spent per frame
+-- and the number of expired timers every few seconds.
+-- Run the engine with this map as starting location and read the output.
+
+local map = ...
+
+local num_timers = 10000
+local max_delay = 10000
+local report_delay = 5000
+local num_expired = 0
+local total_time = 0
+local num_frames = 0
+local last_clock = nil
+
+local function start_timer()
+  sol.timer.start(map, math.random(1, max_delay), function()
+    num_expired = num_expired + 1
+    start_timer()
+  end)
+end
+
+local report
+function report()
+  print(string.format("%d timers: %.3f ms/frame, %d expired",
+      num_timers, total_time * 1000 / math.max(num_frames, 1), num_expired))
+  num_expired = 0
+  total_time = 0
+  num_frames = 0
+  sol.timer.start(map, report_delay, report)
+end
+
+function map:on_started()
+
+  math.randomseed(0)
+  for i = 1, num_timers do
+    start_timer()
+  end
+  sol.timer.start(map, report_delay, report)
+end
+
+function map:on_update()
+
+  local now = os.clock()
+  if last_clock ~= nil then
+    total_time = total_time + now - last_clock
+    num_frames = num_frames + 1
+  end
+  last_clock = now
+end
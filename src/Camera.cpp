@@ -110,9 +110,9 @@ void Camera::update_fixed_on_hero() {
     int adjusted_x = x;  // Updated coordinates after applying separators.
     int adjusted_y = y;
     std::list<const Separator*> applied_separators;
-    const std::list<const Separator*>& separators =
+    const std::vector<const Separator*>& separators =
         map.get_entities().get_separators();
-    std::list<const Separator*>::const_iterator it;
+    std::vector<const Separator*>::const_iterator it;
     for (it = separators.begin(); it != separators.end(); ++it) {
       const Separator& separator = *(*it);
 
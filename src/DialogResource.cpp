@@ -52,11 +52,9 @@ void DialogResource::initialize() {
 
   // Read the dialogs file.
   lua_State* l = luaL_newstate();
-  size_t size;
-  char* buffer;
-  FileTools::data_file_open_buffer(file_name, &buffer, &size, true);
-  int load_result = luaL_loadbuffer(l, buffer, size, file_name.c_str());
-  FileTools::data_file_close_buffer(buffer);
+  FileTools::DataFileView view = FileTools::data_file_open_view(file_name, true);
+  int load_result = luaL_loadbuffer(l, view.data, view.size, file_name.c_str());
+  FileTools::data_file_close_view(view);
 
   if (load_result != 0) {
     Debug::error(StringConcat() << "Failed to load dialog file '" << file_name
@@ -31,6 +31,7 @@
 #include "lowlevel/StringConcat.h"
 #include "lowlevel/Music.h"
 #include "lowlevel/Video.h"
+#include "lowlevel/Profiler.h"
 #include <sstream>
 #include <vector>
 
@@ -339,6 +340,8 @@ void Game::notify_command_released(GameCommands::Command command) {
  */
 void Game::update() {
 
+  SOLARUS_PROFILE(SECTION_GAME_UPDATE);
+
   // update the transitions between maps
   update_transitions();
 
@@ -382,7 +385,6 @@ void Game::update_transitions() {
       transition = Transition::create(
           transition_style,
           Transition::TRANSITION_CLOSING,
-          current_map->get_visible_surface(),
           this);
       if(transition_style == Transition::FADE) {
         static_cast<TransitionFade*>(transition)->set_color(new Color(Color::get_black()));
@@ -416,7 +418,6 @@ void Game::update_transitions() {
         transition = Transition::create(
             transition_style,
             Transition::TRANSITION_OPENING,
-            current_map->get_visible_surface(),
             this);
         if(transition_style == Transition::FADE) {
           static_cast<TransitionFade*>(transition)->set_color(new Color(Color::get_black()));
@@ -458,6 +459,9 @@ void Game::update_transitions() {
 
         current_map = next_map;
         next_map = NULL;
+
+        // Free the images that only the previous map was using.
+        Surface::purge_image_cache();
       }
     }
     else {
@@ -473,7 +477,6 @@ void Game::update_transitions() {
     transition = Transition::create(
         transition_style,
         Transition::TRANSITION_OPENING,
-        current_map->get_visible_surface(),
         this);
     if(transition_style == Transition::FADE) {
       static_cast<TransitionFade*>(transition)->set_color(new Color(Color::get_black()));
@@ -791,7 +794,6 @@ void Game::restart() {
   transition = Transition::create(
       Transition::FADE,
       Transition::TRANSITION_CLOSING,
-      current_map->get_visible_surface(),
       this);
   static_cast<TransitionFade*>(transition)->set_color(new Color(Color::get_black()));
   transition->start();
@@ -22,6 +22,7 @@
 #include "lowlevel/Music.h"
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
+#include "lowlevel/Profiler.h"
 #include "lua/LuaContext.h"
 #include "Settings.h"
 #include "QuestProperties.h"
@@ -29,6 +30,9 @@
 #include "Savegame.h"
 #include "StringResource.h"
 #include "QuestResourceList.h"
+#include "CommandLine.h"
+#include <iostream>
+#include <sstream>
 
 namespace solarus {
 
@@ -41,7 +45,25 @@ MainLoop::MainLoop(const CommandLine& args):
   lua_context(NULL),
   exiting(false),
   game(NULL),
-  next_game(NULL) {
+  next_game(NULL),
+  num_input_events(0),
+  input_latency(0),
+  headless(false),
+  throttling(true),
+  num_ticks(0),
+  max_ticks(0) {
+
+  // Check the -headless, -no-throttle and -max-ticks options.
+  headless = args.has_argument("-headless");
+  throttling = !headless && !args.has_argument("-no-throttle");
+  const std::string& max_ticks_string = args.get_argument_value("-max-ticks");
+  if (!max_ticks_string.empty()) {
+    std::istringstream iss(max_ticks_string);
+    if (!(iss >> max_ticks)) {
+      Debug::error(std::string("Invalid number of ticks: '") + max_ticks_string + "'");
+      max_ticks = 0;
+    }
+  }
 
   // Initialize basic features (input, audio, video, files...).
   System::initialize(args);
@@ -94,6 +116,59 @@ LuaContext& MainLoop::get_lua_context() {
   return *lua_context;
 }
 
+/**
+ * \brief Returns the number of input events handled at the last cycle.
+ *
+ * This is useful to measure input lag.
+ *
+ * \return The number of input events handled before the last update.
+ */
+int MainLoop::get_num_input_events() const {
+  return num_input_events;
+}
+
+/**
+ * \brief Returns the input latency of the last cycle.
+ *
+ * This is the time elapsed between the moment when the first input event
+ * handled at the last cycle occurred and the moment when all events were
+ * handled, that is, just before the simulation is updated.
+ *
+ * \return The input latency in milliseconds, or 0 if there was no input
+ * event at the last cycle.
+ */
+uint32_t MainLoop::get_input_latency() const {
+  return input_latency;
+}
+
+/**
+ * \brief Returns whether the program runs without window and without audio.
+ * \return \c true if the -headless option was passed.
+ */
+bool MainLoop::is_headless() const {
+  return headless;
+}
+
+/**
+ * \brief Returns whether the simulation is slowed down to match the real time.
+ *
+ * When there is no throttling, updates are done as fast as possible.
+ * This is useful to benchmark the simulation.
+ *
+ * \return \c true if the simulated time follows the real time.
+ */
+bool MainLoop::is_throttling() const {
+  return throttling;
+}
+
+/**
+ * \brief Returns the number of updates done since the beginning.
+ * \return The number of simulation steps done so far.
+ */
+uint32_t MainLoop::get_num_ticks() const {
+  return num_ticks;
+}
+
 /**
  * \brief Returns whether the user just closed the window.
  *
@@ -161,6 +236,11 @@ void MainLoop::set_game(Game* game) {
  */
 void MainLoop::run() {
 
+  if (!throttling) {
+    run_unthrottled();
+    return;
+  }
+
   // Main loop.
   uint32_t last_frame_date = System::get_real_time();
   uint32_t lag = 0;  // Lose time of the simulation.
@@ -170,6 +250,10 @@ void MainLoop::run() {
   // Each call to update() makes the simulated time advance one fixed step.
   while (!is_exiting()) {
 
+    // Store the profiling data of the previous cycle, if enabled.
+    SOLARUS_PROFILE_FRAME_FINISHED();
+    SOLARUS_PROFILE(SECTION_FRAME);
+
     // Measure the time of the last iteration without the check_input() phase.
     // Some check_input() calls are much slower than other, for example when
     // they involve loading a map. However, these long check_input() calls do
@@ -213,14 +297,90 @@ void MainLoop::run() {
 }
 
 /**
- * \brief Detects whether there was an input event and if yes, handles it.
+ * \brief Runs the main loop without trying to match the real time.
+ *
+ * Each cycle makes the simulated time advance one fixed step, as fast as
+ * possible. In headless mode, nothing is drawn.
+ * The number of updates per second is printed at the end.
+ */
+void MainLoop::run_unthrottled() {
+
+  const uint32_t start_date = System::get_real_time();
+
+  while (!is_exiting()) {
+
+    SOLARUS_PROFILE_FRAME_FINISHED();
+    SOLARUS_PROFILE(SECTION_FRAME);
+
+    check_input();
+    if (is_exiting()) {
+      break;
+    }
+
+    update();
+
+    if (!headless) {
+      draw();
+    }
+  }
+
+  const uint32_t duration = System::get_real_time() - start_date;
+  std::cout << num_ticks << " ticks in " << duration << " ms";
+  if (duration > 0) {
+    std::cout << " (" << (num_ticks * 1000.0 / duration) << " ticks per second)";
+  }
+  std::cout << std::endl;
+}
+
+/**
+ * \brief Detects whether there were input events and if yes, handles them.
+ *
+ * All pending events are handled, otherwise bursts of events (like joypad
+ * axis moves or text input) would accumulate latency.
+ * Consecutive moves of a joypad axis to the same state are only handled once.
  */
 void MainLoop::check_input() {
 
+  SOLARUS_PROFILE(SECTION_INPUT);
+
+  num_input_events = 0;
+  input_latency = 0;
+  uint32_t first_event_date = 0;
+  int last_axis = -1;
+  int last_axis_state = 0;
+
   InputEvent* event = InputEvent::get_event();
-  if (event != NULL) {
-    notify_input(*event);
+  while (event != NULL) {
+
+    bool redundant = false;
+    if (event->is_joypad_axis_moved()) {
+      int axis = event->get_joypad_axis();
+      int axis_state = event->get_joypad_axis_state();
+      redundant = (axis == last_axis && axis_state == last_axis_state);
+      last_axis = axis;
+      last_axis_state = axis_state;
+    }
+    else {
+      last_axis = -1;
+    }
+
+    if (!redundant) {
+      if (num_input_events == 0) {
+        first_event_date = event->get_date();
+      }
+      ++num_input_events;
+      notify_input(*event);
+    }
     delete event;
+
+    if (is_exiting()) {
+      break;
+    }
+    event = InputEvent::get_event();
+  }
+
+  if (num_input_events > 0) {
+    input_latency = System::get_real_time() - first_event_date;
   }
 }
 
@@ -267,6 +427,11 @@ void MainLoop::update() {
   lua_context->update();
   System::update();
 
+  ++num_ticks;
+  if (max_ticks != 0 && num_ticks >= max_ticks) {
+    set_exiting();
+  }
+
   // go to another game?
   if (next_game != game) {
 
@@ -291,6 +456,8 @@ void MainLoop::update() {
  */
 void MainLoop::draw() {
 
+  SOLARUS_PROFILE(SECTION_DRAW);
+
   if (root_surface->is_software_destination()
       || !Video::is_acceleration_enabled()) {
     root_surface->fill_with_color(Color::get_transparent());
@@ -25,6 +25,7 @@
 #include "lowlevel/Video.h"
 #include "lowlevel/Music.h"
 #include "lowlevel/Debug.h"
+#include "lowlevel/Profiler.h"
 #include "entities/Ground.h"
 #include "entities/Tileset.h"
 #include "entities/TilePattern.h"
@@ -32,6 +33,7 @@
 #include "entities/Destination.h"
 #include "entities/Detector.h"
 #include "entities/Hero.h"
+#include <algorithm>
 
 namespace solarus {
 
@@ -246,6 +248,7 @@ void Map::unload() {
     entities = NULL;
     delete camera;
     camera = NULL;
+    path_finding_cache.clear();
 
     loaded = false;
   }
@@ -260,6 +263,8 @@ void Map::unload() {
  */
 void Map::load(Game& game) {
 
+  SOLARUS_PROFILE(SECTION_MAP_LOAD);
+
   visible_surface = Surface::create(
       Video::get_quest_size()
   );
@@ -322,6 +327,14 @@ const MapEntities& Map::get_entities() const {
   return *entities;
 }
 
+/**
+ * \brief Returns the paths recently computed on this map.
+ * \return The path finding cache of this map.
+ */
+PathFindingCache& Map::get_path_finding_cache() {
+  return path_finding_cache;
+}
+
 /**
  * \brief Sets the current destination point of the map.
  * \param destination_name Name of the destination point you want to use.
@@ -523,6 +536,8 @@ void Map::check_suspended() {
  */
 void Map::draw() {
 
+  SOLARUS_PROFILE(SECTION_MAP_DRAW);
+
   if (is_loaded()) {
     // background
     draw_background();
@@ -827,6 +842,76 @@ bool Map::test_collision_with_ground(
   return on_obstacle;
 }
 
+/**
+ * \brief Quickly tests whether a rectangle collides with the ground of tiles.
+ *
+ * This only works for rectangles aligned on the 8x8 squares of the map
+ * (like the ones tested by the path finding) that no entity modifying the
+ * ground overlaps. In this case, the ground of each square is known
+ * from the tiles and is uniform in the square,
+ * so there is no need to test individual points.
+ * Only the border of the rectangle is considered, like
+ * test_collision_with_obstacles() does.
+ *
+ * \param layer Layer of the rectangle in the map.
+ * \param collision_box The rectangle to check.
+ * \param[out] collision \c true if the rectangle overlaps a wall,
+ * unchanged if the result is unknown.
+ * \return \c true if the result could be determined, \c false if
+ * points have to be checked individually.
+ */
+bool Map::test_collision_with_tiles_ground(
+    Layer layer,
+    const Rectangle& collision_box,
+    bool& collision) const {
+
+  const int x1 = collision_box.get_x();
+  const int y1 = collision_box.get_y();
+  const int width = collision_box.get_width();
+  const int height = collision_box.get_height();
+  if ((x1 & 7) != 0 || (y1 & 7) != 0 || (width & 7) != 0 || (height & 7) != 0
+      || width == 0 || height == 0
+      || test_collision_with_border(collision_box)
+      || entities->has_ground_modifiers_near(layer, collision_box)) {
+    return false;
+  }
+
+  const int x2 = x1 + width - 8;
+  const int y2 = y1 + height - 8;
+  bool traversable = true;
+  for (int y = y1; y <= y2; y += 8) {
+    // Only the first and last squares of inner rows are on the border.
+    const int step = (y == y1 || y == y2) ? 8 : std::max(8, x2 - x1);
+    for (int x = x1; x <= x2; x += step) {
+
+      switch (entities->get_tile_ground(layer, x, y)) {
+
+        case GROUND_EMPTY:
+        case GROUND_TRAVERSABLE:
+        case GROUND_GRASS:
+        case GROUND_ICE:
+          break;
+
+        case GROUND_WALL:
+          collision = true;
+          return true;
+
+        default:
+          // Diagonal walls or grounds that depend on the entity.
+          traversable = false;
+          break;
+      }
+    }
+  }
+
+  if (!traversable) {
+    return false;
+  }
+
+  collision = false;
+  return true;
+}
+
 /**
  * \brief Tests whether a rectangle overlaps an obstacle dynamic entity.
  * \param layer The layer.
@@ -840,12 +925,23 @@ bool Map::test_collision_with_entities(
     const Rectangle& collision_box,
     const MapEntity& entity_to_check) const {
 
-  const std::list<MapEntity*>& obstacle_entities =
-      entities->get_obstacle_entities(layer);
-  const std::list<MapEntity*>::const_iterator end =
+  // The hero is not stored in the grid of obstacles.
+  const Hero& hero = entities->get_hero();
+  if (hero.get_layer() == layer
+      && hero.overlaps(collision_box)
+      && hero.is_obstacle_for(entity_to_check)
+      && hero.is_enabled()
+      && &hero != &entity_to_check) {
+    return true;
+  }
+
+  // Only check entities stored in the cells that the box touches.
+  std::vector<MapEntity*> obstacle_entities;
+  entities->get_obstacle_entities_near(layer, collision_box, obstacle_entities);
+  const std::vector<MapEntity*>::const_iterator end =
       obstacle_entities.end();
 
-  std::list<MapEntity*>::const_iterator it;
+  std::vector<MapEntity*>::const_iterator it;
   for (it = obstacle_entities.begin(); it != end; ++it) {
 
     MapEntity* entity = *it;
@@ -879,6 +975,15 @@ bool Map::test_collision_with_obstacles(
 
   // Collisions with the terrain
   // (i.e., tiles and dynamic entities that may change it).
+  bool tiles_collision = false;
+  if (test_collision_with_tiles_ground(layer, collision_box, tiles_collision)) {
+    // The ground of tiles was enough to decide.
+    if (tiles_collision) {
+      return true;
+    }
+    return test_collision_with_entities(layer, collision_box, entity_to_check);
+  }
+
   const int x1 = collision_box.get_x();
   const int x2 = x1 + collision_box.get_width() - 1;
   const int y1 = collision_box.get_y();
@@ -1009,12 +1114,11 @@ bool Map::has_empty_ground(Layer layer, const Rectangle& collision_box) const {
 Ground Map::get_ground(Layer layer, int x, int y) const {
 
   // See if a dynamic entity changes the ground.
-  // TODO store ground modifiers in a quad tree for performance.
-
-  const std::list<MapEntity*>& ground_modifiers =
-      entities->get_ground_modifiers(layer);
-  std::list<MapEntity*>::const_reverse_iterator it;
-  const std::list<MapEntity*>::const_reverse_iterator rend =
+  // Only ground modifiers stored in the cell of this point are candidates.
+  std::vector<MapEntity*> ground_modifiers;
+  entities->get_ground_modifiers_near(layer, Rectangle(x, y, 1, 1), ground_modifiers);
+  std::vector<MapEntity*>::const_reverse_iterator it;
+  const std::vector<MapEntity*>::const_reverse_iterator rend =
       ground_modifiers.rend();
   for (it = ground_modifiers.rbegin(); it != rend; ++it) {
     const MapEntity& ground_modifier = *(*it);
@@ -1061,11 +1165,19 @@ void Map::check_collision_with_detectors(MapEntity& entity) {
     return;
   }
 
-  const std::list<Detector*>& detectors = entities->get_detectors();
+  // Only check detectors stored near the entity. The search area is
+  // slightly extended because facing points are outside the bounding box.
+  Rectangle where = MapEntities::get_grid_box(entity);
+  where.add_xy(-detector_search_margin, -detector_search_margin);
+  where.add_width(2 * detector_search_margin);
+  where.add_height(2 * detector_search_margin);
+
+  std::vector<Detector*> detectors;
+  entities->get_detectors_near(where, detectors);
 
   // Check each detector.
-  std::list<Detector*>::const_iterator it;
-  const std::list<Detector*>::const_iterator end = detectors.end();
+  std::vector<Detector*>::const_iterator it;
+  const std::vector<Detector*>::const_iterator end = detectors.end();
   for (it = detectors.begin(); it != end; ++it) {
 
     Detector* detector = *it;
@@ -1093,9 +1205,21 @@ void Map::check_collision_with_detectors(MapEntity &entity, Sprite &sprite) {
     return;
   }
 
-  const std::list<Detector*>& detectors = entities->get_detectors();
+  // Sprites may exceed bounding boxes: extend the search area by the
+  // maximum sprite size of both sides.
+  const int margin = detector_search_margin
+      + MapEntities::get_sprite_margin(entity)
+      + entities->get_detectors_sprite_margin();
+  Rectangle where = MapEntities::get_grid_box(entity);
+  where.add_xy(-margin, -margin);
+  where.add_width(2 * margin);
+  where.add_height(2 * margin);
+
+  std::vector<Detector*> detectors;
+  entities->get_detectors_near(where, detectors);
+
   // check each detector
-  std::list<Detector*>::const_iterator i;
+  std::vector<Detector*>::const_iterator i;
   for (i = detectors.begin();
        i != detectors.end();
        i++) {
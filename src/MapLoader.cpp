@@ -15,6 +15,7 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "MapLoader.h"
+#include "MapPreloader.h"
 #include "Map.h"
 #include "Game.h"
 #include "Camera.h"
@@ -29,9 +30,113 @@
 #include "entities/EntityType.h"
 #include "entities/MapEntity.h"
 #include "lua/LuaContext.h"
+#include <cstring>
 
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Functions available to map data files after properties() is called.
+ */
+const luaL_Reg entity_creation_functions[] = {
+  { "tile",             LuaContext::map_api_create_tile },
+  { "destination",      LuaContext::map_api_create_destination },
+  { "teletransporter",  LuaContext::map_api_create_teletransporter },
+  { "pickable",         LuaContext::map_api_create_pickable },
+  { "destructible",     LuaContext::map_api_create_destructible },
+  { "chest",            LuaContext::map_api_create_chest },
+  { "jumper",           LuaContext::map_api_create_jumper },
+  { "enemy",            LuaContext::map_api_create_enemy },
+  { "npc",              LuaContext::map_api_create_npc },
+  { "block",            LuaContext::map_api_create_block },
+  { "dynamic_tile",     LuaContext::map_api_create_dynamic_tile },
+  { "switch",           LuaContext::map_api_create_switch },
+  { "wall",             LuaContext::map_api_create_wall },
+  { "sensor",           LuaContext::map_api_create_sensor },
+  { "crystal",          LuaContext::map_api_create_crystal },
+  { "crystal_block",    LuaContext::map_api_create_crystal_block },
+  { "shop_treasure",    LuaContext::map_api_create_shop_treasure },
+  { "conveyor_belt",    LuaContext::map_api_create_conveyor_belt },
+  { "door",             LuaContext::map_api_create_door },
+  { "stairs",           LuaContext::map_api_create_stairs },
+  { "separator",        LuaContext::map_api_create_separator },
+  { "custom",           LuaContext::map_api_create_custom_entity },
+  { NULL, NULL }
+};
+
+/**
+ * \brief Appends a value to a binary buffer.
+ * \param output The buffer.
+ * \param value The value to append.
+ */
+template<typename T>
+void write_value(std::string& output, const T& value) {
+  output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * \brief Appends a string to a binary buffer.
+ * \param output The buffer.
+ * \param value The string to append, preceded by its size.
+ */
+void write_string(std::string& output, const std::string& value) {
+  write_value(output, uint32_t(value.size()));
+  output.append(value);
+}
+
+/**
+ * \brief Reads values from a binary buffer, checking its bounds.
+ */
+class BufferReader {
+
+  public:
+
+    BufferReader(const char* buffer, size_t size):
+      buffer(buffer),
+      size(size),
+      position(0) {
+    }
+
+    template<typename T>
+    bool read_value(T& value) {
+      if (size - position < sizeof(T)) {
+        return false;
+      }
+      std::memcpy(&value, buffer + position, sizeof(T));
+      position += sizeof(T);
+      return true;
+    }
+
+    bool read_string(std::string& value) {
+      uint32_t length = 0;
+      if (!read_value(length) || size - position < length) {
+        return false;
+      }
+      value.assign(buffer + position, length);
+      position += length;
+      return true;
+    }
+
+    bool is_finished() const {
+      return position == size;
+    }
+
+    size_t get_remaining_size() const {
+      return size - position;
+    }
+
+  private:
+
+    const char* buffer;   /**< The buffer to read. */
+    size_t size;          /**< Size of the buffer in bytes. */
+    size_t position;      /**< Current position in the buffer. */
+};
+
+}
+
+const uint32_t MapLoader::format_version = 2;
+
 /**
  * \brief Creates a map loader.
  */
@@ -48,6 +153,10 @@ MapLoader::~MapLoader() {
 
 /**
  * \brief Loads a map into the game.
+ *
+ * If the map was preloaded by MapPreloader, its data is taken from there.
+ * Otherwise, it is read now.
+ *
  * \param game The game.
  * \param map The map to load.
  */
@@ -55,23 +164,294 @@ void MapLoader::load_map(Game& game, Map& map) {
 
   map.game = &game;
 
-  // Open the map data file in an independent Lua world.
   const std::string& file_name = std::string("maps/") + map.get_id() + ".dat";
-  lua_State* l = luaL_newstate();
-  size_t size;
-  char* buffer;
-  FileTools::data_file_open_buffer(file_name, &buffer, &size);
-  int load_result = luaL_loadbuffer(l, buffer, size, file_name.c_str());
-  FileTools::data_file_close_buffer(buffer);
 
-  if (load_result != 0) {
+  Tileset* tileset = NULL;
+  MapData* map_data = MapPreloader::take(map.get_id(), tileset);
+  if (map_data == NULL) {
+    map_data = new MapData();
+    read_map_data(map.get_id(), *map_data);
+  }
+
+  // The tileset is kept by properties() if it is the one of the map.
+  map.tileset = tileset;
+  create_map(map, file_name, *map_data);
+  delete map_data;
+}
+
+/**
+ * \brief Reads the content of a map data file.
+ *
+ * The compiled form of the map data file is used if it is up to date.
+ * Otherwise, the data file is executed and its compiled form is saved
+ * if the quest has a write directory.
+ *
+ * This function does not use the main Lua context and may be called
+ * from another thread.
+ *
+ * \param map_id Id of the map to read.
+ * \param map_data The content read.
+ */
+void MapLoader::read_map_data(const std::string& map_id, MapData& map_data) {
+
+  const std::string& file_name = std::string("maps/") + map_id + ".dat";
+  const std::string& compiled_file_name =
+      std::string("maps_compiled/") + map_id + ".dat";
+
+  FileTools::DataFileView view = FileTools::data_file_open_view(file_name);
+  const uint64_t source_hash = get_hash(view.data, view.size);
+
+  // See if a compiled form of this exact data file exists.
+  bool loaded = false;
+  if (FileTools::data_file_exists(compiled_file_name)) {
+    FileTools::DataFileView compiled_view =
+        FileTools::data_file_open_view(compiled_file_name);
+    loaded = load_map_data(compiled_view.data, compiled_view.size, source_hash, map_data);
+    FileTools::data_file_close_view(compiled_view);
+  }
+
+  if (!loaded) {
+    // Execute the data file and remember its content for next times.
+    map_data = MapData();
+    parse_map_data(file_name, view.data, view.size, map_data);
+
+    if (!FileTools::get_quest_write_dir().empty()) {
+      // This is only an optimization: the map is valid even if the write
+      // directory is read-only or full.
+      std::string output;
+      save_map_data(map_data, source_hash, output);
+      const size_t index = compiled_file_name.rfind('/');
+      FileTools::data_file_mkdir(compiled_file_name.substr(0, index));
+      if (!FileTools::data_file_try_save_buffer(
+          compiled_file_name, output.data(), output.size())) {
+        Debug::warning(StringConcat() << "Cannot save compiled map data file '"
+            << compiled_file_name << "'");
+      }
+    }
+  }
+  FileTools::data_file_close_view(view);
+}
+
+/**
+ * \brief Computes a hash of the content of a data file.
+ *
+ * This is the 64-bit FNV-1a hash.
+ *
+ * \param buffer The content of the file.
+ * \param size Size of the buffer in bytes.
+ * \return The hash value.
+ */
+uint64_t MapLoader::get_hash(const char* buffer, size_t size) {
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= uint8_t(buffer[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * \brief Executes a map data file and records its content.
+ * \param file_name Name of the map data file (for error messages).
+ * \param buffer Content of the map data file.
+ * \param size Size of the buffer in bytes.
+ * \param map_data The content recorded.
+ */
+void MapLoader::parse_map_data(const std::string& file_name,
+    const char* buffer, size_t size, MapData& map_data) {
+
+  // Open the map data file in an independent Lua world.
+  lua_State* l = luaL_newstate();
+  if (luaL_loadbuffer(l, buffer, size, file_name.c_str()) != 0) {
     Debug::die(StringConcat() << "Failed to load map data file '"
         << file_name << "': " << lua_tostring(l, -1));
-    lua_pop(l, 1);
   }
 
   // Register the properties() function to Lua.
-  lua_register(l, "properties", l_properties);
+  lua_pushlightuserdata(l, &map_data);
+  lua_setfield(l, LUA_REGISTRYINDEX, "map_data");
+  lua_register(l, "properties", l_record_properties);
+
+  // Execute the Lua code.
+  if (lua_pcall(l, 0, 0, 0) != 0) {
+    Debug::die(StringConcat() << "Failed to load map data file '"
+        << file_name << "': " << lua_tostring(l, -1));
+  }
+
+  lua_close(l);
+}
+
+/**
+ * \brief Builds the compiled form of a map data file.
+ * \param map_data Content of the map data file.
+ * \param source_hash Hash of the map data file.
+ * \param output The binary data produced.
+ */
+void MapLoader::save_map_data(const MapData& map_data, uint64_t source_hash,
+    std::string& output) {
+
+  write_value(output, format_version);
+  write_value(output, source_hash);
+
+  // Properties and entities are stored as their fields.
+  const unsigned int num_entities = map_data.entities.size();
+  write_value(output, uint32_t(num_entities + 1));
+  for (unsigned int i = 0; i < num_entities + 1; ++i) {
+    const EntityData& entity_data = (i == 0) ?
+        map_data.properties : map_data.entities[i - 1];
+    write_string(output, entity_data.type);
+    write_value(output, entity_data.num_tiles_before);
+    write_value(output, uint32_t(entity_data.fields.size()));
+    for (unsigned int j = 0; j < entity_data.fields.size(); ++j) {
+      const Field& field = entity_data.fields[j];
+      write_string(output, field.key);
+      write_value(output, int32_t(field.type));
+      if (field.type == LUA_TSTRING) {
+        write_string(output, field.string);
+      }
+      else {
+        write_value(output, field.number);
+      }
+    }
+  }
+
+  // Tiles are stored as a packed array.
+  write_value(output, uint32_t(map_data.tiles.size()));
+  for (unsigned int i = 0; i < map_data.tiles.size(); ++i) {
+    const TileData& tile_data = map_data.tiles[i];
+    write_value(output, int32_t(tile_data.layer));
+    write_value(output, int32_t(tile_data.x));
+    write_value(output, int32_t(tile_data.y));
+    write_value(output, int32_t(tile_data.width));
+    write_value(output, int32_t(tile_data.height));
+    write_value(output, int32_t(tile_data.pattern_id));
+  }
+}
+
+/**
+ * \brief Reads the compiled form of a map data file.
+ * \param buffer The binary data.
+ * \param size Size of the buffer in bytes.
+ * \param source_hash Hash of the current map data file.
+ * \param map_data The content read.
+ * \return \c false if the compiled data is obsolete or invalid.
+ */
+bool MapLoader::load_map_data(const char* buffer, size_t size,
+    uint64_t source_hash, MapData& map_data) {
+
+  // Smallest possible size of each record, to reject counts that cannot fit
+  // in the rest of the buffer before allocating anything.
+  const size_t min_entity_size = 3 * sizeof(uint32_t);  // Type, tiles before and number of fields.
+  const size_t min_field_size = 2 * sizeof(uint32_t) + sizeof(int32_t);  // Key, type and empty string.
+  const size_t tile_size = 6 * sizeof(int32_t);
+
+  BufferReader reader(buffer, size);
+  uint32_t version = 0;
+  uint64_t hash = 0;
+  if (!reader.read_value(version) || version != format_version
+      || !reader.read_value(hash) || hash != source_hash) {
+    return false;
+  }
+
+  uint32_t num_entities = 0;
+  if (!reader.read_value(num_entities)
+      || num_entities == 0
+      || num_entities > reader.get_remaining_size() / min_entity_size) {
+    return false;
+  }
+  map_data.entities.resize(num_entities - 1);
+  for (unsigned int i = 0; i < num_entities; ++i) {
+    EntityData& entity_data = (i == 0) ?
+        map_data.properties : map_data.entities[i - 1];
+    uint32_t num_fields = 0;
+    if (!reader.read_string(entity_data.type)
+        || !reader.read_value(entity_data.num_tiles_before)
+        || !reader.read_value(num_fields)
+        || num_fields > reader.get_remaining_size() / min_field_size) {
+      return false;
+    }
+    entity_data.fields.resize(num_fields);
+    for (unsigned int j = 0; j < num_fields; ++j) {
+      Field& field = entity_data.fields[j];
+      int32_t type = 0;
+      if (!reader.read_string(field.key) || !reader.read_value(type)) {
+        return false;
+      }
+      field.type = type;
+      if (type == LUA_TSTRING) {
+        if (!reader.read_string(field.string)) {
+          return false;
+        }
+      }
+      else if ((type != LUA_TNUMBER && type != LUA_TBOOLEAN)
+          || !reader.read_value(field.number)) {
+        return false;
+      }
+    }
+  }
+
+  uint32_t num_tiles = 0;
+  if (!reader.read_value(num_tiles)
+      || num_tiles != reader.get_remaining_size() / tile_size) {
+    return false;
+  }
+  map_data.tiles.resize(num_tiles);
+  for (unsigned int i = 0; i < num_tiles; ++i) {
+    TileData& tile_data = map_data.tiles[i];
+    int32_t values[6];
+    for (int j = 0; j < 6; ++j) {
+      if (!reader.read_value(values[j])) {
+        return false;
+      }
+    }
+    tile_data.layer = values[0];
+    tile_data.x = values[1];
+    tile_data.y = values[2];
+    tile_data.width = values[3];
+    tile_data.height = values[4];
+    tile_data.pattern_id = values[5];
+
+    // Same checks as LuaContext::check_tile_fields(). The pattern id is
+    // checked when the tile is created, like for the data file.
+    if (tile_data.layer < LAYER_LOW || tile_data.layer >= LAYER_NB
+        || tile_data.width < 0 || tile_data.width % 8 != 0
+        || tile_data.height < 0 || tile_data.height % 8 != 0) {
+      return false;
+    }
+  }
+
+  // Tiles and entities must be interleaved in a possible order.
+  uint32_t num_tiles_before = 0;
+  for (unsigned int i = 0; i < map_data.entities.size(); ++i) {
+    const uint32_t current = map_data.entities[i].num_tiles_before;
+    if (current < num_tiles_before || current > num_tiles) {
+      return false;
+    }
+    num_tiles_before = current;
+  }
+
+  return reader.is_finished();
+}
+
+/**
+ * \brief Creates the content of a map from the recorded content of its
+ * data file.
+ *
+ * Tiles are created directly.
+ * The properties and the other entities are created by calling the usual
+ * creation functions with a table of their recorded fields, in an
+ * independent Lua world where no code is executed.
+ * Everything is created in the order of the data file.
+ *
+ * \param map The map to fill.
+ * \param file_name Name of the map data file (for error messages).
+ * \param map_data Content of the map data file.
+ */
+void MapLoader::create_map(Map& map, const std::string& file_name,
+    const MapData& map_data) {
+
+  lua_State* l = luaL_newstate();
 
   // Make the Lua world aware of our map.
   luaL_newmetatable(l, LuaContext::map_module_name.c_str());
@@ -80,16 +460,208 @@ void MapLoader::load_map(Game& game, Map& map) {
   lua_pop(l, 1);
   LuaContext::set_entity_implicit_creation_map(l, &map);
 
-  // Execute the Lua code.
-  if (lua_pcall(l, 0, 0, 0) != 0) {
-    Debug::die(StringConcat() << "Failed to load map data file '"
-        << file_name << "': " << lua_tostring(l, -1));
-    lua_pop(l, 1);
+  const unsigned int num_entities = map_data.entities.size();
+  unsigned int num_tiles_created = 0;
+  for (unsigned int i = 0; i < num_entities + 1; ++i) {
+
+    const EntityData& entity_data = (i == 0) ?
+        map_data.properties : map_data.entities[i - 1];
+
+    // Create the tiles declared before this entity.
+    create_tiles(map, map_data, num_tiles_created, entity_data.num_tiles_before);
+    num_tiles_created = entity_data.num_tiles_before;
+
+    lua_CFunction function = NULL;
+    if (i == 0) {
+      function = l_properties;
+    }
+    else {
+      for (const luaL_Reg* reg = entity_creation_functions; reg->name != NULL; ++reg) {
+        if (entity_data.type == reg->name) {
+          function = reg->func;
+          break;
+        }
+      }
+    }
+    Debug::check_assertion(function != NULL, StringConcat() <<
+        "Unknown entity type '" << entity_data.type << "' in map data file '"
+        << file_name << "'");
+
+    lua_pushcfunction(l, function);
+    lua_createtable(l, 0, entity_data.fields.size());
+    for (unsigned int j = 0; j < entity_data.fields.size(); ++j) {
+      const Field& field = entity_data.fields[j];
+      if (field.type == LUA_TSTRING) {
+        lua_pushstring(l, field.string.c_str());
+      }
+      else if (field.type == LUA_TBOOLEAN) {
+        lua_pushboolean(l, field.number != 0);
+      }
+      else {
+        lua_pushnumber(l, field.number);
+      }
+      lua_setfield(l, -2, field.key.c_str());
+    }
+
+    if (lua_pcall(l, 1, 0, 0) != 0) {
+      Debug::die(StringConcat() << "Failed to load map data file '"
+          << file_name << "': " << lua_tostring(l, -1));
+    }
   }
 
+  // Create the tiles declared after the last entity.
+  create_tiles(map, map_data, num_tiles_created, map_data.tiles.size());
+
   lua_close(l);
+}
+
+/**
+ * \brief Creates a range of the recorded tiles of a map.
+ * \param map The map to fill. Its properties must be set.
+ * \param map_data Content of the map data file.
+ * \param first Index of the first tile to create.
+ * \param end Index after the last tile to create.
+ */
+void MapLoader::create_tiles(Map& map, const MapData& map_data,
+    unsigned int first, unsigned int end) {
 
-  // TODO if necessary, store the Lua compiled chunck to speed up next loadings of this map.
+  for (unsigned int i = first; i < end; ++i) {
+    const TileData& tile_data = map_data.tiles[i];
+    LuaContext::create_tiles(map,
+        tile_data.layer,
+        tile_data.x,
+        tile_data.y,
+        tile_data.width,
+        tile_data.height,
+        tile_data.pattern_id);
+  }
+}
+
+/**
+ * \brief Returns the map data being recorded in a Lua state.
+ * \param l The Lua state of a map data file.
+ * \return The map data.
+ */
+MapLoader::MapData& MapLoader::get_map_data(lua_State* l) {
+
+  lua_getfield(l, LUA_REGISTRYINDEX, "map_data");
+  MapData* map_data = static_cast<MapData*>(lua_touserdata(l, -1));
+  lua_pop(l, 1);
+  Debug::check_assertion(map_data != NULL, "No map data in this Lua state");
+  return *map_data;
+}
+
+/**
+ * \brief Records the fields of the table passed to an entity creation
+ * function.
+ * \param l The Lua state of a map data file, with the table at index 1.
+ * \param entity_data The entity whose fields are recorded.
+ */
+void MapLoader::record_fields(lua_State* l, EntityData& entity_data) {
+
+  luaL_checktype(l, 1, LUA_TTABLE);
+
+  lua_pushnil(l);
+  while (lua_next(l, 1) != 0) {
+
+    if (lua_type(l, -2) != LUA_TSTRING) {
+      LuaContext::arg_error(l, 1, "Only string keys are allowed");
+    }
+
+    Field field;
+    field.key = lua_tostring(l, -2);
+    field.type = lua_type(l, -1);
+    field.number = 0.0;
+    switch (field.type) {
+
+      case LUA_TNUMBER:
+        field.number = lua_tonumber(l, -1);
+        break;
+
+      case LUA_TSTRING:
+        field.string = lua_tostring(l, -1);
+        break;
+
+      case LUA_TBOOLEAN:
+        field.number = lua_toboolean(l, -1) ? 1.0 : 0.0;
+        break;
+
+      default:
+        LuaContext::arg_error(l, 1, StringConcat() << "Invalid value for field '"
+            << field.key << "': expected number, string or boolean");
+    }
+    entity_data.fields.push_back(field);
+    lua_pop(l, 1);
+  }
+}
+
+/**
+ * \brief Records a call to the properties() function of the Lua map data
+ * file.
+ *
+ * This function must be called before any entity creation function.
+ *
+ * \param l The Lua state that is calling this function.
+ * \return Number of values to return to Lua.
+ */
+int MapLoader::l_record_properties(lua_State* l) {
+
+  MapData& map_data = get_map_data(l);
+  map_data.properties = EntityData();
+  map_data.properties.type = "properties";
+  map_data.properties.num_tiles_before = 0;
+  record_fields(l, map_data.properties);
+
+  // Properties are set: we now allow the data file to declare entities.
+  lua_register(l, "tile", l_record_tile);
+  for (const luaL_Reg* reg = entity_creation_functions + 1; reg->name != NULL; ++reg) {
+    lua_pushstring(l, reg->name);
+    lua_pushcclosure(l, l_record_entity, 1);
+    lua_setglobal(l, reg->name);
+  }
+
+  return 0;
+}
+
+/**
+ * \brief Records a call to the tile() function of the Lua map data file.
+ * \param l The Lua state that is calling this function.
+ * \return Number of values to return to Lua.
+ */
+int MapLoader::l_record_tile(lua_State* l) {
+
+  TileData tile_data;
+  LuaContext::check_tile_fields(l, 1,
+      tile_data.layer,
+      tile_data.x,
+      tile_data.y,
+      tile_data.width,
+      tile_data.height,
+      tile_data.pattern_id);
+
+  get_map_data(l).tiles.push_back(tile_data);
+  return 0;
+}
+
+/**
+ * \brief Records a call to an entity creation function of the Lua map data
+ * file.
+ *
+ * The type of entity is the first upvalue.
+ *
+ * \param l The Lua state that is calling this function.
+ * \return Number of values to return to Lua.
+ */
+int MapLoader::l_record_entity(lua_State* l) {
+
+  MapData& map_data = get_map_data(l);
+  EntityData entity_data;
+  entity_data.type = lua_tostring(l, lua_upvalueindex(1));
+  entity_data.num_tiles_before = map_data.tiles.size();
+  record_fields(l, entity_data);
+
+  map_data.entities.push_back(entity_data);
+  return 0;
 }
 
 /**
@@ -130,8 +702,12 @@ int MapLoader::l_properties(lua_State* l) {
   map->set_floor(floor);
 
   map->tileset_id = tileset_id;
-  map->tileset = new Tileset(tileset_id);
-  map->tileset->load();
+  if (map->tileset == NULL || map->tileset->get_id() != tileset_id) {
+    // No preloaded tileset.
+    delete map->tileset;
+    map->tileset = new Tileset(tileset_id);
+    map->tileset->load();
+  }
 
   MapEntities& entities = map->get_entities();
   entities.map_width8 = map->width8;
@@ -139,49 +715,16 @@ int MapLoader::l_properties(lua_State* l) {
   entities.tiles_grid_size = map->width8 * map->height8;
   for (int layer = 0; layer < LAYER_NB; layer++) {
 
-    entities.animated_tiles[layer] = new bool[entities.tiles_grid_size];
     entities.tiles_ground[layer] = new Ground[entities.tiles_grid_size];
     Ground initial_ground = (layer == LAYER_LOW) ? GROUND_TRAVERSABLE : GROUND_EMPTY;
     for (int i = 0; i < entities.tiles_grid_size; i++) {
-      entities.animated_tiles[layer][i] = false;
       entities.tiles_ground[layer][i] = initial_ground;
     }
   }
   entities.boomerang = NULL;
+  entities.initialize_grids();
   map->camera = new Camera(*map);
 
-  // Properties are set: we now allow the data file to declare entities.
-  static const luaL_Reg functions[] = {
-    { "tile",             LuaContext::map_api_create_tile },
-    { "destination",      LuaContext::map_api_create_destination },
-    { "teletransporter",  LuaContext::map_api_create_teletransporter },
-    { "pickable",         LuaContext::map_api_create_pickable },
-    { "destructible",     LuaContext::map_api_create_destructible },
-    { "chest",            LuaContext::map_api_create_chest },
-    { "jumper",           LuaContext::map_api_create_jumper },
-    { "enemy",            LuaContext::map_api_create_enemy },
-    { "npc",              LuaContext::map_api_create_npc },
-    { "block",            LuaContext::map_api_create_block },
-    { "dynamic_tile",     LuaContext::map_api_create_dynamic_tile },
-    { "switch",           LuaContext::map_api_create_switch },
-    { "wall",             LuaContext::map_api_create_wall },
-    { "sensor",           LuaContext::map_api_create_sensor },
-    { "crystal",          LuaContext::map_api_create_crystal },
-    { "crystal_block",    LuaContext::map_api_create_crystal_block },
-    { "shop_treasure",    LuaContext::map_api_create_shop_treasure },
-    { "conveyor_belt",    LuaContext::map_api_create_conveyor_belt },
-    { "door",             LuaContext::map_api_create_door },
-    { "stairs",           LuaContext::map_api_create_stairs },
-    { "separator",        LuaContext::map_api_create_separator },
-    { "custom",           LuaContext::map_api_create_custom_entity },
-    { NULL, NULL }
-  };
-  const luaL_Reg* function = functions;
-  while (function->name != NULL) {
-    lua_register(l, function->name, function->func);
-    function++;
-  }
-
   return 0;
 }
 
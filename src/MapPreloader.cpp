@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MapPreloader.h"
+#include "Sprite.h"
+#include "SpriteAnimationSet.h"
+#include "entities/Tileset.h"
+#include <lua.hpp>
+#include <set>
+
+namespace solarus {
+
+MapPreloader::Job* MapPreloader::current_job = NULL;
+std::vector<MapPreloader::Job*> MapPreloader::cancelled_jobs;
+
+/**
+ * \brief Initializes the map preloader.
+ */
+void MapPreloader::initialize() {
+
+}
+
+/**
+ * \brief Uninitializes the map preloader.
+ *
+ * Waits for the worker threads if any and frees what they have loaded.
+ */
+void MapPreloader::quit() {
+
+  cancel();
+  for (unsigned int i = 0; i < cancelled_jobs.size(); ++i) {
+    delete_job(cancelled_jobs[i]);
+  }
+  cancelled_jobs.clear();
+}
+
+/**
+ * \brief Starts loading a map in the background.
+ *
+ * Does nothing if this map is already preloaded or being preloaded.
+ * If another map was preloaded or is still being preloaded, it is
+ * cancelled. This function never waits for a worker thread.
+ *
+ * \param map_id Id of the map to preload.
+ */
+void MapPreloader::preload(const std::string& map_id) {
+
+  if (current_job != NULL && map_id == current_job->map_id) {
+    // Already done.
+    return;
+  }
+
+  // This map may have been cancelled recently: take it back.
+  Job* job = NULL;
+  for (unsigned int i = 0; i < cancelled_jobs.size(); ++i) {
+    if (cancelled_jobs[i]->map_id == map_id) {
+      job = cancelled_jobs[i];
+      cancelled_jobs.erase(cancelled_jobs.begin() + i);
+      break;
+    }
+  }
+
+  cancel();
+  delete_finished_jobs();
+
+  if (job == NULL) {
+    job = new Job();
+    job->map_id = map_id;
+    job->map_data = new MapLoader::MapData();
+    job->tileset = NULL;
+    SDL_AtomicSet(&job->finished, 0);
+    job->thread = SDL_CreateThread(run, "map_preloader", job);
+    if (job->thread == NULL) {
+      // No thread: the map will just be loaded normally.
+      delete job->map_data;
+      delete job;
+      return;
+    }
+  }
+
+  current_job = job;
+}
+
+/**
+ * \brief Returns the id of the map preloaded or being preloaded.
+ * \return The map id, or an empty string.
+ */
+const std::string& MapPreloader::get_map_id() {
+
+  static const std::string none;
+  return current_job != NULL ? current_job->map_id : none;
+}
+
+/**
+ * \brief Returns whether the worker thread has finished preloading the map.
+ * \return \c true if a map is preloaded and ready to be taken.
+ */
+bool MapPreloader::is_ready() {
+  return current_job != NULL && SDL_AtomicGet(&current_job->finished) != 0;
+}
+
+/**
+ * \brief Gives the preloaded data of a map to the caller.
+ *
+ * If the map is still being preloaded, waits for the worker thread to
+ * finish: this is still faster than loading it from the beginning.
+ * The sprite animation sets are added to the ones known by Sprite.
+ *
+ * \param map_id Id of the map to take.
+ * \param tileset Receives the loaded tileset of the map.
+ * The caller becomes responsible for deleting it.
+ * \return The content of the map data file (the caller must delete it),
+ * or NULL if this map was not preloaded.
+ */
+MapLoader::MapData* MapPreloader::take(const std::string& map_id,
+    Tileset*& tileset) {
+
+  delete_finished_jobs();
+
+  if (current_job == NULL || map_id != current_job->map_id) {
+    return NULL;
+  }
+
+  Job* job = current_job;
+  current_job = NULL;
+  SDL_WaitThread(job->thread, NULL);
+
+  for (unsigned int i = 0; i < job->animation_sets.size(); ++i) {
+    Sprite::add_animation_set(job->animation_sets[i]);
+  }
+
+  tileset = job->tileset;
+  MapLoader::MapData* result = job->map_data;
+  delete job;
+
+  return result;
+}
+
+/**
+ * \brief Forgets the map preloaded or being preloaded if any.
+ *
+ * Its worker thread is not waited for: its results are deleted later
+ * by delete_finished_jobs().
+ */
+void MapPreloader::cancel() {
+
+  if (current_job == NULL) {
+    return;
+  }
+
+  cancelled_jobs.push_back(current_job);
+  current_job = NULL;
+}
+
+/**
+ * \brief Waits for the worker thread of a job and deletes its results.
+ * \param job The job to delete.
+ */
+void MapPreloader::delete_job(Job* job) {
+
+  SDL_WaitThread(job->thread, NULL);
+
+  for (unsigned int i = 0; i < job->animation_sets.size(); ++i) {
+    delete job->animation_sets[i];
+  }
+  delete job->tileset;
+  delete job->map_data;
+  delete job;
+}
+
+/**
+ * \brief Deletes the cancelled jobs whose worker thread has finished.
+ *
+ * Jobs still running are kept for later.
+ */
+void MapPreloader::delete_finished_jobs() {
+
+  std::vector<Job*> running_jobs;
+  for (unsigned int i = 0; i < cancelled_jobs.size(); ++i) {
+    Job* job = cancelled_jobs[i];
+    if (SDL_AtomicGet(&job->finished) != 0) {
+      // The thread is exiting: this does not block.
+      delete_job(job);
+    }
+    else {
+      running_jobs.push_back(job);
+    }
+  }
+  cancelled_jobs.swap(running_jobs);
+}
+
+/**
+ * \brief Function executed by a worker thread.
+ *
+ * Reads the map data file, then loads the tileset and the sprite
+ * animation sets it refers to.
+ * Only objects of the job, not yet visible from the main thread, are
+ * modified here. Errors in data files are reported through Debug, which
+ * can be used from any thread.
+ *
+ * \param data The job to run.
+ * \return 0.
+ */
+int MapPreloader::run(void* data) {
+
+  Job* job = static_cast<Job*>(data);
+  MapLoader::MapData* map_data = job->map_data;
+
+  MapLoader::read_map_data(job->map_id, *map_data);
+
+  // Find the tileset and the sprites referenced by the map data file.
+  std::string tileset_id;
+  std::set<std::string> sprite_ids;
+  const unsigned int num_entities = map_data->entities.size();
+  for (unsigned int i = 0; i < num_entities + 1; ++i) {
+    const MapLoader::EntityData& entity_data = (i == 0) ?
+        map_data->properties : map_data->entities[i - 1];
+    for (unsigned int j = 0; j < entity_data.fields.size(); ++j) {
+      const MapLoader::Field& field = entity_data.fields[j];
+      if (field.type != LUA_TSTRING) {
+        continue;
+      }
+      if (i == 0 && field.key == "tileset") {
+        tileset_id = field.string;
+      }
+      else if (i != 0 && field.key == "sprite" && !field.string.empty()) {
+        sprite_ids.insert(field.string);
+      }
+    }
+  }
+
+  if (!tileset_id.empty()) {
+    job->tileset = new Tileset(tileset_id);
+    job->tileset->load();
+  }
+
+  std::set<std::string>::const_iterator it;
+  for (it = sprite_ids.begin(); it != sprite_ids.end(); ++it) {
+    job->animation_sets.push_back(new SpriteAnimationSet(*it));
+  }
+
+  SDL_AtomicSet(&job->finished, 1);
+  return 0;
+}
+
+}
+
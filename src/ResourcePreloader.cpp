@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ResourcePreloader.h"
+#include "QuestResourceList.h"
+#include "Sprite.h"
+#include "SpriteAnimationSet.h"
+#include "lowlevel/Sound.h"
+#include "lowlevel/Surface.h"
+#include "lowlevel/System.h"
+#include "lowlevel/TextSurface.h"
+#include "lowlevel/WorkerPool.h"
+
+namespace solarus {
+
+bool ResourcePreloader::preloaded = false;
+std::vector<Surface*> ResourcePreloader::tileset_images;
+
+/**
+ * \brief Loads a sprite animation set in a worker thread.
+ */
+class ResourcePreloader::SpriteJob: public WorkerPool::Job {
+
+  public:
+
+    SpriteJob(const std::string& animation_set_id):
+      animation_set_id(animation_set_id),
+      animation_set(NULL) {
+
+    }
+
+    void execute() {
+      animation_set = new SpriteAnimationSet(animation_set_id);
+    }
+
+    void finish() {
+      Sprite::add_animation_set(animation_set);
+    }
+
+  private:
+
+    const std::string animation_set_id;          /**< Id of the animation set to load. */
+    SpriteAnimationSet* animation_set;           /**< The animation set loaded. */
+};
+
+/**
+ * \brief Decodes the images of a tileset in a worker thread.
+ *
+ * Unless they are kept, the images are then released: they stay in the
+ * image cache until it is purged.
+ */
+class ResourcePreloader::TilesetJob: public WorkerPool::Job {
+
+  public:
+
+    TilesetJob(const std::string& tileset_id, bool keep_images):
+      tileset_id(tileset_id),
+      keep_images(keep_images),
+      tiles_image(NULL),
+      entities_image(NULL) {
+
+    }
+
+    void execute() {
+      tiles_image = Surface::create(
+          std::string("tilesets/") + tileset_id + ".tiles.png", Surface::DIR_DATA);
+      entities_image = Surface::create(
+          std::string("tilesets/") + tileset_id + ".entities.png", Surface::DIR_DATA);
+    }
+
+    void finish() {
+      finish_image(tiles_image);
+      finish_image(entities_image);
+    }
+
+  private:
+
+    void finish_image(Surface* image) {
+      if (image == NULL) {
+        return;
+      }
+      if (keep_images) {
+        RefCountable::ref(image);
+        tileset_images.push_back(image);
+      }
+      else {
+        delete image;
+      }
+    }
+
+    const std::string tileset_id;                /**< Id of the tileset to load. */
+    const bool keep_images;                      /**< Whether to keep the images until the program ends. */
+    Surface* tiles_image;                        /**< Image of tile patterns. */
+    Surface* entities_image;                     /**< Image of skin-dependent entities. */
+};
+
+/**
+ * \brief Loads all sprites, tilesets images, sounds and fonts of the quest.
+ *
+ * This function returns when everything is loaded.
+ * It does nothing if it was already called before.
+ *
+ * \param keep_tileset_images true to keep tileset images in memory until
+ * the program ends, false to let the next map change free the unused ones.
+ * \return The time it took in milliseconds (0 if it was already called).
+ */
+uint32_t ResourcePreloader::preload_all(bool keep_tileset_images) {
+
+  if (preloaded) {
+    return 0;
+  }
+  preloaded = true;
+
+  const uint32_t start_time = System::get_real_time();
+
+  const std::vector<QuestResourceList::Element>& sprites =
+      QuestResourceList::get_elements(QuestResourceList::RESOURCE_SPRITE);
+  std::vector<QuestResourceList::Element>::const_iterator it;
+  for (it = sprites.begin(); it != sprites.end(); ++it) {
+    if (!Sprite::has_animation_set(it->first)) {
+      WorkerPool::add_job(new SpriteJob(it->first));
+    }
+  }
+
+  const std::vector<QuestResourceList::Element>& tilesets =
+      QuestResourceList::get_elements(QuestResourceList::RESOURCE_TILESET);
+  for (it = tilesets.begin(); it != tilesets.end(); ++it) {
+    WorkerPool::add_job(new TilesetJob(it->first, keep_tileset_images));
+  }
+
+  // Meanwhile, load the fonts in the main thread.
+  TextSurface::load_fonts_if_needed();
+
+  // Add the sounds and wait for all jobs.
+  Sound::load_all();
+  WorkerPool::wait_all();
+
+  return System::get_real_time() - start_time;
+}
+
+/**
+ * \brief Frees the resources loaded by preload_all().
+ *
+ * Sprite animation sets and sounds are freed by their own classes.
+ */
+void ResourcePreloader::quit() {
+
+  for (unsigned int i = 0; i < tileset_images.size(); ++i) {
+    RefCountable::unref(tileset_images[i]);
+  }
+  tileset_images.clear();
+  preloaded = false;
+}
+
+}
+
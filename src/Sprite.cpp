@@ -18,6 +18,7 @@
 #include "SpriteAnimationSet.h"
 #include "SpriteAnimation.h"
 #include "SpriteAnimationDirection.h"
+#include "Transition.h"
 #include "Game.h"
 #include "Map.h"
 #include "movements/Movement.h"
@@ -79,6 +80,35 @@ SpriteAnimationSet& Sprite::get_animation_set(const std::string& id) {
   return *animation_set;
 }
 
+/**
+ * \brief Returns whether an animation set is already loaded.
+ * \param id Id of an animation set.
+ * \return \c true if it is in memory.
+ */
+bool Sprite::has_animation_set(const std::string& id) {
+  return all_animation_sets.find(id) != all_animation_sets.end();
+}
+
+/**
+ * \brief Adds an animation set that was loaded elsewhere.
+ *
+ * This is used to give animation sets preloaded by a background thread.
+ * If an animation set with the same id is already known, the new one is
+ * deleted.
+ *
+ * \param animation_set The animation set to add.
+ * Sprites now become responsible for deleting it.
+ */
+void Sprite::add_animation_set(SpriteAnimationSet* animation_set) {
+
+  const std::string& id = animation_set->get_id();
+  if (all_animation_sets.find(id) != all_animation_sets.end()) {
+    delete animation_set;
+    return;
+  }
+  all_animation_sets[id] = animation_set;
+}
+
 /**
  * \brief Creates a sprite with the specified animation set.
  * \param id name of an animation set
@@ -97,6 +127,8 @@ Sprite::Sprite(const std::string& id):
   finished(false),
   synchronize_to(NULL),
   intermediate_surface(NULL),
+  intermediate_surface_needed(false),
+  opacity(255),
   blink_delay(0) {
 
   set_current_animation(animation_set.get_default_animation());
@@ -696,14 +728,16 @@ void Sprite::raw_draw(
   if (!is_animation_finished()
       && (blink_delay == 0 || blink_is_sprite_visible)) {
 
-    if (intermediate_surface == NULL) {
+    if (!intermediate_surface_needed) {
+      // Apply the opacity to the drawing itself: in GPU mode, it is just a
+      // parameter of the draw command.
       current_animation->draw(dst_surface, dst_position,
-          current_direction, current_frame);
+          current_direction, current_frame, opacity);
     }
     else {
       intermediate_surface->fill_with_color(Color::get_transparent());
       current_animation->draw(*intermediate_surface, get_origin(),
-          current_direction, current_frame);
+          current_direction, current_frame, 255);
       Rectangle dst_position2(dst_position);
       dst_position2.add_xy(-get_origin().get_x(), -get_origin().get_y());
       intermediate_surface->draw_region(get_size(), dst_surface, dst_position2);
@@ -727,6 +761,13 @@ void Sprite::raw_draw_region(
   if (!is_animation_finished()
       && (blink_delay == 0 || blink_is_sprite_visible)) {
 
+    if (!intermediate_surface_needed) {
+      // Clip the frame and apply the opacity to the drawing itself.
+      current_animation->draw_region(region, dst_surface, dst_position,
+          current_direction, current_frame, opacity);
+      return;
+    }
+
     // Clear the working surface.
     get_intermediate_surface().fill_with_color(Color::get_transparent());
 
@@ -736,7 +777,8 @@ void Sprite::raw_draw_region(
         get_intermediate_surface(),
         origin,
         current_direction,
-        current_frame);
+        current_frame,
+        255);
 
     // If the region is bigger than the current frame, clip it.
     // Otherwise, more than the current frame could be visible.
@@ -777,12 +819,24 @@ void Sprite::raw_draw_region(
  */
 void Sprite::draw_transition(Transition& transition) {
 
-  transition.draw(get_intermediate_surface());
+  if (transition.is_opacity_only()) {
+    // No need for an intermediate surface: the opacity is applied
+    // to each drawing of the sprite, and is kept when the transition ends.
+    opacity = transition.get_opacity();
+  }
+  else {
+    transition.draw(get_intermediate_surface());
+    intermediate_surface_needed = true;
+  }
 }
 
 /**
  * \brief Returns the surface where transitions on this drawable object
  * are applied.
+ *
+ * The sprite is only drawn through this surface if a transition needs it
+ * (see draw_transition()).
+ *
  * \return The surface for transitions.
  */
 Surface& Sprite::get_transition_surface() {
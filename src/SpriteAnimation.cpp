@@ -148,19 +148,53 @@ int SpriteAnimation::get_next_frame(
  * (the origin point will be drawn at this position)
  * \param current_direction the direction to show
  * \param current_frame the frame to show in this direction
+ * \param opacity opacity of this drawing (0 to 255)
  */
 void SpriteAnimation::draw(Surface& dst_surface,
-    const Rectangle& dst_position, int current_direction, int current_frame) {
+    const Rectangle& dst_position, int current_direction, int current_frame,
+    int opacity) {
 
   if (src_image != NULL) {
-    if (current_direction < 0
-        || current_direction >= get_nb_directions()) {
-      Debug::die(StringConcat() << "Invalid sprite direction "
-          << current_direction << ": this sprite has " << get_nb_directions()
-          << " direction(s)");
-    }
+    check_direction(current_direction);
     directions[current_direction]->draw(dst_surface, dst_position,
-        current_frame, *src_image);
+        current_frame, *src_image, opacity);
+  }
+}
+
+/**
+ * \brief Draws a subrectangle of a specific frame of this animation on a
+ * surface.
+ * \param region the subrectangle to draw, relative to the origin point;
+ * it may be bigger than the frame: in this case it is clipped
+ * \param dst_surface the surface on which the sprite will be drawn
+ * \param dst_position coordinates on the destination surface
+ * (the origin point will be drawn at this position)
+ * \param current_direction the direction to show
+ * \param current_frame the frame to show in this direction
+ * \param opacity opacity of this drawing (0 to 255)
+ */
+void SpriteAnimation::draw_region(const Rectangle& region,
+    Surface& dst_surface, const Rectangle& dst_position,
+    int current_direction, int current_frame, int opacity) {
+
+  if (src_image != NULL) {
+    check_direction(current_direction);
+    directions[current_direction]->draw_region(region, dst_surface,
+        dst_position, current_frame, *src_image, opacity);
+  }
+}
+
+/**
+ * \brief Stops the program if a direction does not exist in this animation.
+ * \param current_direction the direction to check
+ */
+void SpriteAnimation::check_direction(int current_direction) const {
+
+  if (current_direction < 0
+      || current_direction >= get_nb_directions()) {
+    Debug::die(StringConcat() << "Invalid sprite direction "
+        << current_direction << ": this sprite has " << get_nb_directions()
+        << " direction(s)");
   }
 }
 
@@ -19,6 +19,7 @@
 #include "lowlevel/Surface.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include <algorithm>
 
 namespace solarus {
 
@@ -86,9 +87,11 @@ const Rectangle& SpriteAnimationDirection::get_frame(int frame) const {
  * (the origin point will be drawn at this position)
  * \param current_frame the frame to show
  * \param src_image the image from which the frame is extracted
+ * \param opacity opacity of this drawing (0 to 255)
  */
 void SpriteAnimationDirection::draw(Surface& dst_surface,
-    const Rectangle& dst_position, int current_frame, Surface& src_image) {
+    const Rectangle& dst_position, int current_frame, Surface& src_image,
+    int opacity) {
 
   const Rectangle& current_frame_rect = get_frame(current_frame);
 
@@ -97,7 +100,51 @@ void SpriteAnimationDirection::draw(Surface& dst_surface,
   position_top_left.add_xy(-origin.get_x(), -origin.get_y());
   position_top_left.set_size(current_frame_rect);
 
-  src_image.draw_region(current_frame_rect, dst_surface, position_top_left);
+  src_image.draw_region_with_opacity(current_frame_rect, dst_surface,
+      position_top_left, opacity);
+}
+
+/**
+ * \brief Draws a subrectangle of a specific frame on the map.
+ * \param region the subrectangle to draw, relative to the origin point;
+ * it may be bigger than the frame: in this case it is clipped
+ * \param dst_surface the surface on which the frame will be drawn
+ * \param dst_position coordinates on the destination surface
+ * (the origin point will be drawn at this position)
+ * \param current_frame the frame to show
+ * \param src_image the image from which the frame is extracted
+ * \param opacity opacity of this drawing (0 to 255)
+ */
+void SpriteAnimationDirection::draw_region(const Rectangle& region,
+    Surface& dst_surface, const Rectangle& dst_position,
+    int current_frame, Surface& src_image, int opacity) {
+
+  const Rectangle& current_frame_rect = get_frame(current_frame);
+
+  // Clip the region to the frame, relative to its upper left corner.
+  // Otherwise, more than the current frame could be visible.
+  int x1 = std::max(region.get_x() + origin.get_x(), 0);
+  int y1 = std::max(region.get_y() + origin.get_y(), 0);
+  int x2 = std::min(region.get_x() + origin.get_x() + region.get_width(),
+      current_frame_rect.get_width());
+  int y2 = std::min(region.get_y() + origin.get_y() + region.get_height(),
+      current_frame_rect.get_height());
+
+  if (x2 <= x1 || y2 <= y1) {
+    // Nothing remains visible.
+    return;
+  }
+
+  Rectangle src_position(
+      current_frame_rect.get_x() + x1, current_frame_rect.get_y() + y1,
+      x2 - x1, y2 - y1);
+  Rectangle dst_position2(
+      dst_position.get_x() + x1 - origin.get_x(),
+      dst_position.get_y() + y1 - origin.get_y(),
+      x2 - x1, y2 - y1);
+
+  src_image.draw_region_with_opacity(src_position, dst_surface,
+      dst_position2, opacity);
 }
 
 /**
@@ -48,6 +48,14 @@ SpriteAnimationSet::~SpriteAnimationSet() {
   }
 }
 
+/**
+ * \brief Returns the id of this animation set.
+ * \return The id.
+ */
+const std::string& SpriteAnimationSet::get_id() const {
+  return id;
+}
+
 /**
  * \brief Attempts to load this animation set from its file.
  */
@@ -60,11 +68,9 @@ void SpriteAnimationSet::load() {
   std::string file_name = std::string("sprites/") + id + ".dat";
 
   lua_State* l = luaL_newstate();
-  size_t size;
-  char* buffer;
-  FileTools::data_file_open_buffer(file_name, &buffer, &size);
-  int load_result = luaL_loadbuffer(l, buffer, size, file_name.c_str());
-  FileTools::data_file_close_buffer(buffer);
+  FileTools::DataFileView view = FileTools::data_file_open_view(file_name);
+  int load_result = luaL_loadbuffer(l, view.data, view.size, file_name.c_str());
+  FileTools::data_file_close_view(view);
 
   if (load_result != 0) {
     Debug::error(std::string("Failed to load sprite file '") + file_name
@@ -18,6 +18,7 @@
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include <algorithm>
 
 namespace solarus {
 
@@ -46,14 +47,19 @@ StringResource::~StringResource() {
 void StringResource::initialize() {
 
   strings.clear();
-  std::istream& file = FileTools::data_file_open("text/strings.dat", true);
-  std::string line;
+  FileTools::DataFileView file =
+      FileTools::data_file_open_view("text/strings.dat", true);
+  const char* end = file.data + file.size;
 
   // read each line
   int i = 0;
-  while (std::getline(file, line)) {
+  const char* line_start = file.data;
+  while (line_start < end) {
 
     i++;
+    const char* line_end = std::find(line_start, end, '\n');
+    const std::string line(line_start, line_end);
+    line_start = line_end + 1;
 
     // ignore empty lines or lines starting with '#'
     if (line.size() == 0 || line[0] == '\r' || line[0] == '#') {
@@ -87,7 +93,7 @@ void StringResource::initialize() {
     strings[key] = value;
   }
 
-  FileTools::data_file_close(file);
+  FileTools::data_file_close_view(file);
 }
 
 /**
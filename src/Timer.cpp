@@ -129,6 +129,23 @@ bool Timer::is_finished() {
   return finished;
 }
 
+/**
+ * \brief Returns the next date when something happens to this timer.
+ *
+ * Calling update() before this date is useless unless the timer is suspended
+ * or resumed in the meantime.
+ *
+ * \return The expiration date, or the date of the next clock sound if it is
+ * earlier.
+ */
+uint32_t Timer::get_next_update_date() {
+
+  if (is_with_sound() && next_sound_date < expiration_date) {
+    return next_sound_date;
+  }
+  return expiration_date;
+}
+
 /**
  * \brief Updates the timer.
  */
@@ -46,15 +46,12 @@ Transition::~Transition() {
  * \brief Creates a transition effect with the specified type and direction.
  * \param style style of the transition: Transition::IMMEDIATE, Transition::FADE, etc.
  * \param direction Direction of the transition.
- * \param dst_surface The surface that will receive the transition
- * (used by some kinds of transitions).
  * \param game The current game if any (used by some kinds of transitions).
  * \return the transition created
  */
 Transition* Transition::create(
     Transition::Style style,
     Transition::Direction direction,
-    Surface& dst_surface,
     Game* game) {
 
   Transition* transition = NULL;
@@ -66,7 +63,7 @@ Transition* Transition::create(
     break;
 
   case Transition::FADE:
-    transition = new TransitionFade(direction, dst_surface);
+    transition = new TransitionFade(direction);
     break;
 
   case Transition::SCROLLING:
@@ -129,6 +126,30 @@ bool Transition::needs_previous_surface() const {
   return false;
 }
 
+/**
+ * \brief Returns whether this transition effect only changes the opacity
+ * of what it applies to.
+ *
+ * If true, the object can apply get_opacity() when it is drawn instead of
+ * calling draw() on an intermediate surface.
+ *
+ * \return false
+ */
+bool Transition::is_opacity_only() const {
+  return false;
+}
+
+/**
+ * \brief Returns the current opacity given by this transition effect.
+ *
+ * Only meaningful if is_opacity_only() is true.
+ *
+ * \return The opacity (0 to 255).
+ */
+int Transition::get_opacity() const {
+  return 255;
+}
+
 /**
  * \brief Returns whether this transition is currently suspended.
  * \return true if this transition is suspended.
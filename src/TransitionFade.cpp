@@ -25,15 +25,16 @@ namespace solarus {
 
 /**
  * \brief Creates a fade-in or fade-out transition effect.
+ *
+ * The destination surface is only known when the transition is drawn,
+ * so that objects that apply the opacity themselves don't need one.
+ *
  * \param direction direction of the transition effect (opening or closing)
- * \param dst_surface The destination surface that will receive this
- * transition.
  */
-TransitionFade::TransitionFade(Direction direction, Surface& dst_surface):
+TransitionFade::TransitionFade(Direction direction):
   Transition(direction),
   finished(false),
   alpha(-1),
-  dst_surface(&dst_surface),
   transition_color(NULL) {
 
   if (direction == TRANSITION_CLOSING) {
@@ -96,6 +97,28 @@ void TransitionFade::set_color(Color* color) {
   transition_color = color;
 }
 
+/**
+ * \brief Returns whether this transition only changes the opacity of the
+ * destination.
+ * \return true if the transition has no foreground color.
+ */
+bool TransitionFade::is_opacity_only() const {
+  return transition_color == NULL;
+}
+
+/**
+ * \brief Returns the current opacity of the destination.
+ * \return The opacity (0 to 255).
+ */
+int TransitionFade::get_opacity() const {
+
+  if (alpha == -1) {
+    // Not started yet.
+    return std::min(alpha_start, 255);
+  }
+  return std::min(alpha, 255);
+}
+
 /**
  * \brief Returns whether the transition effect is started and not finished yet.
  * \return true if the transition effect is started
@@ -179,8 +202,6 @@ void TransitionFade::draw(Surface& dst_surface) {
     dst_surface.set_opacity(255);
     dst_surface.fill_with_color(fade_color);
   }
-
-  this->dst_surface = &dst_surface;
 }
 
 }
@@ -884,8 +884,8 @@ bool Hero::is_on_raised_blocks() const {
  */
 Stairs* Hero::get_stairs_overlapping() {
 
-  std::list<Stairs*> all_stairs = get_entities().get_stairs(get_layer());
-  std::list<Stairs*>::iterator it;
+  const std::vector<Stairs*>& all_stairs = get_entities().get_stairs(get_layer());
+  std::vector<Stairs*>::const_iterator it;
   for (it = all_stairs.begin(); it != all_stairs.end(); it++) {
 
     Stairs* stairs = *it;
@@ -25,16 +25,111 @@
 #include "entities/Stairs.h"
 #include "entities/Separator.h"
 #include "entities/Destination.h"
+#include "entities/Detector.h"
+#include "entities/NonAnimatedRegions.h"
 #include "Map.h"
+#include "Sprite.h"
 #include "Game.h"
 #include "lowlevel/Surface.h"
 #include "lowlevel/Color.h"
 #include "lowlevel/Music.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include "lowlevel/Profiler.h"
+#include <cstdlib>
+#include <algorithm>
 
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Removes an element from a vector, preserving the order of the
+ * other ones.
+ * \param elements The vector to modify.
+ * \param element The element to remove.
+ */
+template<typename T>
+void remove_element(std::vector<T>& elements, const T& element) {
+
+  elements.erase(std::remove(elements.begin(), elements.end(), element),
+      elements.end());
+}
+
+/**
+ * \brief Predicate that tells whether an entity belongs to a sorted vector
+ * of entities being removed.
+ */
+class IsRemoved {
+
+  public:
+
+    explicit IsRemoved(const std::vector<const MapEntity*>& removed):
+      removed(removed) {
+    }
+
+    bool operator()(const MapEntity* entity) const {
+      return std::binary_search(removed.begin(), removed.end(), entity);
+    }
+
+  private:
+
+    const std::vector<const MapEntity*>& removed; /**< sorted entities to remove */
+};
+
+/**
+ * \brief Returns the y coordinate that determines the drawing order of an
+ * entity drawn in y order.
+ *
+ * The top of the bounding box would not work for big entities like bosses.
+ *
+ * \param entity An entity.
+ * \return The y coordinate of the bottom of its bounding box.
+ */
+int get_drawn_y(const MapEntity& entity) {
+  return entity.get_top_left_y() + entity.get_height();
+}
+
+/**
+ * \brief Compares entities drawn in y order to a y coordinate, using the
+ * y coordinate each entity had when it was last placed in its vector.
+ */
+class CompareDrawnY {
+
+  public:
+
+    explicit CompareDrawnY(const std::map<const MapEntity*, int>& drawn_y):
+      drawn_y(drawn_y) {
+    }
+
+    bool operator()(const MapEntity* entity, int y) const {
+      return drawn_y.find(entity)->second < y;
+    }
+
+    bool operator()(int y, const MapEntity* entity) const {
+      return y < drawn_y.find(entity)->second;
+    }
+
+  private:
+
+    const std::map<const MapEntity*, int>& drawn_y; /**< y coordinate of each entity when it was placed */
+};
+
+/**
+ * \brief Removes from a vector all entities matched by a predicate,
+ * preserving the order of the other ones.
+ * \param elements The vector to modify.
+ * \param is_removed The entities to remove.
+ */
+template<typename T>
+void remove_elements(std::vector<T>& elements, const IsRemoved& is_removed) {
+
+  elements.erase(std::remove_if(elements.begin(), elements.end(), is_removed),
+      elements.end());
+}
+
+}
+
 /**
  * \brief Constructor.
  * \param game the game
@@ -45,18 +140,19 @@ MapEntities::MapEntities(Game& game, Map& map):
   map(map),
   hero(game.get_hero()),
   default_destination(NULL),
+  detectors_sprite_margin(0),
   boomerang(NULL),
   music_before_miniboss(Music::none) {
 
   Layer layer = hero.get_layer();
   this->obstacle_entities[layer].push_back(&hero);
-  this->entities_drawn_y_order[layer].push_back(&hero);
+  add_entity_drawn_y_order(hero, layer);
   this->ground_observers[layer].push_back(&hero);
   this->named_entities[hero.get_name()] = &hero;
 
-  // surfaces to pre-render static tiles
+  // optimized drawing of static tiles
   for (int layer = 0; layer < LAYER_NB; layer++) {
-    non_animated_tiles_surfaces[layer] = NULL;
+    non_animated_regions[layer] = new NonAnimatedRegions(map, Layer(layer));
   }
 }
 
@@ -66,6 +162,10 @@ MapEntities::MapEntities(Game& game, Map& map):
 MapEntities::~MapEntities() {
 
   destroy_all_entities();
+
+  for (int layer = 0; layer < LAYER_NB; layer++) {
+    delete non_animated_regions[layer];
+  }
 }
 
 /**
@@ -84,9 +184,7 @@ void MapEntities::destroy_all_entities() {
 
     tiles[layer].clear();
     delete[] tiles_ground[layer];
-    delete[] animated_tiles[layer];
-
-    RefCountable::unref(non_animated_tiles_surfaces[layer]);
+    non_animated_regions[layer]->clear();
 
     entities_drawn_first[layer].clear();
     entities_drawn_y_order[layer].clear();
@@ -94,21 +192,44 @@ void MapEntities::destroy_all_entities() {
     ground_observers[layer].clear();
     ground_modifiers[layer].clear();
     stairs[layer].clear();
+    obstacle_entities_grid[layer].clear();
+    ground_modifiers_grid[layer].clear();
+    crystal_blocks_grid[layer].clear();
   }
 
   // delete the other entities
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
-    destroy_entity(*i);
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    destroy_entity(all_entities[i]);
   }
   all_entities.clear();
   named_entities.clear();
+  entities_drawn_y.clear();
+  entities_moved_y_order.clear();
 
   detectors.clear();
+  detectors_grid.clear();
   entities_to_remove.clear();
 }
 
+/**
+ * \brief Sets the size of the spatial indexes of entities.
+ *
+ * This function is called when the size of the map is known,
+ * before any entity is added.
+ */
+void MapEntities::initialize_grids() {
+
+  const int width = map.get_width();
+  const int height = map.get_height();
+  for (int layer = 0; layer < LAYER_NB; layer++) {
+    obstacle_entities_grid[layer].initialize(width, height, grid_cell_size);
+    ground_modifiers_grid[layer].initialize(width, height, grid_cell_size);
+    crystal_blocks_grid[layer].initialize(width, height, grid_cell_size);
+  }
+  detectors_grid.initialize(width, height, grid_cell_size);
+}
+
 /**
  * \brief Destroys an entity.
  *
@@ -138,7 +259,7 @@ Hero& MapEntities::get_hero() {
  * \param layer The layer.
  * \return The obstacle entities on that layer.
  */
-const std::list<MapEntity*>& MapEntities::get_obstacle_entities(Layer layer) {
+const std::vector<MapEntity*>& MapEntities::get_obstacle_entities(Layer layer) {
   return obstacle_entities[layer];
 }
 
@@ -147,7 +268,7 @@ const std::list<MapEntity*>& MapEntities::get_obstacle_entities(Layer layer) {
  * \param layer The layer.
  * \return The ground observers on that layer.
  */
-const std::list<MapEntity*>& MapEntities::get_ground_observers(Layer layer) {
+const std::vector<MapEntity*>& MapEntities::get_ground_observers(Layer layer) {
   return ground_observers[layer];
 }
 
@@ -156,7 +277,7 @@ const std::list<MapEntity*>& MapEntities::get_ground_observers(Layer layer) {
  * \param layer The layer.
  * \return The ground observers on that layer.
  */
-const std::list<MapEntity*>& MapEntities::get_ground_modifiers(Layer layer) {
+const std::vector<MapEntity*>& MapEntities::get_ground_modifiers(Layer layer) {
   return ground_modifiers[layer];
 }
 
@@ -164,10 +285,125 @@ const std::list<MapEntity*>& MapEntities::get_ground_modifiers(Layer layer) {
  * \brief Returns all detectors on the map.
  * \return the detectors
  */
-const std::list<Detector*>& MapEntities::get_detectors() {
+const std::vector<Detector*>& MapEntities::get_detectors() {
   return detectors;
 }
 
+/**
+ * \brief Returns the obstacle entities that may overlap a rectangle.
+ *
+ * This is much faster than traversing get_obstacle_entities() because
+ * only entities stored near the rectangle are considered.
+ * The hero is not included: he is not indexed because he survives map
+ * changes.
+ *
+ * \param layer The layer.
+ * \param where The rectangle to test.
+ * \param[out] obstacles The candidates found are appended to this vector,
+ * in the order of get_obstacle_entities(). Some of them may not actually
+ * overlap the rectangle.
+ */
+void MapEntities::get_obstacle_entities_near(Layer layer, const Rectangle& where,
+    std::vector<MapEntity*>& obstacles) const {
+  obstacle_entities_grid[layer].get_elements(where, obstacles);
+}
+
+/**
+ * \brief Returns the ground modifiers that may overlap a rectangle.
+ * \param layer The layer.
+ * \param where The rectangle to test.
+ * \param[out] ground_modifiers The candidates found are appended to this
+ * vector, in the order of get_ground_modifiers(). Some of them may not
+ * actually overlap the rectangle.
+ */
+void MapEntities::get_ground_modifiers_near(Layer layer, const Rectangle& where,
+    std::vector<MapEntity*>& ground_modifiers) const {
+  ground_modifiers_grid[layer].get_elements(where, ground_modifiers);
+}
+
+/**
+ * \brief Returns whether some ground modifiers may overlap a rectangle.
+ * \param layer The layer.
+ * \param where The rectangle to test.
+ * \return \c false if no ground modifier overlaps this rectangle.
+ */
+bool MapEntities::has_ground_modifiers_near(Layer layer, const Rectangle& where) const {
+  return ground_modifiers_grid[layer].has_elements(where);
+}
+
+/**
+ * \brief Returns the detectors of any layer that may overlap a rectangle.
+ * \param where The rectangle to test.
+ * \param[out] detectors The candidates found are appended to this vector,
+ * in the order of get_detectors(). Some of them may not actually overlap
+ * the rectangle.
+ */
+void MapEntities::get_detectors_near(const Rectangle& where,
+    std::vector<Detector*>& detectors) const {
+  detectors_grid.get_elements(where, detectors);
+}
+
+/**
+ * \brief Returns how far the sprites of detectors may go from their
+ * bounding box.
+ *
+ * Pixel-precise collision checks must extend their search area by this
+ * distance.
+ *
+ * \return The maximum sprite margin of detectors seen on this map.
+ */
+int MapEntities::get_detectors_sprite_margin() const {
+  return detectors_sprite_margin;
+}
+
+/**
+ * \brief Returns the rectangle used to index an entity in the grids.
+ *
+ * This is the bounding box, extended to contain the origin point in case
+ * the origin is outside the bounding box.
+ *
+ * \param entity An entity.
+ * \return The rectangle that represents this entity in the grids.
+ */
+Rectangle MapEntities::get_grid_box(const MapEntity& entity) {
+
+  const Rectangle& bounding_box = entity.get_bounding_box();
+  const int x = entity.get_x();
+  const int y = entity.get_y();
+  const int x1 = std::min(bounding_box.get_x(), x);
+  const int y1 = std::min(bounding_box.get_y(), y);
+  const int x2 = std::max(bounding_box.get_x() + bounding_box.get_width(), x + 1);
+  const int y2 = std::max(bounding_box.get_y() + bounding_box.get_height(), y + 1);
+  return Rectangle(x1, y1, x2 - x1, y2 - y1);
+}
+
+/**
+ * \brief Returns how far the sprites of an entity may go from its origin
+ * point.
+ *
+ * This is a conservative estimation based on the maximum frame size of each
+ * animation set, which is enough to locate candidates of pixel-precise
+ * collisions.
+ *
+ * \param entity An entity.
+ * \return The distance in pixels.
+ */
+int MapEntities::get_sprite_margin(MapEntity& entity) {
+
+  int margin = 0;
+  const std::vector<Sprite*>& sprites = entity.get_sprites();
+  std::vector<Sprite*>::const_iterator it;
+  for (it = sprites.begin(); it != sprites.end(); ++it) {
+    const Sprite& sprite = *(*it);
+    const Rectangle& max_size = sprite.get_max_size();
+    const Rectangle& xy = sprite.get_xy();
+    const int sprite_margin = 2 * std::max(max_size.get_width(), max_size.get_height())
+        + std::abs(xy.get_x()) + std::abs(xy.get_y());
+    margin = std::max(margin, sprite_margin);
+  }
+  return margin;
+}
+
 /**
  * \brief Returns the default destination of the map.
  * \return The default destination, or NULL if there exists no destination
@@ -182,7 +418,7 @@ Destination* MapEntities::get_default_destination() {
  * \param layer the layer
  * \return the stairs on this layer
  */
-const std::list<Stairs*>& MapEntities::get_stairs(Layer layer) {
+const std::vector<Stairs*>& MapEntities::get_stairs(Layer layer) {
   return stairs[layer];
 }
 
@@ -191,7 +427,7 @@ const std::list<Stairs*>& MapEntities::get_stairs(Layer layer) {
  * \param layer the layer
  * \return the crystal blocks on this layer
  */
-const std::list<CrystalBlock*>& MapEntities::get_crystal_blocks(Layer layer) {
+const std::vector<CrystalBlock*>& MapEntities::get_crystal_blocks(Layer layer) {
   return crystal_blocks[layer];
 }
 
@@ -199,7 +435,7 @@ const std::list<CrystalBlock*>& MapEntities::get_crystal_blocks(Layer layer) {
  * \brief Returns all separators of the map.
  * \return The separators.
  */
-const std::list<const Separator*>& MapEntities::get_separators() const {
+const std::vector<const Separator*>& MapEntities::get_separators() const {
   return separators;
 }
 
@@ -273,10 +509,9 @@ std::list<MapEntity*> MapEntities::get_entities_with_prefix(const std::string& p
 
   std::list<MapEntity*> entities;
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
 
-    MapEntity* entity = *i;
+    MapEntity* entity = all_entities[i];
     if (entity->has_prefix(prefix) && !entity->is_being_removed()) {
       entities.push_back(entity);
     }
@@ -297,10 +532,9 @@ std::list<MapEntity*> MapEntities::get_entities_with_prefix(
 
   std::list<MapEntity*> entities;
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
 
-    MapEntity* entity = *i;
+    MapEntity* entity = all_entities[i];
     if (entity->get_type() == type && entity->has_prefix(prefix) && !entity->is_being_removed()) {
       entities.push_back(entity);
     }
@@ -317,10 +551,9 @@ std::list<MapEntity*> MapEntities::get_entities_with_prefix(
  */
 bool MapEntities::has_entity_with_prefix(const std::string& prefix) const {
 
-  std::list<MapEntity*>::const_iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
 
-    const MapEntity* entity = *i;
+    const MapEntity* entity = all_entities[i];
     if (entity->has_prefix(prefix) && !entity->is_being_removed()) {
       return true;
     }
@@ -342,7 +575,7 @@ void MapEntities::bring_to_front(MapEntity* entity) {
     StringConcat() << "Cannot bring to front entity '" << entity->get_name() << "' since it is drawn in the y order");
 
   Layer layer = entity->get_layer();
-  entities_drawn_first[layer].remove(entity);
+  remove_element(entities_drawn_first[layer], entity);
   entities_drawn_first[layer].push_back(entity);
 }
 
@@ -351,17 +584,18 @@ void MapEntities::bring_to_front(MapEntity* entity) {
  */
 void MapEntities::notify_map_started() {
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
-    MapEntity* entity = *i;
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    MapEntity* entity = all_entities[i];
     entity->notify_map_started();
     entity->notify_tileset_changed();
   }
   hero.notify_map_started();
   hero.notify_tileset_changed();
 
-  // pre-render non-animated tiles
-  build_non_animated_tiles();
+  // determine the animated regions to optimize the drawing of tiles
+  for (int layer = 0; layer < LAYER_NB; layer++) {
+    non_animated_regions[layer]->build(tiles[layer]);
+  }
 }
 
 /**
@@ -370,9 +604,8 @@ void MapEntities::notify_map_started() {
  */
 void MapEntities::notify_map_opening_transition_finished() {
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
-    MapEntity* entity = *i;
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    MapEntity* entity = all_entities[i];
     entity->notify_map_opening_transition_finished();
   }
   hero.notify_map_opening_transition_finished();
@@ -385,11 +618,12 @@ void MapEntities::notify_map_opening_transition_finished() {
 void MapEntities::notify_tileset_changed() {
 
   // Redraw optimized tiles (i.e. non animated ones).
-  redraw_non_animated_tiles();
+  for (int layer = 0; layer < LAYER_NB; layer++) {
+    non_animated_regions[layer]->notify_tileset_changed();
+  }
 
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin(); i != all_entities.end(); i++) {
-    MapEntity* entity = *i;
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    MapEntity* entity = all_entities[i];
     entity->notify_tileset_changed();
   }
   hero.notify_map_opening_transition_finished();
@@ -579,9 +813,15 @@ void MapEntities::add_entity(MapEntity* entity) {
   else {
     Layer layer = entity->get_layer();
 
+    const Rectangle& grid_box = get_grid_box(*entity);
+
     // update the detectors list
     if (entity->is_detector()) {
-      detectors.push_back(static_cast<Detector*>(entity));
+      Detector* detector = static_cast<Detector*>(entity);
+      detectors.push_back(detector);
+      detectors_grid.add(detector, grid_box);
+      detectors_sprite_margin = std::max(detectors_sprite_margin,
+          get_sprite_margin(*entity));
     }
 
     // update the obstacle list
@@ -589,13 +829,15 @@ void MapEntities::add_entity(MapEntity* entity) {
 
       if (entity->has_layer_independent_collisions()) {
         // some entities handle collisions on any layer (e.g. stairs inside a single floor)
-        obstacle_entities[LAYER_LOW].push_back(entity);
-        obstacle_entities[LAYER_INTERMEDIATE].push_back(entity);
-        obstacle_entities[LAYER_HIGH].push_back(entity);
+        for (int i = 0; i < LAYER_NB; i++) {
+          obstacle_entities[i].push_back(entity);
+          obstacle_entities_grid[i].add(entity, grid_box);
+        }
       }
       else {
         // but usually, an entity collides with only one layer
         obstacle_entities[layer].push_back(entity);
+        obstacle_entities_grid[layer].add(entity, grid_box);
       }
     }
 
@@ -607,11 +849,12 @@ void MapEntities::add_entity(MapEntity* entity) {
     // update the ground modifiers list
     if (entity->is_ground_modifier()) {
       ground_modifiers[layer].push_back(entity);
+      ground_modifiers_grid[layer].add(entity, grid_box);
     }
 
     // update the sprites list
     if (entity->is_drawn_in_y_order()) {
-      entities_drawn_y_order[layer].push_back(entity);
+      add_entity_drawn_y_order(*entity, layer);
     }
     else if (entity->can_be_drawn()) {
       entities_drawn_first[layer].push_back(entity);
@@ -626,6 +869,7 @@ void MapEntities::add_entity(MapEntity* entity) {
 
       case ENTITY_CRYSTAL_BLOCK:
         crystal_blocks[layer].push_back(static_cast<CrystalBlock*>(entity));
+        crystal_blocks_grid[layer].add(static_cast<CrystalBlock*>(entity), grid_box);
         break;
 
       case ENTITY_SEPARATOR:
@@ -709,75 +953,48 @@ void MapEntities::remove_entities_with_prefix(const std::string& prefix) {
 
 /**
  * \brief Removes and destroys the entities placed in the entities_to_remove list.
+ *
+ * Entities are first removed from the spatial indexes, then all
+ * entity vectors are compacted in a single pass each, keeping the order
+ * of the remaining entities.
  */
 void MapEntities::remove_marked_entities() {
 
-  std::list<MapEntity*>::iterator it;
+  if (entities_to_remove.empty()) {
+    return;
+  }
 
-  // remove the marked entities
-  for (it = entities_to_remove.begin();
-       it != entities_to_remove.end();
-       it++) {
+  // remove the marked entities from the spatial indexes
+  for (unsigned int i = 0; i < entities_to_remove.size(); i++) {
 
-    MapEntity* entity = *it;
+    MapEntity* entity = entities_to_remove[i];
     Layer layer = entity->get_layer();
 
-    // remove it from the obstacle entities list if present
     if (entity->can_be_obstacle()) {
-
-      if (entity->has_layer_independent_collisions()) {
-        for (int i = 0; i < LAYER_NB; i++) {
-          obstacle_entities[i].remove(entity);
-        }
-      }
-      else {
-        obstacle_entities[layer].remove(entity);
+      for (int j = 0; j < LAYER_NB; j++) {
+        obstacle_entities_grid[j].remove(entity);
       }
     }
 
-    // remove it from the detectors list if present
     if (entity->is_detector()) {
-      detectors.remove(static_cast<Detector*>(entity));
+      detectors_grid.remove(static_cast<Detector*>(entity));
     }
 
-    // remove it from the ground obsevers list if present
-    if (entity->is_ground_observer()) {
-      ground_observers[layer].remove(entity);
-    }
-
-    // remove it from the ground modifiers list if present
     if (entity->is_ground_modifier()) {
-      ground_modifiers[layer].remove(entity);
+      ground_modifiers_grid[layer].remove(entity);
     }
 
-    // remove it from the sprite entities list if present
-    if (entity->is_drawn_in_y_order()) {
-      entities_drawn_y_order[layer].remove(entity);
-    }
-    else if (entity->can_be_drawn()) {
-      entities_drawn_first[layer].remove(entity);
-    }
+    entities_drawn_y.erase(entity);
 
-    // remove it from the whole list
-    all_entities.remove(entity);
     const std::string& name = entity->get_name();
     if (!name.empty()) {
       named_entities.erase(name);
     }
 
-    // update the specific entities lists
     switch (entity->get_type()) {
 
-      case ENTITY_STAIRS:
-        stairs[layer].remove(static_cast<Stairs*>(entity));
-        break;
-
       case ENTITY_CRYSTAL_BLOCK:
-        crystal_blocks[layer].remove(static_cast<CrystalBlock*>(entity));
-        break;
-
-      case ENTITY_SEPARATOR:
-        separators.remove(static_cast<Separator*>(entity));
+        crystal_blocks_grid[layer].remove(static_cast<CrystalBlock*>(entity));
         break;
 
       case ENTITY_BOOMERANG:
@@ -787,9 +1004,31 @@ void MapEntities::remove_marked_entities() {
       default:
       break;
     }
+  }
 
-    // destroy it
-    destroy_entity(entity);
+  // compact the entity vectors
+  std::vector<const MapEntity*> removed(
+      entities_to_remove.begin(), entities_to_remove.end());
+  std::sort(removed.begin(), removed.end());
+  const IsRemoved is_removed(removed);
+
+  for (int layer = 0; layer < LAYER_NB; layer++) {
+    remove_elements(obstacle_entities[layer], is_removed);
+    remove_elements(ground_observers[layer], is_removed);
+    remove_elements(ground_modifiers[layer], is_removed);
+    remove_elements(entities_drawn_first[layer], is_removed);
+    remove_elements(entities_drawn_y_order[layer], is_removed);
+    remove_elements(stairs[layer], is_removed);
+    remove_elements(crystal_blocks[layer], is_removed);
+  }
+  remove_elements(detectors, is_removed);
+  remove_elements(separators, is_removed);
+  remove_elements(entities_moved_y_order, is_removed);
+  remove_elements(all_entities, is_removed);
+
+  // destroy them
+  for (unsigned int i = 0; i < entities_to_remove.size(); i++) {
+    destroy_entity(entities_to_remove[i]);
   }
   entities_to_remove.clear();
 }
@@ -809,12 +1048,8 @@ void MapEntities::set_suspended(bool suspended) {
   hero.set_suspended(suspended);
 
   // other entities
-  std::list<MapEntity*>::iterator i;
-  for (i = all_entities.begin();
-       i != all_entities.end();
-       i++) {
-
-    (*i)->set_suspended(suspended);
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    all_entities[i]->set_suspended(suspended);
   }
 
   // note that we don't suspend the tiles
@@ -825,25 +1060,25 @@ void MapEntities::set_suspended(bool suspended) {
  */
 void MapEntities::update() {
 
+  SOLARUS_PROFILE(SECTION_ENTITIES_UPDATE);
+
   Debug::check_assertion(map.is_started(), "The map is not started");
 
   // First update the hero.
   hero.update();
 
-  // Update the dynamic entities.
-  std::list<MapEntity*>::iterator it;
-  for (int layer = 0; layer < LAYER_NB; layer++) {
+  // Move the entities drawn in y order that have moved since the last cycle.
+  update_entities_drawn_y_order();
 
-    // Sort the entities drawn in y order.
-    entities_drawn_y_order[layer].sort(compare_y);
-  }
+  // Update the dynamic entities.
 
-  for (it = all_entities.begin();
-       it != all_entities.end();
-       it++) {
+  // Entities created during this loop are appended to the vector:
+  // use an index since iterators may be invalidated.
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
 
-    if (!(*it)->is_being_removed()) {
-      (*it)->update();
+    MapEntity* entity = all_entities[i];
+    if (!entity->is_being_removed()) {
+      entity->update();
     }
   }
 
@@ -852,205 +1087,119 @@ void MapEntities::update() {
 }
 
 /**
- * \brief Determines which rectangles are animated and draws all non-animated
- * rectangles of tiles on intermediate surfaces.
+ * \brief Draws the entities on the map surface.
  */
-void MapEntities::build_non_animated_tiles() {
+void MapEntities::draw() {
 
-  const Rectangle map_size(0, 0, map.get_width(), map.get_height());
   for (int layer = 0; layer < LAYER_NB; layer++) {
 
-    Surface* non_animated_tiles_surface = non_animated_tiles_surfaces[layer];
+    // draw the tiles near the visible area
+    non_animated_regions[layer]->draw_on_map();
 
-    RefCountable::unref(non_animated_tiles_surface);
-    non_animated_tiles_surface = Surface::create(
-        map_size.get_width(), map_size.get_height()
-    );
-    non_animated_tiles_surfaces[layer] = non_animated_tiles_surface;
-    RefCountable::ref(non_animated_tiles_surface);
-
-    // Set this surface as a software destination because it is built only
-    // once and never changes later.
-    non_animated_tiles_surface->set_software_destination(true);
+    // draw the first sprites
+    const std::vector<MapEntity*>& drawn_first = entities_drawn_first[layer];
+    for (unsigned int i = 0; i < drawn_first.size(); i++) {
 
-    for (unsigned int i = 0; i < tiles[layer].size(); i++) {
-      Tile& tile = *tiles[layer][i];
-      if (!tile.is_animated()) {
-        // non-animated tile: optimize its displaying
-        tile.draw(*non_animated_tiles_surface, map_size);
-      }
-      else {
-        // animated tile: mark its region as non-optimizable
-        // (otherwise, a non-animated tile above an animated one would screw us)
-
-        int tile_x8 = tile.get_x() / 8;
-        int tile_y8 = tile.get_y() / 8;
-        int tile_width8 = tile.get_width() / 8;
-        int tile_height8 = tile.get_height() / 8;
-
-        for (int i = 0; i < tile_height8; i++) {
-          for (int j = 0; j < tile_width8; j++) {
-
-            int x8 = tile_x8 + j;
-            int y8 = tile_y8 + i;
-            if (x8 >= 0 && x8 < map_width8 && y8 >= 0 && y8 < map_height8) {
-              int index = y8 * map_width8 + x8;
-              animated_tiles[layer][index] = true;
-            }
-          }
-        }
+      MapEntity* entity = drawn_first[i];
+      if (entity->is_enabled()) {
+        entity->draw_on_map();
       }
     }
 
-    // erase the rectangles that contain animated tiles
-    int index = 0;
-    for (int y = 0; y < map.get_height(); y += 8) {
-      for (int x = 0; x < map.get_width(); x += 8) {
-
-        if (animated_tiles[layer][index]) {
-          Rectangle animated_square(x, y, 8, 8);
-          non_animated_tiles_surface->fill_with_color(Color::get_transparent(), animated_square);
-        }
-        index++;
-      }
-    }
+    // draw the sprites at the hero's level, in the order
+    // defined by their y position (including the hero)
+    const std::vector<MapEntity*>& drawn_y_order = entities_drawn_y_order[layer];
+    for (unsigned int i = 0; i < drawn_y_order.size(); i++) {
 
-    // build the list of animated tiles and tiles overlapping them
-    for (unsigned int i = 0; i < tiles[layer].size(); i++) {
-      Tile& tile = *tiles[layer][i];
-      if (tile.is_animated() || overlaps_animated_tile(tile)) {
-        tiles_in_animated_regions[layer].push_back(&tile);
+      MapEntity* entity = drawn_y_order[i];
+      if (entity->is_enabled()) {
+        entity->draw_on_map();
       }
     }
   }
 }
 
 /**
- * \brief Draws all non-animated rectangles of tiles on intermediate surfaces.
- *
- * This function is similar to build_non_animated_tiles() except that it
- * assumes that animated and non-animated rectangles were already determined.
- *
- * This function is called when the tileset changes.
+ * \brief Inserts an entity drawn in y order at its place in the drawing
+ * order of a layer.
+ * \param entity The entity to insert.
+ * \param layer The layer where to insert it.
  */
-void MapEntities::redraw_non_animated_tiles() {
-
-  const Rectangle map_size(0, 0, map.get_width(), map.get_height());
-  for (int layer = 0; layer < LAYER_NB; layer++) {
+void MapEntities::add_entity_drawn_y_order(MapEntity& entity, Layer layer) {
 
-    non_animated_tiles_surfaces[layer]->fill_with_color(Color::get_transparent());
+  const int y = get_drawn_y(entity);
+  entities_drawn_y[&entity] = y;
 
-    for (unsigned int i = 0; i < tiles[layer].size(); i++) {
-      Tile& tile = *tiles[layer][i];
-      if (!tile.is_animated()) {
-        // Non-animated tile: optimize its displaying.
-        tile.draw(*non_animated_tiles_surfaces[layer], map_size);
-      }
-    }
-
-    // Erase rectangles that contain animated tiles.
-    int index = 0;
-    for (int y = 0; y < map.get_height(); y += 8) {
-      for (int x = 0; x < map.get_width(); x += 8) {
-
-        if (animated_tiles[layer][index]) {
-          Rectangle animated_square(x, y, 8, 8);
-          non_animated_tiles_surfaces[layer]->fill_with_color(Color::get_transparent(), animated_square);
-        }
-        index++;
-      }
-    }
-  }
+  std::vector<MapEntity*>& entities = entities_drawn_y_order[layer];
+  entities.insert(
+      std::upper_bound(entities.begin(), entities.end(), y, CompareDrawnY(entities_drawn_y)),
+      &entity);
 }
 
 /**
- * \brief Returns whether a tile is overlapping an animated other tile.
- * \param tile the tile to check
- * \return true if this tile is overlapping an animated tile
+ * \brief Moves an entity drawn in y order to its new place in the drawing
+ * order if its y coordinate has changed since it was last placed.
+ *
+ * The entity is found by binary search from the y coordinate it was placed
+ * with, and only the entities between its old and its new place are
+ * shifted. Other entities are not compared.
+ *
+ * \param entity The entity to update.
  */
-bool MapEntities::overlaps_animated_tile(Tile& tile) {
+void MapEntities::update_entity_drawn_y_order(MapEntity& entity) {
 
-  bool* animated_tiles_layer = animated_tiles[tile.get_layer()];
-
-  int tile_x8 = tile.get_x() / 8;
-  int tile_y8 = tile.get_y() / 8;
-  int tile_width8 = tile.get_width() / 8;
-  int tile_height8 = tile.get_height() / 8;
-
-  for (int i = 0; i < tile_height8; i++) {
-    for (int j = 0; j < tile_width8; j++) {
+  std::map<const MapEntity*, int>::iterator it = entities_drawn_y.find(&entity);
+  if (it == entities_drawn_y.end()) {
+    // Not placed on this map (yet).
+    return;
+  }
 
-      int x8 = tile_x8 + j;
-      int y8 = tile_y8 + i;
-      if (x8 >= 0 && x8 < map_width8 && y8 >= 0 && y8 < map_height8) {
+  const int old_y = it->second;
+  const int new_y = get_drawn_y(entity);
+  if (new_y == old_y) {
+    return;
+  }
 
-        int index = y8 * map_width8 + x8;
-        if (animated_tiles_layer[index]) {
-          return true;
-        }
-      }
-    }
+  std::vector<MapEntity*>& entities = entities_drawn_y_order[entity.get_layer()];
+  const CompareDrawnY compare(entities_drawn_y);
+  std::vector<MapEntity*>::iterator current =
+      std::lower_bound(entities.begin(), entities.end(), old_y, compare);
+  while (current != entities.end() && *current != &entity) {
+    ++current;
+  }
+  Debug::check_assertion(current != entities.end(),
+      "Entity drawn in y order not found at its y coordinate");
+
+  // The entity itself is not in the ranges searched below.
+  it->second = new_y;
+  if (new_y > old_y) {
+    std::vector<MapEntity*>::iterator destination =
+        std::upper_bound(current + 1, entities.end(), new_y, compare);
+    std::rotate(current, current + 1, destination);
+  }
+  else {
+    std::vector<MapEntity*>::iterator destination =
+        std::upper_bound(entities.begin(), current, new_y, compare);
+    std::rotate(destination, current, current + 1);
   }
-  return false;
 }
 
 /**
- * \brief Draws the entities on the map surface.
+ * \brief Restores the drawing order of the entities drawn in y order after
+ * some of them have moved.
+ *
+ * Only the entities that moved since the last call are placed again,
+ * so the cost does not depend on the number of entities that did not move.
  */
-void MapEntities::draw() {
+void MapEntities::update_entities_drawn_y_order() {
 
-  for (int layer = 0; layer < LAYER_NB; layer++) {
+  // The hero does not notify his moves.
+  update_entity_drawn_y_order(hero);
 
-    // draw the animated tiles and the tiles that overlap them:
-    // in other words, draw all regions containing animated tiles
-    // (and maybe more, but we don't care because non-animated tiles
-    // will be drawn later)
-    for (unsigned int i = 0; i < tiles_in_animated_regions[layer].size(); i++) {
-      tiles_in_animated_regions[layer][i]->draw_on_map();
-    }
-
-    // draw the non-animated tiles (with transparent rectangles on the regions of animated tiles
-    // since they are already drawn)
-    non_animated_tiles_surfaces[layer]->draw_region(
-        map.get_camera_position(), map.get_visible_surface());
-
-    // draw the first sprites
-    std::list<MapEntity*>::iterator i;
-    for (i = entities_drawn_first[layer].begin();
-        i != entities_drawn_first[layer].end();
-        i++) {
-
-      MapEntity* entity = *i;
-      if (entity->is_enabled()) {
-        entity->draw_on_map();
-      }
-    }
-
-    // draw the sprites at the hero's level, in the order
-    // defined by their y position (including the hero)
-    for (i = entities_drawn_y_order[layer].begin();
-        i != entities_drawn_y_order[layer].end();
-        i++) {
-
-      MapEntity* entity = *i;
-      if (entity->is_enabled()) {
-        entity->draw_on_map();
-      }
-    }
+  for (unsigned int i = 0; i < entities_moved_y_order.size(); i++) {
+    update_entity_drawn_y_order(*entities_moved_y_order[i]);
   }
-}
-
-/**
- * \brief Compares the y position of two entities.
- * \param first an entity
- * \param second another entity
- * \return true if the y position of the first entity is lower
- * than the second one
- */
-bool MapEntities::compare_y(MapEntity* first, MapEntity* second) {
-
-  // before was: first->get_top_left_y() < second->get_top_left_y(); but doesn't work for bosses
-  return first->get_top_left_y() + first->get_height() < second->get_top_left_y() + second->get_height();
+  entities_moved_y_order.clear();
 }
 
 /**
@@ -1069,29 +1218,35 @@ void MapEntities::set_entity_layer(MapEntity& entity, Layer layer) {
 
     // update the obstacle list
     if (entity.can_be_obstacle() && !entity.has_layer_independent_collisions()) {
-      obstacle_entities[old_layer].remove(&entity);
+      remove_element(obstacle_entities[old_layer], &entity);
       obstacle_entities[layer].push_back(&entity);
+      if (obstacle_entities_grid[old_layer].has_element(&entity)) {
+        obstacle_entities_grid[old_layer].remove(&entity);
+        obstacle_entities_grid[layer].add(&entity, get_grid_box(entity));
+      }
     }
 
     // update the ground observers list
     if (entity.is_ground_observer()) {
-      ground_observers[old_layer].remove(&entity);
+      remove_element(ground_observers[old_layer], &entity);
       ground_observers[layer].push_back(&entity);
     }
 
     // update the ground modifiers list
     if (entity.is_ground_modifier()) {
-      ground_modifiers[old_layer].remove(&entity);
+      remove_element(ground_modifiers[old_layer], &entity);
       ground_modifiers[layer].push_back(&entity);
+      ground_modifiers_grid[old_layer].remove(&entity);
+      ground_modifiers_grid[layer].add(&entity, get_grid_box(entity));
     }
 
     // update the sprites list
     if (entity.is_drawn_in_y_order()) {
-      entities_drawn_y_order[old_layer].remove(&entity);
-      entities_drawn_y_order[layer].push_back(&entity);
+      remove_element(entities_drawn_y_order[old_layer], &entity);
+      add_entity_drawn_y_order(entity, layer);
     }
     else if (entity.can_be_drawn()) {
-      entities_drawn_first[old_layer].remove(&entity);
+      remove_element(entities_drawn_first[old_layer], &entity);
       entities_drawn_first[layer].push_back(&entity);
     }
 
@@ -1100,6 +1255,44 @@ void MapEntities::set_entity_layer(MapEntity& entity, Layer layer) {
   }
 }
 
+/**
+ * \brief Updates the spatial indexes and the drawing order after the
+ * bounding box of an entity has changed.
+ *
+ * This function is called by MapEntity whenever its position or size
+ * changes. Entities not indexed (like the hero or tiles) are ignored.
+ *
+ * \param entity An entity of this map.
+ */
+void MapEntities::notify_entity_bounding_box_changed(MapEntity& entity) {
+
+  if (entity.get_type() == ENTITY_TILE) {
+    return;
+  }
+
+  if (entity.is_drawn_in_y_order()) {
+    entities_moved_y_order.push_back(&entity);
+  }
+
+  const Rectangle& grid_box = get_grid_box(entity);
+
+  if (entity.can_be_obstacle()) {
+    for (int layer = 0; layer < LAYER_NB; layer++) {
+      obstacle_entities_grid[layer].move(&entity, grid_box);
+    }
+  }
+
+  if (entity.is_ground_modifier()) {
+    ground_modifiers_grid[entity.get_layer()].move(&entity, grid_box);
+  }
+
+  if (entity.is_detector()) {
+    detectors_grid.move(static_cast<Detector*>(&entity), grid_box);
+    detectors_sprite_margin = std::max(detectors_sprite_margin,
+        get_sprite_margin(entity));
+  }
+}
+
 /**
  * \brief Returns whether a rectangle overlaps with a raised crystal block.
  * \param layer the layer to check
@@ -1109,10 +1302,11 @@ void MapEntities::set_entity_layer(MapEntity& entity, Layer layer) {
 bool MapEntities::overlaps_raised_blocks(Layer layer, const Rectangle& rectangle) {
 
   bool overlaps = false;
-  std::list<CrystalBlock*> blocks = get_crystal_blocks(layer);
+  std::vector<CrystalBlock*> blocks;
+  crystal_blocks_grid[layer].get_elements(rectangle, blocks);
 
-  std::list<CrystalBlock*>::iterator it;
-  for (it = blocks.begin(); it != blocks.end() && !overlaps; it++) {
+  std::vector<CrystalBlock*>::const_iterator it;
+  for (it = blocks.begin(); it != blocks.end() && !overlaps; ++it) {
     overlaps = (*it)->overlaps(rectangle) && (*it)->is_raised();
   }
 
@@ -1144,9 +1338,8 @@ void MapEntities::remove_boomerang() {
 void MapEntities::remove_arrows() {
 
   // TODO this function may be slow if there are a lot of entities: store the arrows?
-  std::list<MapEntity*>::iterator it;
-  for (it = all_entities.begin(); it != all_entities.end(); it++) {
-    MapEntity* entity = *it;
+  for (unsigned int i = 0; i < all_entities.size(); i++) {
+    MapEntity* entity = all_entities[i];
     if (entity->get_type() == ENTITY_ARROW) {
       remove_entity(entity);
     }
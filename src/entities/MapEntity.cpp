@@ -227,11 +227,11 @@ void MapEntity::update_ground_observers() {
   }
 
   // Update overlapping entities sensible to their ground.
-  std::list<MapEntity*>::const_iterator it;
-  const std::list<MapEntity*>& ground_observers =
+  // Use an index: observers may change their layer while being updated.
+  const std::vector<MapEntity*>& ground_observers =
       get_entities().get_ground_observers(get_layer());
-  for (it = ground_observers.begin(); it != ground_observers.end(); ++it) {
-    MapEntity& ground_observer = *(*it);
+  for (unsigned int i = 0; i < ground_observers.size(); i++) {
+    MapEntity& ground_observer = *ground_observers[i];
     // Update the ground of entities that overlap or were just overlapping this one.
 
     if (overlaps(ground_observer.get_ground_point())
@@ -610,6 +610,7 @@ int MapEntity::get_y() const {
  */
 void MapEntity::set_x(int x) {
   bounding_box.set_x(x - origin.get_x());
+  notify_bounding_box_changed();
 }
 
 /**
@@ -621,6 +622,7 @@ void MapEntity::set_x(int x) {
  */
 void MapEntity::set_y(int y) {
   bounding_box.set_y(y - origin.get_y());
+  notify_bounding_box_changed();
 }
 
 /**
@@ -643,8 +645,8 @@ const Rectangle MapEntity::get_xy() const {
  * \param y the new y coordinate of the entity on the map
  */
 void MapEntity::set_xy(int x, int y) {
-  set_x(x);
-  set_y(y);
+  bounding_box.set_xy(x - origin.get_x(), y - origin.get_y());
+  notify_bounding_box_changed();
 }
 
 /**
@@ -680,6 +682,7 @@ int MapEntity::get_top_left_y() const {
  */
 void MapEntity::set_top_left_x(int x) {
   bounding_box.set_x(x);
+  notify_bounding_box_changed();
 }
 
 /**
@@ -688,6 +691,7 @@ void MapEntity::set_top_left_x(int x) {
  */
 void MapEntity::set_top_left_y(int y) {
   bounding_box.set_y(y);
+  notify_bounding_box_changed();
 }
 
 /**
@@ -699,8 +703,8 @@ void MapEntity::set_top_left_y(int y) {
  * \param y y position of the entity
  */
 void MapEntity::set_top_left_xy(int x, int y) {
-  set_top_left_x(x);
-  set_top_left_y(y);
+  bounding_box.set_xy(x, y);
+  notify_bounding_box_changed();
 }
 
 /**
@@ -756,6 +760,7 @@ void MapEntity::set_size(int width, int height) {
   Debug::check_assertion(width % 8 == 0 && height % 8 == 0,
       "Invalid entity size: width and height must be multiple of 8");
   bounding_box.set_size(width, height);
+  notify_bounding_box_changed();
 }
 
 /**
@@ -789,6 +794,23 @@ const Rectangle& MapEntity::get_bounding_box() const {
  */
 void MapEntity::set_bounding_box(const Rectangle &bounding_box) {
   this->bounding_box = bounding_box;
+  notify_bounding_box_changed();
+}
+
+/**
+ * \brief Notifies the map that the bounding box of this entity has just
+ * changed, so that its spatial indexes remain up to date.
+ *
+ * This function is called by all functions that change the position or the
+ * size of the entity.
+ */
+void MapEntity::notify_bounding_box_changed() {
+
+  // The hero is not indexed: he is kept when changing maps and his map
+  // may already be destroyed while he is placed on the new one.
+  if (is_on_map() && !is_hero()) {
+    get_entities().notify_entity_bounding_box_changed(*this);
+  }
 }
 
 /**
@@ -971,6 +993,7 @@ void MapEntity::set_origin(int x, int y) {
 
   bounding_box.add_xy(origin.get_x() - x, origin.get_y() - y);
   origin.set_xy(x, y);
+  notify_bounding_box_changed();
 }
 
 /**
@@ -1064,6 +1087,9 @@ Sprite& MapEntity::create_sprite(const std::string& animation_set_id,
   }
 
   sprites.push_back(sprite);
+
+  // The map may need to know how far sprites go for pixel-precise collisions.
+  notify_bounding_box_changed();
   return *sprite;
 }
 
@@ -1879,8 +1905,8 @@ int MapEntity::get_distance_to_camera2() const {
  */
 bool MapEntity::is_in_same_region(const MapEntity& other) const {
 
-  const std::list<const Separator*>& separators = get_entities().get_separators();
-  std::list<const Separator*>::const_iterator it;
+  const std::vector<const Separator*>& separators = get_entities().get_separators();
+  std::vector<const Separator*>::const_iterator it;
   for (it = separators.begin(); it != separators.end(); ++it) {
 
     const Separator& separator = *(*it);
@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "entities/NonAnimatedRegions.h"
+#include "entities/Tile.h"
+#include "lowlevel/Surface.h"
+#include "lowlevel/Color.h"
+#include "Map.h"
+#include <algorithm>
+
+namespace solarus {
+
+/**
+ * \brief Creates the optimization of the tiles of a layer.
+ * \param map The map (not loaded yet).
+ * \param layer The layer to handle.
+ */
+NonAnimatedRegions::NonAnimatedRegions(Map& map, Layer layer):
+  map(map),
+  layer(layer),
+  map_width8(0),
+  map_height8(0),
+  num_columns(0),
+  num_rows(0),
+  num_chunks_built(0),
+  max_chunks_built(1),
+  frame_number(0) {
+
+  // Share the memory budget between layers.
+  const int chunk_bytes = chunk_size * chunk_size * (SOLARUS_COLOR_DEPTH / 8);
+  max_chunks_built = std::max(
+      SOLARUS_TILE_CACHE_SIZE * 1024 / chunk_bytes / LAYER_NB, 1);
+}
+
+/**
+ * \brief Destructor.
+ */
+NonAnimatedRegions::~NonAnimatedRegions() {
+
+  clear();
+}
+
+/**
+ * \brief Frees the pre-rendered chunks and forgets all tiles.
+ */
+void NonAnimatedRegions::clear() {
+
+  for (unsigned int i = 0; i < chunks.size(); ++i) {
+    free_chunk(i);
+  }
+  chunks.clear();
+  chunks_built.clear();
+  chunks_last_used.clear();
+  animated_squares.clear();
+  non_animated_tiles.clear();
+  tiles_in_animated_regions.clear();
+}
+
+/**
+ * \brief Determines which regions of the layer are animated.
+ *
+ * No chunk is pre-rendered yet: this is done later when they get
+ * close to the visible area.
+ *
+ * \param tiles All tiles of the layer, in the order in which they are drawn.
+ */
+void NonAnimatedRegions::build(const std::vector<Tile*>& tiles) {
+
+  clear();
+
+  const int map_width = map.get_width();
+  const int map_height = map.get_height();
+  map_width8 = map_width / 8;
+  map_height8 = map_height / 8;
+  animated_squares.assign(map_width8 * map_height8, false);
+  non_animated_tiles.initialize(map_width, map_height, chunk_size);
+  tiles_in_animated_regions.initialize(map_width, map_height, chunk_size);
+
+  num_columns = (map_width + chunk_size - 1) / chunk_size;
+  num_rows = (map_height + chunk_size - 1) / chunk_size;
+  chunks.assign(num_columns * num_rows, NULL);
+  chunks_built.assign(chunks.size(), false);
+  chunks_last_used.assign(chunks.size(), 0);
+
+  // Mark the squares of animated tiles as non-optimizable
+  // (otherwise, a non-animated tile above an animated one would screw us).
+  for (unsigned int i = 0; i < tiles.size(); ++i) {
+
+    Tile& tile = *tiles[i];
+    if (!tile.is_animated()) {
+      continue;
+    }
+
+    const int tile_x8 = tile.get_x() / 8;
+    const int tile_y8 = tile.get_y() / 8;
+    const int tile_width8 = tile.get_width() / 8;
+    const int tile_height8 = tile.get_height() / 8;
+
+    for (int y8 = tile_y8; y8 < tile_y8 + tile_height8; y8++) {
+      for (int x8 = tile_x8; x8 < tile_x8 + tile_width8; x8++) {
+        if (x8 >= 0 && x8 < map_width8 && y8 >= 0 && y8 < map_height8) {
+          animated_squares[y8 * map_width8 + x8] = true;
+        }
+      }
+    }
+  }
+
+  const Rectangle map_size(0, 0, map_width, map_height);
+  for (unsigned int i = 0; i < tiles.size(); ++i) {
+
+    Tile* tile = tiles[i];
+    if (!tile->is_animated()) {
+      non_animated_tiles.add(tile, tile->get_bounding_box());
+    }
+
+    if (tile->is_animated() || overlaps_animated_tile(*tile)) {
+      // Tiles that are not drawn at their position (like parallax
+      // scrolling ones) may be visible from anywhere.
+      const Rectangle& where = tile->is_drawn_at_its_position() ?
+          tile->get_bounding_box() : map_size;
+      tiles_in_animated_regions.add(tile, where);
+    }
+  }
+}
+
+/**
+ * \brief Returns whether a tile is overlapping an animated other tile.
+ * \param tile The tile to check.
+ * \return \c true if this tile is overlapping an animated tile.
+ */
+bool NonAnimatedRegions::overlaps_animated_tile(const Tile& tile) const {
+
+  const int tile_x8 = tile.get_x() / 8;
+  const int tile_y8 = tile.get_y() / 8;
+  const int tile_width8 = tile.get_width() / 8;
+  const int tile_height8 = tile.get_height() / 8;
+
+  for (int y8 = tile_y8; y8 < tile_y8 + tile_height8; y8++) {
+    for (int x8 = tile_x8; x8 < tile_x8 + tile_width8; x8++) {
+      if (x8 >= 0 && x8 < map_width8 && y8 >= 0 && y8 < map_height8) {
+        if (animated_squares[y8 * map_width8 + x8]) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief This function is called when the tileset of the map has changed.
+ *
+ * All pre-rendered chunks are freed: they will be redrawn with the new
+ * tileset when needed.
+ */
+void NonAnimatedRegions::notify_tileset_changed() {
+
+  for (unsigned int i = 0; i < chunks.size(); ++i) {
+    free_chunk(i);
+  }
+}
+
+/**
+ * \brief Returns the rectangle of the map covered by a chunk.
+ * \param index Index of a chunk.
+ * \return The rectangle of this chunk, clipped to the map.
+ */
+Rectangle NonAnimatedRegions::get_chunk_rectangle(int index) const {
+
+  const int x = (index % num_columns) * chunk_size;
+  const int y = (index / num_columns) * chunk_size;
+  return Rectangle(x, y,
+      std::min(chunk_size, map.get_width() - x),
+      std::min(chunk_size, map.get_height() - y));
+}
+
+/**
+ * \brief Pre-renders the non-animated tiles of a chunk.
+ * \param index Index of the chunk to build.
+ */
+void NonAnimatedRegions::build_chunk(int index) {
+
+  chunks_built[index] = true;
+
+  const Rectangle chunk_rectangle = get_chunk_rectangle(index);
+  std::vector<Tile*> tiles;
+  non_animated_tiles.get_elements(chunk_rectangle, tiles);
+  if (tiles.empty()) {
+    // Nothing to draw here: don't waste a surface.
+    return;
+  }
+
+  Surface* surface = Surface::create(
+      chunk_rectangle.get_width(), chunk_rectangle.get_height());
+  RefCountable::ref(surface);
+
+  // Set this surface as a software destination because it is built only
+  // once and never changes later.
+  surface->set_software_destination(true);
+
+  for (unsigned int i = 0; i < tiles.size(); ++i) {
+    tiles[i]->draw(*surface, chunk_rectangle);
+  }
+
+  // Erase the squares that contain animated tiles.
+  const int x8_start = chunk_rectangle.get_x() / 8;
+  const int y8_start = chunk_rectangle.get_y() / 8;
+  const int x8_end = std::min(x8_start + chunk_rectangle.get_width() / 8, map_width8);
+  const int y8_end = std::min(y8_start + chunk_rectangle.get_height() / 8, map_height8);
+  for (int y8 = y8_start; y8 < y8_end; ++y8) {
+    for (int x8 = x8_start; x8 < x8_end; ++x8) {
+      if (animated_squares[y8 * map_width8 + x8]) {
+        Rectangle animated_square(
+            x8 * 8 - chunk_rectangle.get_x(),
+            y8 * 8 - chunk_rectangle.get_y(),
+            8, 8);
+        surface->fill_with_color(Color::get_transparent(), animated_square);
+      }
+    }
+  }
+
+  chunks[index] = surface;
+  ++num_chunks_built;
+}
+
+/**
+ * \brief Frees the pre-rendered surface of a chunk if any.
+ * \param index Index of a chunk.
+ */
+void NonAnimatedRegions::free_chunk(int index) {
+
+  if (chunks[index] != NULL) {
+    RefCountable::unref(chunks[index]);
+    chunks[index] = NULL;
+    --num_chunks_built;
+  }
+  chunks_built[index] = false;
+}
+
+/**
+ * \brief Frees the chunks that were not used for the longest time, until
+ * the memory budget is respected.
+ *
+ * Chunks used at the current frame are never freed.
+ */
+void NonAnimatedRegions::free_old_chunks() {
+
+  while (num_chunks_built > max_chunks_built) {
+
+    int oldest = -1;
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+      if (chunks[i] != NULL
+          && chunks_last_used[i] != frame_number
+          && (oldest == -1 || chunks_last_used[i] < chunks_last_used[oldest])) {
+        oldest = i;
+      }
+    }
+
+    if (oldest == -1) {
+      // All chunks are currently needed.
+      return;
+    }
+    free_chunk(oldest);
+  }
+}
+
+/**
+ * \brief Draws the tiles of this layer on the map.
+ *
+ * Only the chunks and the animated tiles near the visible area are drawn.
+ * Missing chunks are built if they are visible.
+ * Chunks that are only close to the visible area are built one per frame,
+ * so that scrolling rarely has to build a chunk immediately.
+ */
+void NonAnimatedRegions::draw_on_map() {
+
+  if (chunks.empty()) {
+    return;
+  }
+
+  ++frame_number;
+  const Rectangle& camera_position = map.get_camera_position();
+  Surface& dst_surface = map.get_visible_surface();
+
+  // Draw the animated tiles and the tiles that overlap them:
+  // in other words, draw all regions containing animated tiles
+  // (and maybe more, but we don't care because non-animated tiles
+  // will be drawn later).
+  std::vector<Tile*> tiles;
+  tiles_in_animated_regions.get_elements(camera_position, tiles);
+  for (unsigned int i = 0; i < tiles.size(); ++i) {
+    tiles[i]->draw_on_map();
+  }
+
+  // Draw the non-animated tiles (with transparent squares on the regions
+  // of animated tiles since they are already drawn).
+  const int margin = chunk_size / 2;
+  const int x1 = std::max((camera_position.get_x() - margin) / chunk_size, 0);
+  const int y1 = std::max((camera_position.get_y() - margin) / chunk_size, 0);
+  const int x2 = std::min((camera_position.get_x() + camera_position.get_width() + margin) / chunk_size,
+      num_columns - 1);
+  const int y2 = std::min((camera_position.get_y() + camera_position.get_height() + margin) / chunk_size,
+      num_rows - 1);
+  bool prefetched = false;
+  for (int y = y1; y <= y2; ++y) {
+    for (int x = x1; x <= x2; ++x) {
+
+      const int index = y * num_columns + x;
+      chunks_last_used[index] = frame_number;
+
+      const Rectangle chunk_rectangle = get_chunk_rectangle(index);
+      if (!chunk_rectangle.overlaps(camera_position)) {
+        // Only in the neighborhood: build it in advance if we have time.
+        if (!chunks_built[index] && !prefetched) {
+          build_chunk(index);
+          prefetched = true;
+        }
+        continue;
+      }
+
+      if (!chunks_built[index]) {
+        build_chunk(index);
+      }
+
+      Surface* surface = chunks[index];
+      if (surface == NULL) {
+        continue;
+      }
+
+      // Only draw the visible part of the chunk.
+      const int visible_x1 = std::max(chunk_rectangle.get_x(), camera_position.get_x());
+      const int visible_y1 = std::max(chunk_rectangle.get_y(), camera_position.get_y());
+      const int visible_x2 = std::min(chunk_rectangle.get_x() + chunk_rectangle.get_width(),
+          camera_position.get_x() + camera_position.get_width());
+      const int visible_y2 = std::min(chunk_rectangle.get_y() + chunk_rectangle.get_height(),
+          camera_position.get_y() + camera_position.get_height());
+      const Rectangle region(
+          visible_x1 - chunk_rectangle.get_x(),
+          visible_y1 - chunk_rectangle.get_y(),
+          visible_x2 - visible_x1,
+          visible_y2 - visible_y1);
+      surface->draw_region(region, dst_surface, Rectangle(
+          visible_x1 - camera_position.get_x(),
+          visible_y1 - camera_position.get_y()));
+    }
+  }
+
+  free_old_chunks();
+}
+
+}
+
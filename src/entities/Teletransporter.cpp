@@ -19,6 +19,7 @@
 #include "Game.h"
 #include "Sprite.h"
 #include "Map.h"
+#include "MapPreloader.h"
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
@@ -63,7 +64,8 @@ Teletransporter::Teletransporter(
   destination_map_id(destination_map_id),
   destination_name(destination_name),
   destination_side(-1),
-  transporting_hero(false) {
+  transporting_hero(false),
+  hero_nearby(false) {
 
   if (!sprite_name.empty()) {
     create_sprite(sprite_name);
@@ -113,6 +115,32 @@ void Teletransporter::set_map(Map& map) {
   transition_direction = (destination_side + 2) % 4;
 }
 
+/**
+ * \brief Updates this teletransporter.
+ *
+ * When the hero comes close, the destination map starts being preloaded
+ * in the background.
+ */
+void Teletransporter::update() {
+
+  Detector::update();
+
+  if (destination_map_id == get_map().get_id()) {
+    return;
+  }
+
+  const Rectangle area(
+      get_top_left_x() - preloading_distance,
+      get_top_left_y() - preloading_distance,
+      get_width() + 2 * preloading_distance,
+      get_height() + 2 * preloading_distance);
+  bool was_hero_nearby = hero_nearby;
+  hero_nearby = get_hero().overlaps(area);
+  if (hero_nearby && !was_hero_nearby) {
+    MapPreloader::preload(destination_map_id);
+  }
+}
+
 /**
  * \brief Returns the type of entity.
  * \return the type of entity
@@ -105,11 +105,9 @@ void Tileset::load() {
   std::string file_name = std::string("tilesets/") + id + ".dat";
 
   lua_State* l = luaL_newstate();
-  size_t size;
-  char* buffer;
-  FileTools::data_file_open_buffer(file_name, &buffer, &size);
-  int load_result = luaL_loadbuffer(l, buffer, size, file_name.c_str());
-  FileTools::data_file_close_buffer(buffer);
+  FileTools::DataFileView view = FileTools::data_file_open_view(file_name);
+  int load_result = luaL_loadbuffer(l, view.data, view.size, file_name.c_str());
+  FileTools::data_file_close_view(view);
 
   if (load_result != 0) {
     Debug::die(StringConcat() << "Failed to load tileset file '"
@@ -15,7 +15,9 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "lowlevel/Debug.h"
+#include <SDL_atomic.h>
 #include <SDL_messagebox.h>
+#include <SDL_thread.h>
 
 namespace solarus {
 
@@ -23,6 +25,29 @@ namespace {
 
   const std::string error_output_file_name = "error.txt";
   std::ofstream error_output_file;
+
+  // Resources are also loaded by worker threads, which may report errors.
+  SDL_SpinLock output_lock = 0;
+  const SDL_threadID main_thread_id = SDL_ThreadID();
+
+  /**
+   * \brief Prints a message on both stderr and error.txt.
+   *
+   * This function can be called from any thread.
+   *
+   * \param prefix Kind of message.
+   * \param message The message to print.
+   */
+  void print(const char* prefix, const std::string& message) {
+
+    SDL_AtomicLock(&output_lock);
+    if (!error_output_file.is_open()) {
+      error_output_file.open(error_output_file_name.c_str());
+    }
+    error_output_file << prefix << message << std::endl << std::flush;
+    std::cerr << prefix << message << std::endl;
+    SDL_AtomicUnlock(&output_lock);
+  }
 }
 
 /**
@@ -31,11 +56,7 @@ namespace {
  */
 void Debug::warning(const std::string& message) {
 
-  if (!error_output_file.is_open()) {
-    error_output_file.open(error_output_file_name.c_str());
-  }
-  error_output_file << "Warning: " << message << std::endl << std::flush;
-  std::cerr << "Warning: " << message << std::endl;
+  print("Warning: ", message);
 }
 
 /**
@@ -47,11 +68,7 @@ void Debug::warning(const std::string& message) {
  */
 void Debug::error(const std::string& message) {
 
-  if (!error_output_file.is_open()) {
-    error_output_file.open(error_output_file_name.c_str());
-  }
-  error_output_file << "Error: " << message << std::endl << std::flush;
-  std::cerr << "Error: " << message << std::endl;
+  print("Error: ", message);
 }
 
 /**
@@ -79,23 +96,23 @@ void Debug::check_assertion(bool assertion, const std::string& error_message) {
  * \brief Aborts the program.
  *
  * This function is equivalent to Debug::check_assertion(false, error_message).
- * The error message is printed on both stderr and error.txt.
+ * The error message is printed on both stderr and error.txt, and is also
+ * shown in a message box when this is called from the main thread.
  *
  * \param error_message The error message to show.
  */
 void Debug::die(const std::string& error_message) {
 
-  if (!error_output_file.is_open()) {
-    error_output_file.open(error_output_file_name.c_str());
+  print("Fatal: ", error_message);
+
+  // Message boxes can only be shown from the main thread on some systems.
+  if (SDL_ThreadID() == main_thread_id) {
+    SDL_ShowSimpleMessageBox(
+        SDL_MESSAGEBOX_ERROR,
+        "Error",
+        error_message.c_str(),
+        NULL);
   }
-  error_output_file << "Fatal: " << error_message << std::endl << std::flush;
-  std::cerr << "Fatal: " << error_message << std::endl;
-
-  SDL_ShowSimpleMessageBox(
-      SDL_MESSAGEBOX_ERROR,
-      "Error",
-      error_message.c_str(),
-      NULL);
 
   std::abort();
 }
@@ -29,6 +29,12 @@
 #ifdef HAVE_UNISTD_H
 #  include <unistd.h>
 #endif
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_MMAN_H)
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  define SOLARUS_HAVE_MMAP
+#endif
 
 #if defined(SOLARUS_OSX) || defined(SOLARUS_IOS)
 #   include "lowlevel/apple/AppleInterface.h"
@@ -195,13 +201,11 @@ bool FileTools::data_file_exists(const std::string& file_name,
 std::istream& FileTools::data_file_open(const std::string& file_name,
     bool language_specific) {
 
-  size_t size;
-  char* buffer;
-  data_file_open_buffer(file_name, &buffer, &size, language_specific);
+  DataFileView view = data_file_open_view(file_name, language_specific);
 
   // create an input stream
-  std::istringstream* is = new std::istringstream(std::string(buffer, size));
-  data_file_close_buffer(buffer);
+  std::istringstream* is = new std::istringstream(std::string(view.data, view.size));
+  data_file_close_view(view);
   return *is;
 }
 
@@ -224,15 +228,7 @@ void FileTools::data_file_close(const std::istream& data_file) {
 void FileTools::data_file_open_buffer(const std::string& file_name, char** buffer,
     size_t* size, bool language_specific) {
 
-  std::string full_file_name;
-  if (language_specific) {
-    Debug::check_assertion(!Language::get_language().empty(), StringConcat() <<
-        "Cannot open language-specific file '" << file_name << "': no language was set");
-    full_file_name = std::string("languages/") + Language::get_language() + "/" + file_name;
-  }
-  else {
-    full_file_name = file_name;
-  }
+  const std::string& full_file_name = get_full_file_name(file_name, language_specific);
 
   // open the file
   Debug::check_assertion(PHYSFS_exists(full_file_name.c_str()), StringConcat()
@@ -252,6 +248,98 @@ void FileTools::data_file_open_buffer(const std::string& file_name, char** buffe
   PHYSFS_close(file);
 }
 
+/**
+ * \brief Returns the name of a data file relative to the search path.
+ * \param file_name Name of a data file.
+ * \param language_specific true if the file is specific to the current language.
+ * \return The file name, prefixed by the language directory if necessary.
+ */
+std::string FileTools::get_full_file_name(const std::string& file_name,
+    bool language_specific) {
+
+  if (!language_specific) {
+    return file_name;
+  }
+
+  Debug::check_assertion(!Language::get_language().empty(), StringConcat() <<
+      "Cannot open language-specific file '" << file_name << "': no language was set");
+  return std::string("languages/") + Language::get_language() + "/" + file_name;
+}
+
+/**
+ * \brief Opens a data file and gives a read-only access to its content.
+ *
+ * If the file is a regular file of the data directory or of the write
+ * directory, it is mapped in memory and nothing is copied.
+ * Otherwise, like for files of a data archive, its content is loaded with
+ * data_file_open_buffer().
+ * Don't forget to close the view with data_file_close_view().
+ * This function can be called from any thread.
+ *
+ * \param file_name name of the file to open
+ * \param language_specific true if the file is specific to the current language
+ * \return A view of the content of the file.
+ */
+FileTools::DataFileView FileTools::data_file_open_view(
+    const std::string& file_name, bool language_specific) {
+
+  DataFileView view;
+
+#ifdef SOLARUS_HAVE_MMAP
+  const std::string& full_file_name = get_full_file_name(file_name, language_specific);
+  const DataFileLocation location = data_file_get_location(full_file_name);
+  if (location == LOCATION_DATA_DIRECTORY
+      || location == LOCATION_WRITE_DIRECTORY) {
+
+    const std::string& real_file_name =
+        std::string(PHYSFS_getRealDir(full_file_name.c_str())) + "/" + full_file_name;
+    int fd = open(real_file_name.c_str(), O_RDONLY);
+    if (fd != -1) {
+      struct stat file_stat;
+      void* data = MAP_FAILED;
+      if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(NULL, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);  // The mapping remains valid.
+
+      if (data != MAP_FAILED) {
+        view.data = static_cast<const char*>(data);
+        view.size = size_t(file_stat.st_size);
+        view.mapped = true;
+        return view;
+      }
+    }
+    // Empty or unreadable file: let PhysFS handle it.
+  }
+#endif
+
+  char* buffer;
+  data_file_open_buffer(file_name, &buffer, &view.size, language_specific);
+  view.data = buffer;
+  view.mapped = false;
+  return view;
+}
+
+/**
+ * \brief Closes a view previously open with data_file_open_view().
+ * \param view the view to close
+ */
+void FileTools::data_file_close_view(DataFileView& view) {
+
+#ifdef SOLARUS_HAVE_MMAP
+  if (view.mapped) {
+    munmap(const_cast<char*>(view.data), view.size);
+    view.data = NULL;
+    view.size = 0;
+    return;
+  }
+#endif
+
+  data_file_close_buffer(const_cast<char*>(view.data));
+  view.data = NULL;
+  view.size = 0;
+}
+
 /**
  * \brief Saves a buffer into a data file.
  * \param file_name Name of the file to write, relative to Solarus write directory.
@@ -276,6 +364,33 @@ void FileTools::data_file_save_buffer(const std::string& file_name,
   PHYSFS_close(file);
 }
 
+/**
+ * \brief Saves a buffer into a data file if possible.
+ *
+ * Unlike data_file_save_buffer(), failures are not fatal.
+ *
+ * \param file_name Name of the file to write, relative to Solarus write directory.
+ * \param buffer The buffer to save.
+ * \param size Number of bytes to write.
+ * \return \c true in case of success.
+ */
+bool FileTools::data_file_try_save_buffer(const std::string& file_name,
+    const char* buffer, size_t size) {
+
+  PHYSFS_file *file = PHYSFS_openWrite(file_name.c_str());
+  if (file == NULL) {
+    return false;
+  }
+
+  bool success = PHYSFS_write(file, buffer, PHYSFS_uint32(size), 1) == 1;
+  success = PHYSFS_close(file) != 0 && success;
+  if (!success) {
+    // Don't leave a truncated file.
+    PHYSFS_delete(file_name.c_str());
+  }
+  return success;
+}
+
 /**
  * \brief Closes a data buffer previously open with data_file_open_buffer().
  * \param buffer the buffer to close
@@ -50,9 +50,12 @@ void Hq2xFilter::filter(
     const uint32_t* src,
     int src_width,
     int src_height,
-    uint32_t* dst) const {
+    int src_pitch,
+    uint32_t* dst,
+    int dst_pitch) const {
 
-  hq2x_32(const_cast<uint32_t*>(src), dst, src_width, src_height);
+  hq2x_32_rb(const_cast<uint32_t*>(src), src_pitch * sizeof(uint32_t),
+      dst, dst_pitch * sizeof(uint32_t), src_width, src_height);
 }
 
 }
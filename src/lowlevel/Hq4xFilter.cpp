@@ -53,9 +53,12 @@ void Hq4xFilter::filter(
     const uint32_t* src,
     int src_width,
     int src_height,
-    uint32_t* dst) const {
+    int src_pitch,
+    uint32_t* dst,
+    int dst_pitch) const {
 
-  hq4x_32(const_cast<uint32_t*>(src), dst, src_width, src_height);
+  hq4x_32_rb(const_cast<uint32_t*>(src), src_pitch * sizeof(uint32_t),
+      dst, dst_pitch * sizeof(uint32_t), src_width, src_height);
 }
 
 /**
@@ -200,13 +200,17 @@ InputEvent::~InputEvent() {
 /**
  * \brief Returns the first event from the event queue, or NULL
  * if there is no event.
+ *
+ * Events ignored by the engine are skipped, so NULL means that the queue is
+ * empty.
+ *
  * \return the current event to handle, or NULL if there is no event
  */
 InputEvent* InputEvent::get_event() {
 
   InputEvent* result = NULL;
   SDL_Event internal_event;
-  if (SDL_PollEvent(&internal_event)) {
+  while (result == NULL && SDL_PollEvent(&internal_event)) {
 
     // ignore intermediate positions of joystick axis
     if (internal_event.type != SDL_JOYAXISMOTION
@@ -1025,5 +1029,17 @@ bool InputEvent::is_window_closing() const {
   return internal_event.type == SDL_QUIT;
 }
 
+// date
+
+/**
+ * \brief Returns when this event occurred.
+ * \return Date of the event in real milliseconds since the beginning of
+ * the program (like System::get_real_time()).
+ */
+uint32_t InputEvent::get_date() const {
+
+  return internal_event.common.timestamp;
+}
+
 }
 
@@ -20,16 +20,24 @@
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include "lowlevel/Profiler.h"
 #include <vector>
 
 namespace solarus {
 
 const int Music::nb_buffers;
+const int Music::buffer_size;
 SpcDecoder* Music::spc_decoder = NULL;
 ItDecoder* Music::it_decoder = NULL;
 float Music::volume = 1.0;
 Music* Music::current_music = NULL;
 std::map<std::string, Music> Music::all_musics;
+Music::DecodedChunk Music::decoded_chunks[Music::nb_buffers];
+SDL_atomic_t Music::nb_chunks_written;
+SDL_atomic_t Music::nb_chunks_read;
+SDL_atomic_t Music::decoding_stopped;
+SDL_Thread* Music::decoding_thread = NULL;
+SDL_mutex* Music::decoder_mutex = NULL;
 
 const std::string Music::none = "none";
 const std::string Music::unchanged = "same";
@@ -85,6 +93,7 @@ void Music::initialize() {
   // initialize the decoding features
   spc_decoder = new SpcDecoder();
   it_decoder = new ItDecoder();
+  decoder_mutex = SDL_CreateMutex();
 
   set_volume(100);
 }
@@ -97,6 +106,8 @@ void Music::quit() {
     all_musics.clear();
     delete spc_decoder;
     delete it_decoder;
+    SDL_DestroyMutex(decoder_mutex);
+    decoder_mutex = NULL;
   }
 }
 
@@ -156,7 +167,10 @@ int Music::get_num_channels() {
   Debug::check_assertion(get_format() == IT,
       "This function is only supported for .it musics");
 
-  return it_decoder->get_num_channels();
+  SDL_LockMutex(decoder_mutex);
+  int num_channels = it_decoder->get_num_channels();
+  SDL_UnlockMutex(decoder_mutex);
+  return num_channels;
 }
 
 /**
@@ -172,7 +186,10 @@ int Music::get_channel_volume(int channel) {
   Debug::check_assertion(get_format() == IT,
       "This function is only supported for .it musics");
 
-  return it_decoder->get_channel_volume(channel);
+  SDL_LockMutex(decoder_mutex);
+  int volume = it_decoder->get_channel_volume(channel);
+  SDL_UnlockMutex(decoder_mutex);
+  return volume;
 }
 
 /**
@@ -188,7 +205,9 @@ void Music::set_channel_volume(int channel, int volume) {
   Debug::check_assertion(get_format() == IT,
       "This function is only supported for .it musics");
 
+  SDL_LockMutex(decoder_mutex);
   it_decoder->set_channel_volume(channel, volume);
+  SDL_UnlockMutex(decoder_mutex);
 }
 
 /**
@@ -203,7 +222,10 @@ int Music::get_tempo() {
   Debug::check_assertion(get_format() == IT,
       "This function is only supported for .it musics");
 
-  return it_decoder->get_tempo();
+  SDL_LockMutex(decoder_mutex);
+  int tempo = it_decoder->get_tempo();
+  SDL_UnlockMutex(decoder_mutex);
+  return tempo;
 }
 
 /**
@@ -218,7 +240,9 @@ void Music::set_tempo(int tempo) {
   Debug::check_assertion(get_format() == IT,
       "This function is only supported for .it musics");
 
+  SDL_LockMutex(decoder_mutex);
   it_decoder->set_tempo(tempo);
+  SDL_UnlockMutex(decoder_mutex);
 }
 
 
@@ -335,6 +359,8 @@ void Music::play(const std::string& music_id) {
  */
 void Music::update() {
 
+  SOLARUS_PROFILE(SECTION_MUSIC_UPDATE);
+
   if (!is_initialized()) {
     return;
   }
@@ -347,119 +373,167 @@ void Music::update() {
 /**
  * \brief Updates this music when it is playing.
  *
- * This function handles the double buffering.
+ * This function gives the chunks already decoded by the decoding thread
+ * to the OpenAL buffers that have finished playing.
+ * It never decodes anything itself.
  */
 void Music::update_playing() {
 
   // get the empty buffers
   ALint nb_empty;
   alGetSourcei(source, AL_BUFFERS_PROCESSED, &nb_empty);
-
-  // refill them
   for (int i = 0; i < nb_empty; i++) {
     ALuint buffer;
-    alSourceUnqueueBuffers(source, 1, &buffer); // unqueue the buffer
-
-    // fill it by decoding more data
-    switch (format) {
+    alSourceUnqueueBuffers(source, 1, &buffer);
+    free_buffers.push_back(buffer);
+  }
 
-      case SPC:
-        decode_spc(buffer, 4096);
-        break;
+  // refill them with the chunks available in the ring
+  int nb_read = SDL_AtomicGet(&nb_chunks_read);
+  const int nb_written = SDL_AtomicGet(&nb_chunks_written);
+  while (!free_buffers.empty() && nb_read < nb_written) {
 
-      case IT:
-        decode_it(buffer, 4096);
-        break;
+    const DecodedChunk& chunk = decoded_chunks[nb_read % nb_buffers];
+    ALuint buffer = free_buffers.back();
+    alBufferData(buffer, chunk.format, &chunk.data[0], chunk.size, chunk.sample_rate);
 
-      case OGG:
-        decode_ogg(buffer, 4096);
-        break;
+    // OpenAL has copied the data: give the slot back to the decoding thread.
+    ++nb_read;
+    SDL_AtomicSet(&nb_chunks_read, nb_read);
 
-      case NO_FORMAT:
-        Debug::die("Invalid music format");
-        break;
+    int error = alGetError();
+    if (error != AL_NO_ERROR) {
+      Debug::error(StringConcat()
+          << "Failed to fill the audio buffer with decoded data for music file '"
+          << file_name << "': error " << error);
+      continue;
     }
-    alSourceQueueBuffers(source, 1, &buffer);   // queue it again
+
+    free_buffers.pop_back();
+    alSourceQueueBuffers(source, 1, &buffer);
   }
 
   ALint status;
   alGetSourcei(source, AL_SOURCE_STATE, &status);
 
   if (status != AL_PLAYING) {
-    alSourcePlay(source);
+    // The source stops by itself if it runs out of data.
+    ALint nb_queued;
+    alGetSourcei(source, AL_BUFFERS_QUEUED, &nb_queued);
+    if (nb_queued > 0) {
+      alSourcePlay(source);
+    }
+  }
+}
+
+/**
+ * \brief Decodes the next chunk of this music.
+ *
+ * This function is called by the decoding thread.
+ *
+ * \param chunk The chunk to fill.
+ * \return true in case of success.
+ */
+bool Music::decode_chunk(DecodedChunk& chunk) {
+
+  switch (format) {
+
+    case SPC:
+      return decode_spc(chunk, buffer_size);
+
+    case IT:
+      return decode_it(chunk, buffer_size);
+
+    case OGG:
+      return decode_ogg(chunk, buffer_size);
+
+    case NO_FORMAT:
+      Debug::die("Invalid music format");
+      break;
   }
+  return false;
 }
 
 /**
  * \brief Decodes a chunk of SPC data into PCM data for the current music.
- * \param destination_buffer the destination buffer to write
+ * \param chunk The chunk to fill.
  * \param nb_samples number of samples to write
+ * \return true in case of success.
  */
-void Music::decode_spc(ALuint destination_buffer, ALsizei nb_samples) {
+bool Music::decode_spc(DecodedChunk& chunk, ALsizei nb_samples) {
 
-  // decode the SPC data
-  std::vector<ALushort> raw_data(nb_samples);
-  spc_decoder->decode((int16_t*) &raw_data[0], nb_samples);
+  const size_t size = nb_samples * sizeof(int16_t);
+  if (chunk.data.size() < size) {
+    chunk.data.resize(size);
+  }
 
-  // put this decoded data into the buffer
-  alBufferData(destination_buffer, AL_FORMAT_STEREO16, &raw_data[0], nb_samples * 2, 32000);
+  // decode the SPC data
+  spc_decoder->decode((int16_t*) &chunk.data[0], nb_samples);
 
-  int error = alGetError();
-  Debug::check_assertion(error == AL_NO_ERROR,
-      StringConcat() << "Failed to fill the audio buffer with decoded SPC data for music file '" << file_name << ": error " << error);
+  chunk.size = ALsizei(size);
+  chunk.format = AL_FORMAT_STEREO16;
+  chunk.sample_rate = 32000;
+  return true;
 }
 
 /**
  * \brief Decodes a chunk of IT data into PCM data for the current music.
- * \param destination_buffer the destination buffer to write
+ * \param chunk The chunk to fill.
  * \param nb_samples number of samples to write
+ * \return true in case of success.
  */
-void Music::decode_it(ALuint destination_buffer, ALsizei nb_samples) {
+bool Music::decode_it(DecodedChunk& chunk, ALsizei nb_samples) {
 
-  // decode the IT data
-  std::vector<ALushort> raw_data(nb_samples);
-  it_decoder->decode(&raw_data[0], nb_samples);
+  if (chunk.data.size() < size_t(nb_samples)) {
+    chunk.data.resize(nb_samples);
+  }
 
-  // put this decoded data into the buffer
-  alBufferData(destination_buffer, AL_FORMAT_STEREO16, &raw_data[0], nb_samples, 44100);
+  // decode the IT data
+  it_decoder->decode(&chunk.data[0], nb_samples);
 
-  int error = alGetError();
-  Debug::check_assertion(error == AL_NO_ERROR,
-      StringConcat() << "Failed to fill the audio buffer with decoded IT data for music file '" << file_name << ": error " << error);
+  chunk.size = nb_samples;
+  chunk.format = AL_FORMAT_STEREO16;
+  chunk.sample_rate = 44100;
+  return true;
 }
 
 /**
  * \brief Decodes a chunk of OGG data into PCM data for the current music.
- * \param destination_buffer the destination buffer to write
+ * \param chunk The chunk to fill.
  * \param nb_samples number of samples to write
+ * \return true in case of success.
  */
-void Music::decode_ogg(ALuint destination_buffer, ALsizei nb_samples) {
+bool Music::decode_ogg(DecodedChunk& chunk, ALsizei nb_samples) {
 
   // read the encoded music properties
   vorbis_info* info = ov_info(&ogg_file, -1);
-  ALsizei sample_rate = ALsizei(info->rate);
+  chunk.sample_rate = ALsizei(info->rate);
 
-  ALenum al_format = AL_NONE;
+  chunk.format = AL_NONE;
   if (info->channels == 1) {
-    al_format = AL_FORMAT_MONO16;
+    chunk.format = AL_FORMAT_MONO16;
   }
   else if (info->channels == 2) {
-    al_format = AL_FORMAT_STEREO16;
+    chunk.format = AL_FORMAT_STEREO16;
   }
 
   // decode the OGG data
-  std::vector<ALshort> raw_data(nb_samples * info->channels);
+  const size_t size = nb_samples * info->channels * sizeof(ALshort);
+  if (chunk.data.size() < size) {
+    chunk.data.resize(size);
+  }
+
   int bitstream;
   long bytes_read;
   long total_bytes_read = 0;
-  long remaining_bytes = nb_samples * info->channels * sizeof(ALshort);
+  long remaining_bytes = long(size);
   do {
-    bytes_read = ov_read(&ogg_file, ((char*) &raw_data[0]) + total_bytes_read, int(remaining_bytes), 0, 2, 1, &bitstream);
+    bytes_read = ov_read(&ogg_file, &chunk.data[0] + total_bytes_read, int(remaining_bytes), 0, 2, 1, &bitstream);
     if (bytes_read < 0) {
       if (bytes_read != OV_HOLE) { // OV_HOLE is normal when the music loops
         Debug::error(StringConcat() << "Error while decoding ogg chunk: "
             << bytes_read);
-        return;
+        return false;
       }
     }
     else {
@@ -469,15 +543,85 @@ void Music::decode_ogg(ALuint destination_buffer, ALsizei nb_samples) {
   }
   while (remaining_bytes > 0 && bytes_read > 0);
 
-  // put this decoded data into the buffer
-  alBufferData(destination_buffer, al_format, &raw_data[0], ALsizei(total_bytes_read), sample_rate);
+  chunk.size = ALsizei(total_bytes_read);
+  return total_bytes_read > 0;
+}
 
-  int error = alGetError();
-  if (error != AL_NO_ERROR) {
-    Debug::error(StringConcat()
-        << "Failed to fill the audio buffer with decoded OGG data for music file '"
-        << file_name << "': error " << error);
+/**
+ * \brief Starts the thread that decodes this music in advance.
+ *
+ * The decoder of this music must be loaded.
+ */
+void Music::start_decoding_thread() {
+
+  Debug::check_assertion(decoding_thread == NULL,
+      "A music decoding thread is already running");
+
+  SDL_AtomicSet(&nb_chunks_written, 0);
+  SDL_AtomicSet(&nb_chunks_read, 0);
+  SDL_AtomicSet(&decoding_stopped, 0);
+  decoding_thread = SDL_CreateThread(decoding_thread_main, "music", this);
+  if (decoding_thread == NULL) {
+    Debug::error(StringConcat() << "Cannot create the music decoding thread: "
+        << SDL_GetError());
+  }
+}
+
+/**
+ * \brief Stops the thread that decodes this music, if any.
+ *
+ * After this call, the decoder of this music can be safely unloaded.
+ */
+void Music::stop_decoding_thread() {
+
+  if (decoding_thread == NULL) {
+    return;
+  }
+
+  SDL_AtomicSet(&decoding_stopped, 1);
+  SDL_WaitThread(decoding_thread, NULL);
+  decoding_thread = NULL;
+}
+
+/**
+ * \brief Function executed by the music decoding thread.
+ *
+ * The thread keeps the ring of decoded chunks full until it is asked to stop.
+ * This is a single producer, single consumer ring: this thread only writes
+ * nb_chunks_written and the main thread only writes nb_chunks_read.
+ *
+ * \param music The music to decode.
+ * \return 0.
+ */
+int Music::decoding_thread_main(void* music) {
+
+  Music& current = *static_cast<Music*>(music);
+
+  while (SDL_AtomicGet(&decoding_stopped) == 0) {
+
+    const int nb_written = SDL_AtomicGet(&nb_chunks_written);
+    const int nb_read = SDL_AtomicGet(&nb_chunks_read);
+    if (nb_written - nb_read >= nb_buffers) {
+      // The ring is full: wait for the main thread to consume a chunk.
+      SDL_Delay(5);
+      continue;
+    }
+
+    DecodedChunk& chunk = decoded_chunks[nb_written % nb_buffers];
+    SDL_LockMutex(decoder_mutex);
+    bool success = current.decode_chunk(chunk);
+    SDL_UnlockMutex(decoder_mutex);
+
+    if (success) {
+      // Publish the chunk.
+      SDL_AtomicSet(&nb_chunks_written, nb_written + 1);
+    }
+    else {
+      SDL_Delay(5);
+    }
   }
+
+  return 0;
 }
 
 /**
@@ -509,6 +653,7 @@ bool Music::start() {
   }
 
   bool success = true;
+  bool decoder_loaded = true;
 
   // create the buffers and the source
   alGenBuffers(nb_buffers, buffers);
@@ -527,10 +672,6 @@ bool Music::start() {
       // load the SPC data into the SPC decoding library
       spc_decoder->load((int16_t*) sound_data, sound_size);
       FileTools::data_file_close_buffer(sound_data);
-
-      for (int i = 0; i < nb_buffers; i++) {
-        decode_spc(buffers[i], 4096);
-      }
       break;
 
     case IT:
@@ -540,10 +681,6 @@ bool Music::start() {
       // load the IT data into the IT decoding library
       it_decoder->load(sound_data, sound_size);
       FileTools::data_file_close_buffer(sound_data);
-
-      for (int i = 0; i < nb_buffers; i++) {
-        decode_it(buffers[i], 4096);
-      }
       break;
 
     case OGG:
@@ -558,11 +695,7 @@ bool Music::start() {
       if (error) {
         Debug::error(StringConcat() << "Cannot load music file '" << file_name
           << "' from memory: error " << error);
-      }
-      else {
-        for (int i = 0; i < nb_buffers; i++) {
-          decode_ogg(buffers[i], 4096);
-        }
+        decoder_loaded = false;
       }
       break;
     }
@@ -572,8 +705,6 @@ bool Music::start() {
       break;
   }
 
-  // start the streaming
-  alSourceQueueBuffers(source, nb_buffers, buffers);
   int error = alGetError();
   if (error != AL_NO_ERROR) {
     Debug::error(StringConcat() << "Cannot initialize buffers for music '"
@@ -581,7 +712,11 @@ bool Music::start() {
     success = false;
   }
 
-  alSourcePlay(source);
+  // start the streaming: all buffers are empty until the thread decodes data
+  free_buffers.assign(buffers, buffers + nb_buffers);
+  if (success && decoder_loaded) {
+    start_decoding_thread();
+  }
 
   // now the update() function will take care of filling the buffers
   current_music = this;
@@ -602,6 +737,9 @@ void Music::stop() {
     return;
   }
 
+  // the decoders must not be used anymore
+  stop_decoding_thread();
+
   // empty the source
   alSourceStop(source);
 
@@ -618,6 +756,7 @@ void Music::stop() {
 
   // delete the buffers
   alDeleteBuffers(nb_buffers, buffers);
+  free_buffers.clear();
 
   current_music = NULL;
 
@@ -15,9 +15,119 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "lowlevel/PixelFilter.h"
+#include "lowlevel/WorkerPool.h"
+#include <algorithm>
+#include <cstring>
 
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Minimum number of rows of a band.
+ *
+ * Each band also filters one row above and below it, so small bands would
+ * waste time.
+ */
+const int min_band_height = 16;
+
+}
+
+/**
+ * \brief Rows of a frame filtered by a thread.
+ *
+ * The band is filtered together with the rows around it, so that its
+ * border pixels take their neighbors into account.
+ * Only the rows of the band are copied into the destination.
+ */
+class PixelFilter::Band: public WorkerPool::Job {
+
+  public:
+
+    void execute();
+
+    const PixelFilter* filter;    /**< the filter to apply */
+    const uint32_t* src;          /**< the whole source frame */
+    int src_width;                /**< width of the source frame */
+    int src_height;               /**< height of the source frame */
+    int src_pitch;                /**< pixels between two rows of the source */
+    uint32_t* dst;                /**< the whole destination frame */
+    int dst_pitch;                /**< pixels between two rows of the destination */
+    int first_row;                /**< first source row of the band */
+    int num_rows;                 /**< number of source rows of the band */
+    std::vector<uint32_t> buffer; /**< the band filtered with its neighbor rows */
+};
+
+/**
+ * \brief Filters the band.
+ */
+void PixelFilter::Band::execute() {
+
+  const int factor = filter->get_scaling_factor();
+  const int first_filtered_row = std::max(first_row - 1, 0);
+  const int end_row = std::min(first_row + num_rows + 1, src_height);
+  const int buffer_pitch = src_width * factor;
+  buffer.resize(buffer_pitch * (end_row - first_filtered_row) * factor);
+
+  filter->filter(
+      src + first_filtered_row * src_pitch,
+      src_width,
+      end_row - first_filtered_row,
+      src_pitch,
+      &buffer[0],
+      buffer_pitch);
+
+  const int row_offset = (first_row - first_filtered_row) * factor;
+  for (int y = 0; y < num_rows * factor; ++y) {
+    std::memcpy(
+        dst + (first_row * factor + y) * dst_pitch,
+        &buffer[(row_offset + y) * buffer_pitch],
+        buffer_pitch * sizeof(uint32_t));
+  }
+}
+
+std::vector<PixelFilter::Band*> PixelFilter::bands;
+int PixelFilter::num_threads = 0;
+
+/**
+ * \brief Frees the memory used to filter frames.
+ */
+void PixelFilter::quit() {
+
+  for (unsigned i = 0; i < bands.size(); ++i) {
+    delete bands[i];
+  }
+  bands.clear();
+}
+
+/**
+ * \brief Returns the number of threads that filter whole frames.
+ *
+ * By default, these are the main thread and all workers.
+ *
+ * \return The number of threads, including the main thread.
+ */
+int PixelFilter::get_num_threads() {
+
+  if (num_threads == 0) {
+    return WorkerPool::get_num_workers() + 1;
+  }
+  return num_threads;
+}
+
+/**
+ * \brief Changes the number of threads that filter whole frames.
+ *
+ * Frames are split into this number of bands. Bands beyond the number of
+ * workers wait for a free one.
+ *
+ * \param num_threads The number of threads, including the main thread.
+ */
+void PixelFilter::set_num_threads(int num_threads) {
+
+  PixelFilter::num_threads = std::max(num_threads, 1);
+}
+
 /**
  * \brief Constructor.
  */
@@ -30,5 +140,53 @@ PixelFilter::PixelFilter() {
 PixelFilter::~PixelFilter() {
 }
 
+/**
+ * \brief Applies the algorithm on a whole frame, splitting it into
+ * horizontal bands filtered in parallel.
+ *
+ * Parameters are the same as filter().
+ * This function must be called from the main thread.
+ */
+void PixelFilter::filter_in_bands(
+    const uint32_t* src,
+    int src_width,
+    int src_height,
+    int src_pitch,
+    uint32_t* dst,
+    int dst_pitch) const {
+
+  const int num_bands = std::min(get_num_threads(), src_height / min_band_height);
+  if (num_bands <= 1) {
+    // Not worth it.
+    filter(src, src_width, src_height, src_pitch, dst, dst_pitch);
+    return;
+  }
+
+  while (int(bands.size()) < num_bands) {
+    bands.push_back(new Band());
+  }
+
+  const int rows_per_band = (src_height + num_bands - 1) / num_bands;
+  static std::vector<WorkerPool::Job*> jobs;
+  jobs.clear();
+  for (int i = 0; i < num_bands; ++i) {
+    Band& band = *bands[i];
+    band.filter = this;
+    band.src = src;
+    band.src_width = src_width;
+    band.src_height = src_height;
+    band.src_pitch = src_pitch;
+    band.dst = dst;
+    band.dst_pitch = dst_pitch;
+    band.first_row = i * rows_per_band;
+    band.num_rows = std::min(rows_per_band, src_height - band.first_row);
+    if (band.num_rows > 0) {
+      jobs.push_back(&band);
+    }
+  }
+
+  WorkerPool::execute_now(jobs);
+}
+
 }
 
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lowlevel/Profiler.h"
+#include "lowlevel/FileTools.h"
+#include "lowlevel/Debug.h"
+#include <SDL.h>
+#include <algorithm>
+#include <sstream>
+
+namespace solarus {
+
+uint64_t Profiler::current_frame[SECTION_NB] = { 0 };
+std::vector<uint32_t> Profiler::frames[SECTION_NB];
+int Profiler::next_frame = 0;
+
+const std::string Profiler::section_names[] = {
+  "frame",
+  "input",
+  "game_update",
+  "entities_update",
+  "lua_update",
+  "music_update",
+  "draw",
+  "map_draw",
+  "map_load",
+  "video_render"
+};
+
+/**
+ * \brief Starts measuring the time spent in a section.
+ * \param section The section to measure.
+ */
+Profiler::ScopedTimer::ScopedTimer(Section section):
+  section(section),
+  start_counter(SDL_GetPerformanceCounter()) {
+
+}
+
+/**
+ * \brief Stops measuring the time and adds it to the current cycle.
+ */
+Profiler::ScopedTimer::~ScopedTimer() {
+
+  Profiler::add_time(section, SDL_GetPerformanceCounter() - start_counter);
+}
+
+/**
+ * \brief Returns whether the profiler was compiled in the engine.
+ * \return \c true if SOLARUS_PROFILING was defined at build time.
+ */
+bool Profiler::is_enabled() {
+
+#ifdef SOLARUS_PROFILING
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * \brief Returns the name of a section.
+ * \param section A section.
+ * \return The name of this section, as used in Lua and in saved files.
+ */
+const std::string& Profiler::get_section_name(Section section) {
+
+  return section_names[section];
+}
+
+/**
+ * \brief Adds some time spent in a section during the current cycle.
+ * \param section A section.
+ * \param counter_ticks The time spent, in performance counter ticks.
+ */
+void Profiler::add_time(Section section, uint64_t counter_ticks) {
+
+  current_frame[section] += counter_ticks;
+}
+
+/**
+ * \brief Stores the time spent in each section during the cycle that has
+ * just finished.
+ *
+ * This function is called by the main loop at the end of each cycle.
+ */
+void Profiler::notify_frame_finished() {
+
+  const uint64_t frequency = SDL_GetPerformanceFrequency();
+
+  for (int i = 0; i < SECTION_NB; ++i) {
+    uint32_t microseconds = uint32_t(current_frame[i] * 1000000 / frequency);
+    if (int(frames[i].size()) < max_frames) {
+      frames[i].push_back(microseconds);
+    }
+    else {
+      frames[i][next_frame] = microseconds;
+    }
+    current_frame[i] = 0;
+  }
+  next_frame = (next_frame + 1) % max_frames;
+}
+
+/**
+ * \brief Returns the number of cycles the statistics are computed on.
+ * \return The number of cycles stored, at most max_frames.
+ */
+int Profiler::get_num_frames() {
+
+  return frames[SECTION_FRAME].size();
+}
+
+/**
+ * \brief Returns the statistics of a section over the last cycles.
+ * \param section A section.
+ * \return The statistics of this section (all zero if no cycle was stored).
+ */
+Profiler::Statistics Profiler::get_statistics(Section section) {
+
+  Statistics statistics;
+  statistics.min = 0.0;
+  statistics.average = 0.0;
+  statistics.max = 0.0;
+  statistics.p99 = 0.0;
+
+  std::vector<uint32_t> sorted_frames = frames[section];
+  if (sorted_frames.empty()) {
+    return statistics;
+  }
+  std::sort(sorted_frames.begin(), sorted_frames.end());
+
+  uint64_t total = 0;
+  for (unsigned int i = 0; i < sorted_frames.size(); ++i) {
+    total += sorted_frames[i];
+  }
+
+  const int num_frames = sorted_frames.size();
+  const int p99_index = std::min(num_frames - 1, num_frames * 99 / 100);
+  statistics.min = sorted_frames.front() / 1000.0;
+  statistics.average = double(total) / num_frames / 1000.0;
+  statistics.max = sorted_frames.back() / 1000.0;
+  statistics.p99 = sorted_frames[p99_index] / 1000.0;
+  return statistics;
+}
+
+/**
+ * \brief Saves the statistics of all sections into a CSV file.
+ * \param file_name Name of the file to write, relative to the quest write
+ * directory.
+ * \return \c true in case of success, \c false if the file could not be
+ * written.
+ */
+bool Profiler::save(const std::string& file_name) {
+
+  Debug::check_assertion(!FileTools::get_quest_write_dir().empty(),
+      "Cannot save profile: no quest write directory was specified in quest.dat");
+
+  std::ostringstream oss;
+  oss << "section,min,average,max,p99\n";
+  for (int i = 0; i < SECTION_NB; ++i) {
+    const Statistics& statistics = get_statistics(Section(i));
+    oss << section_names[i]
+        << "," << statistics.min
+        << "," << statistics.average
+        << "," << statistics.max
+        << "," << statistics.p99 << "\n";
+  }
+
+  const std::string& text = oss.str();
+  return FileTools::data_file_try_save_buffer(file_name, text.c_str(), text.size());
+}
+
+}
+
@@ -16,8 +16,99 @@
  */
 #include "lowlevel/Scale2xFilter.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Applies Scale2x to one pixel.
+ * \param above The row above the pixel.
+ * \param row The row of the pixel.
+ * \param below The row below the pixel.
+ * \param col Column of the pixel.
+ * \param width Width of the rows.
+ * \param dst_row1 First destination row.
+ * \param dst_row2 Second destination row.
+ */
+inline void scale2x_pixel(
+    const uint32_t* above,
+    const uint32_t* row,
+    const uint32_t* below,
+    int col,
+    int width,
+    uint32_t* dst_row1,
+    uint32_t* dst_row2) {
+
+  const uint32_t b = above[col];
+  const uint32_t e = row[col];
+  const uint32_t h = below[col];
+  const uint32_t d = (col == 0) ? e : row[col - 1];
+  const uint32_t f = (col == width - 1) ? e : row[col + 1];
+
+  uint32_t* e1 = &dst_row1[2 * col];
+  uint32_t* e3 = &dst_row2[2 * col];
+  if (b != h && d != f) {
+    e1[0] = (d == b) ? d : e;
+    e1[1] = (b == f) ? f : e;
+    e3[0] = (d == h) ? d : e;
+    e3[1] = (h == f) ? f : e;
+  }
+  else {
+    e1[0] = e1[1] = e3[0] = e3[1] = e;
+  }
+}
+
+#ifdef __SSE2__
+/**
+ * \brief Returns a where the mask is set and b elsewhere.
+ */
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/**
+ * \brief Applies Scale2x to four consecutive pixels that all have
+ * neighbors on both sides.
+ *
+ * Parameters are the same as scale2x_pixel().
+ */
+inline void scale2x_pixels_sse2(
+    const uint32_t* above,
+    const uint32_t* row,
+    const uint32_t* below,
+    int col,
+    uint32_t* dst_row1,
+    uint32_t* dst_row2) {
+
+  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&above[col]));
+  const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&below[col]));
+  const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row[col - 1]));
+  const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row[col]));
+  const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row[col + 1]));
+
+  // Pixels where b == h or d == f are just copied.
+  const __m128i copied = _mm_or_si128(_mm_cmpeq_epi32(b, h), _mm_cmpeq_epi32(d, f));
+
+  const __m128i e1 = select(_mm_andnot_si128(copied, _mm_cmpeq_epi32(d, b)), d, e);
+  const __m128i e2 = select(_mm_andnot_si128(copied, _mm_cmpeq_epi32(b, f)), f, e);
+  const __m128i e3 = select(_mm_andnot_si128(copied, _mm_cmpeq_epi32(d, h)), d, e);
+  const __m128i e4 = select(_mm_andnot_si128(copied, _mm_cmpeq_epi32(h, f)), f, e);
+
+  __m128i* dst1 = reinterpret_cast<__m128i*>(&dst_row1[2 * col]);
+  __m128i* dst2 = reinterpret_cast<__m128i*>(&dst_row2[2 * col]);
+  _mm_storeu_si128(dst1, _mm_unpacklo_epi32(e1, e2));
+  _mm_storeu_si128(dst1 + 1, _mm_unpackhi_epi32(e1, e2));
+  _mm_storeu_si128(dst2, _mm_unpacklo_epi32(e3, e4));
+  _mm_storeu_si128(dst2 + 1, _mm_unpackhi_epi32(e3, e4));
+}
+#endif
+
+}
+
 /**
  * \brief Constructor.
  */
@@ -45,58 +136,34 @@ void Scale2xFilter::filter(
     const uint32_t* src,
     int src_width,
     int src_height,
-    uint32_t* dst) const {
-
-  const int dst_width = src_width * 2;
+    int src_pitch,
+    uint32_t* dst,
+    int dst_pitch) const {
 
-  int e1 = 0;
-  int e2, e3, e4;
-  int b, d, e = 0, f,  h;
   for (int row = 0; row < src_height; row++) {
-    for (int col = 0; col < src_width; col++) {
-
-      // compute a to i
-
-      b = e - src_width;
-      d = e - 1;
-      f = e + 1;
-      h = e + src_width;
-
-      if (row == 0) {
-        b = e;
-      }
-      if (row == src_height - 1) {
-        h = e;
-      }
-      if (col == 0) {
-        d = e;
-      }
-      if (col == src_width - 1) {
-        f = e;
-      }
-
-      // compute e1 to e4
-      e2 = e1 + 1;
-      e3 = e1 + dst_width;
-      e4 = e3 + 1;
-
-      // compute the color
-
-      if (src[b] != src[h] && src[d] != src[f]) {
-        dst[e1] = src[(src[d] == src[b]) ? d : e];
-        dst[e2] = src[(src[b] == src[f]) ? f : e];
-        dst[e3] = src[(src[d] == src[h]) ? d : e];
-        dst[e4] = src[(src[h] == src[f]) ? f : e];
-      }
-      else {
-        dst[e1] = dst[e2] = dst[e3] = dst[e4] = src[e];
-      }
-      e1 += 2;
-      e++;
+
+    const uint32_t* src_row = src + row * src_pitch;
+    const uint32_t* above = (row == 0) ? src_row : src_row - src_pitch;
+    const uint32_t* below = (row == src_height - 1) ? src_row : src_row + src_pitch;
+    uint32_t* dst_row1 = dst + 2 * row * dst_pitch;
+    uint32_t* dst_row2 = dst_row1 + dst_pitch;
+
+    int col = 0;
+#ifdef __SSE2__
+    // Four pixels at a time, except the first and last ones of the row
+    // that have no neighbor on one side.
+    if (src_width > 0) {
+      scale2x_pixel(above, src_row, below, 0, src_width, dst_row1, dst_row2);
+      col = 1;
+    }
+    for (; col + 4 < src_width; col += 4) {
+      scale2x_pixels_sse2(above, src_row, below, col, dst_row1, dst_row2);
+    }
+#endif
+    for (; col < src_width; col++) {
+      scale2x_pixel(above, src_row, below, col, src_width, dst_row1, dst_row2);
     }
-    e1 += dst_width;
   }
-
 }
 
 }
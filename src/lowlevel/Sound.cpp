@@ -22,6 +22,7 @@
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include "lowlevel/WorkerPool.h"
 #include "QuestResourceList.h"
 #include "CommandLine.h"
 
@@ -32,8 +33,10 @@ ALCcontext* Sound::context = NULL;
 bool Sound::initialized = false;
 bool Sound::sounds_preloaded = false;
 float Sound::volume = 1.0;
-std::list<Sound*> Sound::current_sounds;
 std::map<std::string, Sound> Sound::all_sounds;
+std::vector<Sound::Voice> Sound::voices;
+uint32_t Sound::num_plays = 0;
+Sound::VoiceStatistics Sound::statistics = { 0, 0, 0, 0 };
 ov_callbacks Sound::ogg_callbacks = {
     cb_read,
     NULL,
@@ -41,6 +44,41 @@ ov_callbacks Sound::ogg_callbacks = {
     NULL
 };
 
+/**
+ * \brief Decodes a sound in a worker thread and creates its OpenAL buffer
+ * in the main thread.
+ */
+class Sound::DecodingJob: public WorkerPool::Job {
+
+  public:
+
+    DecodingJob(Sound& sound):
+      sound(sound),
+      file_name(sound.get_file_name()),
+      sample_rate(0),
+      success(false) {
+
+    }
+
+    void execute() {
+      success = Sound::decode_samples(file_name, samples, sample_rate);
+    }
+
+    void finish() {
+      if (success) {
+        sound.buffer = Sound::create_buffer(file_name, samples, sample_rate);
+      }
+    }
+
+  private:
+
+    Sound& sound;                  /**< The sound to load. */
+    const std::string file_name;   /**< File of the sound. */
+    std::vector<char> samples;     /**< Decoded PCM samples. */
+    ALsizei sample_rate;           /**< Sample rate of the sound. */
+    bool success;                  /**< Whether the sound was decoded successfully. */
+};
+
 /**
  * \brief Creates a new Ogg Vorbis sound.
  * \param sound_id id of the sound: name of a .ogg file in the sounds subdirectory,
@@ -48,7 +86,10 @@ ov_callbacks Sound::ogg_callbacks = {
  */
 Sound::Sound(const std::string& sound_id):
   id(sound_id),
-  buffer(AL_NONE) {
+  buffer(AL_NONE),
+  priority(0),
+  max_instances(0),
+  num_instances(0) {
 
 }
 
@@ -60,15 +101,12 @@ Sound::~Sound() {
   if (is_initialized() && buffer != AL_NONE) {
 
     // stop the sources where this buffer is attached
-    std::list<ALuint>::iterator it;
-    for (it = sources.begin(); it != sources.end(); it++) {
-      ALuint source = (*it);
-      alSourceStop(source);
-      alSourcei(source, AL_BUFFER, 0);
-      alDeleteSources(1, &source);
+    for (unsigned int i = 0; i < voices.size(); i++) {
+      if (voices[i].sound == this) {
+        release_voice(voices[i]);
+      }
     }
     alDeleteBuffers(1, &buffer);
-    current_sounds.remove(this);
   }
 }
 
@@ -76,15 +114,18 @@ Sound::~Sound() {
  * \brief Initializes the audio (music and sound) system.
  *
  * This method should be called when the application starts.
- * If the argument -no-audio is provided, this function has no effect and
- * there will be no sound.
+ * If the argument -no-audio or -headless is provided, this function has no
+ * effect and there will be no sound.
+ * The number of sound effects that can play at the same time is given by
+ * the -sound-voices=N option (32 by default).
  *
  * \param args Command-line arguments.
  */
 void Sound::initialize(const CommandLine& args) {
 
-  // Check the -no-audio option.
-  const bool disable = args.has_argument("-no-audio");
+  // Check the -no-audio and -headless options.
+  const bool disable = args.has_argument("-no-audio")
+      || args.has_argument("-headless");
   if (disable) {
     return;
   }
@@ -113,6 +154,39 @@ void Sound::initialize(const CommandLine& args) {
 
   alGenBuffers(0, AL_NONE);  // Necessary on some systems to avoid errors with the first sound loaded.
 
+  // Create the sources of sound effects once for all.
+  int num_voices = 32;
+  const std::string& num_voices_string = args.get_argument_value("-sound-voices");
+  if (!num_voices_string.empty()) {
+    std::istringstream iss(num_voices_string);
+    int value = 0;
+    if (!(iss >> value) || value <= 0) {
+      Debug::error(std::string("Invalid number of sound voices: '") + num_voices_string + "'");
+    }
+    else {
+      num_voices = value;
+    }
+  }
+
+  voices.reserve(num_voices);
+  for (int i = 0; i < num_voices; i++) {
+    Voice voice;
+    alGenSources(1, &voice.source);
+    if (alGetError() != AL_NO_ERROR) {
+      // The driver limit is reached: keep a source for the music.
+      Debug::error(StringConcat() << "Cannot create more than " << i
+          << " audio sources for sounds");
+      if (!voices.empty()) {
+        alDeleteSources(1, &voices.back().source);
+        voices.pop_back();
+      }
+      break;
+    }
+    voice.sound = NULL;
+    voice.play_index = 0;
+    voices.push_back(voice);
+  }
+
   initialized = true;
   set_volume(100);
 
@@ -135,6 +209,11 @@ void Sound::quit() {
     // clear the sounds
     all_sounds.clear();
 
+    for (unsigned int i = 0; i < voices.size(); i++) {
+      alDeleteSources(1, &voices[i].source);
+    }
+    voices.clear();
+
     // uninitialize OpenAL
 
     alcMakeContextCurrent(NULL);
@@ -157,6 +236,9 @@ bool Sound::is_initialized() {
 
 /**
  * \brief Loads and decodes all sounds listed in the game database.
+ *
+ * Sounds are decoded in parallel by the worker pool.
+ * Only the OpenAL buffers are created in the main thread.
  */
 void Sound::load_all() {
 
@@ -166,11 +248,15 @@ void Sound::load_all() {
         QuestResourceList::get_elements(QuestResourceList::RESOURCE_SOUND);
     std::vector<QuestResourceList::Element>::const_iterator it;
     for (it = sound_elements.begin(); it != sound_elements.end(); ++it) {
-      const std::string& sound_id = it->first;
-
-      all_sounds[sound_id] = Sound(sound_id);
-      all_sounds[sound_id].load();
+      // Sounds already used keep their settings, their voices and their
+      // buffer. Elements of a std::map don't move, so jobs can keep
+      // references.
+      Sound& sound = get(it->first);
+      if (sound.buffer == AL_NONE) {
+        WorkerPool::add_job(new DecodingJob(sound));
+      }
     }
+    WorkerPool::wait_all();
 
     sounds_preloaded = true;
   }
@@ -194,11 +280,66 @@ bool Sound::exists(const std::string& sound_id) {
  */
 void Sound::play(const std::string& sound_id) {
 
-  if (all_sounds.find(sound_id) == all_sounds.end()) {
-    all_sounds[sound_id] = Sound(sound_id);
+  get(sound_id).start();
+}
+
+/**
+ * \brief Sets the priority of a sound.
+ *
+ * When all voices are busy, a sound can only stop a playing sound whose
+ * priority is lower or equal. Otherwise, it is not played.
+ *
+ * \param sound_id Id of a sound.
+ * \param priority The priority to set (0 by default).
+ */
+void Sound::set_priority(const std::string& sound_id, int priority) {
+
+  get(sound_id).priority = priority;
+}
+
+/**
+ * \brief Sets how many times a sound can play simultaneously.
+ *
+ * When the limit is reached, playing the sound again stops its oldest
+ * instance.
+ *
+ * \param sound_id Id of a sound.
+ * \param max_instances The maximum number of instances, or 0 for no limit.
+ */
+void Sound::set_max_instances(const std::string& sound_id, int max_instances) {
+
+  get(sound_id).max_instances = max_instances;
+}
+
+/**
+ * \brief Returns counters about the voices playing sound effects.
+ * \return The current statistics.
+ */
+Sound::VoiceStatistics Sound::get_voice_statistics() {
+
+  VoiceStatistics result = statistics;
+  result.num_voices = voices.size();
+  result.num_active_voices = 0;
+  for (unsigned int i = 0; i < voices.size(); i++) {
+    if (voices[i].sound != NULL) {
+      ++result.num_active_voices;
+    }
   }
+  return result;
+}
+
+/**
+ * \brief Returns a sound, creating it if necessary.
+ * \param sound_id Id of a sound.
+ * \return The sound.
+ */
+Sound& Sound::get(const std::string& sound_id) {
 
-  all_sounds[sound_id].start();
+  std::map<std::string, Sound>::iterator it = all_sounds.find(sound_id);
+  if (it == all_sounds.end()) {
+    it = all_sounds.insert(std::make_pair(sound_id, Sound(sound_id))).first;
+  }
+  return it->second;
 }
 
 /**
@@ -227,49 +368,111 @@ void Sound::set_volume(int volume) {
  */
 void Sound::update() {
 
-  // update the playing sounds
-  Sound* sound;
-  std::list<Sound*> sounds_to_remove;
-  std::list<Sound*>::iterator it;
-  for (it = current_sounds.begin(); it != current_sounds.end(); it++) {
-    sound = *it;
-    if (!sound->update_playing()) {
-      sounds_to_remove.push_back(sound);
+  // free the voices whose sound is finished
+  for (unsigned int i = 0; i < voices.size(); i++) {
+    Voice& voice = voices[i];
+    if (voice.sound != NULL && is_finished(voice)) {
+      release_voice(voice);
     }
   }
 
-  for (it = sounds_to_remove.begin(); it != sounds_to_remove.end(); it++) {
-    sound = *it;
-    current_sounds.remove(sound);
-  }
-
   // also update the music
   Music::update();
 }
 
 /**
- * \brief Updates this sound when it is playing.
- * \return true if the sound is still playing, false if it is finished.
+ * \brief Returns whether a voice has finished playing its sound.
+ * \param voice A voice currently attached to a sound.
+ * \return true if the sound is finished.
  */
-bool Sound::update_playing() {
+bool Sound::is_finished(const Voice& voice) {
 
-  // See if this sound is still playing.
-  std::list<ALuint>::iterator it = sources.begin();
-  if (it == sources.end()) {
-    return false;
+  ALint status;
+  alGetSourcei(voice.source, AL_SOURCE_STATE, &status);
+  return status != AL_PLAYING;
+}
+
+/**
+ * \brief Stops a voice and makes it available for other sounds.
+ * \param voice A voice currently attached to a sound.
+ */
+void Sound::release_voice(Voice& voice) {
+
+  alSourceStop(voice.source);
+  alSourcei(voice.source, AL_BUFFER, 0);
+  --voice.sound->num_instances;
+  voice.sound = NULL;
+}
+
+/**
+ * \brief Finds a voice to play this sound.
+ *
+ * If this sound already plays its maximum number of instances, its oldest
+ * instance is stopped.
+ * Otherwise, a free voice is used if any, or the oldest voice with the
+ * lowest priority is stopped if this priority does not exceed the one of
+ * this sound.
+ *
+ * \return The voice to use, or NULL if the sound should not be played.
+ */
+Sound::Voice* Sound::get_voice() {
+
+  if (max_instances > 0 && num_instances >= max_instances) {
+    Voice* oldest = NULL;
+    for (unsigned int i = 0; i < voices.size(); i++) {
+      Voice& voice = voices[i];
+      if (voice.sound == this
+          && (oldest == NULL || voice.play_index < oldest->play_index)) {
+        oldest = &voice;
+      }
+    }
+    if (oldest != NULL) {
+      release_voice(*oldest);
+      ++statistics.num_steals;
+      return oldest;
+    }
   }
 
-  ALuint source = *it;
-  ALint status;
-  alGetSourcei(source, AL_SOURCE_STATE, &status);
+  Voice* candidate = NULL;
+  for (unsigned int i = 0; i < voices.size(); i++) {
+    Voice& voice = voices[i];
+    if (voice.sound == NULL) {
+      return &voice;
+    }
+    if (is_finished(voice)) {
+      // Finished since the last update.
+      release_voice(voice);
+      return &voice;
+    }
+    if (candidate == NULL
+        || voice.sound->priority < candidate->sound->priority
+        || (voice.sound->priority == candidate->sound->priority
+            && voice.play_index < candidate->play_index)) {
+      candidate = &voice;
+    }
+  }
 
-  if (status != AL_PLAYING) {
-    sources.pop_front();
-    alSourcei(source, AL_BUFFER, 0);
-    alDeleteSources(1, &source);
+  if (candidate == NULL || candidate->sound->priority > priority) {
+    ++statistics.num_rejected_plays;
+    return NULL;
   }
 
-  return !sources.empty();
+  release_voice(*candidate);
+  ++statistics.num_steals;
+  return candidate;
+}
+
+/**
+ * \brief Returns the name of the file of this sound.
+ * \return The file name, relative to the data directory.
+ */
+std::string Sound::get_file_name() const {
+
+  std::string file_name = std::string("sounds/" + id);
+  if (id.find(".") == std::string::npos) {
+    file_name += ".ogg";
+  }
+  return file_name;
 }
 
 /**
@@ -281,13 +484,8 @@ void Sound::load() {
     Debug::error("Previous audio error not cleaned");
   }
 
-  std::string file_name = std::string("sounds/" + id);
-  if (id.find(".") == std::string::npos) {
-    file_name += ".ogg";
-  }
-
   // Create an OpenAL buffer with the sound decoded by the library.
-  buffer = decode_file(file_name);
+  buffer = decode_file(get_file_name());
 
   // buffer is now AL_NONE if there was an error.
 }
@@ -306,11 +504,15 @@ bool Sound::start() {
       load();
     }
 
+    Voice* voice = NULL;
     if (buffer != AL_NONE) {
+      voice = get_voice();
+    }
+
+    if (voice != NULL) {
 
-      // create a source
-      ALuint source;
-      alGenSources(1, &source);
+      // attach the sound to the source
+      ALuint source = voice->source;
       alSourcei(source, AL_BUFFER, buffer);
       alSourcef(source, AL_GAIN, volume);
 
@@ -319,12 +521,12 @@ bool Sound::start() {
       if (error != AL_NO_ERROR) {
         Debug::error(StringConcat() << "Cannot attach buffer " << buffer
             << " to the source to play sound '" << id << "': error " << error);
-        alDeleteSources(1, &source);
+        alSourcei(source, AL_BUFFER, 0);
       }
       else {
-        sources.push_back(source);
-        current_sounds.remove(this); // to avoid duplicates
-        current_sounds.push_back(this);
+        voice->sound = this;
+        voice->play_index = num_plays++;
+        ++num_instances;
         alSourcePlay(source);
         error = alGetError();
         if (error != AL_NO_ERROR) {
@@ -347,11 +549,32 @@ bool Sound::start() {
  */
 ALuint Sound::decode_file(const std::string& file_name) {
 
-  ALuint buffer = AL_NONE;
+  std::vector<char> samples;
+  ALsizei sample_rate = 0;
+  if (!decode_samples(file_name, samples, sample_rate)) {
+    return AL_NONE;
+  }
+  return create_buffer(file_name, samples, sample_rate);
+}
+
+/**
+ * \brief Loads the specified sound file and decodes its content.
+ *
+ * This function does not use OpenAL and may be called from any thread.
+ *
+ * \param file_name name of the file to open
+ * \param samples receives the decoded samples (16-bit stereo)
+ * \param sample_rate receives the sample rate of the sound
+ * \return true if the sound could be decoded
+ */
+bool Sound::decode_samples(const std::string& file_name,
+    std::vector<char>& samples, ALsizei& sample_rate) {
+
+  bool success = false;
 
   if (!FileTools::data_file_exists(file_name)) {
     Debug::error(StringConcat() << "Cannot find sound file '" << file_name << "'");
-    return AL_NONE;
+    return false;
   }
 
   // load the sound file
@@ -371,7 +594,7 @@ ALuint Sound::decode_file(const std::string& file_name) {
 
     // read the encoded sound properties
     vorbis_info* info = ov_info(&file, -1);
-    ALsizei sample_rate = ALsizei(info->rate);
+    sample_rate = ALsizei(info->rate);
 
     ALenum format = AL_NONE;
     if (info->channels == 1) {
@@ -387,10 +610,8 @@ ALuint Sound::decode_file(const std::string& file_name) {
     }
     else {
       // decode the sound with vorbisfile
-      std::vector<char> samples;
       int bitstream;
       long bytes_read;
-      long total_bytes_read = 0;
       const int buffer_size = 4096;
       char samples_buffer[buffer_size];
       do {
@@ -400,7 +621,6 @@ ALuint Sound::decode_file(const std::string& file_name) {
               << file_name << "': " << bytes_read);
         }
         else {
-          total_bytes_read += bytes_read;
           if (format == AL_FORMAT_STEREO16) {
             samples.insert(samples.end(), samples_buffer, samples_buffer + bytes_read);
           }
@@ -412,35 +632,51 @@ ALuint Sound::decode_file(const std::string& file_name) {
               samples.insert(samples.end(), samples_buffer + i, samples_buffer + i + 2);
               samples.insert(samples.end(), samples_buffer + i, samples_buffer + i + 2);
             }
-            total_bytes_read += bytes_read;
           }
         }
       }
       while (bytes_read > 0);
-
-      // copy the samples into an OpenAL buffer
-      alGenBuffers(1, &buffer);
-      if (alGetError() != AL_NO_ERROR) {
-          Debug::error("Failed to generate audio buffer");
-      }
-      alBufferData(buffer,
-          AL_FORMAT_STEREO16,
-          reinterpret_cast<ALshort*>(&samples[0]),
-          ALsizei(total_bytes_read),
-          sample_rate);
-      ALenum error = alGetError();
-      if (error != AL_NO_ERROR) {
-        Debug::error(StringConcat() << "Cannot copy the sound samples of '"
-            << file_name << "' into buffer " << buffer
-            << ": error " << error);
-        buffer = AL_NONE;
-      }
+      success = true;
     }
     ov_clear(&file);
   }
 
   FileTools::data_file_close_buffer(mem.data);
 
+  return success;
+}
+
+/**
+ * \brief Copies decoded samples into a new OpenAL buffer.
+ *
+ * This function must be called from the main thread.
+ *
+ * \param file_name name of the sound file (for error messages)
+ * \param samples the decoded samples (16-bit stereo)
+ * \param sample_rate the sample rate of the sound
+ * \return the buffer created, or AL_NONE in case of error
+ */
+ALuint Sound::create_buffer(const std::string& file_name,
+    const std::vector<char>& samples, ALsizei sample_rate) {
+
+  ALuint buffer = AL_NONE;
+  alGenBuffers(1, &buffer);
+  if (alGetError() != AL_NO_ERROR) {
+      Debug::error("Failed to generate audio buffer");
+  }
+  alBufferData(buffer,
+      AL_FORMAT_STEREO16,
+      samples.empty() ? NULL : reinterpret_cast<const ALshort*>(&samples[0]),
+      ALsizei(samples.size()),
+      sample_rate);
+  ALenum error = alGetError();
+  if (error != AL_NO_ERROR) {
+    Debug::error(StringConcat() << "Cannot copy the sound samples of '"
+        << file_name << "' into buffer " << buffer
+        << ": error " << error);
+    buffer = AL_NONE;
+  }
+
   return buffer;
 }
 
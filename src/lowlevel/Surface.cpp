@@ -23,63 +23,424 @@
 #include "lowlevel/Video.h"
 #include "lowlevel/PixelFilter.h"
 #include "lua/LuaContext.h"
+#include "Language.h"
 #include "Transition.h"
 #include <SDL.h>
 #include <SDL_image.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
 
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Computes the intersection of two rectangles.
+ * \param a A rectangle.
+ * \param b Another rectangle.
+ * \param result Receives the intersection.
+ * \return false if the intersection is empty.
+ */
+bool intersect(const Rectangle& a, const Rectangle& b, Rectangle& result) {
+
+  const int x1 = std::max(a.get_x(), b.get_x());
+  const int y1 = std::max(a.get_y(), b.get_y());
+  const int x2 = std::min(a.get_x() + a.get_width(), b.get_x() + b.get_width());
+  const int y2 = std::min(a.get_y() + a.get_height(), b.get_y() + b.get_height());
+  if (x2 <= x1 || y2 <= y1) {
+    return false;
+  }
+  result = Rectangle(x1, y1, x2 - x1, y2 - y1);
+  return true;
+}
+
 /**
- * \brief Stores the tree of what surfaces have to be drawn on other surfaces.
+ * \brief Returns whether two rectangles have pixels in common.
+ * \param a A rectangle.
+ * \param b Another rectangle.
+ * \return true if they overlap.
+ */
+bool overlaps(const Rectangle& a, const Rectangle& b) {
+
+  return a.get_x() < b.get_x() + b.get_width()
+      && b.get_x() < a.get_x() + a.get_width()
+      && a.get_y() < b.get_y() + b.get_height()
+      && b.get_y() < a.get_y() + a.get_height();
+}
+
+/**
+ * \brief Blits a software surface multiplied by a color.
  *
- * When a drawing is requested, if the destination surface is in GPU, no
- * drawing actually occurs: instead, the information is stored into this tree.
- * At rendering time, the tree is traverses to perform all drawings
- * accelerated in GPU.
+ * The color and alpha modulation of the source surface are only changed
+ * during this blit.
  *
- * The root node of the tree is the screen, and the children nodes are the
- * surfaces drawn on it.
+ * \param src_surface The source surface.
+ * \param src_rect The subrectangle to draw in the source surface.
+ * \param dst_surface The destination surface.
+ * \param dst_rect Coordinates on the destination surface.
+ * \param modulation Red, green, blue and alpha factors (0 to 255).
+ */
+void blit_modulated(
+    SDL_Surface* src_surface,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dst_surface,
+    SDL_Rect* dst_rect,
+    const uint8_t modulation[4]) {
+
+  const bool modulate_color = modulation[0] < 255
+      || modulation[1] < 255
+      || modulation[2] < 255;
+  const bool modulate_alpha = modulation[3] < 255;
+
+  Uint8 r = 255, g = 255, b = 255, a = 255;
+  if (modulate_color) {
+    SDL_GetSurfaceColorMod(src_surface, &r, &g, &b);
+    SDL_SetSurfaceColorMod(src_surface,
+        r * modulation[0] / 255,
+        g * modulation[1] / 255,
+        b * modulation[2] / 255);
+  }
+  if (modulate_alpha) {
+    SDL_GetSurfaceAlphaMod(src_surface, &a);
+    SDL_SetSurfaceAlphaMod(src_surface, a * modulation[3] / 255);
+  }
+
+  SDL_BlitSurface(src_surface, src_rect, dst_surface, dst_rect);
+
+  if (modulate_color) {
+    SDL_SetSurfaceColorMod(src_surface, r, g, b);
+  }
+  if (modulate_alpha) {
+    SDL_SetSurfaceAlphaMod(src_surface, a);
+  }
+}
+
+/**
+ * \brief Number of previous batches examined when looking for a batch that
+ * a render item can join.
+ */
+const int max_batch_lookback = 16;
+
+/**
+ * \brief Maximum number of damaged regions tracked before updating the
+ * whole texture.
+ */
+const unsigned max_damaged_regions = 32;
+
+/**
+ * \brief Size of the blocks of pixels compared to detect changes before
+ * applying a pixel filter.
+ */
+const int pixel_filter_block_size = 16;
+
+}
+
+/**
+ * \brief A texture where several small images loaded from files are packed.
  *
- * Each node represents a source surface drawn somewhere, and the list of
- * surfaces drawn on itself.
+ * Images are stored in rows.
+ * The page is destroyed when no image uses it anymore.
  */
-class Surface::SubSurfaceNode: public RefCountable {
+class Surface::AtlasPage {
 
   public:
 
-    SubSurfaceNode(
-        Surface* src_surface,
-        const Rectangle& src_rect,
-        const Rectangle& dst_rect,
-        const std::vector<SubSurfaceNode*> subsurfaces
-    ):
-      src_surface(src_surface),
-      src_rect(src_rect),
-      dst_rect(dst_rect),
-      subsurfaces(subsurfaces) {
-
-      RefCountable::ref(src_surface);
-      for (unsigned i = 0; i < subsurfaces.size(); ++i) {
-        RefCountable::ref(subsurfaces[i]);
-      }
+    AtlasPage(SDL_Texture* texture, int size):
+      texture(texture),
+      size(size),
+      num_images(0),
+      pen_x(0),
+      pen_y(0),
+      row_height(0) {
+
     }
 
-    ~SubSurfaceNode() {
+    ~AtlasPage() {
 
-      RefCountable::unref(src_surface);
+      SDL_DestroyTexture(texture);
+    }
 
-      for (unsigned i = 0; i < subsurfaces.size(); ++i) {
-        RefCountable::unref(subsurfaces[i]);
+    /**
+     * \brief Reserves some room in this page.
+     * \param width Width of the image to store.
+     * \param height Height of the image to store.
+     * \param x Receives the x coordinate of the room found.
+     * \param y Receives the y coordinate of the room found.
+     * \return false if the page is full.
+     */
+    bool find_room(int width, int height, int& x, int& y) {
+
+      if (pen_x + width > size) {
+        // Start a new row.
+        pen_x = 0;
+        pen_y += row_height;
+        row_height = 0;
+      }
+      if (pen_y + height > size) {
+        return false;
       }
+
+      x = pen_x;
+      y = pen_y;
+      pen_x += width;
+      row_height = std::max(row_height, height);
+      return true;
+    }
+
+    SDL_Texture* texture;                        /**< The GPU texture of the page. */
+    int size;                                    /**< Width and height of the texture. */
+    int num_images;                              /**< Number of images stored in the page. */
+    int pen_x;                                   /**< Where the next image goes. */
+    int pen_y;                                   /**< Top of the current row. */
+    int row_height;                              /**< Height of the current row. */
+};
+
+/**
+ * \brief An image loaded from a file, shared by all surfaces created from
+ * this file.
+ *
+ * The pixels are never modified while they are shared: a surface that
+ * needs to draw onto them first makes its own copy.
+ * The texture is created lazily by the first surface rendered.
+ * Small images are packed with other ones into an atlas page so that
+ * drawing them does not require to switch textures.
+ *
+ * Accesses to the reference count and to the texture are protected by
+ * image_cache_mutex because images may be loaded by other threads.
+ */
+class Surface::SharedImage {
+
+  public:
+
+    explicit SharedImage(SDL_Surface* internal_surface):
+      internal_surface(internal_surface),
+      internal_texture(NULL),
+      atlas_page(NULL),
+      atlas_x(0),
+      atlas_y(0),
+      refcount(0) {
+
     }
 
-    Surface* src_surface;                        /**< Surface to draw. */
+    ~SharedImage() {
+
+      if (atlas_page != NULL) {
+        // The texture belongs to the atlas page.
+        --atlas_page->num_images;
+      }
+      else if (internal_texture != NULL) {
+        SDL_DestroyTexture(internal_texture);
+      }
+      SDL_FreeSurface(internal_surface);
+    }
 
-    Rectangle src_rect;                          /**< Region of the Subsurface to draw. */
-    Rectangle dst_rect;                          /**< The rectangle where to draw the Subsurface, relative to the parent Surface. */
-    std::vector<SubSurfaceNode*> subsurfaces;    /**< Subsurfaces drawn onto src_surface. */
+    SDL_Surface* internal_surface;               /**< The pixels of the image. */
+    SDL_Texture* internal_texture;               /**< The GPU texture of the image, if created. */
+    AtlasPage* atlas_page;                       /**< The atlas page containing the texture, if any. */
+    int atlas_x;                                 /**< X position of the image in its atlas page. */
+    int atlas_y;                                 /**< Y position of the image in its atlas page. */
+    int refcount;                                /**< Number of surfaces using this image. */
 };
 
+std::map<std::string, Surface::SharedImage*> Surface::image_cache;
+SDL_mutex* Surface::image_cache_mutex = NULL;
+int Surface::image_cache_hits = 0;
+int Surface::image_cache_misses = 0;
+std::vector<Surface::AtlasPage*> Surface::atlas_pages;
+uint32_t Surface::current_frame = 1;
+int Surface::num_draw_commands = 0;
+int Surface::num_draw_calls = 0;
+int Surface::num_texture_switches = 0;
+Surface::DrawStatistics Surface::last_frame_draw_statistics = { 0, 0, 0, 0 };
+std::vector<Surface::RenderItem> Surface::render_items;
+std::vector<int> Surface::render_item_batches;
+std::vector<int> Surface::render_order;
+std::vector<Surface::RenderBatch> Surface::render_batches;
+
+/**
+ * \brief Initializes the surface system.
+ */
+void Surface::initialize() {
+
+  image_cache_mutex = SDL_CreateMutex();
+  image_cache_hits = 0;
+  image_cache_misses = 0;
+}
+
+/**
+ * \brief Uninitializes the surface system.
+ *
+ * Must be called before the renderer is destroyed.
+ */
+void Surface::quit() {
+
+  purge_image_cache();
+  for (unsigned i = 0; i < atlas_pages.size(); ++i) {
+    delete atlas_pages[i];
+  }
+  atlas_pages.clear();
+  SDL_DestroyMutex(image_cache_mutex);
+  image_cache_mutex = NULL;
+}
+
+/**
+ * \brief Returns statistics about the images loaded from files.
+ * \return The statistics of the image cache.
+ */
+Surface::ImageCacheStatistics Surface::get_image_cache_statistics() {
+
+  ImageCacheStatistics statistics;
+  statistics.num_images = 0;
+  statistics.num_unused_images = 0;
+  statistics.num_bytes = 0;
+
+  SDL_LockMutex(image_cache_mutex);
+  std::map<std::string, SharedImage*>::const_iterator it;
+  for (it = image_cache.begin(); it != image_cache.end(); ++it) {
+    const SharedImage& image = *it->second;
+    ++statistics.num_images;
+    if (image.refcount == 0) {
+      ++statistics.num_unused_images;
+    }
+    statistics.num_bytes += image.internal_surface->pitch * image.internal_surface->h;
+  }
+  statistics.num_hits = image_cache_hits;
+  statistics.num_misses = image_cache_misses;
+  SDL_UnlockMutex(image_cache_mutex);
+
+  return statistics;
+}
+
+/**
+ * \brief Frees the images loaded from files that no surface uses anymore.
+ *
+ * Unused images are kept until this function is called, so that creating
+ * again a surface from the same file is fast.
+ * This is typically called after a map change.
+ */
+void Surface::purge_image_cache() {
+
+  SDL_LockMutex(image_cache_mutex);
+  std::map<std::string, SharedImage*>::iterator it = image_cache.begin();
+  while (it != image_cache.end()) {
+    if (it->second->refcount == 0) {
+      delete it->second;
+      image_cache.erase(it++);
+    }
+    else {
+      ++it;
+    }
+  }
+  purge_atlas_pages();
+  SDL_UnlockMutex(image_cache_mutex);
+}
+
+/**
+ * \brief Destroys the atlas pages that no image uses anymore.
+ *
+ * image_cache_mutex must be locked.
+ */
+void Surface::purge_atlas_pages() {
+
+  std::vector<AtlasPage*>::iterator it = atlas_pages.begin();
+  while (it != atlas_pages.end()) {
+    if ((*it)->num_images == 0) {
+      delete *it;
+      it = atlas_pages.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+/**
+ * \brief Tries to store the texture of a shared image in an atlas page.
+ *
+ * Images too big for atlas pages are not packed.
+ * image_cache_mutex must be locked.
+ *
+ * \param image The image to pack. If it gets packed, its texture becomes
+ * the texture of the atlas page.
+ */
+void Surface::pack_in_atlas(SharedImage& image) {
+
+  const int page_size = SOLARUS_TEXTURE_ATLAS_SIZE;
+  const int width = image.internal_surface->w;
+  const int height = image.internal_surface->h;
+  if (page_size <= 0 || width > page_size / 2 || height > page_size / 2) {
+    return;
+  }
+
+  int x = 0;
+  int y = 0;
+  AtlasPage* page = atlas_pages.empty() ? NULL : atlas_pages.back();
+  if (page == NULL || !page->find_room(width, height, x, y)) {
+    // Start a new page.
+    SDL_Renderer* main_renderer = Video::get_renderer();
+    SDL_RendererInfo renderer_info;
+    if (SDL_GetRendererInfo(main_renderer, &renderer_info) != 0
+        || (renderer_info.max_texture_width != 0
+            && renderer_info.max_texture_width < page_size)
+        || (renderer_info.max_texture_height != 0
+            && renderer_info.max_texture_height < page_size)) {
+      return;
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(
+        main_renderer,
+        Video::get_pixel_format()->format,
+        SDL_TEXTUREACCESS_STATIC,
+        page_size,
+        page_size
+    );
+    if (texture == NULL) {
+      return;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    page = new AtlasPage(texture, page_size);
+    atlas_pages.push_back(page);
+    page->find_room(width, height, x, y);
+  }
+
+  SDL_Rect dst_rect = { x, y, width, height };
+  SDL_UpdateTexture(page->texture, &dst_rect,
+      image.internal_surface->pixels, image.internal_surface->pitch);
+  ++page->num_images;
+  image.atlas_page = page;
+  image.atlas_x = x;
+  image.atlas_y = y;
+  image.internal_texture = page->texture;
+}
+
+/**
+ * \brief Returns statistics about the drawing commands recorded for the GPU.
+ * \return The statistics of the previous frame.
+ */
+Surface::DrawStatistics Surface::get_draw_statistics() {
+
+  return last_frame_draw_statistics;
+}
+
+/**
+ * \brief Notifies the surface system that a frame was rendered.
+ *
+ * Surfaces drawn during this frame will start a new list of draw commands
+ * if something is drawn on them again.
+ */
+void Surface::finish_frame() {
+
+  last_frame_draw_statistics.num_commands = num_draw_commands;
+  last_frame_draw_statistics.num_bytes = num_draw_commands * sizeof(DrawCommand);
+  last_frame_draw_statistics.num_draw_calls = num_draw_calls;
+  last_frame_draw_statistics.num_texture_switches = num_texture_switches;
+  num_draw_commands = 0;
+  num_draw_calls = 0;
+  num_texture_switches = 0;
+  ++current_frame;
+}
+
 /**
  * \brief Creates a surface with the specified size.
  * \param width The width in pixels.
@@ -90,11 +451,16 @@ Surface::Surface(int width, int height):
   software_destination(false),
   internal_surface(NULL),
   internal_texture(NULL),
-  internal_color(NULL),
   is_rendered(false),
   internal_opacity(255),
   width(width),
-  height(height) {
+  height(height),
+  shared_image(NULL),
+  draw_commands_generation(0),
+  draw_commands_drawn_frame(0),
+  retained_by(NULL),
+  retained_generation(0),
+  pixel_filter(NULL) {
 
   Debug::check_assertion(width > 0 && height > 0,
       "Attempt to create a surface with an empty size");
@@ -114,9 +480,14 @@ Surface::Surface(SDL_Surface* internal_surface):
   software_destination(false),
   internal_surface(internal_surface),
   internal_texture(NULL),
-  internal_color(NULL),
   is_rendered(false),
-  internal_opacity(255) {
+  internal_opacity(255),
+  shared_image(NULL),
+  draw_commands_generation(0),
+  draw_commands_drawn_frame(0),
+  retained_by(NULL),
+  retained_generation(0),
+  pixel_filter(NULL) {
 
   width = internal_surface->w;
   height = internal_surface->h;
@@ -127,16 +498,19 @@ Surface::Surface(SDL_Surface* internal_surface):
  */
 Surface::~Surface() {
 
-  if (internal_texture != NULL) {
-    SDL_DestroyTexture(internal_texture);
+  if (shared_image != NULL) {
+    release_shared_image();
   }
-  if (internal_surface != NULL) {
-    SDL_FreeSurface(internal_surface);
+  else {
+    if (internal_texture != NULL) {
+      SDL_DestroyTexture(internal_texture);
+    }
+    if (internal_surface != NULL) {
+      SDL_FreeSurface(internal_surface);
+    }
   }
 
-  delete internal_color;
-
-  clear_subsurfaces();
+  clear_draw_commands();
 }
 
 /**
@@ -163,6 +537,10 @@ Surface* Surface::create(const Rectangle& size) {
  * This function acts like a constructor excepts that it returns NULL if the
  * file does not exist or is not a valid image.
  *
+ * Images are cached: surfaces created from the same file share their
+ * pixels and their texture until one of them is modified.
+ * This function may be called from any thread.
+ *
  * \param file_name Name of the image file to load, relative to the base directory specified.
  * \param base_directory The base directory to use.
  * \return The surface created, or NULL if the file could not be loaded.
@@ -170,13 +548,64 @@ Surface* Surface::create(const Rectangle& size) {
 Surface* Surface::create(const std::string& file_name,
     ImageDirectory base_directory) {
 
-  SDL_Surface* sdl_surface = get_surface_from_file(file_name, base_directory);
+  std::ostringstream oss;
+  oss << base_directory << ':' << file_name;
+  if (base_directory == DIR_LANGUAGE) {
+    oss << ':' << Language::get_language();
+  }
+  const std::string& key = oss.str();
+
+  SDL_LockMutex(image_cache_mutex);
+  SharedImage* image = NULL;
+  std::map<std::string, SharedImage*>::const_iterator it = image_cache.find(key);
+  if (it != image_cache.end()) {
+    image = it->second;
+    ++image->refcount;
+    ++image_cache_hits;
+  }
+  SDL_UnlockMutex(image_cache_mutex);
 
-  if (sdl_surface == NULL) {
-    return NULL;
+  if (image == NULL) {
+    // Decode the file without blocking other threads.
+    SDL_Surface* sdl_surface = get_surface_from_file(file_name, base_directory);
+
+    if (sdl_surface == NULL) {
+      return NULL;
+    }
+
+    // Convert it now to the format of textures so that it stays shared.
+    SDL_PixelFormat* pixel_format = Video::get_pixel_format();
+    if (pixel_format != NULL && sdl_surface->format->format != pixel_format->format) {
+      SDL_Surface* converted_surface = SDL_ConvertSurface(sdl_surface, pixel_format, 0);
+      Debug::check_assertion(converted_surface != NULL,
+          "Failed to convert software surface");
+      SDL_FreeSurface(sdl_surface);
+      sdl_surface = converted_surface;
+    }
+
+    SDL_LockMutex(image_cache_mutex);
+    it = image_cache.find(key);
+    if (it != image_cache.end()) {
+      // Another thread has just loaded the same image.
+      image = it->second;
+      SDL_FreeSurface(sdl_surface);
+      ++image_cache_hits;
+    }
+    else {
+      image = new SharedImage(sdl_surface);
+      image_cache[key] = image;
+      ++image_cache_misses;
+    }
+    ++image->refcount;
+    SDL_UnlockMutex(image_cache_mutex);
   }
 
-  Surface* surface = new Surface(sdl_surface);
+  Surface* surface = new Surface(image->internal_surface);
+  surface->shared_image = image;
+  SDL_LockMutex(image_cache_mutex);
+  surface->internal_texture = image->internal_texture;
+  SDL_UnlockMutex(image_cache_mutex);
+
   surface->set_software_destination(true);
   return surface;
 }
@@ -227,6 +656,45 @@ SDL_Surface* Surface::get_surface_from_file(
   return software_surface;
 }
 
+/**
+ * \brief Gives this surface its own copy of its shared image if any.
+ *
+ * This must be called before modifying the pixels of the internal surface.
+ */
+void Surface::make_image_private() {
+
+  if (shared_image == NULL) {
+    return;
+  }
+
+  SDL_Surface* copy = SDL_ConvertSurface(
+      internal_surface,
+      internal_surface->format,
+      0
+  );
+  Debug::check_assertion(copy != NULL, "Failed to copy software surface");
+
+  release_shared_image();
+  internal_surface = copy;
+  set_modified();
+}
+
+/**
+ * \brief Stops using the shared image of this surface.
+ *
+ * The image stays in the cache until the cache is purged.
+ */
+void Surface::release_shared_image() {
+
+  SDL_LockMutex(image_cache_mutex);
+  --shared_image->refcount;
+  SDL_UnlockMutex(image_cache_mutex);
+
+  shared_image = NULL;
+  internal_surface = NULL;
+  internal_texture = NULL;
+}
+
 /**
  * \brief Converts the software surface to the preferred pixel format
  * (32-bit with alpha channel).
@@ -247,7 +715,12 @@ void Surface::convert_software_surface() {
     Debug::check_assertion(converted_surface != NULL,
         "Failed to convert software surface");
 
-    SDL_FreeSurface(internal_surface);
+    if (shared_image != NULL) {
+      release_shared_image();
+    }
+    else {
+      SDL_FreeSurface(internal_surface);
+    }
     internal_surface = converted_surface;
   }
 }
@@ -270,6 +743,29 @@ void Surface::create_texture_from_surface() {
     // for performance reasons.
     convert_software_surface();
 
+    if (shared_image != NULL) {
+      // Create the texture only once for all surfaces sharing this image.
+      SDL_LockMutex(image_cache_mutex);
+      if (shared_image->internal_texture == NULL) {
+        pack_in_atlas(*shared_image);
+      }
+      if (shared_image->internal_texture == NULL) {
+        shared_image->internal_texture = SDL_CreateTexture(
+            main_renderer,
+            Video::get_pixel_format()->format,
+            SDL_TEXTUREACCESS_STATIC,
+            internal_surface->w,
+            internal_surface->h
+        );
+        SDL_SetTextureBlendMode(shared_image->internal_texture, SDL_BLENDMODE_BLEND);
+        SDL_UpdateTexture(shared_image->internal_texture, NULL,
+            internal_surface->pixels, internal_surface->pitch);
+      }
+      internal_texture = shared_image->internal_texture;
+      SDL_UnlockMutex(image_cache_mutex);
+      return;
+    }
+
     // Create the texture.
     internal_texture = SDL_CreateTexture(
         main_renderer,
@@ -319,6 +815,7 @@ void Surface::set_opacity(int opacity) {
   if (software_destination  // The destination surface is in RAM.
       || !Video::is_acceleration_enabled()  // The rendering is in RAM.
   ) {
+    make_image_private();
     if (internal_surface == NULL) {
       create_software_surface();
     }
@@ -330,7 +827,7 @@ void Surface::set_opacity(int opacity) {
     if (error != 0) {
       Debug::error(SDL_GetError());
     }
-    is_rendered = false;  // The surface has changed.
+    set_modified();
   }
   else {
     internal_opacity = opacity;
@@ -388,7 +885,7 @@ void Surface::create_software_surface() {
       format->Amask
   );
   SDL_SetSurfaceBlendMode(internal_surface, SDL_BLENDMODE_BLEND);
-  is_rendered = false;
+  set_modified();
 
   Debug::check_assertion(internal_surface != NULL,
       "Failed to create software surface");
@@ -415,6 +912,7 @@ void Surface::fill_with_color(Color& color, const Rectangle& where) {
   ) {
 
     // We have to draw on a software surface: draw pixels directly.
+    make_image_private();
     if (internal_surface == NULL) {
       create_software_surface();
     }
@@ -432,54 +930,210 @@ void Surface::fill_with_color(Color& color, const Rectangle& where) {
         Rectangle(where).get_internal_rect(),
         color_value
     );
-    is_rendered = false;  // The surface has changed.
+    add_damaged_region(where);
   }
   else {
-    // Create a Surface with the requested size and color, and add it to the subsurface queue.
-    Rectangle subsurface_size(0, 0, where.get_width(), where.get_height());
-    Surface* subsurface = Surface::create(subsurface_size);
-    RefCountable::ref(subsurface);
-    subsurface->internal_color = new Color(color);
-    subsurface->raw_draw_region(subsurface_size, *this, where);
+    // Record the filling for rendering time.
+    int r, g, b, a;
+    color.get_components(r, g, b, a);
+    if (a == 0) {
+      // Nothing would change.
+      return;
+    }
+
+    prepare_draw_commands();
+    if (a == 255 && where.contains(get_size())) {
+      // Everything drawn before is hidden.
+      clear_draw_commands();
+    }
+
+    DrawCommand command;
+    command.src_surface = NULL;
+    command.dst_position = where;
+    command.clip = where;
+    command.opacity = 255;
+    command.color[0] = r;
+    command.color[1] = g;
+    command.color[2] = b;
+    command.color[3] = a;
+    add_draw_command(command);
   }
 }
 
 /**
- * \brief Add a SubSurface to draw on this surface.
- * \param src_surface The Surface to draw.
+ * \brief Records the drawing of a surface onto this GPU surface.
+ *
+ * The source surface's own texture is recorded, followed by a copy of its
+ * own draw commands, moved to their new position.
+ *
+ * \param src_surface The surface to draw.
  * \param region The subrectangle to draw in the source surface.
  * \param dst_position Coordinates on this surface.
+ * \param modulation Color and opacity of this drawing only (0 to 255),
+ * combined with the ones of the source surface and of its commands.
  */
-void Surface::add_subsurface(
+void Surface::add_draw_commands(
     Surface& src_surface,
     const Rectangle& region,
-    const Rectangle& dst_position) {
+    const Rectangle& dst_position,
+    const uint8_t modulation[4]) {
+
+  prepare_draw_commands();
+
+  const Rectangle clip(dst_position.get_x(), dst_position.get_y(),
+      region.get_width(), region.get_height());
+  const int dx = dst_position.get_x() - region.get_x();
+  const int dy = dst_position.get_y() - region.get_y();
+  // Opacities are multiplied, like the alpha modulation of software blits.
+  const int opacity = modulation[3] * src_surface.internal_opacity / 255;
+
+  if (src_surface.internal_surface != NULL
+      || src_surface.internal_texture != NULL) {
+    DrawCommand command;
+    command.src_surface = &src_surface;
+    command.src_position = region;
+    command.dst_position = clip;
+    command.clip = clip;
+    command.opacity = opacity;
+    command.color[0] = modulation[0];
+    command.color[1] = modulation[1];
+    command.color[2] = modulation[2];
+    command.color[3] = 255;
+    add_draw_command(command);
+  }
 
-  SubSurfaceNode* node = new SubSurfaceNode(
-      &src_surface,
-      region,
-      dst_position,
-      src_surface.subsurfaces
-  );
-  RefCountable::ref(node);
+  if (!src_surface.draw_commands.empty()) {
+    const std::vector<DrawCommand>* src_commands = &src_surface.draw_commands;
+    std::vector<DrawCommand> own_commands;
+    if (&src_surface == this) {
+      // The surface is drawn on itself: adding commands would invalidate
+      // the ones we are iterating on.
+      own_commands = draw_commands;
+      src_commands = &own_commands;
+    }
+    std::vector<DrawCommand>::const_iterator it;
+    const std::vector<DrawCommand>::const_iterator end = src_commands->end();
+    for (it = src_commands->begin(); it != end; ++it) {
+      DrawCommand command = *it;
+      command.dst_position.add_xy(dx, dy);
+      command.clip.add_xy(dx, dy);
+      if (!intersect(command.clip, clip, command.clip)) {
+        // Outside the region.
+        continue;
+      }
+      command.opacity = command.opacity * opacity / 255;
+      command.color[0] = command.color[0] * modulation[0] / 255;
+      command.color[1] = command.color[1] * modulation[1] / 255;
+      command.color[2] = command.color[2] * modulation[2] / 255;
+      add_draw_command(command);
+    }
+  }
+
+  src_surface.draw_commands_drawn_frame = current_frame;
+}
+
+/**
+ * \brief Adds a command to the drawing commands of this surface.
+ *
+ * The source surface of the command is kept alive until the commands
+ * are cleared.
+ *
+ * \param command The command to add.
+ */
+void Surface::add_draw_command(const DrawCommand& command) {
+
+  Surface* src_surface = command.src_surface;
+  if (src_surface != NULL
+      && src_surface != this
+      && (src_surface->retained_by != this
+          || src_surface->retained_generation != draw_commands_generation)) {
+    // Only retain each source once in a row.
+    RefCountable::ref(src_surface);
+    retained_surfaces.push_back(src_surface);
+    src_surface->retained_by = this;
+    src_surface->retained_generation = draw_commands_generation;
+  }
+
+  draw_commands.push_back(command);
+  ++num_draw_commands;
+}
+
+/**
+ * \brief Clears the draw commands of this surface if they were already
+ * drawn or rendered during a previous frame.
+ *
+ * This must be called before recording new commands.
+ */
+void Surface::prepare_draw_commands() {
 
-  // Clear the subsurface queue if the current dst_surface has already been rendered.
-  if (is_rendered) {
-    clear_subsurfaces();
+  if (draw_commands_drawn_frame != 0
+      && draw_commands_drawn_frame != current_frame) {
+    clear_draw_commands();
   }
+}
+
+/**
+ * \brief Clears the draw commands of this surface.
+ *
+ * The memory of the command list is kept for the next ones.
+ */
+void Surface::clear_draw_commands() {
 
-  subsurfaces.push_back(node);
+  draw_commands.clear();
+  draw_commands_drawn_frame = 0;
+  ++draw_commands_generation;
+
+  std::vector<Surface*> surfaces;
+  surfaces.swap(retained_surfaces);
+  for (unsigned i = 0; i < surfaces.size(); ++i) {
+    RefCountable::unref(surfaces[i]);
+  }
+  surfaces.clear();
+  surfaces.swap(retained_surfaces);  // Keep the memory.
 }
 
 /**
- * \brief clear the internal SubSurface queue.
+ * \brief Executes in RAM the draw commands of this surface.
+ *
+ * This is necessary if the video mode switched from an accelerated one
+ * to a software one.
  */
-void Surface::clear_subsurfaces() {
+void Surface::execute_draw_commands_in_software() {
 
-  for (unsigned i = 0; i < subsurfaces.size() ; ++i) {
-    RefCountable::unref(subsurfaces[i]);
+  make_image_private();
+  if (internal_surface == NULL) {
+    create_software_surface();
   }
-  subsurfaces.clear();
+
+  std::vector<DrawCommand>::const_iterator it;
+  const std::vector<DrawCommand>::const_iterator end = draw_commands.end();
+  for (it = draw_commands.begin(); it != end; ++it) {
+    const DrawCommand& command = *it;
+
+    SDL_SetClipRect(internal_surface, command.clip.get_internal_rect());
+    Rectangle dst_position(command.dst_position);
+    if (command.src_surface == NULL) {
+      uint32_t color_value = SDL_MapRGBA(internal_surface->format,
+          command.color[0], command.color[1], command.color[2], command.color[3]);
+      SDL_FillRect(internal_surface, dst_position.get_internal_rect(), color_value);
+    }
+    else if (command.src_surface->internal_surface != NULL) {
+      const uint8_t modulation[4] = {
+          command.color[0], command.color[1], command.color[2], command.opacity
+      };
+      blit_modulated(
+          command.src_surface->internal_surface,
+          command.src_position.get_internal_rect(),
+          internal_surface,
+          dst_position.get_internal_rect(),
+          modulation
+      );
+    }
+  }
+  SDL_SetClipRect(internal_surface, NULL);
+
+  clear_draw_commands();
+  set_modified();
 }
 
 /**
@@ -504,58 +1158,117 @@ void Surface::raw_draw_region(
     Surface& dst_surface,
     const Rectangle& dst_position) {
 
+  draw_region_with_opacity(region, dst_surface, dst_position, 255);
+}
+
+/**
+ * \brief Draws a subrectangle of this surface on another surface with an
+ * opacity that only applies to this drawing.
+ *
+ * Unlike set_opacity(), this does not modify the surface, so it neither
+ * requires a software surface nor a texture upload.
+ * The movement of this surface is not applied.
+ *
+ * \param region The subrectangle to draw in this object.
+ * \param dst_surface The destination surface.
+ * \param dst_position Coordinates on the destination surface.
+ * \param opacity Opacity of this drawing (0 to 255).
+ */
+void Surface::draw_region_with_opacity(
+    const Rectangle& region,
+    Surface& dst_surface,
+    const Rectangle& dst_position,
+    int opacity) {
+
+  const uint8_t modulation[4] = { 255, 255, 255, uint8_t(opacity) };
+  draw_region_modulated(region, dst_surface, dst_position, modulation);
+}
+
+/**
+ * \brief Draws a subrectangle of this surface on another surface,
+ * multiplied by a color.
+ *
+ * This is how white images like the glyphs of a font are drawn in any
+ * color.
+ * The alpha component of the color is an opacity that only applies to this
+ * drawing, like in draw_region_with_opacity().
+ *
+ * \param region The subrectangle to draw in this object.
+ * \param dst_surface The destination surface.
+ * \param dst_position Coordinates on the destination surface.
+ * \param color The color to multiply the pixels with.
+ */
+void Surface::draw_region_with_color(
+    const Rectangle& region,
+    Surface& dst_surface,
+    const Rectangle& dst_position,
+    const Color& color) {
+
+  int r, g, b, a;
+  color.get_components(r, g, b, a);
+  const uint8_t modulation[4] = {
+      uint8_t(r), uint8_t(g), uint8_t(b), uint8_t(a)
+  };
+  draw_region_modulated(region, dst_surface, dst_position, modulation);
+}
+
+/**
+ * \brief Draws a subrectangle of this surface on another surface,
+ * multiplied by a color and an opacity that only apply to this drawing.
+ * \param region The subrectangle to draw in this object.
+ * \param dst_surface The destination surface.
+ * \param dst_position Coordinates on the destination surface.
+ * \param modulation Red, green, blue and alpha factors (0 to 255).
+ */
+void Surface::draw_region_modulated(
+    const Rectangle& region,
+    Surface& dst_surface,
+    const Rectangle& dst_position,
+    const uint8_t modulation[4]) {
+
+  if (modulation[3] == 0) {
+    return;
+  }
+
   if (dst_surface.software_destination  // The destination surface is in RAM.
       || !Video::is_acceleration_enabled()  // The rendering is in RAM.
   ) {
 
-    // First, draw subsurfaces if any.
+    // First, execute draw commands if any.
     // They can exist if the video mode recently switched from an accelerated
     // one to a software one.
-    if (!subsurfaces.empty()) {
-
-      if (this->internal_surface == NULL) {
-        create_software_surface();
-      }
-      std::vector<SubSurfaceNode*>::const_iterator it;
-      const std::vector<SubSurfaceNode*>::const_iterator end = subsurfaces.end();
-      for (it = subsurfaces.begin(); it != end; ++it) {
-        SubSurfaceNode* subsurface = *it;
-
-        subsurface->src_surface->raw_draw_region(
-            subsurface->src_rect,
-            *this,
-            subsurface->dst_rect
-        );
-      }
-      clear_subsurfaces();
+    if (!draw_commands.empty()) {
+      execute_draw_commands_in_software();
     }
 
     if (this->internal_surface != NULL) {
       // The source surface is not empty: draw it onto the destination.
 
+      dst_surface.make_image_private();
       if (dst_surface.internal_surface == NULL) {
         dst_surface.create_software_surface();
       }
 
-      SDL_BlitSurface(
+      blit_modulated(
           this->internal_surface,
           region.get_internal_rect(),
           dst_surface.internal_surface,
-          Rectangle(dst_position).get_internal_rect()
+          Rectangle(dst_position).get_internal_rect(),
+          modulation
       );
-    }
-    else if (internal_color != NULL) { // No internal surface to draw: this may be a color.
-      dst_surface.fill_with_color(*internal_color, dst_position);
+
+      dst_surface.add_damaged_region(Rectangle(
+          dst_position.get_x(), dst_position.get_y(),
+          region.get_width(), region.get_height()));
     }
   }
   else {
     // The destination is a GPU surface (a texture).
-    // Do not draw anything, just store the operation in the tree instead.
+    // Do not draw anything, just record the operation instead.
     // The actual drawing will be done at rendering time in GPU.
-    dst_surface.add_subsurface(*this, region, dst_position);
+    dst_surface.add_draw_commands(*this, region, dst_position, modulation);
+    dst_surface.is_rendered = false;
   }
-
-  dst_surface.is_rendered = false;
 }
 
 /**
@@ -569,6 +1282,11 @@ void Surface::draw_transition(Transition& transition) {
 /**
  * \brief Draws this software surface with a pixel filter on another software
  * surface.
+ *
+ * If the destination surface already contains the result of this filter
+ * from a previous call, only the blocks of pixels that have changed since
+ * then are filtered again.
+ *
  * \param filter The pixel filter to apply.
  * \param dst_surface The destination surface. It must have the size of the
  * this surface multiplied by the scaling factor of the filter.
@@ -582,6 +1300,7 @@ void Surface::apply_pixel_filter(
   Debug::check_assertion(dst_surface.get_height() == get_height() * factor,
       "Wrong destination surface size");
 
+  dst_surface.make_image_private();
   SDL_Surface* src_internal_surface = this->internal_surface;
   SDL_Surface* dst_internal_surface = dst_surface.internal_surface;
 
@@ -593,52 +1312,173 @@ void Surface::apply_pixel_filter(
   SDL_LockSurface(src_internal_surface);
   SDL_LockSurface(dst_internal_surface);
 
+  const int width = get_width();
+  const int height = get_height();
+  const int src_pitch = src_internal_surface->pitch / sizeof(uint32_t);
+  const int dst_pitch = dst_internal_surface->pitch / sizeof(uint32_t);
   uint32_t* src = static_cast<uint32_t*>(src_internal_surface->pixels);
   uint32_t* dst = static_cast<uint32_t*>(dst_internal_surface->pixels);
+  std::vector<uint32_t>& previous_src = dst_surface.pixel_filter_source;
+
+  bool filter_everything = dst_surface.pixel_filter != &pixel_filter
+      || previous_src.size() != size_t(width * height);
+
+  static std::vector<Rectangle> changed_regions;
+  changed_regions.clear();
+  if (!filter_everything) {
+    // Find the blocks that have changed, and group them in rows.
+    int changed_area = 0;
+    for (int block_y = 0; block_y < height; block_y += pixel_filter_block_size) {
+      const int block_height = std::min(pixel_filter_block_size, height - block_y);
+      int run_x = 0;
+      int run_width = 0;
+      for (int block_x = 0; block_x < width; block_x += pixel_filter_block_size) {
+        const int block_width = std::min(pixel_filter_block_size, width - block_x);
+        const size_t row_size = block_width * sizeof(uint32_t);
+
+        bool changed = false;
+        for (int y = block_y; y < block_y + block_height && !changed; ++y) {
+          changed = std::memcmp(&src[y * src_pitch + block_x],
+              &previous_src[y * width + block_x], row_size) != 0;
+        }
+
+        if (changed) {
+          for (int y = block_y; y < block_y + block_height; ++y) {
+            std::memcpy(&previous_src[y * width + block_x],
+                &src[y * src_pitch + block_x], row_size);
+          }
+          if (run_width == 0) {
+            run_x = block_x;
+          }
+          run_width = block_x + block_width - run_x;
+          changed_area += block_width * block_height;
+        }
+        else if (run_width != 0) {
+          changed_regions.push_back(Rectangle(run_x, block_y, run_width, block_height));
+          run_width = 0;
+        }
+      }
+      if (run_width != 0) {
+        changed_regions.push_back(Rectangle(run_x, block_y, run_width, block_height));
+      }
+    }
+
+    // Beyond half of the surface, filtering regions separately is slower.
+    filter_everything = changed_area * 2 > width * height;
+  }
 
-  pixel_filter.filter(src, get_width(), get_height(), dst);
+  if (filter_everything) {
+    pixel_filter.filter_in_bands(src, width, height, src_pitch, dst, dst_pitch);
+    previous_src.resize(width * height);
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(&previous_src[y * width], &src[y * src_pitch],
+          width * sizeof(uint32_t));
+    }
+    dst_surface.set_modified();
+  }
+  else {
+    std::vector<Rectangle>::const_iterator it;
+    for (it = changed_regions.begin(); it != changed_regions.end(); ++it) {
+      apply_pixel_filter_region(pixel_filter, dst_surface, *it);
+    }
+  }
 
   SDL_UnlockSurface(dst_internal_surface);
   SDL_UnlockSurface(src_internal_surface);
 
-  // The destination surface has changed.
-  dst_surface.is_rendered = false;
+  // Remember that the destination now contains the result of this filter.
+  dst_surface.pixel_filter = &pixel_filter;
 }
 
 /**
- * \brief Draws the internal texture if any, and all subtextures on the
- * renderer.
- * \param renderer The renderer where to draw.
+ * \brief Copies the pixels of this 32-bit software surface.
+ * \param pixels Receives the pixels, row by row, without padding.
  */
-void Surface::render(SDL_Renderer* renderer) {
+void Surface::copy_pixels(std::vector<uint32_t>& pixels) const {
+
+  Debug::check_assertion(internal_surface != NULL,
+      "Attempt to copy the pixels of a hardware or a buffer surface");
+
+  const int width = get_width();
+  const int height = get_height();
+  const int pitch = internal_surface->pitch / sizeof(uint32_t);
+  const uint32_t* src = static_cast<const uint32_t*>(internal_surface->pixels);
+  pixels.resize(width * height);
+  for (int y = 0; y < height; ++y) {
+    std::memcpy(&pixels[y * width], &src[y * pitch], width * sizeof(uint32_t));
+  }
+}
 
+/**
+ * \brief Applies a pixel filter to the surroundings of a region that has
+ * changed.
+ *
+ * Filters take each pixel and its neighbors into account, so the pixels
+ * around the region are filtered again too.
+ * Both surfaces must be locked.
+ *
+ * \param filter The pixel filter to apply.
+ * \param dst_surface The destination surface.
+ * \param region The region of this surface that has changed.
+ */
+void Surface::apply_pixel_filter_region(
+    const PixelFilter& pixel_filter,
+    Surface& dst_surface,
+    const Rectangle& region) {
+
+  const int factor = pixel_filter.get_scaling_factor();
   const Rectangle size(get_size());
-  render(renderer, size, size, size, 255, subsurfaces);
+
+  // The region and the pixels around it change in the destination.
+  Rectangle dst_region(region.get_x() - 1, region.get_y() - 1,
+      region.get_width() + 2, region.get_height() + 2);
+  intersect(dst_region, size, dst_region);
+
+  // Filtering them correctly needs one more pixel around.
+  Rectangle src_region(dst_region.get_x() - 1, dst_region.get_y() - 1,
+      dst_region.get_width() + 2, dst_region.get_height() + 2);
+  intersect(src_region, size, src_region);
+
+  static std::vector<uint32_t> buffer;
+  const int buffer_pitch = src_region.get_width() * factor;
+  buffer.resize(buffer_pitch * src_region.get_height() * factor);
+
+  const int src_pitch = internal_surface->pitch / sizeof(uint32_t);
+  const uint32_t* src = static_cast<const uint32_t*>(internal_surface->pixels)
+      + src_region.get_y() * src_pitch + src_region.get_x();
+  pixel_filter.filter(src, src_region.get_width(), src_region.get_height(),
+      src_pitch, &buffer[0], buffer_pitch);
+
+  // Copy the result except the outer pixels, filtered without their neighbors.
+  const int dst_pitch = dst_surface.internal_surface->pitch / sizeof(uint32_t);
+  uint32_t* dst = static_cast<uint32_t*>(dst_surface.internal_surface->pixels);
+  const Rectangle scaled_region(
+      dst_region.get_x() * factor,
+      dst_region.get_y() * factor,
+      dst_region.get_width() * factor,
+      dst_region.get_height() * factor);
+  const int x_offset = scaled_region.get_x() - src_region.get_x() * factor;
+  const int y_offset = scaled_region.get_y() - src_region.get_y() * factor;
+  for (int y = 0; y < scaled_region.get_height(); ++y) {
+    std::memcpy(
+        &dst[(scaled_region.get_y() + y) * dst_pitch + scaled_region.get_x()],
+        &buffer[(y_offset + y) * buffer_pitch + x_offset],
+        scaled_region.get_width() * sizeof(uint32_t));
+  }
+
+  dst_surface.add_damaged_region(scaled_region);
 }
 
 /**
- * \brief Draws the internal texture if any, and all subtextures on the
- * renderer.
+ * \brief Makes sure the texture of this surface is up to date.
  *
- * Clears the subsurfaces vector at the end of the method.
+ * Creates the texture if necessary, or updates it if the software surface
+ * has changed.
  *
- * \param renderer The renderer where to draw.
- * \param src_rect The subrectangle of the texture to draw.
- * \param dst_rect The portion of renderer where to draw.
- * \param clip_rect The clip area, correspond to parents dst_rect.
- * \param opacity The opacity of the parent surface.
- */
-void Surface::render(
-    SDL_Renderer* renderer,
-    const Rectangle& src_rect,
-    const Rectangle& dst_rect,
-    const Rectangle& clip_rect,
-    int opacity,
-    const std::vector<SubSurfaceNode*>& subsurfaces) {
-
-  const int current_opacity = std::min(internal_opacity, opacity);
-
-  // Accelerate the internal software surface.
+ * \return true if this surface has a texture to draw.
+ */
+bool Surface::update_texture() {
+
   if (internal_surface != NULL) {
 
     if (internal_texture == NULL) {
@@ -648,70 +1488,346 @@ void Surface::render(
     // If the software surface has changed, update the hardware texture.
     else if (
         (software_destination || !Video::is_acceleration_enabled())
-         && !is_rendered) {
+         && !is_rendered
+         && shared_image == NULL) {  // Shared images never change.
+      SDL_Surface* previous_surface = internal_surface;
       convert_software_surface();
-      SDL_UpdateTexture(
-          internal_texture,
-          NULL,
-          internal_surface->pixels,
-          internal_surface->pitch
-      );
+      if (damaged_regions.empty() || internal_surface != previous_surface) {
+        SDL_UpdateTexture(
+            internal_texture,
+            NULL,
+            internal_surface->pixels,
+            internal_surface->pitch
+        );
+      }
+      else {
+        // Only upload the parts that have changed.
+        const int pitch = internal_surface->pitch;
+        const int bytes_per_pixel = internal_surface->format->BytesPerPixel;
+        std::vector<Rectangle>::const_iterator it;
+        for (it = damaged_regions.begin(); it != damaged_regions.end(); ++it) {
+          const Rectangle& region = *it;
+          const uint8_t* pixels = static_cast<const uint8_t*>(internal_surface->pixels)
+              + region.get_y() * pitch + region.get_x() * bytes_per_pixel;
+          SDL_UpdateTexture(
+              internal_texture,
+              region.get_internal_rect(),
+              pixels,
+              pitch
+          );
+        }
+      }
     }
   }
 
-  // Draw the internal color as background color.
-  if (internal_color != NULL) {
-    int r, g, b, a;
-    internal_color->get_components(r, g, b, a);
+  damaged_regions.clear();
+  is_rendered = true;
+  return internal_texture != NULL;
+}
+
+/**
+ * \brief Notifies that the pixels of the software surface have changed.
+ *
+ * The whole texture will be updated the next time it is rendered.
+ */
+void Surface::set_modified() {
+
+  is_rendered = false;
+  damaged_regions.clear();
+  pixel_filter = NULL;
+}
+
+/**
+ * \brief Notifies that a region of the software surface has changed.
+ *
+ * Only the regions changed will be uploaded to the texture the next time
+ * it is rendered.
+ *
+ * \param region The rectangle modified.
+ */
+void Surface::add_damaged_region(const Rectangle& region) {
 
-    SDL_SetRenderDrawColor(renderer, r, g, b, std::min(a, current_opacity));
-    //SDL_RenderSetClipRect(renderer, clip_rect.get_internal_rect());
-    SDL_RenderFillRect(renderer, clip_rect.get_internal_rect());
+  // The pixels are no longer the result of a pixel filter.
+  pixel_filter = NULL;
+
+  if (!is_rendered && damaged_regions.empty()) {
+    // Everything has to be updated already.
+    return;
+  }
+
+  Rectangle damaged_region;
+  if (!intersect(region, get_size(), damaged_region)) {
+    // Outside the surface.
+    return;
+  }
+
+  if (damaged_regions.size() >= max_damaged_regions) {
+    // Too many regions: update everything.
+    damaged_regions.clear();
+  }
+  else {
+    damaged_regions.push_back(damaged_region);
   }
+  is_rendered = false;
+}
+
+/**
+ * \brief Returns where a region of this surface is in its texture.
+ *
+ * Surfaces whose image is packed in an atlas page only use a part of
+ * their texture.
+ *
+ * \param region A region of this surface.
+ * \return The corresponding region of the texture.
+ */
+Rectangle Surface::get_texture_position(const Rectangle& region) const {
+
+  Rectangle texture_position(region);
+  if (shared_image != NULL && shared_image->atlas_page != NULL) {
+    texture_position.add_xy(shared_image->atlas_x, shared_image->atlas_y);
+  }
+  return texture_position;
+}
+
+/**
+ * \brief Draws the internal texture if any, and executes all draw commands
+ * on the renderer.
+ *
+ * Draw commands are grouped in batches of the same texture when this does
+ * not change the result, that is, when the commands moved do not overlap
+ * the ones they jump over.
+ *
+ * \param renderer The renderer where to draw.
+ */
+void Surface::render(SDL_Renderer* renderer) {
+
+  const Rectangle size(get_size());
+  render_items.clear();
+  render_item_batches.clear();
+  render_batches.clear();
+
+  RenderItem item;
 
   // Draw the internal texture.
-  if (internal_texture != NULL) {
-    SDL_SetTextureAlphaMod(internal_texture, current_opacity);
-    //SDL_RenderSetClipRect(renderer, clip_rect.get_internal_rect());
-    SDL_RenderCopy(
-        renderer,
-        internal_texture,
-        src_rect.get_internal_rect(),
-        dst_rect.get_internal_rect());
-  }
-
-  // Draw all subtextures.
-  std::vector<SubSurfaceNode*>::const_iterator it;
-  const std::vector<SubSurfaceNode*>::const_iterator end = subsurfaces.end();
-  for (it = subsurfaces.begin(); it != end; ++it) {
-    SubSurfaceNode* subsurface = *it;
-
-    // Calculate absolute destination subrectangle position on screen.
-    Rectangle subsurface_dst_rect(
-        dst_rect.get_x() + subsurface->dst_rect.get_x() - src_rect.get_x(),
-        dst_rect.get_y() + subsurface->dst_rect.get_y() - src_rect.get_y(),
-        subsurface->src_rect.get_width(),
-        subsurface->src_rect.get_height());
-
-    // Set the intersection of the subsurface destination and this surface's clip as clipping rectangle.
-    Rectangle superimposed_clip_rect;
-    if (SDL_IntersectRect(subsurface_dst_rect.get_internal_rect(),
-        clip_rect.get_internal_rect(),
-        superimposed_clip_rect.get_internal_rect())) {
-
-      // If there is an intersection, render the subsurface.
-      subsurface->src_surface->render(
-          renderer,
-          subsurface->src_rect,
-          subsurface_dst_rect,
-          superimposed_clip_rect,
-          current_opacity,
-          subsurface->subsurfaces
-      );
+  if (update_texture()) {
+    item.texture = internal_texture;
+    item.src_position = get_texture_position(size);
+    item.dst_position = size;
+    item.color[0] = item.color[1] = item.color[2] = 255;
+    item.color[3] = internal_opacity;
+    add_render_item(item);
+  }
+
+  // Execute the draw commands.
+  std::vector<DrawCommand>::const_iterator it;
+  const std::vector<DrawCommand>::const_iterator end = draw_commands.end();
+  for (it = draw_commands.begin(); it != end; ++it) {
+    const DrawCommand& command = *it;
+
+    Rectangle dst_position;
+    if (!intersect(command.dst_position, command.clip, dst_position)
+        || !intersect(dst_position, size, dst_position)) {
+      // Nothing visible.
+      continue;
+    }
+    const int opacity = command.opacity * internal_opacity / 255;
+
+    if (command.src_surface == NULL) {
+      // Fill with a color.
+      item.texture = NULL;
+      item.color[0] = command.color[0];
+      item.color[1] = command.color[1];
+      item.color[2] = command.color[2];
+      item.color[3] = command.color[3] * opacity / 255;
     }
+    else {
+      // Draw a texture.
+      Surface& src_surface = *command.src_surface;
+      if (!src_surface.update_texture()) {
+        continue;
+      }
+      item.texture = src_surface.internal_texture;
+      item.src_position = src_surface.get_texture_position(Rectangle(
+          command.src_position.get_x() + dst_position.get_x() - command.dst_position.get_x(),
+          command.src_position.get_y() + dst_position.get_y() - command.dst_position.get_y(),
+          dst_position.get_width(),
+          dst_position.get_height()));
+      item.color[0] = command.color[0];
+      item.color[1] = command.color[1];
+      item.color[2] = command.color[2];
+      item.color[3] = opacity;
+    }
+    item.dst_position = dst_position;
+    add_render_item(item);
   }
 
-  is_rendered = true;
+  // Sort the items by batch, keeping their order inside each batch.
+  int first = 0;
+  std::vector<RenderBatch>::iterator batch_it;
+  for (batch_it = render_batches.begin(); batch_it != render_batches.end(); ++batch_it) {
+    batch_it->first = first;
+    first += batch_it->num_items;
+    batch_it->num_items = 0;
+  }
+  render_order.resize(render_items.size());
+  for (unsigned i = 0; i < render_items.size(); ++i) {
+    RenderBatch& batch = render_batches[render_item_batches[i]];
+    render_order[batch.first + batch.num_items] = i;
+    ++batch.num_items;
+  }
+
+  // Submit the batches.
+  for (unsigned i = 0; i < render_batches.size(); ++i) {
+    const RenderBatch& batch = render_batches[i];
+    if (i > 0 && batch.texture != render_batches[i - 1].texture) {
+      ++num_texture_switches;
+    }
+    submit_render_batch(renderer, batch);
+  }
+
+  draw_commands_drawn_frame = current_frame;
+}
+
+/**
+ * \brief Adds an item to render and chooses its batch.
+ *
+ * The item joins a recent batch with the same texture if no batch drawn
+ * after that one overlaps it. Otherwise, it starts a new batch.
+ *
+ * \param item The item to render.
+ */
+void Surface::add_render_item(const RenderItem& item) {
+
+  const int num_batches = render_batches.size();
+  const int last_batch = std::max(0, num_batches - max_batch_lookback);
+  int batch_index = -1;
+  for (int i = num_batches - 1; i >= last_batch; --i) {
+    const RenderBatch& batch = render_batches[i];
+    if (batch.texture == item.texture) {
+      batch_index = i;
+      break;
+    }
+    if (overlaps(batch.bounds, item.dst_position)) {
+      // The item must be drawn after this batch.
+      break;
+    }
+  }
+
+  if (batch_index == -1) {
+    RenderBatch batch;
+    batch.texture = item.texture;
+    batch.bounds = item.dst_position;
+    batch.first = 0;
+    batch.num_items = 0;
+    render_batches.push_back(batch);
+    batch_index = num_batches;
+  }
+  else {
+    // Extend the bounds of the batch.
+    Rectangle& bounds = render_batches[batch_index].bounds;
+    const Rectangle& dst_position = item.dst_position;
+    const int x1 = std::min(bounds.get_x(), dst_position.get_x());
+    const int y1 = std::min(bounds.get_y(), dst_position.get_y());
+    const int x2 = std::max(bounds.get_x() + bounds.get_width(),
+        dst_position.get_x() + dst_position.get_width());
+    const int y2 = std::max(bounds.get_y() + bounds.get_height(),
+        dst_position.get_y() + dst_position.get_height());
+    bounds = Rectangle(x1, y1, x2 - x1, y2 - y1);
+  }
+
+  ++render_batches[batch_index].num_items;
+  render_items.push_back(item);
+  render_item_batches.push_back(batch_index);
+}
+
+/**
+ * \brief Submits a batch of render items to the renderer.
+ * \param renderer The renderer where to draw.
+ * \param batch The batch to draw.
+ */
+void Surface::submit_render_batch(SDL_Renderer* renderer, const RenderBatch& batch) {
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  // Submit all quads of the batch at once.
+  static std::vector<SDL_Vertex> vertices;
+  static std::vector<int> indices;
+  vertices.clear();
+  indices.clear();
+
+  float texture_width = 1.0f;
+  float texture_height = 1.0f;
+  if (batch.texture != NULL) {
+    int width, height;
+    SDL_QueryTexture(batch.texture, NULL, NULL, &width, &height);
+    texture_width = float(width);
+    texture_height = float(height);
+    // The opacity is in the vertex colors.
+    SDL_SetTextureAlphaMod(batch.texture, 255);
+  }
+
+  for (int i = batch.first; i < batch.first + batch.num_items; ++i) {
+    const RenderItem& item = render_items[render_order[i]];
+    const Rectangle& src = item.src_position;
+    const Rectangle& dst = item.dst_position;
+    const float x1 = float(dst.get_x());
+    const float y1 = float(dst.get_y());
+    const float x2 = float(dst.get_x() + dst.get_width());
+    const float y2 = float(dst.get_y() + dst.get_height());
+    const float u1 = src.get_x() / texture_width;
+    const float v1 = src.get_y() / texture_height;
+    const float u2 = (src.get_x() + src.get_width()) / texture_width;
+    const float v2 = (src.get_y() + src.get_height()) / texture_height;
+
+    SDL_Vertex vertex;
+    vertex.color.r = item.color[0];
+    vertex.color.g = item.color[1];
+    vertex.color.b = item.color[2];
+    vertex.color.a = item.color[3];
+    const int index = vertices.size();
+    vertex.position.x = x1; vertex.position.y = y1;
+    vertex.tex_coord.x = u1; vertex.tex_coord.y = v1;
+    vertices.push_back(vertex);
+    vertex.position.x = x2; vertex.tex_coord.x = u2;
+    vertices.push_back(vertex);
+    vertex.position.y = y2; vertex.tex_coord.y = v2;
+    vertices.push_back(vertex);
+    vertex.position.x = x1; vertex.tex_coord.x = u1;
+    vertices.push_back(vertex);
+
+    indices.push_back(index);
+    indices.push_back(index + 1);
+    indices.push_back(index + 2);
+    indices.push_back(index);
+    indices.push_back(index + 2);
+    indices.push_back(index + 3);
+  }
+
+  SDL_RenderGeometry(renderer, batch.texture,
+      &vertices[0], int(vertices.size()), &indices[0], int(indices.size()));
+  ++num_draw_calls;
+#else
+  // No geometry submission before SDL 2.0.18: submit each item.
+  // Recent versions of SDL still group consecutive copies of a texture.
+  for (int i = batch.first; i < batch.first + batch.num_items; ++i) {
+    const RenderItem& item = render_items[render_order[i]];
+    if (batch.texture == NULL) {
+      SDL_SetRenderDrawColor(renderer,
+          item.color[0], item.color[1], item.color[2], item.color[3]);
+      SDL_RenderFillRect(renderer, item.dst_position.get_internal_rect());
+    }
+    else {
+      SDL_SetTextureColorMod(batch.texture,
+          item.color[0], item.color[1], item.color[2]);
+      SDL_SetTextureAlphaMod(batch.texture, item.color[3]);
+      SDL_RenderCopy(
+          renderer,
+          batch.texture,
+          item.src_position.get_internal_rect(),
+          item.dst_position.get_internal_rect());
+    }
+    ++num_draw_calls;
+  }
+#endif
 }
 
 /**
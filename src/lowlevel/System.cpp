@@ -19,11 +19,17 @@
 #include "lowlevel/Video.h"
 #include "lowlevel/Shader.h"
 #include "lowlevel/Color.h"
+#include "lowlevel/Surface.h"
 #include "lowlevel/TextSurface.h"
 #include "lowlevel/Sound.h"
 #include "lowlevel/Random.h"
 #include "lowlevel/InputEvent.h"
+#include "lowlevel/WorkerPool.h"
+#include "lowlevel/PixelFilter.h"
 #include "Sprite.h"
+#include "MapPreloader.h"
+#include "ResourcePreloader.h"
+#include "CommandLine.h"
 #include <SDL.h>
 #ifdef SOLARUS_USE_APPLE_POOL
 #  include "lowlevel/apple/AppleInterface.h"
@@ -49,6 +55,10 @@ void System::initialize(const CommandLine& args) {
 #endif
 
   // initialize SDL
+  if (args.has_argument("-headless")) {
+    // No display is needed, but keep events and text input working.
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+  }
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK);
 
   // files
@@ -63,11 +73,16 @@ void System::initialize(const CommandLine& args) {
   // random number generator
   Random::initialize();
 
+  // worker threads
+  WorkerPool::initialize(args);
+
   // video
   Video::initialize(args);
   Color::initialize();
+  Surface::initialize();
   TextSurface::initialize();
   Sprite::initialize();
+  MapPreloader::initialize();
 }
 
 /**
@@ -77,11 +92,16 @@ void System::initialize(const CommandLine& args) {
  */
 void System::quit() {
 
+  WorkerPool::quit();
+  PixelFilter::quit();
   Random::quit();
   InputEvent::quit();
   Sound::quit();
+  MapPreloader::quit();
+  ResourcePreloader::quit();
   Sprite::quit();
   TextSurface::quit();
+  Surface::quit();
   Color::quit();
   Shader::quit();
   Video::quit();
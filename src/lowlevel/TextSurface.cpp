@@ -24,12 +24,225 @@
 #include "lua/LuaContext.h"
 #include "Transition.h"
 #include <lua.hpp>
+#include <algorithm>
 
 namespace solarus {
 
+namespace {
+
+/**
+ * \brief Decodes a character of an UTF-8 string.
+ *
+ * Only characters of the basic multilingual plane are supported.
+ *
+ * \param text An UTF-8 string.
+ * \param i Index of the first byte of the character in the string.
+ * It is then incremented to the index of the next character.
+ * \return The code point of the character.
+ */
+uint16_t get_next_code_point(const std::string& text, unsigned& i) {
+
+  const uint8_t first_byte = text[i];
+  ++i;
+
+  if ((first_byte & 0xE0) == 0xC0 && i < text.size()) {
+    // This character uses two bytes.
+    const uint8_t second_byte = text[i];
+    ++i;
+    return ((first_byte & 0x1F) << 6) | (second_byte & 0x3F);
+  }
+
+  if ((first_byte & 0xF0) == 0xE0 && i + 1 < text.size()) {
+    // This character uses three bytes.
+    const uint8_t second_byte = text[i];
+    const uint8_t third_byte = text[i + 1];
+    i += 2;
+    return ((first_byte & 0x0F) << 12) | ((second_byte & 0x3F) << 6)
+        | (third_byte & 0x3F);
+  }
+
+  return first_byte;
+}
+
+/**
+ * \brief Color of the glyphs of usual fonts.
+ *
+ * Texts multiply it by their own color when they are drawn.
+ */
+const SDL_Color white = { 255, 255, 255, 255 };
+
+}
+
+/**
+ * \brief Glyphs of a font rendered with a rendering mode.
+ *
+ * Each glyph is rendered the first time it is needed and packed with the
+ * other ones into pages.
+ * Glyphs are rendered in white, and texts multiply them by their color
+ * when they draw them.
+ * Pages are software destinations, so their texture is updated when glyphs
+ * are added.
+ */
+class TextSurface::GlyphAtlas {
+
+  public:
+
+    /**
+     * \brief A glyph rendered in the atlas.
+     */
+    struct Glyph {
+      Surface* page;                 /**< page containing the glyph, or NULL if it has no pixels */
+      Rectangle src_position;        /**< the glyph in this page */
+      int x_offset;                  /**< x position of the glyph relative to the pen */
+      int y_offset;                  /**< y position of the glyph relative to the top of the line */
+      int advance;                   /**< distance from this glyph to the next one */
+    };
+
+    GlyphAtlas(TTF_Font* font, RenderingMode rendering_mode);
+    ~GlyphAtlas();
+
+    const Glyph& get_glyph(uint16_t code_point);
+
+  private:
+
+    static const int page_size = 256;  /**< width and height of each page */
+
+    void render_glyph(uint16_t code_point, Glyph& glyph);
+
+    TTF_Font* font;                    /**< the font */
+    RenderingMode rendering_mode;      /**< solid or antialiased glyphs */
+    std::map<uint16_t, Glyph> glyphs;  /**< glyphs already rendered */
+    std::vector<Surface*> pages;       /**< images containing the glyphs */
+    int pen_x;                         /**< where the next glyph goes in the last page */
+    int pen_y;                         /**< top of the current row in the last page */
+    int row_height;                    /**< height of the current row */
+};
+
+/**
+ * \brief Creates an empty glyph atlas.
+ * \param font The font to render.
+ * \param rendering_mode The rendering mode.
+ */
+TextSurface::GlyphAtlas::GlyphAtlas(TTF_Font* font,
+    RenderingMode rendering_mode):
+  font(font),
+  rendering_mode(rendering_mode),
+  pen_x(0),
+  pen_y(0),
+  row_height(0) {
+
+}
+
+/**
+ * \brief Destroys the glyph atlas.
+ */
+TextSurface::GlyphAtlas::~GlyphAtlas() {
+
+  for (unsigned i = 0; i < pages.size(); ++i) {
+    RefCountable::unref(pages[i]);
+  }
+}
+
+/**
+ * \brief Returns a glyph, rendering it first if necessary.
+ * \param code_point The character to get.
+ * \return The corresponding glyph.
+ */
+const TextSurface::GlyphAtlas::Glyph& TextSurface::GlyphAtlas::get_glyph(
+    uint16_t code_point) {
+
+  std::map<uint16_t, Glyph>::iterator it = glyphs.find(code_point);
+  if (it == glyphs.end()) {
+    it = glyphs.insert(std::make_pair(code_point, Glyph())).first;
+    render_glyph(code_point, it->second);
+  }
+  return it->second;
+}
+
+/**
+ * \brief Renders a glyph and copies it into a page.
+ * \param code_point The character to render.
+ * \param glyph Receives the glyph rendered.
+ */
+void TextSurface::GlyphAtlas::render_glyph(uint16_t code_point, Glyph& glyph) {
+
+  glyph.page = NULL;
+  glyph.x_offset = 0;
+  glyph.y_offset = 0;
+  glyph.advance = 0;
+
+  int min_x, max_x, min_y, max_y, advance;
+  if (TTF_GlyphMetrics(font, code_point,
+      &min_x, &max_x, &min_y, &max_y, &advance) != 0) {
+    // This character does not exist in the font.
+    return;
+  }
+  glyph.x_offset = min_x;
+  glyph.y_offset = TTF_FontAscent(font) - max_y;
+  glyph.advance = advance;
+
+  SDL_Surface* glyph_surface = NULL;
+  switch (rendering_mode) {
+
+  case TEXT_SOLID:
+    glyph_surface = TTF_RenderGlyph_Solid(font, code_point, white);
+    break;
+
+  case TEXT_ANTIALIASING:
+    glyph_surface = TTF_RenderGlyph_Blended(font, code_point, white);
+    break;
+  }
+
+  if (glyph_surface == NULL) {
+    // Nothing to draw, like for spaces.
+    return;
+  }
+
+  const int width = std::min(glyph_surface->w, int(page_size));
+  const int height = std::min(glyph_surface->h, int(page_size));
+  if (width == 0 || height == 0) {
+    SDL_FreeSurface(glyph_surface);
+    return;
+  }
+
+  // Find some room.
+  if (!pages.empty() && pen_x + width > page_size) {
+    // Start a new row.
+    pen_x = 0;
+    pen_y += row_height;
+    row_height = 0;
+  }
+  if (pages.empty() || pen_y + height > page_size) {
+    // Start a new page.
+    Surface* page = Surface::create(page_size, page_size);
+    page->set_software_destination(true);
+    page->create_software_surface();
+    RefCountable::ref(page);
+    pages.push_back(page);
+    pen_x = 0;
+    pen_y = 0;
+    row_height = 0;
+  }
+
+  // Copy the pixels as they are, including their alpha value.
+  Surface* page = pages.back();
+  SDL_Rect dst_rect = { pen_x, pen_y, width, height };
+  SDL_SetSurfaceBlendMode(glyph_surface, SDL_BLENDMODE_NONE);
+  SDL_BlitSurface(glyph_surface, NULL, page->internal_surface, &dst_rect);
+  SDL_FreeSurface(glyph_surface);
+  page->add_damaged_region(Rectangle(pen_x, pen_y, width, height));
+
+  glyph.page = page;
+  glyph.src_position = Rectangle(pen_x, pen_y, width, height);
+
+  pen_x += width;
+  row_height = std::max(row_height, height);
+}
+
 bool TextSurface::fonts_loaded = false;
 std::map<std::string, TextSurface::FontData> TextSurface::fonts;
 std::string TextSurface::default_font_id;
+std::map<std::string, TextSurface::GlyphAtlas*> TextSurface::glyph_atlases;
 
 /**
  * \brief Initializes the font system.
@@ -76,11 +289,29 @@ void TextSurface::load_fonts() {
   fonts_loaded = true;
 }
 
+/**
+ * \brief Loads the fonts now if they are not loaded yet.
+ *
+ * Otherwise, they are loaded the first time a text is drawn.
+ */
+void TextSurface::load_fonts_if_needed() {
+
+  if (!fonts_loaded) {
+    load_fonts();
+  }
+}
+
 /**
  * \brief Closes the font system.
  */
 void TextSurface::quit() {
 
+  std::map<std::string, GlyphAtlas*>::iterator atlas_it;
+  for (atlas_it = glyph_atlases.begin(); atlas_it != glyph_atlases.end(); ++atlas_it) {
+    delete atlas_it->second;
+  }
+  glyph_atlases.clear();
+
   std::map<std::string, FontData>::iterator it;
   for (it = fonts.begin(); it != fonts.end(); it++) {
     std::string font_id = it->first;
@@ -172,7 +403,10 @@ TextSurface::TextSurface(int x, int y):
   horizontal_alignment(ALIGN_LEFT),
   vertical_alignment(ALIGN_MIDDLE),
   rendering_mode(TEXT_SOLID),
-  surface(NULL) {
+  width(0),
+  height(0),
+  intermediate_surface(NULL),
+  text_surface(NULL) {
 
   text = "";
   set_text_color(Color::get_white());
@@ -196,7 +430,10 @@ TextSurface::TextSurface(int x, int y,
   horizontal_alignment(horizontal_alignment),
   vertical_alignment(vertical_alignment),
   rendering_mode(TEXT_SOLID),
-  surface(NULL) {
+  width(0),
+  height(0),
+  intermediate_surface(NULL),
+  text_surface(NULL) {
 
   text = "";
   set_text_color(Color::get_white());
@@ -208,7 +445,8 @@ TextSurface::TextSurface(int x, int y,
  */
 TextSurface::~TextSurface() {
 
-  RefCountable::unref(surface);
+  RefCountable::unref(intermediate_surface);
+  RefCountable::unref(text_surface);
 }
 
 /**
@@ -324,11 +562,13 @@ const Color& TextSurface::get_text_color() const {
 
 /**
  * \brief Sets the color of the text.
+ *
+ * The glyphs are drawn in this color: they don't need to be computed again.
+ *
  * \param color The color to set.
  */
 void TextSurface::set_text_color(const Color &color) {
   this->text_color = color;
-  rebuild();
 }
 
 /**
@@ -339,7 +579,6 @@ void TextSurface::set_text_color(const Color &color) {
  */
 void TextSurface::set_text_color(int r, int g, int b) {
   this->text_color = Color(r, g, b);
-  rebuild();
 }
 
 /**
@@ -437,29 +676,21 @@ void TextSurface::add_char(char c) {
 }
 
 /**
- * \brief Returns the width of the surface containing the text.
+ * \brief Returns the width of the text.
  * \return the width in pixels
  */
 int TextSurface::get_width() const {
 
-  if (surface == NULL) {
-    return 0;
-  }
-
-  return surface->get_width();
+  return width;
 }
 
 /**
- * \brief Returns the height of the surface containing the text.
+ * \brief Returns the height of the text.
  * \return the height in pixels
  */
 int TextSurface::get_height() const {
 
-  if (surface == NULL) {
-    return 0;
-  }
-
-  return surface->get_height();
+  return height;
 }
 
 /**
@@ -471,7 +702,7 @@ const Rectangle TextSurface::get_size() const {
 }
 
 /**
- * \brief Redraws the text surface.
+ * \brief Computes the position of each character of the text.
  *
  * This function is called when there is a change.
  */
@@ -485,11 +716,14 @@ void TextSurface::rebuild() {
     }
   }
 
-  RefCountable::unref(surface);
-  surface = NULL;
+  glyphs.clear();
+  RefCountable::unref(text_surface);
+  text_surface = NULL;
+  width = 0;
+  height = 0;
 
   if (is_empty()) {
-    // Empty string or only whitespaces: no surface to create.
+    // Empty string or only whitespaces: nothing to draw.
     // Some fonts make TTF_Font fail if the string contains only whitespaces.
     return;
   }
@@ -514,11 +748,11 @@ void TextSurface::rebuild() {
     break;
 
   case ALIGN_CENTER:
-    x_left = x - surface->get_width() / 2;
+    x_left = x - width / 2;
     break;
 
   case ALIGN_RIGHT:
-    x_left = x - surface->get_width();
+    x_left = x - width;
     break;
   }
 
@@ -529,11 +763,11 @@ void TextSurface::rebuild() {
     break;
 
   case ALIGN_MIDDLE:
-    y_top = y - surface->get_height() / 2;
+    y_top = y - height / 2;
     break;
 
   case ALIGN_BOTTOM:
-    y_top = y - surface->get_height();
+    y_top = y - height;
     break;
   }
 
@@ -541,81 +775,185 @@ void TextSurface::rebuild() {
 }
 
 /**
- * \brief Redraws the text surface in the case of a bitmap font.
+ * \brief Computes the position of each character in the case of a bitmap
+ * font.
  *
  * This function is called when there is a change.
  */
 void TextSurface::rebuild_bitmap() {
 
-  // First count the number of characters in the UTF-8 string.
-  int num_chars = 0;
-  for (unsigned i = 0; i < text.size(); i++) {
-    char current_char = text[i];
-    if ((current_char & 0xE0) == 0xC0) {
-      // This character uses two bytes.
-      ++i;
-    }
-    ++num_chars;
-  }
-
   // Determine the letter size from the surface size.
   Surface& bitmap = *fonts[font_id].bitmap;
   const Rectangle& bitmap_size = bitmap.get_size();
   int char_width = bitmap_size.get_width() / 128;
   int char_height = bitmap_size.get_height() / 16;
 
-  surface = Surface::create(char_width * num_chars, char_height);
-  surface->set_software_destination(true);  // Necessary as long as Lua surfaces are software destinations.
-  RefCountable::ref(surface);
-
-  // Traverse the string again to draw the characters.
-  Rectangle dst_position(0, 0);
-  for (unsigned i = 0; i < text.size(); i++) {
-    char first_byte = text[i];
-    Rectangle src_position(0, 0, char_width, char_height);
-    if ((first_byte & 0xE0) != 0xC0) {
-      // This character uses one byte.
-      src_position.set_xy(first_byte * char_width, 0);
-    }
-    else {
-      // This character uses two bytes.
-      ++i;
-      char second_byte = text[i];
-      uint16_t code_point = ((first_byte & 0x1F) << 6) | (second_byte & 0x3F);
-      src_position.set_xy((code_point % 128) * char_width,
-          (code_point / 128) * char_height);
-    }
-    bitmap.draw_region(src_position, *surface, dst_position);
-    dst_position.add_x(char_width - 1);
+  // Each character is taken directly from the font image.
+  GlyphQuad glyph;
+  glyph.src_surface = &bitmap;
+  glyph.dst_position = Rectangle(0, 0, char_width, char_height);
+  for (unsigned i = 0; i < text.size(); ) {
+    uint16_t code_point = get_next_code_point(text, i);
+    glyph.src_position = Rectangle((code_point % 128) * char_width,
+        (code_point / 128) * char_height, char_width, char_height);
+    glyphs.push_back(glyph);
+    glyph.dst_position.add_x(char_width - 1);
   }
+
+  width = char_width * int(glyphs.size());
+  height = char_height;
 }
 
 /**
- * \brief Redraws the text surface in the case of a normal font.
+ * \brief Computes the position of each character in the case of a normal
+ * font.
  *
+ * Glyphs not rendered yet are added to the atlas of this font and rendering
+ * mode, and the kerning of the font is applied between them.
  * This function is called when there is a change.
  */
 void TextSurface::rebuild_ttf() {
 
-  // create the text surface
+  TTF_Font* font = fonts[font_id].internal_font;
 
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) \
+    >= SDL_VERSIONNUM(2, 0, 14)
+  const std::string& atlas_key = font_id +
+      (rendering_mode == TEXT_SOLID ? ":solid" : ":antialiasing");
+  GlyphAtlas*& atlas = glyph_atlases[atlas_key];
+  if (atlas == NULL) {
+    atlas = new GlyphAtlas(font, rendering_mode);
+  }
+
+  const bool kerning = TTF_GetFontKerning(font) != 0;
+  GlyphQuad glyph;
+  int pen_x = 0;
+  uint16_t previous_code_point = 0;
+  for (unsigned i = 0; i < text.size(); ) {
+    uint16_t code_point = get_next_code_point(text, i);
+    if (kerning && previous_code_point != 0) {
+      pen_x += TTF_GetFontKerningSizeGlyphs(font, previous_code_point, code_point);
+    }
+    previous_code_point = code_point;
+
+    const GlyphAtlas::Glyph& atlas_glyph = atlas->get_glyph(code_point);
+    if (atlas_glyph.page != NULL) {
+      glyph.src_surface = atlas_glyph.page;
+      glyph.src_position = atlas_glyph.src_position;
+      glyph.dst_position = Rectangle(
+          pen_x + atlas_glyph.x_offset,
+          atlas_glyph.y_offset,
+          atlas_glyph.src_position.get_width(),
+          atlas_glyph.src_position.get_height());
+      glyphs.push_back(glyph);
+      width = std::max(width,
+          glyph.dst_position.get_x() + glyph.dst_position.get_width());
+    }
+    pen_x += atlas_glyph.advance;
+  }
+
+  width = std::max(width, pen_x);
+  height = TTF_FontHeight(font);
+#else
+  // The kerning between two characters is not available before
+  // SDL_ttf 2.0.14: let SDL_ttf render the whole text.
   SDL_Surface* internal_surface = NULL;
   switch (rendering_mode) {
 
   case TEXT_SOLID:
-    internal_surface = TTF_RenderUTF8_Solid(fonts[font_id].internal_font, text.c_str(), *text_color.get_internal_color());
+    internal_surface = TTF_RenderUTF8_Solid(font, text.c_str(), white);
     break;
 
   case TEXT_ANTIALIASING:
-    internal_surface = TTF_RenderUTF8_Blended(fonts[font_id].internal_font, text.c_str(), *text_color.get_internal_color());
+    internal_surface = TTF_RenderUTF8_Blended(font, text.c_str(), white);
     break;
   }
 
   Debug::check_assertion(internal_surface != NULL, StringConcat()
       << "Cannot create the text surface for string '" << text << "': " << SDL_GetError());
 
-  surface = new Surface(internal_surface);
-  RefCountable::ref(surface);
+  text_surface = new Surface(internal_surface);
+  RefCountable::ref(text_surface);
+
+  GlyphQuad glyph;
+  glyph.src_surface = text_surface;
+  glyph.src_position = text_surface->get_size();
+  glyph.dst_position = text_surface->get_size();
+  glyphs.push_back(glyph);
+
+  width = text_surface->get_width();
+  height = text_surface->get_height();
+#endif
+}
+
+/**
+ * \brief Draws a region of the characters on a surface.
+ * \param region The subrectangle to draw, relative to the top-left corner
+ * of the text.
+ * \param dst_surface The destination surface.
+ * \param dst_position Where to draw the top-left corner of the region
+ * on the destination surface.
+ */
+void TextSurface::draw_glyphs(const Rectangle& region,
+    Surface& dst_surface, const Rectangle& dst_position) {
+
+  const bool bitmap_font = fonts[font_id].bitmap != NULL;
+  std::vector<GlyphQuad>::const_iterator it;
+  const std::vector<GlyphQuad>::const_iterator end = glyphs.end();
+  for (it = glyphs.begin(); it != end; ++it) {
+
+    // Clip the glyph to the region.
+    const Rectangle& glyph_dst = it->dst_position;
+    const int x1 = std::max(glyph_dst.get_x(), region.get_x());
+    const int y1 = std::max(glyph_dst.get_y(), region.get_y());
+    const int x2 = std::min(glyph_dst.get_x() + glyph_dst.get_width(),
+        region.get_x() + region.get_width());
+    const int y2 = std::min(glyph_dst.get_y() + glyph_dst.get_height(),
+        region.get_y() + region.get_height());
+    if (x2 <= x1 || y2 <= y1) {
+      continue;
+    }
+
+    Rectangle src_position(
+        it->src_position.get_x() + x1 - glyph_dst.get_x(),
+        it->src_position.get_y() + y1 - glyph_dst.get_y(),
+        x2 - x1,
+        y2 - y1);
+    Rectangle dst_position2(
+        dst_position.get_x() + x1 - region.get_x(),
+        dst_position.get_y() + y1 - region.get_y());
+    if (bitmap_font) {
+      it->src_surface->raw_draw_region(src_position, dst_surface, dst_position2);
+    }
+    else {
+      // Glyphs of usual fonts are white.
+      it->src_surface->draw_region_with_color(
+          src_position, dst_surface, dst_position2, text_color);
+    }
+  }
+}
+
+/**
+ * \brief Returns the intermediate surface used for transitions.
+ *
+ * Creates it if it does not exist yet or if the size of the text has
+ * changed.
+ *
+ * \return The intermediate surface of this text.
+ */
+Surface& TextSurface::get_intermediate_surface() {
+
+  const int surface_width = std::max(width, 1);
+  const int surface_height = std::max(height, 1);
+  if (intermediate_surface == NULL
+      || intermediate_surface->get_width() != surface_width
+      || intermediate_surface->get_height() != surface_height) {
+    RefCountable::unref(intermediate_surface);
+    intermediate_surface = Surface::create(surface_width, surface_height);
+    intermediate_surface->set_software_destination(true);
+    RefCountable::ref(intermediate_surface);
+  }
+  return *intermediate_surface;
 }
 
 /**
@@ -631,12 +969,7 @@ void TextSurface::rebuild_ttf() {
 void TextSurface::raw_draw(Surface& dst_surface,
     const Rectangle& dst_position) {
 
-  if (surface != NULL) {
-
-    Rectangle dst_position2(text_position);
-    dst_position2.add_xy(dst_position);
-    surface->raw_draw(dst_surface, dst_position2);
-  }
+  raw_draw_region(get_size(), dst_surface, dst_position);
 }
 
 /**
@@ -648,11 +981,22 @@ void TextSurface::raw_draw(Surface& dst_surface,
 void TextSurface::raw_draw_region(const Rectangle& region,
     Surface& dst_surface, const Rectangle& dst_position) {
 
-  if (surface != NULL) {
+  if (glyphs.empty()) {
+    return;
+  }
+
+  Rectangle dst_position2(text_position);
+  dst_position2.add_xy(dst_position);
 
-    Rectangle dst_position2(text_position);
-    dst_position2.add_xy(dst_position);
-    surface->raw_draw_region(region, dst_surface, dst_position2);
+  if (intermediate_surface == NULL) {
+    draw_glyphs(region, dst_surface, dst_position2);
+  }
+  else {
+    // A transition was applied: draw the text through its surface.
+    Surface& surface = get_intermediate_surface();
+    surface.fill_with_color(Color::get_transparent());
+    draw_glyphs(get_size(), surface, Rectangle(0, 0));
+    surface.raw_draw_region(region, dst_surface, dst_position2);
   }
 }
 
@@ -661,7 +1005,7 @@ void TextSurface::raw_draw_region(const Rectangle& region,
  * \param transition The transition effect to apply.
  */
 void TextSurface::draw_transition(Transition& transition) {
-  transition.draw(*surface);
+  transition.draw(get_intermediate_surface());
 }
 
 /**
@@ -670,7 +1014,7 @@ void TextSurface::draw_transition(Transition& transition) {
  * \return The surface for transitions.
  */
 Surface& TextSurface::get_transition_surface() {
-  return *surface;
+  return get_intermediate_surface();
 }
 
 /**
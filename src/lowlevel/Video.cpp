@@ -25,9 +25,12 @@
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include "lowlevel/Profiler.h"
 #include "CommandLine.h"
 #include <map>
 #include <algorithm>
+#include <iostream>
+#include <sstream>
 
 namespace solarus {
 
@@ -57,6 +60,11 @@ Rectangle max_quest_size;                 /**< Maximum value of quest_size (depe
 Rectangle quest_size;                     /**< Size of the quest surface to render. */
 Rectangle wanted_quest_size;              /**< Size wanted by the user. */
 
+int filter_benchmark_frames = 0;          /**< Number of frames to record for the pixel filter benchmark
+                                           * (0 means no benchmark). */
+std::vector<std::vector<uint32_t> >
+    filter_benchmark_recording;           /**< Frames recorded for the pixel filter benchmark. */
+
 /**
  * \brief Creates the window but does not show it.
  * \param args Command-line arguments.
@@ -214,6 +222,72 @@ void initialize_video_modes() {
   Video::set_default_video_mode();
 }
 
+/**
+ * \brief Measures the time spent by each software pixel filter on the
+ * recorded frames with different numbers of threads, and prints the
+ * results on the standard output.
+ */
+void run_filter_benchmark() {
+
+  const int width = quest_size.get_width();
+  const int height = quest_size.get_height();
+  const int num_frames = filter_benchmark_recording.size();
+  const int initial_num_threads = PixelFilter::get_num_threads();
+  const int max_num_threads = std::max(SDL_GetCPUCount(), initial_num_threads);
+  std::vector<uint32_t> dst;
+
+  std::cout << "Pixel filter benchmark: " << num_frames << " frames of "
+      << width << "x" << height << std::endl;
+  for (unsigned i = 0; i < all_video_modes.size(); ++i) {
+    const VideoMode& mode = *all_video_modes[i];
+    const PixelFilter* pixel_filter = mode.get_software_filter();
+    if (pixel_filter == NULL) {
+      continue;
+    }
+
+    const int factor = pixel_filter->get_scaling_factor();
+    dst.resize(width * factor * height * factor);
+    for (int num_threads = 1; ; num_threads *= 2) {
+      num_threads = std::min(num_threads, max_num_threads);
+      PixelFilter::set_num_threads(num_threads);
+
+      const uint64_t start = SDL_GetPerformanceCounter();
+      for (int j = 0; j < num_frames; ++j) {
+        pixel_filter->filter_in_bands(&filter_benchmark_recording[j][0],
+            width, height, width, &dst[0], width * factor);
+      }
+      const uint64_t end = SDL_GetPerformanceCounter();
+      const double milliseconds = (end - start) * 1000.0
+          / SDL_GetPerformanceFrequency() / num_frames;
+
+      std::cout << "  " << mode.get_name() << ", " << num_threads
+          << " thread(s): " << milliseconds << " ms/frame" << std::endl;
+      if (num_threads >= max_num_threads) {
+        break;
+      }
+    }
+  }
+
+  PixelFilter::set_num_threads(initial_num_threads);
+}
+
+/**
+ * \brief Records a frame for the pixel filter benchmark, and runs the
+ * benchmark when enough frames are recorded.
+ * \param quest_surface The software quest surface to record.
+ */
+void record_filter_benchmark_frame(const Surface& quest_surface) {
+
+  filter_benchmark_recording.push_back(std::vector<uint32_t>());
+  quest_surface.copy_pixels(filter_benchmark_recording.back());
+
+  if (int(filter_benchmark_recording.size()) >= filter_benchmark_frames) {
+    run_filter_benchmark();
+    filter_benchmark_recording.clear();
+    filter_benchmark_frames = 0;
+  }
+}
+
 };
 
 /**
@@ -222,6 +296,7 @@ void initialize_video_modes() {
  * This method should be called when the program starts.
  * Options recognized:
  *   -no-video
+ *   -headless
  *   -video-acceleration=yes|no
  *   -quest-size=<width>x<height>
  *
@@ -229,9 +304,11 @@ void initialize_video_modes() {
  */
 void Video::initialize(const CommandLine& args) {
 
-  // Check the -no-video and the -quest-size options.
+  // Check the -no-video, -headless, -quest-size and -filter-benchmark options.
   const std::string& quest_size_string = args.get_argument_value("-quest-size");
-  disable_window = args.has_argument("-no-video");
+  const std::string& filter_benchmark_string = args.get_argument_value("-filter-benchmark");
+  disable_window = args.has_argument("-no-video")
+      || args.has_argument("-headless");
 
   wanted_quest_size = Rectangle(0, 0,
       SOLARUS_DEFAULT_QUEST_WIDTH, SOLARUS_DEFAULT_QUEST_HEIGHT);
@@ -242,6 +319,17 @@ void Video::initialize(const CommandLine& args) {
     }
   }
 
+  if (!filter_benchmark_string.empty()) {
+    std::istringstream iss(filter_benchmark_string);
+    int value = 0;
+    if (!(iss >> value) || value < 1) {
+      Debug::error(std::string("Invalid number of frames: '") + filter_benchmark_string + "'");
+    }
+    else {
+      filter_benchmark_frames = value;
+    }
+  }
+
   if (!disable_window) {
     create_window(args);
   }
@@ -550,7 +638,10 @@ const VideoMode* Video::get_video_mode_by_name(
  */
 void Video::render(Surface& quest_surface) {
 
+  SOLARUS_PROFILE(SECTION_VIDEO_RENDER);
+
   if (disable_window) {
+    Surface::finish_frame();
     return;
   }
 
@@ -573,6 +664,9 @@ void Video::render(Surface& quest_surface) {
           "Missing destination surface for scaling");
       quest_surface.apply_pixel_filter(*software_filter, *scaled_surface);
       surface_to_render = scaled_surface;
+      if (filter_benchmark_frames > 0) {
+        record_filter_benchmark_frame(quest_surface);
+      }
     }
     else {
       surface_to_render = &quest_surface;
@@ -584,6 +678,8 @@ void Video::render(Surface& quest_surface) {
     surface_to_render->render(main_renderer);
     SDL_RenderPresent(main_renderer);
   }
+
+  Surface::finish_frame();
 }
 
 /**
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lowlevel/WorkerPool.h"
+#include "lowlevel/Debug.h"
+#include "CommandLine.h"
+#include <algorithm>
+#include <sstream>
+
+namespace solarus {
+
+std::vector<SDL_Thread*> WorkerPool::threads;
+SDL_mutex* WorkerPool::mutex = NULL;
+SDL_cond* WorkerPool::job_added = NULL;
+SDL_cond* WorkerPool::job_executed = NULL;
+std::deque<WorkerPool::Job*> WorkerPool::pending_jobs;
+int WorkerPool::num_jobs_executing = 0;
+bool WorkerPool::quitting = false;
+std::vector<WorkerPool::Job*> WorkerPool::jobs;
+std::deque<WorkerPool::Job*> WorkerPool::urgent_jobs;
+int WorkerPool::num_urgent_jobs_left = 0;
+
+/**
+ * \brief Destructor.
+ */
+WorkerPool::Job::~Job() {
+}
+
+/**
+ * \brief Does the work that has to be done in the main thread.
+ *
+ * This is called by WorkerPool::wait_all() after all jobs are executed.
+ * The default implementation does nothing.
+ */
+void WorkerPool::Job::finish() {
+}
+
+/**
+ * \brief Starts the worker threads.
+ *
+ * The number of workers is given by the -workers=N option.
+ * By default, there is one worker per processor except one.
+ *
+ * \param args Command-line arguments.
+ */
+void WorkerPool::initialize(const CommandLine& args) {
+
+  int num_workers = std::max(SDL_GetCPUCount() - 1, 1);
+  const std::string& num_workers_string = args.get_argument_value("-workers");
+  if (!num_workers_string.empty()) {
+    std::istringstream iss(num_workers_string);
+    int value = 0;
+    if (!(iss >> value) || value < 0) {
+      Debug::error(std::string("Invalid number of workers: '") + num_workers_string + "'");
+    }
+    else {
+      num_workers = value;
+    }
+  }
+
+  mutex = SDL_CreateMutex();
+  job_added = SDL_CreateCond();
+  job_executed = SDL_CreateCond();
+  quitting = false;
+  num_jobs_executing = 0;
+  num_urgent_jobs_left = 0;
+
+  for (int i = 0; i < num_workers; ++i) {
+    SDL_Thread* thread = SDL_CreateThread(run, "worker", NULL);
+    if (thread == NULL) {
+      Debug::error(std::string("Cannot create worker thread: ") + SDL_GetError());
+      break;
+    }
+    threads.push_back(thread);
+  }
+}
+
+/**
+ * \brief Stops the worker threads.
+ *
+ * Jobs not finished yet are executed first.
+ */
+void WorkerPool::quit() {
+
+  wait_all();
+
+  SDL_LockMutex(mutex);
+  quitting = true;
+  SDL_CondBroadcast(job_added);
+  SDL_UnlockMutex(mutex);
+
+  for (unsigned int i = 0; i < threads.size(); ++i) {
+    SDL_WaitThread(threads[i], NULL);
+  }
+  threads.clear();
+
+  SDL_DestroyCond(job_executed);
+  job_executed = NULL;
+  SDL_DestroyCond(job_added);
+  job_added = NULL;
+  SDL_DestroyMutex(mutex);
+  mutex = NULL;
+}
+
+/**
+ * \brief Returns the number of worker threads.
+ * \return The number of workers, or 0 if jobs are executed by the main
+ * thread.
+ */
+int WorkerPool::get_num_workers() {
+  return threads.size();
+}
+
+/**
+ * \brief Adds a job to execute.
+ *
+ * This function must be called from the main thread.
+ *
+ * \param job The job to execute. The pool takes ownership of it
+ * and deletes it after calling its finish() method.
+ */
+void WorkerPool::add_job(Job* job) {
+
+  jobs.push_back(job);
+
+  if (threads.empty()) {
+    job->execute();
+    return;
+  }
+
+  SDL_LockMutex(mutex);
+  pending_jobs.push_back(job);
+  SDL_CondSignal(job_added);
+  SDL_UnlockMutex(mutex);
+}
+
+/**
+ * \brief Waits for all jobs added so far to be executed, then finishes them.
+ *
+ * The finish() method of each job is called by the main thread in the order
+ * jobs were added.
+ */
+void WorkerPool::wait_all() {
+
+  SDL_LockMutex(mutex);
+  while (!pending_jobs.empty() || num_jobs_executing > 0) {
+    SDL_CondWait(job_executed, mutex);
+  }
+  SDL_UnlockMutex(mutex);
+
+  // Swap first because finish() may add new jobs.
+  std::vector<Job*> executed_jobs;
+  executed_jobs.swap(jobs);
+  for (unsigned int i = 0; i < executed_jobs.size(); ++i) {
+    executed_jobs[i]->finish();
+    delete executed_jobs[i];
+  }
+}
+
+/**
+ * \brief Executes jobs in parallel and waits for them.
+ *
+ * Workers execute these jobs before the ones added with add_job(), and the
+ * calling thread executes some of them too, so that it does not depend on
+ * loading jobs in progress.
+ * The finish() method of these jobs is not called.
+ *
+ * This function must be called from the main thread.
+ *
+ * \param jobs The jobs to execute. The pool does not take ownership of them.
+ */
+void WorkerPool::execute_now(const std::vector<Job*>& jobs) {
+
+  if (threads.empty()) {
+    for (unsigned int i = 0; i < jobs.size(); ++i) {
+      jobs[i]->execute();
+    }
+    return;
+  }
+
+  SDL_LockMutex(mutex);
+  urgent_jobs.insert(urgent_jobs.end(), jobs.begin(), jobs.end());
+  num_urgent_jobs_left += jobs.size();
+  SDL_CondBroadcast(job_added);
+
+  while (!urgent_jobs.empty()) {
+    Job* job = urgent_jobs.front();
+    urgent_jobs.pop_front();
+    SDL_UnlockMutex(mutex);
+
+    job->execute();
+
+    SDL_LockMutex(mutex);
+    --num_urgent_jobs_left;
+  }
+
+  while (num_urgent_jobs_left > 0) {
+    SDL_CondWait(job_executed, mutex);
+  }
+  SDL_UnlockMutex(mutex);
+}
+
+/**
+ * \brief Function executed by each worker thread.
+ * \param data Unused.
+ * \return 0.
+ */
+int WorkerPool::run(void* /* data */) {
+
+  SDL_LockMutex(mutex);
+  while (true) {
+
+    while (pending_jobs.empty() && urgent_jobs.empty() && !quitting) {
+      SDL_CondWait(job_added, mutex);
+    }
+    if (quitting) {
+      break;
+    }
+
+    const bool urgent = !urgent_jobs.empty();
+    Job* job = NULL;
+    if (urgent) {
+      job = urgent_jobs.front();
+      urgent_jobs.pop_front();
+    }
+    else {
+      job = pending_jobs.front();
+      pending_jobs.pop_front();
+      ++num_jobs_executing;
+    }
+    SDL_UnlockMutex(mutex);
+
+    job->execute();
+
+    SDL_LockMutex(mutex);
+    if (urgent) {
+      --num_urgent_jobs_left;
+    }
+    else {
+      --num_jobs_executing;
+    }
+    SDL_CondBroadcast(job_executed);
+  }
+  SDL_UnlockMutex(mutex);
+
+  return 0;
+}
+
+}
+
@@ -33,6 +33,9 @@ void LuaContext::register_audio_module() {
       { "set_sound_volume", audio_api_set_sound_volume },
       { "play_sound", audio_api_play_sound },
       { "preload_sounds", audio_api_preload_sounds },
+      { "set_sound_priority", audio_api_set_sound_priority },
+      { "set_sound_max_instances", audio_api_set_sound_max_instances },
+      { "get_sound_statistics", audio_api_get_sound_statistics },
       { "get_music_volume", audio_api_get_music_volume },
       { "set_music_volume", audio_api_set_music_volume },
       { "play_music", audio_api_play_music },
@@ -102,6 +105,69 @@ int LuaContext::audio_api_preload_sounds(lua_State* l) {
   return 0;
 }
 
+/**
+ * \brief Implementation of sol.audio.set_sound_priority().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::audio_api_set_sound_priority(lua_State* l) {
+
+  const std::string& sound_id = luaL_checkstring(l, 1);
+  int priority = luaL_checkint(l, 2);
+
+  if (!Sound::exists(sound_id)) {
+    arg_error(l, 1, StringConcat() << "Cannot find sound '" << sound_id << "'");
+  }
+
+  Sound::set_priority(sound_id, priority);
+
+  return 0;
+}
+
+/**
+ * \brief Implementation of sol.audio.set_sound_max_instances().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::audio_api_set_sound_max_instances(lua_State* l) {
+
+  const std::string& sound_id = luaL_checkstring(l, 1);
+  int max_instances = luaL_checkint(l, 2);
+
+  if (!Sound::exists(sound_id)) {
+    arg_error(l, 1, StringConcat() << "Cannot find sound '" << sound_id << "'");
+  }
+  if (max_instances < 0) {
+    arg_error(l, 2, StringConcat()
+        << "Invalid maximum number of instances: " << max_instances);
+  }
+
+  Sound::set_max_instances(sound_id, max_instances);
+
+  return 0;
+}
+
+/**
+ * \brief Implementation of sol.audio.get_sound_statistics().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::audio_api_get_sound_statistics(lua_State* l) {
+
+  const Sound::VoiceStatistics& statistics = Sound::get_voice_statistics();
+
+  lua_createtable(l, 0, 4);
+  lua_pushinteger(l, statistics.num_voices);
+  lua_setfield(l, -2, "voices");
+  lua_pushinteger(l, statistics.num_active_voices);
+  lua_setfield(l, -2, "active_voices");
+  lua_pushinteger(l, statistics.num_steals);
+  lua_setfield(l, -2, "steals");
+  lua_pushinteger(l, statistics.num_rejected_plays);
+  lua_setfield(l, -2, "rejected");
+  return 1;
+}
+
 /**
  * \brief Implementation of sol.audio.get_music_volume().
  * \param l the Lua context that is calling this function
@@ -199,9 +199,10 @@ int LuaContext::drawable_api_fade_in(lua_State* l) {
     }
   }
 
+  // The surface for transitions is not needed yet: a sprite applies the
+  // opacity of a fade itself and never creates it.
   TransitionFade* transition = new TransitionFade(
-      Transition::TRANSITION_OPENING,
-      drawable.get_transition_surface());
+      Transition::TRANSITION_OPENING);
   transition->set_delay(delay);
   drawable.start_transition(*transition, callback_ref, &get_lua_context(l));
 
@@ -236,8 +237,7 @@ int LuaContext::drawable_api_fade_out(lua_State* l) {
   }
 
   TransitionFade* transition = new TransitionFade(
-      Transition::TRANSITION_CLOSING,
-      drawable.get_transition_surface());
+      Transition::TRANSITION_CLOSING);
   transition->set_delay(delay);
   drawable.start_transition(*transition, callback_ref, &get_lua_context(l));
 
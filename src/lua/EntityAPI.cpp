@@ -2758,7 +2758,7 @@ void LuaContext::entity_on_removed(MapEntity& entity) {
   }
 
   push_entity(l, entity);
-  if (userdata_has_field(entity, "on_removed")) {
+  if (userdata_has_event(entity, EVENT_ON_REMOVED)) {
     on_removed();
   }
   remove_timers(-1);  // Stop timers associated to this entity.
@@ -2777,7 +2777,7 @@ void LuaContext::entity_on_removed(MapEntity& entity) {
 void LuaContext::entity_on_position_changed(
     MapEntity& entity, const Rectangle& xy, Layer layer) {
 
-  if (!userdata_has_field(entity, "on_position_changed")) {
+  if (!userdata_has_event(entity, EVENT_ON_POSITION_CHANGED)) {
     return;
   }
 
@@ -2797,7 +2797,7 @@ void LuaContext::entity_on_position_changed(
 void LuaContext::entity_on_obstacle_reached(
     MapEntity& entity, Movement& movement) {
 
-  if (!userdata_has_field(entity, "on_obstacle_reached")) {
+  if (!userdata_has_event(entity, EVENT_ON_OBSTACLE_REACHED)) {
     return;
   }
 
@@ -2817,7 +2817,7 @@ void LuaContext::entity_on_obstacle_reached(
 void LuaContext::entity_on_movement_changed(
     MapEntity& entity, Movement& movement) {
 
-  if (!userdata_has_field(entity, "on_movement_changed")) {
+  if (!userdata_has_event(entity, EVENT_ON_MOVEMENT_CHANGED)) {
     return;
   }
 
@@ -2835,7 +2835,7 @@ void LuaContext::entity_on_movement_changed(
  */
 void LuaContext::entity_on_movement_finished(MapEntity& entity) {
 
-  if (!userdata_has_field(entity, "on_movement_finished")) {
+  if (!userdata_has_event(entity, EVENT_ON_MOVEMENT_FINISHED)) {
     return;
   }
 
@@ -2855,7 +2855,7 @@ void LuaContext::entity_on_movement_finished(MapEntity& entity) {
 void LuaContext::hero_on_state_changed(
     Hero& hero, const std::string& state_name) {
 
-  if (!userdata_has_field(hero, "on_state_changed")) {
+  if (!userdata_has_event(hero, EVENT_ON_STATE_CHANGED)) {
     return;
   }
 
@@ -2873,7 +2873,7 @@ void LuaContext::hero_on_state_changed(
  */
 void LuaContext::npc_on_interaction(NPC& npc) {
 
-  if (!userdata_has_field(npc, "on_interaction")) {
+  if (!userdata_has_event(npc, EVENT_ON_INTERACTION)) {
     return;
   }
 
@@ -2893,7 +2893,7 @@ void LuaContext::npc_on_interaction(NPC& npc) {
  */
 bool LuaContext::npc_on_interaction_item(NPC& npc, EquipmentItem& item_used) {
 
-  if (!userdata_has_field(npc, "on_interaction_item")) {
+  if (!userdata_has_event(npc, EVENT_ON_INTERACTION_ITEM)) {
     return false;
   }
 
@@ -2912,7 +2912,7 @@ bool LuaContext::npc_on_interaction_item(NPC& npc, EquipmentItem& item_used) {
  */
 void LuaContext::npc_on_collision_fire(NPC& npc) {
 
-  if (!userdata_has_field(npc, "on_collision_fire")) {
+  if (!userdata_has_event(npc, EVENT_ON_COLLISION_FIRE)) {
     return;
   }
 
@@ -2930,7 +2930,7 @@ void LuaContext::npc_on_collision_fire(NPC& npc) {
  */
 void LuaContext::block_on_moving(Block& block) {
 
-  if (!userdata_has_field(block, "on_moving")) {
+  if (!userdata_has_event(block, EVENT_ON_MOVING)) {
     return;
   }
 
@@ -2948,7 +2948,7 @@ void LuaContext::block_on_moving(Block& block) {
  */
 void LuaContext::block_on_moved(Block& block) {
 
-  if (!userdata_has_field(block, "on_moved")) {
+  if (!userdata_has_event(block, EVENT_ON_MOVED)) {
     return;
   }
 
@@ -2967,7 +2967,7 @@ void LuaContext::block_on_moved(Block& block) {
  */
 bool LuaContext::chest_on_empty(Chest& chest) {
 
-  if (!userdata_has_field(chest, "on_empty")) {
+  if (!userdata_has_event(chest, EVENT_ON_EMPTY)) {
     return false;
   }
 
@@ -2986,7 +2986,7 @@ bool LuaContext::chest_on_empty(Chest& chest) {
  */
 void LuaContext::switch_on_activated(Switch& sw) {
 
-  if (!userdata_has_field(sw, "on_activated")) {
+  if (!userdata_has_event(sw, EVENT_ON_ACTIVATED)) {
     return;
   }
 
@@ -3004,7 +3004,7 @@ void LuaContext::switch_on_activated(Switch& sw) {
  */
 void LuaContext::switch_on_inactivated(Switch& sw) {
 
-  if (!userdata_has_field(sw, "on_inactivated")) {
+  if (!userdata_has_event(sw, EVENT_ON_INACTIVATED)) {
     return;
   }
 
@@ -3022,7 +3022,7 @@ void LuaContext::switch_on_inactivated(Switch& sw) {
  */
 void LuaContext::switch_on_left(Switch& sw) {
 
-  if (!userdata_has_field(sw, "on_left")) {
+  if (!userdata_has_event(sw, EVENT_ON_LEFT)) {
     return;
   }
 
@@ -3040,7 +3040,7 @@ void LuaContext::switch_on_left(Switch& sw) {
  */
 void LuaContext::sensor_on_activated(Sensor& sensor) {
 
-  if (!userdata_has_field(sensor, "on_activated")) {
+  if (!userdata_has_event(sensor, EVENT_ON_ACTIVATED)) {
     return;
   }
 
@@ -3058,7 +3058,7 @@ void LuaContext::sensor_on_activated(Sensor& sensor) {
  */
 void LuaContext::sensor_on_activated_repeat(Sensor& sensor) {
 
-  if (!userdata_has_field(sensor, "on_activated_repeat")) {
+  if (!userdata_has_event(sensor, EVENT_ON_ACTIVATED_REPEAT)) {
     return;
   }
 
@@ -3073,7 +3073,7 @@ void LuaContext::sensor_on_activated_repeat(Sensor& sensor) {
  */
 void LuaContext::sensor_on_left(Sensor& sensor) {
 
-  if (!userdata_has_field(sensor, "on_left")) {
+  if (!userdata_has_event(sensor, EVENT_ON_LEFT)) {
     return;
   }
 
@@ -3091,7 +3091,7 @@ void LuaContext::sensor_on_left(Sensor& sensor) {
  */
 void LuaContext::sensor_on_collision_explosion(Sensor& sensor) {
 
-  if (!userdata_has_field(sensor, "on_collision_explosion")) {
+  if (!userdata_has_event(sensor, EVENT_ON_COLLISION_EXPLOSION)) {
     return;
   }
 
@@ -3110,7 +3110,7 @@ void LuaContext::sensor_on_collision_explosion(Sensor& sensor) {
  */
 void LuaContext::separator_on_activating(Separator& separator, int direction4) {
 
-  if (!userdata_has_field(separator, "on_activating")) {
+  if (!userdata_has_event(separator, EVENT_ON_ACTIVATING)) {
     return;
   }
 
@@ -3129,7 +3129,7 @@ void LuaContext::separator_on_activating(Separator& separator, int direction4) {
  */
 void LuaContext::separator_on_activated(Separator& separator, int direction4) {
 
-  if (!userdata_has_field(separator, "on_activated")) {
+  if (!userdata_has_event(separator, EVENT_ON_ACTIVATED)) {
     return;
   }
 
@@ -3147,7 +3147,7 @@ void LuaContext::separator_on_activated(Separator& separator, int direction4) {
  */
 void LuaContext::door_on_opened(Door& door) {
 
-  if (!userdata_has_field(door, "on_opened")) {
+  if (!userdata_has_event(door, EVENT_ON_OPENED)) {
     return;
   }
 
@@ -3165,7 +3165,7 @@ void LuaContext::door_on_opened(Door& door) {
  */
 void LuaContext::door_on_closed(Door& door) {
 
-  if (!userdata_has_field(door, "on_closed")) {
+  if (!userdata_has_event(door, EVENT_ON_CLOSED)) {
     return;
   }
 
@@ -3184,7 +3184,7 @@ void LuaContext::door_on_closed(Door& door) {
  */
 bool LuaContext::shop_treasure_on_buying(ShopTreasure& shop_treasure) {
 
-  if (!userdata_has_field(shop_treasure, "on_buying")) {
+  if (!userdata_has_event(shop_treasure, EVENT_ON_BUYING)) {
     return true;
   }
 
@@ -3203,7 +3203,7 @@ bool LuaContext::shop_treasure_on_buying(ShopTreasure& shop_treasure) {
  */
 void LuaContext::shop_treasure_on_bought(ShopTreasure& shop_treasure) {
 
-  if (!userdata_has_field(shop_treasure, "on_bought")) {
+  if (!userdata_has_event(shop_treasure, EVENT_ON_BOUGHT)) {
     return;
   }
 
@@ -3221,10 +3221,7 @@ void LuaContext::shop_treasure_on_bought(ShopTreasure& shop_treasure) {
  */
 void LuaContext::enemy_on_update(Enemy& enemy) {
 
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (!userdata_has_field(enemy, method_name)) {
+  if (!userdata_has_event(enemy, EVENT_ON_UPDATE)) {
     return;
   }
 
@@ -3243,7 +3240,7 @@ void LuaContext::enemy_on_update(Enemy& enemy) {
  */
 void LuaContext::enemy_on_suspended(Enemy& enemy, bool suspended) {
 
-  if (!userdata_has_field(enemy, "on_suspended")) {
+  if (!userdata_has_event(enemy, EVENT_ON_SUSPENDED)) {
     return;
   }
 
@@ -3261,7 +3258,7 @@ void LuaContext::enemy_on_suspended(Enemy& enemy, bool suspended) {
  */
 void LuaContext::enemy_on_created(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_created")) {
+  if (!userdata_has_event(enemy, EVENT_ON_CREATED)) {
     return;
   }
 
@@ -3279,7 +3276,7 @@ void LuaContext::enemy_on_created(Enemy& enemy) {
  */
 void LuaContext::enemy_on_enabled(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_enabled")) {
+  if (!userdata_has_event(enemy, EVENT_ON_ENABLED)) {
     return;
   }
 
@@ -3297,7 +3294,7 @@ void LuaContext::enemy_on_enabled(Enemy& enemy) {
  */
 void LuaContext::enemy_on_disabled(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_disabled")) {
+  if (!userdata_has_event(enemy, EVENT_ON_DISABLED)) {
     return;
   }
 
@@ -3321,7 +3318,7 @@ void LuaContext::enemy_on_restarted(Enemy& enemy) {
 
   push_enemy(l, enemy);
   remove_timers(-1);  // Stop timers associated to this enemy.
-  if (userdata_has_field(enemy, "on_restarted")) {
+  if (userdata_has_event(enemy, EVENT_ON_RESTARTED)) {
     on_restarted();
   }
   lua_pop(l, 1);
@@ -3336,7 +3333,7 @@ void LuaContext::enemy_on_restarted(Enemy& enemy) {
  */
 void LuaContext::enemy_on_pre_draw(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_pre_draw")) {
+  if (!userdata_has_event(enemy, EVENT_ON_PRE_DRAW)) {
     return;
   }
 
@@ -3354,7 +3351,7 @@ void LuaContext::enemy_on_pre_draw(Enemy& enemy) {
  */
 void LuaContext::enemy_on_post_draw(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_post_draw")) {
+  if (!userdata_has_event(enemy, EVENT_ON_POST_DRAW)) {
     return;
   }
 
@@ -3376,7 +3373,7 @@ void LuaContext::enemy_on_post_draw(Enemy& enemy) {
 void LuaContext::enemy_on_collision_enemy(Enemy& enemy,
     Enemy& other_enemy, Sprite& other_sprite, Sprite& this_sprite) {
 
-  if (!userdata_has_field(enemy, "on_collision_enemy")) {
+  if (!userdata_has_event(enemy, EVENT_ON_COLLISION_ENEMY)) {
     return;
   }
 
@@ -3397,7 +3394,7 @@ void LuaContext::enemy_on_collision_enemy(Enemy& enemy,
 void LuaContext::enemy_on_custom_attack_received(Enemy& enemy,
     EnemyAttack attack, Sprite* sprite) {
 
-  if (!userdata_has_field(enemy, "on_custom_attack_received")) {
+  if (!userdata_has_event(enemy, EVENT_ON_CUSTOM_ATTACK_RECEIVED)) {
     return;
   }
 
@@ -3423,7 +3420,7 @@ void LuaContext::enemy_on_hurt(Enemy& enemy, EnemyAttack attack, int life_lost)
 
   push_enemy(l, enemy);
   remove_timers(-1);  // Stop timers associated to this enemy.
-  if (userdata_has_field(enemy, "on_hurt")) {
+  if (userdata_has_event(enemy, EVENT_ON_HURT)) {
     on_hurt(attack, life_lost);
   }
   lua_pop(l, 1);
@@ -3444,7 +3441,7 @@ void LuaContext::enemy_on_dying(Enemy& enemy) {
 
   push_enemy(l, enemy);
   remove_timers(-1);  // Stop timers associated to this enemy.
-  if (userdata_has_field(enemy, "on_dying")) {
+  if (userdata_has_event(enemy, EVENT_ON_DYING)) {
     on_dying();
   }
   lua_pop(l, 1);
@@ -3459,7 +3456,7 @@ void LuaContext::enemy_on_dying(Enemy& enemy) {
  */
 void LuaContext::enemy_on_dead(Enemy& enemy) {
 
-  if (!userdata_has_field(enemy, "on_dead")) {
+  if (!userdata_has_event(enemy, EVENT_ON_DEAD)) {
     return;
   }
 
@@ -3483,7 +3480,7 @@ void LuaContext::enemy_on_immobilized(Enemy& enemy) {
 
   push_enemy(l, enemy);
   remove_timers(-1);  // Stop timers associated to this enemy.
-  if (userdata_has_field(enemy, "on_immobilized")) {
+  if (userdata_has_event(enemy, EVENT_ON_IMMOBILIZED)) {
     on_immobilized();
   }
   lua_pop(l, 1);
@@ -17,6 +17,7 @@
 #include "lua/ExportableToLua.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include <lua.hpp>
 
 namespace solarus {
 
@@ -26,7 +27,8 @@ namespace solarus {
 ExportableToLua::ExportableToLua():
   RefCountable(),
   known_to_lua(false),
-  with_lua_table(false) {
+  with_lua_table(false),
+  lua_userdata_ref(LUA_NOREF) {
 
 }
 
@@ -77,5 +79,53 @@ void ExportableToLua::set_with_lua_table(bool with_lua_table) {
   this->with_lua_table = with_lua_table;
 }
 
+/**
+ * \brief Returns the index of the Lua userdata of this object in the table
+ * of all userdata.
+ *
+ * This allows to push an existing userdata quickly.
+ * The userdata at this index must be checked: if it was collected,
+ * the index may now be used by another object.
+ *
+ * \return The index of the userdata, or LUA_NOREF if it was never created.
+ */
+int ExportableToLua::get_lua_userdata_ref() const {
+  return lua_userdata_ref;
+}
+
+/**
+ * \brief Sets the index of the Lua userdata of this object in the table
+ * of all userdata.
+ * \param lua_userdata_ref The index of the userdata.
+ */
+void ExportableToLua::set_lua_userdata_ref(int lua_userdata_ref) {
+  this->lua_userdata_ref = lua_userdata_ref;
+}
+
+/**
+ * \brief Returns whether a field with the name of an event is set on this
+ * userdata.
+ *
+ * This is only for performance, to avoid Lua lookups for callbacks that are
+ * not defined.
+ *
+ * \param event Index of an event in LuaContext.
+ * \return \c true if a field with this name exists in the userdata table.
+ */
+bool ExportableToLua::has_lua_event(int event) const {
+  return lua_events[event];
+}
+
+/**
+ * \brief Sets whether a field with the name of an event is set on this
+ * userdata.
+ * \param event Index of an event in LuaContext.
+ * \param defined \c true if a field with this name now exists in the
+ * userdata table.
+ */
+void ExportableToLua::set_lua_event(int event, bool defined) {
+  lua_events[event] = defined;
+}
+
 }
 
@@ -1345,7 +1345,7 @@ int LuaContext::game_api_get_commands_direction(lua_State* l) {
  */
 void LuaContext::game_on_started(Game& game) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_started")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_STARTED)) {
     return;
   }
 
@@ -1368,7 +1368,7 @@ void LuaContext::game_on_finished(Game& game) {
   }
 
   push_game(l, game.get_savegame());
-  if (userdata_has_field(game.get_savegame(), "on_finished")) {
+  if (userdata_has_event(game.get_savegame(), EVENT_ON_FINISHED)) {
     on_finished();
   }
   remove_timers(-1);  // Stop timers and menus associated to this game.
@@ -1390,10 +1390,7 @@ void LuaContext::game_on_update(Game& game) {
   }
 
   push_game(l, game.get_savegame());
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (userdata_has_field(game.get_savegame(), method_name)) {
+  if (userdata_has_event(game.get_savegame(), EVENT_ON_UPDATE)) {
     on_update();
   }
   menus_on_update(-1);
@@ -1415,7 +1412,7 @@ void LuaContext::game_on_draw(Game& game, Surface& dst_surface) {
   }
 
   push_game(l, game.get_savegame());
-  if (userdata_has_field(game.get_savegame(), "on_draw")) {
+  if (userdata_has_event(game.get_savegame(), EVENT_ON_DRAW)) {
     on_draw(dst_surface);
   }
   menus_on_draw(-1, dst_surface);
@@ -1432,7 +1429,7 @@ void LuaContext::game_on_draw(Game& game, Surface& dst_surface) {
  */
 void LuaContext::game_on_map_changed(Game& game, Map& map) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_map_changed")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_MAP_CHANGED)) {
     return;
   }
 
@@ -1450,7 +1447,7 @@ void LuaContext::game_on_map_changed(Game& game, Map& map) {
  */
 void LuaContext::game_on_paused(Game& game) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_paused")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_PAUSED)) {
     return;
   }
 
@@ -1468,7 +1465,7 @@ void LuaContext::game_on_paused(Game& game) {
  */
 void LuaContext::game_on_unpaused(Game& game) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_unpaused")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_UNPAUSED)) {
     return;
   }
 
@@ -1491,7 +1488,7 @@ void LuaContext::game_on_unpaused(Game& game) {
 bool LuaContext::game_on_dialog_started(Game& game,
     const Dialog& dialog, int info_ref) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_dialog_started")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_DIALOG_STARTED)) {
     return false;
   }
 
@@ -1513,7 +1510,7 @@ bool LuaContext::game_on_dialog_started(Game& game,
 void LuaContext::game_on_dialog_finished(Game& game,
     const Dialog& dialog) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_dialog_finished")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_DIALOG_FINISHED)) {
     return;
   }
 
@@ -1532,7 +1529,7 @@ void LuaContext::game_on_dialog_finished(Game& game,
  */
 bool LuaContext::game_on_game_over_started(Game& game) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_game_over_started")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_GAME_OVER_STARTED)) {
     return false;
   }
 
@@ -1552,7 +1549,7 @@ bool LuaContext::game_on_game_over_started(Game& game) {
  */
 void LuaContext::game_on_game_over_finished(Game& game) {
 
-  if (!userdata_has_field(game.get_savegame(), "on_game_over_finished")) {
+  if (!userdata_has_event(game.get_savegame(), EVENT_ON_GAME_OVER_FINISHED)) {
     return;
   }
 
@@ -1608,7 +1605,7 @@ bool LuaContext::game_on_command_pressed(Game& game, GameCommands::Command comma
 
   bool handled = false;
   push_game(l, game.get_savegame());
-  if (userdata_has_field(game.get_savegame(), "on_command_pressed")) {
+  if (userdata_has_event(game.get_savegame(), EVENT_ON_COMMAND_PRESSED)) {
     handled = on_command_pressed(command);
   }
   if (!handled) {
@@ -1636,7 +1633,7 @@ bool LuaContext::game_on_command_released(Game& game, GameCommands::Command comm
 
   bool handled = false;
   push_game(l, game.get_savegame());
-  if (userdata_has_field(game.get_savegame(), "on_command_released")) {
+  if (userdata_has_event(game.get_savegame(), EVENT_ON_COMMAND_RELEASED)) {
     handled = on_command_released(command);
   }
   if (!handled) {
@@ -698,7 +698,7 @@ int LuaContext::item_api_set_finished(lua_State* l) {
  */
 void LuaContext::item_on_started(EquipmentItem& item) {
 
-  if (!userdata_has_field(item, "on_started")) {
+  if (!userdata_has_event(item, EVENT_ON_STARTED)) {
     return;
   }
 
@@ -721,7 +721,7 @@ void LuaContext::item_on_finished(EquipmentItem& item) {
   }
 
   push_item(l, item);
-  if (userdata_has_field(item, "on_finished")) {
+  if (userdata_has_event(item, EVENT_ON_FINISHED)) {
     on_finished();
   }
   remove_timers(-1);  // Stop timers and menus associated to this item.
@@ -738,10 +738,7 @@ void LuaContext::item_on_finished(EquipmentItem& item) {
  */
 void LuaContext::item_on_update(EquipmentItem& item) {
 
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (!userdata_has_field(item, method_name)) {
+  if (!userdata_has_event(item, EVENT_ON_UPDATE)) {
     return;
   }
 
@@ -760,7 +757,7 @@ void LuaContext::item_on_update(EquipmentItem& item) {
  */
 void LuaContext::item_on_suspended(EquipmentItem& item, bool suspended) {
 
-  if (!userdata_has_field(item, "on_suspended")) {
+  if (!userdata_has_event(item, EVENT_ON_SUSPENDED)) {
     return;
   }
 
@@ -778,7 +775,7 @@ void LuaContext::item_on_suspended(EquipmentItem& item, bool suspended) {
  */
 void LuaContext::item_on_created(EquipmentItem& item) {
 
-  if (!userdata_has_field(item, "on_created")) {
+  if (!userdata_has_event(item, EVENT_ON_CREATED)) {
     return;
   }
 
@@ -797,7 +794,7 @@ void LuaContext::item_on_created(EquipmentItem& item) {
  */
 void LuaContext::item_on_map_changed(EquipmentItem& item, Map& map) {
 
-  if (!userdata_has_field(item, "on_map_changed")) {
+  if (!userdata_has_event(item, EVENT_ON_MAP_CHANGED)) {
     return;
   }
 
@@ -817,7 +814,7 @@ void LuaContext::item_on_map_changed(EquipmentItem& item, Map& map) {
 void LuaContext::item_on_pickable_created(EquipmentItem& item,
     Pickable& pickable) {
 
-  if (!userdata_has_field(item, "on_pickable_created")) {
+  if (!userdata_has_event(item, EVENT_ON_PICKABLE_CREATED)) {
     return;
   }
 
@@ -838,7 +835,7 @@ void LuaContext::item_on_pickable_created(EquipmentItem& item,
 void LuaContext::item_on_pickable_movement_changed(EquipmentItem& item,
     Pickable& pickable, Movement& movement) {
 
-  if (!userdata_has_field(item, "on_pickable_movement_changed")) {
+  if (!userdata_has_event(item, EVENT_ON_PICKABLE_MOVEMENT_CHANGED)) {
     return;
   }
 
@@ -857,7 +854,7 @@ void LuaContext::item_on_pickable_movement_changed(EquipmentItem& item,
  */
 void LuaContext::item_on_obtaining(EquipmentItem& item, const Treasure& treasure) {
 
-  if (!userdata_has_field(item, "on_obtaining")) {
+  if (!userdata_has_event(item, EVENT_ON_OBTAINING)) {
     return;
   }
 
@@ -876,7 +873,7 @@ void LuaContext::item_on_obtaining(EquipmentItem& item, const Treasure& treasure
  */
 void LuaContext::item_on_obtained(EquipmentItem& item, const Treasure& treasure) {
 
-  if (!userdata_has_field(item, "on_obtained")) {
+  if (!userdata_has_event(item, EVENT_ON_OBTAINED)) {
     return;
   }
 
@@ -895,7 +892,7 @@ void LuaContext::item_on_obtained(EquipmentItem& item, const Treasure& treasure)
  */
 void LuaContext::item_on_variant_changed(EquipmentItem& item, int variant) {
 
-  if (!userdata_has_field(item, "on_variant_changed")) {
+  if (!userdata_has_event(item, EVENT_ON_VARIANT_CHANGED)) {
     return;
   }
 
@@ -914,7 +911,7 @@ void LuaContext::item_on_variant_changed(EquipmentItem& item, int variant) {
  */
 void LuaContext::item_on_amount_changed(EquipmentItem& item, int amount) {
 
-  if (!userdata_has_field(item, "on_amount_changed")) {
+  if (!userdata_has_event(item, EVENT_ON_AMOUNT_CHANGED)) {
     return;
   }
 
@@ -932,7 +929,7 @@ void LuaContext::item_on_amount_changed(EquipmentItem& item, int amount) {
  */
 void LuaContext::item_on_using(EquipmentItem& item) {
 
-  if (!userdata_has_field(item, "on_using")) {
+  if (!userdata_has_event(item, EVENT_ON_USING)) {
     return;
   }
 
@@ -951,7 +948,7 @@ void LuaContext::item_on_using(EquipmentItem& item) {
  */
 void LuaContext::item_on_ability_used(EquipmentItem& item, const std::string& ability_name) {
 
-  if (!userdata_has_field(item, "on_ability_used")) {
+  if (!userdata_has_event(item, EVENT_ON_ABILITY_USED)) {
     return;
   }
 
@@ -970,7 +967,7 @@ void LuaContext::item_on_ability_used(EquipmentItem& item, const std::string& ab
  */
 void LuaContext::item_on_npc_interaction(EquipmentItem& item, NPC& npc) {
 
-  if (!userdata_has_field(item, "on_npc_interaction")) {
+  if (!userdata_has_event(item, EVENT_ON_NPC_INTERACTION)) {
     return;
   }
 
@@ -992,7 +989,7 @@ void LuaContext::item_on_npc_interaction(EquipmentItem& item, NPC& npc) {
 bool LuaContext::item_on_npc_interaction_item(EquipmentItem& item, NPC& npc,
     EquipmentItem& item_used) {
 
-  if (!userdata_has_field(item, "on_npc_interaction_item")) {
+  if (!userdata_has_event(item, EVENT_ON_NPC_INTERACTION_ITEM)) {
     return false;
   }
 
@@ -1012,7 +1009,7 @@ bool LuaContext::item_on_npc_interaction_item(EquipmentItem& item, NPC& npc,
  */
 void LuaContext::item_on_npc_collision_fire(EquipmentItem& item, NPC& npc) {
 
-  if (!userdata_has_field(item, "on_npc_collision_fire")) {
+  if (!userdata_has_event(item, EVENT_ON_NPC_COLLISION_FIRE)) {
     return;
   }
 
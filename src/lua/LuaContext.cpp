@@ -28,6 +28,7 @@
 #include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
+#include "lowlevel/Profiler.h"
 #include "EquipmentItem.h"
 #include "Treasure.h"
 #include "Map.h"
@@ -38,6 +39,79 @@
 namespace solarus {
 
 std::map<lua_State*, LuaContext*> LuaContext::lua_contexts;
+int LuaContext::all_userdata_ref = LUA_NOREF;
+
+const std::string LuaContext::userdata_event_names[] = {
+  "on_ability_used",
+  "on_activated",
+  "on_activated_repeat",
+  "on_activating",
+  "on_amount_changed",
+  "on_animation_changed",
+  "on_animation_finished",
+  "on_bought",
+  "on_buying",
+  "on_camera_back",
+  "on_changed",
+  "on_closed",
+  "on_collision_enemy",
+  "on_collision_explosion",
+  "on_collision_fire",
+  "on_command_pressed",
+  "on_command_released",
+  "on_created",
+  "on_custom_attack_received",
+  "on_dead",
+  "on_dialog_finished",
+  "on_dialog_started",
+  "on_direction_changed",
+  "on_disabled",
+  "on_draw",
+  "on_dying",
+  "on_empty",
+  "on_enabled",
+  "on_finished",
+  "on_frame_changed",
+  "on_game_over_finished",
+  "on_game_over_started",
+  "on_hurt",
+  "on_immobilized",
+  "on_inactivated",
+  "on_interaction",
+  "on_interaction_item",
+  "on_left",
+  "on_map_changed",
+  "on_moved",
+  "on_movement_changed",
+  "on_movement_finished",
+  "on_moving",
+  "on_npc_collision_fire",
+  "on_npc_interaction",
+  "on_npc_interaction_item",
+  "on_obstacle_reached",
+  "on_obtained",
+  "on_obtained_treasure",
+  "on_obtaining",
+  "on_obtaining_treasure",
+  "on_opened",
+  "on_opening_transition_finished",
+  "on_paused",
+  "on_pickable_created",
+  "on_pickable_movement_changed",
+  "on_position_changed",
+  "on_post_draw",
+  "on_pre_draw",
+  "on_removed",
+  "on_restarted",
+  "on_started",
+  "on_state_changed",
+  "on_suspended",
+  "on_unpaused",
+  "on_update",
+  "on_using",
+  "on_variant_changed",
+  ""  // Sentinel.
+};
 
 /**
  * \brief Creates a Lua context.
@@ -45,7 +119,8 @@ std::map<lua_State*, LuaContext*> LuaContext::lua_contexts;
  */
 LuaContext::LuaContext(MainLoop& main_loop):
   l(NULL),
-  main_loop(main_loop) {
+  main_loop(main_loop),
+  next_timer_schedule_id(1) {
 
 }
 
@@ -102,6 +177,8 @@ void LuaContext::initialize() {
   lua_contexts[l] = this;
 
   // Create a table that will keep track of all userdata.
+  // Each userdata is stored at the index given by
+  // ExportableToLua::get_lua_userdata_ref().
                                   // --
   lua_newtable(l);
                                   // all_udata
@@ -113,7 +190,7 @@ void LuaContext::initialize() {
                                   // all_udata meta
   lua_setmetatable(l, -2);
                                   // all_udata
-  lua_setfield(l, LUA_REGISTRYINDEX, "sol.all_userdata");
+  all_userdata_ref = luaL_ref(l, LUA_REGISTRYINDEX);
                                   // --
 
   // Allow userdata to be indexable if they want.
@@ -181,6 +258,8 @@ void LuaContext::exit() {
  */
 void LuaContext::update() {
 
+  SOLARUS_PROFILE(SECTION_LUA_UPDATE);
+
   update_drawables();
   update_movements();
   update_menus();
@@ -818,6 +897,48 @@ bool LuaContext::userdata_has_field(ExportableToLua& userdata,
   return it->second.find(key) != it->second.end();
 }
 
+/**
+ * \brief Returns whether a userdata has an event callback defined.
+ *
+ * This is equivalent to userdata_has_field() with the name of the event,
+ * but much faster: this function is called for each entity at each cycle.
+ *
+ * \param userdata A userdata.
+ * \param event The event to test.
+ * \return \c true if a field with the name of this event exists on the
+ * userdata.
+ */
+bool LuaContext::userdata_has_event(ExportableToLua& userdata,
+    UserdataEvent event) const {
+
+  return userdata.has_lua_event(event);
+}
+
+/**
+ * \brief Returns the event whose callback has the specified name.
+ * \param key Name of a field of a userdata.
+ * \return The corresponding event, or EVENT_NB if this is not the name of
+ * an event.
+ */
+LuaContext::UserdataEvent LuaContext::get_userdata_event(const char* key) {
+
+  static std::map<std::string, UserdataEvent> events;
+  if (events.empty()) {
+    Debug::check_assertion(EVENT_NB <= ExportableToLua::max_lua_events,
+        "Too many userdata events");
+    for (int i = 0; i < EVENT_NB; ++i) {
+      events[userdata_event_names[i]] = UserdataEvent(i);
+    }
+  }
+
+  const std::map<std::string, UserdataEvent>::const_iterator it =
+      events.find(key);
+  if (it == events.end()) {
+    return EVENT_NB;
+  }
+  return it->second;
+}
+
 /**
  * \brief Gets a method of the object on top of the stack.
  *
@@ -1218,65 +1339,62 @@ void LuaContext::push_string(lua_State* l, const std::string& text) {
 void LuaContext::push_userdata(lua_State* l, ExportableToLua& userdata) {
 
   // See if this userdata already exists.
-  lua_getfield(l, LUA_REGISTRYINDEX, "sol.all_userdata");
+  lua_rawgeti(l, LUA_REGISTRYINDEX, all_userdata_ref);
                                   // ... all_udata
-  lua_pushlightuserdata(l, &userdata);
-                                  // ... all_udata lightudata
-  lua_gettable(l, -2);
+  const int userdata_ref = userdata.get_lua_userdata_ref();
+  if (userdata_ref != LUA_NOREF) {
+    lua_rawgeti(l, -1, userdata_ref);
                                   // ... all_udata udata/nil
-  if (!lua_isnil(l, -1)) {
+    // The slot may have been collected and reused by another userdata.
+    if (lua_isuserdata(l, -1) &&
+        *(static_cast<ExportableToLua**>(lua_touserdata(l, -1))) == &userdata) {
                                   // ... all_udata udata
-    lua_remove(l, -2);
+      lua_remove(l, -2);
                                   // ... udata
-  }
-  else {
-    // Create a new userdata.
-
-    if (!userdata.is_known_to_lua()) {
-      // This is the first time we create a Lua userdata for this object.
-      userdata.set_known_to_lua(true);
+      return;
     }
-
-                                  // ... all_udata nil
     lua_pop(l, 1);
                                   // ... all_udata
-    lua_pushlightuserdata(l, &userdata);
-                                  // ... all_udata lightudata
-    RefCountable::ref(&userdata);
-    ExportableToLua** block_address = static_cast<ExportableToLua**>(
-        lua_newuserdata(l, sizeof(ExportableToLua*)));
-    *block_address = &userdata;
-                                  // ... all_udata lightudata udata
-    luaL_getmetatable(l, userdata.get_lua_type_name().c_str());
-                                  // ... all_udata lightudata udata mt
+  }
+
+  // Create a new userdata.
+  if (!userdata.is_known_to_lua()) {
+    // This is the first time we create a Lua userdata for this object.
+    userdata.set_known_to_lua(true);
+  }
+
+  RefCountable::ref(&userdata);
+  ExportableToLua** block_address = static_cast<ExportableToLua**>(
+      lua_newuserdata(l, sizeof(ExportableToLua*)));
+  *block_address = &userdata;
+                                  // ... all_udata udata
+  luaL_getmetatable(l, userdata.get_lua_type_name().c_str());
+                                  // ... all_udata udata mt
 
 #ifndef NDEBUG
-    Debug::check_assertion(!lua_isnil(l, -1),
-        std::string("Userdata of type '" + userdata.get_lua_type_name()
-        + "' has no metatable, this is a memory leak"));
-
-    lua_getfield(l, -1, "__gc");
-                                  // ... all_udata lightudata udata mt gc
-    Debug::check_assertion(lua_isfunction(l, -1),
-        std::string("Userdata of type '") + userdata.get_lua_type_name()
-        + "' must have the __gc function LuaContext::userdata_meta_gc");
-                                  // ... all_udata lightudata udata mt gc
-    lua_pop(l, 1);
-                                  // ... all_udata lightudata udata mt
+  Debug::check_assertion(!lua_isnil(l, -1),
+      std::string("Userdata of type '" + userdata.get_lua_type_name()
+      + "' has no metatable, this is a memory leak"));
+
+  lua_getfield(l, -1, "__gc");
+                                  // ... all_udata udata mt gc
+  Debug::check_assertion(lua_isfunction(l, -1),
+      std::string("Userdata of type '") + userdata.get_lua_type_name()
+      + "' must have the __gc function LuaContext::userdata_meta_gc");
+                                  // ... all_udata udata mt gc
+  lua_pop(l, 1);
+                                  // ... all_udata udata mt
 #endif
 
-    lua_setmetatable(l, -2);
-                                  // ... all_udata lightudata udata
-    // Keep track of our new userdata.
-    lua_pushvalue(l, -1);
-                                  // ... all_udata lightudata udata udata
-    lua_insert(l, -4);
-                                  // ... udata all_udata lightudata udata
-    lua_settable(l, -3);
-                                  // ... udata all_udata
-    lua_pop(l, 1);
+  lua_setmetatable(l, -2);
+                                  // ... all_udata udata
+  // Keep track of our new userdata.
+  lua_pushvalue(l, -1);
+                                  // ... all_udata udata udata
+  userdata.set_lua_userdata_ref(luaL_ref(l, -3));
+                                  // ... all_udata udata
+  lua_remove(l, -2);
                                   // ... udata
-  }
 }
 
 /**
@@ -1413,9 +1531,10 @@ int LuaContext::userdata_meta_gc(lua_State* l) {
   // The full userdata is destroyed, but if the refcount is zero, the light
   // userdata and its table persist.
 
-  // We don't need to remove the entry from sol.all_userdata
+  // We don't need to remove the entry from the table of all userdata
   // because it is already done: that table is weak on its values and the
   // value was the full userdata.
+  // The ref kept by the object becomes obsolete, push_userdata() detects it.
 
   userdata->decrement_refcount();
   if (userdata->get_refcount() == 0) {
@@ -1497,13 +1616,21 @@ int LuaContext::userdata_meta_newindex_as_table(lua_State* l) {
                                   // ... udata_tables udata_table
 
   if (lua_isstring(l, 2)) {
-    if (!lua_isnil(l, 3)) {
+    const char* key = lua_tostring(l, 2);
+    const bool defined = !lua_isnil(l, 3);
+    if (defined) {
       // Add the key to the list of existing strings keys on this userdata.
-      get_lua_context(l).userdata_fields[userdata].insert(lua_tostring(l, 2));
+      get_lua_context(l).userdata_fields[userdata].insert(key);
     }
     else {
       // Assigning nil: remove the key from the list.
-      get_lua_context(l).userdata_fields[userdata].erase(lua_tostring(l, 2));
+      get_lua_context(l).userdata_fields[userdata].erase(key);
+    }
+
+    // Also remember whether this is an event callback.
+    const UserdataEvent event = get_userdata_event(key);
+    if (event != EVENT_NB) {
+      userdata->set_lua_event(event, defined);
     }
   }
 
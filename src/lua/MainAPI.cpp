@@ -17,7 +17,10 @@
 #include "lua/LuaContext.h"
 #include "lowlevel/Geometry.h"
 #include "lowlevel/FileTools.h"
+#include "lowlevel/Profiler.h"
+#include "lowlevel/System.h"
 #include "MainLoop.h"
+#include "ResourcePreloader.h"
 #include "Settings.h"
 #include <lua.hpp>
 #include <sstream>
@@ -43,6 +46,11 @@ void LuaContext::register_main_module() {
       { "save_settings", main_api_save_settings },
       { "get_distance", main_api_get_distance },
       { "get_angle", main_api_get_angle },
+      { "get_input_stats", main_api_get_input_stats },
+      { "preload_resources", main_api_preload_resources },
+      { "get_elapsed_time", main_api_get_elapsed_time },
+      { "get_profile", main_api_get_profile },
+      { "save_profile", main_api_save_profile },
       { NULL, NULL }
   };
   register_functions(main_module_name, functions);
@@ -223,6 +231,97 @@ int LuaContext::main_api_get_angle(lua_State* l) {
   return 1;
 }
 
+/**
+ * \brief Implementation of sol.main.get_input_stats().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::main_api_get_input_stats(lua_State* l) {
+
+  MainLoop& main_loop = get_lua_context(l).get_main_loop();
+
+  lua_pushinteger(l, main_loop.get_num_input_events());
+  lua_pushinteger(l, main_loop.get_input_latency());
+  return 2;
+}
+
+/**
+ * \brief Implementation of sol.main.preload_resources().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::main_api_preload_resources(lua_State* l) {
+
+  const bool keep_tileset_images = lua_toboolean(l, 1) != 0;
+
+  const uint32_t elapsed_time = ResourcePreloader::preload_all(keep_tileset_images);
+
+  lua_pushinteger(l, elapsed_time);
+  return 1;
+}
+
+/**
+ * \brief Implementation of sol.main.get_elapsed_time().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::main_api_get_elapsed_time(lua_State* l) {
+
+  lua_pushinteger(l, System::get_real_time());
+  return 1;
+}
+
+/**
+ * \brief Implementation of sol.main.get_profile().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::main_api_get_profile(lua_State* l) {
+
+  if (!Profiler::is_enabled()) {
+    lua_pushnil(l);
+    return 1;
+  }
+
+  lua_newtable(l);
+  for (int i = 0; i < Profiler::SECTION_NB; ++i) {
+    Profiler::Section section = Profiler::Section(i);
+    const Profiler::Statistics statistics = Profiler::get_statistics(section);
+    lua_newtable(l);
+    lua_pushnumber(l, statistics.min);
+    lua_setfield(l, -2, "min");
+    lua_pushnumber(l, statistics.average);
+    lua_setfield(l, -2, "average");
+    lua_pushnumber(l, statistics.max);
+    lua_setfield(l, -2, "max");
+    lua_pushnumber(l, statistics.p99);
+    lua_setfield(l, -2, "p99");
+    lua_setfield(l, -2, Profiler::get_section_name(section).c_str());
+  }
+  lua_pushinteger(l, Profiler::get_num_frames());
+  lua_setfield(l, -2, "num_frames");
+  return 1;
+}
+
+/**
+ * \brief Implementation of sol.main.save_profile().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::main_api_save_profile(lua_State* l) {
+
+  std::string file_name = luaL_optstring(l, 1, "profile.csv");
+
+  if (FileTools::get_quest_write_dir().empty()) {
+    error(l, "Cannot save profile: no write directory was specified in quest.dat");
+  }
+
+  bool success = Profiler::is_enabled() && Profiler::save(file_name);
+
+  lua_pushboolean(l, success);
+  return 1;
+}
+
 /**
  * \brief Calls sol.main.on_started() if it exists.
  *
@@ -18,6 +18,7 @@
 #include "MainLoop.h"
 #include "Game.h"
 #include "Map.h"
+#include "MapPreloader.h"
 #include "Treasure.h"
 #include "EquipmentItem.h"
 #include "Timer.h"
@@ -53,6 +54,7 @@
 #include "movements/Movement.h"
 #include "lowlevel/Sound.h"
 #include "lowlevel/Music.h"
+#include "lowlevel/FileTools.h"
 #include "lowlevel/Debug.h"
 #include "lowlevel/StringConcat.h"
 #include <lua.hpp>
@@ -76,6 +78,7 @@ void LuaContext::register_map_module() {
       { "get_floor", map_api_get_floor },
       { "get_tileset", map_api_get_tileset },
       { "set_tileset", map_api_set_tileset },
+      { "preload", map_api_preload },
       { "get_music", map_api_get_music },
       { "get_camera_position", map_api_get_camera_position },
       { "move_camera", map_api_move_camera },
@@ -115,6 +118,7 @@ void LuaContext::register_map_module() {
       { "create_door", map_api_create_door },
       { "create_stairs", map_api_create_stairs },
       { "create_separator", map_api_create_separator },
+      { "create_custom_entity", map_api_create_custom_entity },
       { "create_bomb", map_api_create_bomb },
       { "create_explosion", map_api_create_explosion },
       { "create_fire", map_api_create_fire },
@@ -463,6 +467,25 @@ int LuaContext::map_api_set_tileset(lua_State* l) {
   return 0;
 }
 
+/**
+ * \brief Implementation of map:preload().
+ * \param l The Lua context that is calling this function.
+ * \return Number of values to return to Lua.
+ */
+int LuaContext::map_api_preload(lua_State* l) {
+
+  check_map(l, 1);
+  const std::string& map_id = luaL_checkstring(l, 2);
+
+  if (!FileTools::data_file_exists(std::string("maps/") + map_id + ".dat")) {
+    arg_error(l, 2, StringConcat() << "No such map: '" << map_id << "'");
+  }
+
+  MapPreloader::preload(map_id);
+
+  return 0;
+}
+
 /**
  * \brief Implementation of map:get_camera_position().
  * \param l The Lua context that is calling this function.
@@ -854,27 +877,68 @@ int LuaContext::map_api_create_tile(lua_State* l) {
   Debug::check_assertion(!map.is_started(),
       "Cannot create a tile when the map is already started");
 
-  luaL_checktype(l, 1, LUA_TTABLE);
-  const int layer = check_int_field(l, 1, "layer");
-  const int x = check_int_field(l, 1, "x");
-  const int y = check_int_field(l, 1, "y");
-  const int width = check_int_field(l, 1, "width");
-  const int height = check_int_field(l, 1, "height");
-  const int tile_pattern_id = check_int_field(l, 1, "pattern");
+  int layer, x, y, width, height, tile_pattern_id;
+  check_tile_fields(l, 1, layer, x, y, width, height, tile_pattern_id);
+  create_tiles(map, layer, x, y, width, height, tile_pattern_id);
+
+  return 0;
+}
+
+/**
+ * \brief Checks the fields of the table that declares a tile.
+ *
+ * This function is also used when recording map data files.
+ *
+ * \param l A Lua context.
+ * \param table_index Index of the table in the stack.
+ * \param[out] layer Layer of the tile.
+ * \param[out] x X coordinate of the tile.
+ * \param[out] y Y coordinate of the tile.
+ * \param[out] width Width of the tile (a multiple of 8).
+ * \param[out] height Height of the tile (a multiple of 8).
+ * \param[out] pattern_id Id of the tile pattern.
+ */
+void LuaContext::check_tile_fields(lua_State* l, int table_index,
+    int& layer, int& x, int& y, int& width, int& height, int& pattern_id) {
+
+  luaL_checktype(l, table_index, LUA_TTABLE);
+  layer = check_int_field(l, table_index, "layer");
+  x = check_int_field(l, table_index, "x");
+  y = check_int_field(l, table_index, "y");
+  width = check_int_field(l, table_index, "width");
+  height = check_int_field(l, table_index, "height");
+  pattern_id = check_int_field(l, table_index, "pattern");
 
   if (layer < LAYER_LOW || layer >= LAYER_NB) {
-    arg_error(l, 1, StringConcat() << "Invalid layer: " << layer);
+    arg_error(l, table_index, StringConcat() << "Invalid layer: " << layer);
   }
   if (width < 0 || width % 8 != 0) {
-    arg_error(l, 1, StringConcat() <<
+    arg_error(l, table_index, StringConcat() <<
         "Invalid width: " << width << ": should be a positive multiple of 8");
   }
   if (height < 0 || height % 8 != 0) {
-    arg_error(l, 1, StringConcat() <<
+    arg_error(l, table_index, StringConcat() <<
         "Invalid height: " << height << ": should be a positive multiple of 8");
   }
+}
+
+/**
+ * \brief Creates the tiles that repeat a pattern over a rectangle.
+ *
+ * This function is also used when loading compiled map data files.
+ *
+ * \param map The map where to create the tiles. Its tileset must be set.
+ * \param layer Layer of the tiles.
+ * \param x X coordinate of the rectangle.
+ * \param y Y coordinate of the rectangle.
+ * \param width Width of the rectangle.
+ * \param height Height of the rectangle.
+ * \param pattern_id Id of the tile pattern to repeat.
+ */
+void LuaContext::create_tiles(Map& map, int layer, int x, int y,
+    int width, int height, int pattern_id) {
 
-  TilePattern& pattern = map.get_tileset().get_tile_pattern(tile_pattern_id);
+  TilePattern& pattern = map.get_tileset().get_tile_pattern(pattern_id);
 
   for (int current_y = y; current_y < y + height; current_y += pattern.get_height()) {
     for (int current_x = x; current_x < x + width; current_x += pattern.get_width()) {
@@ -884,12 +948,10 @@ int LuaContext::map_api_create_tile(lua_State* l) {
           current_y,
           pattern.get_width(),
           pattern.get_height(),
-          tile_pattern_id);
+          pattern_id);
       map.get_entities().add_entity(entity);
     }
   }
-
-  return 0;
 }
 
 /**
@@ -2055,7 +2117,7 @@ int LuaContext::map_api_create_fire(lua_State* l) {
  */
 void LuaContext::map_on_started(Map& map, Destination* destination) {
 
-  if (!userdata_has_field(map, "on_started")) {
+  if (!userdata_has_event(map, EVENT_ON_STARTED)) {
     return;
   }
 
@@ -2078,7 +2140,7 @@ void LuaContext::map_on_finished(Map& map) {
   }
 
   push_map(l, map);
-  if (userdata_has_field(map, "on_finished")) {
+  if (userdata_has_event(map, EVENT_ON_FINISHED)) {
     on_finished();
   }
   remove_timers(-1);  // Stop timers and menus associated to this map.
@@ -2100,10 +2162,7 @@ void LuaContext::map_on_update(Map& map) {
   }
 
   push_map(l, map);
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (userdata_has_field(map, method_name)) {
+  if (userdata_has_event(map, EVENT_ON_UPDATE)) {
     on_update();
   }
   menus_on_update(-1);
@@ -2124,7 +2183,7 @@ void LuaContext::map_on_draw(Map& map, Surface& dst_surface) {
     return;
   }
   push_map(l, map);
-  if (userdata_has_field(map, "on_draw")) {
+  if (userdata_has_event(map, EVENT_ON_DRAW)) {
     on_draw(dst_surface);
   }
   menus_on_draw(-1, dst_surface);
@@ -2178,7 +2237,7 @@ bool LuaContext::map_on_command_pressed(Map& map, GameCommands::Command command)
 
   bool handled = false;
   push_map(l, map);
-  if (userdata_has_field(map, "on_command_pressed")) {
+  if (userdata_has_event(map, EVENT_ON_COMMAND_PRESSED)) {
     handled = on_command_pressed(command);
   }
   if (!handled) {
@@ -2206,7 +2265,7 @@ bool LuaContext::map_on_command_released(Map& map, GameCommands::Command command
 
   bool handled = false;
   push_map(l, map);
-  if (userdata_has_field(map, "on_command_released")) {
+  if (userdata_has_event(map, EVENT_ON_COMMAND_RELEASED)) {
     handled = on_command_released(command);
   }
   if (!handled) {
@@ -2226,7 +2285,7 @@ bool LuaContext::map_on_command_released(Map& map, GameCommands::Command command
  */
 void LuaContext::map_on_suspended(Map& map, bool suspended) {
 
-  if (!userdata_has_field(map, "on_suspended")) {
+  if (!userdata_has_event(map, EVENT_ON_SUSPENDED)) {
     return;
   }
 
@@ -2246,7 +2305,7 @@ void LuaContext::map_on_suspended(Map& map, bool suspended) {
 void LuaContext::map_on_opening_transition_finished(Map& map,
     Destination* destination) {
 
-  if (!userdata_has_field(map, "on_opening_transition_finished")) {
+  if (!userdata_has_event(map, EVENT_ON_OPENING_TRANSITION_FINISHED)) {
     return;
   }
 
@@ -2264,7 +2323,7 @@ void LuaContext::map_on_opening_transition_finished(Map& map,
  */
 void LuaContext::map_on_camera_back(Map& map) {
 
-  if (!userdata_has_field(map, "on_camera_back")) {
+  if (!userdata_has_event(map, EVENT_ON_CAMERA_BACK)) {
     return;
   }
 
@@ -2283,7 +2342,7 @@ void LuaContext::map_on_camera_back(Map& map) {
  */
 void LuaContext::map_on_obtaining_treasure(Map& map, const Treasure& treasure) {
 
-  if (!userdata_has_field(map, "on_obtaining_treasure")) {
+  if (!userdata_has_event(map, EVENT_ON_OBTAINING_TREASURE)) {
     return;
   }
 
@@ -2302,7 +2361,7 @@ void LuaContext::map_on_obtaining_treasure(Map& map, const Treasure& treasure) {
  */
 void LuaContext::map_on_obtained_treasure(Map& map, const Treasure& treasure) {
 
-  if (!userdata_has_field(map, "on_obtained_treasure")) {
+  if (!userdata_has_event(map, EVENT_ON_OBTAINED_TREASURE)) {
     return;
   }
 
@@ -27,6 +27,7 @@
 #include "movements/CircleMovement.h"
 #include "movements/JumpMovement.h"
 #include "lowlevel/Debug.h"
+#include "lowlevel/StringConcat.h"
 #include "entities/Hero.h"
 #include "entities/MapEntities.h"
 #include "MainLoop.h"
@@ -155,6 +156,8 @@ void LuaContext::register_movement_module() {
       { "set_target", path_finding_movement_api_set_target },
       { "get_speed", path_finding_movement_api_get_speed },
       { "set_speed", path_finding_movement_api_set_speed },
+      { "get_max_distance", path_finding_movement_api_get_max_distance },
+      { "set_max_distance", path_finding_movement_api_set_max_distance },
       { NULL, NULL }
   };
   register_functions(movement_path_finding_module_name, common_methods);
@@ -1213,6 +1216,36 @@ int LuaContext::path_finding_movement_api_set_speed(lua_State* l) {
   return 0;
 }
 
+/**
+ * \brief Implementation of path_finding_movement:get_max_distance().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::path_finding_movement_api_get_max_distance(lua_State* l) {
+
+  PathFindingMovement& movement = check_path_finding_movement(l, 1);
+  lua_pushinteger(l, movement.get_max_distance());
+  return 1;
+}
+
+/**
+ * \brief Implementation of path_finding_movement:set_max_distance().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::path_finding_movement_api_set_max_distance(lua_State* l) {
+
+  PathFindingMovement& movement = check_path_finding_movement(l, 1);
+  int max_distance = luaL_checkint(l, 2);
+
+  if (max_distance < 0) {
+    arg_error(l, 2, StringConcat() << "Invalid maximum distance: " << max_distance);
+  }
+
+  movement.set_max_distance(max_distance);
+  return 0;
+}
+
 /**
  * \brief Returns whether a value is a userdata of type circle movement.
  * \param l A Lua context.
@@ -1730,7 +1763,7 @@ void LuaContext::movement_on_position_changed(Movement& movement) {
   }
   lua_pop(l, 2);
                                   // ... movement
-  if (userdata_has_field(movement, "on_position_changed")) {
+  if (userdata_has_event(movement, EVENT_ON_POSITION_CHANGED)) {
     on_position_changed();
   }
   lua_pop(l, 1);
@@ -1745,7 +1778,7 @@ void LuaContext::movement_on_position_changed(Movement& movement) {
  */
 void LuaContext::movement_on_obstacle_reached(Movement& movement) {
 
-  if (!userdata_has_field(movement, "on_obstacle_reached")) {
+  if (!userdata_has_event(movement, EVENT_ON_OBSTACLE_REACHED)) {
     return;
   }
 
@@ -1763,7 +1796,7 @@ void LuaContext::movement_on_obstacle_reached(Movement& movement) {
  */
 void LuaContext::movement_on_changed(Movement& movement) {
 
-  if (!userdata_has_field(movement, "on_changed")) {
+  if (!userdata_has_event(movement, EVENT_ON_CHANGED)) {
     return;
   }
 
@@ -1781,7 +1814,7 @@ void LuaContext::movement_on_changed(Movement& movement) {
  */
 void LuaContext::movement_on_finished(Movement& movement) {
 
-  if (!userdata_has_field(movement, "on_finished")) {
+  if (!userdata_has_event(movement, EVENT_ON_FINISHED)) {
     return;
   }
 
@@ -334,7 +334,7 @@ int LuaContext::sprite_api_synchronize(lua_State *l) {
 void LuaContext::sprite_on_animation_finished(Sprite& sprite,
     const std::string& animation) {
 
-  if (!userdata_has_field(sprite, "on_animation_finished")) {
+  if (!userdata_has_event(sprite, EVENT_ON_ANIMATION_FINISHED)) {
     return;
   }
 
@@ -354,7 +354,7 @@ void LuaContext::sprite_on_animation_finished(Sprite& sprite,
 void LuaContext::sprite_on_animation_changed(
     Sprite& sprite, const std::string& animation) {
 
-  if (!userdata_has_field(sprite, "on_animation_changed")) {
+  if (!userdata_has_event(sprite, EVENT_ON_ANIMATION_CHANGED)) {
     return;
   }
 
@@ -375,7 +375,7 @@ void LuaContext::sprite_on_animation_changed(
 void LuaContext::sprite_on_direction_changed(Sprite& sprite,
     const std::string& animation, int direction) {
 
-  if (!userdata_has_field(sprite, "on_direction_changed")) {
+  if (!userdata_has_event(sprite, EVENT_ON_DIRECTION_CHANGED)) {
     return;
   }
 
@@ -396,7 +396,7 @@ void LuaContext::sprite_on_direction_changed(Sprite& sprite,
 void LuaContext::sprite_on_frame_changed(Sprite& sprite,
     const std::string& animation, int frame) {
 
-  if (!userdata_has_field(sprite, "on_frame_changed")) {
+  if (!userdata_has_event(sprite, EVENT_ON_FRAME_CHANGED)) {
     return;
   }
 
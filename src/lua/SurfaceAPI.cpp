@@ -34,6 +34,8 @@ void LuaContext::register_surface_module() {
 
   static const luaL_Reg methods[] = {
       { "create", surface_api_create },
+      { "get_cache_statistics", surface_api_get_cache_statistics },
+      { "get_draw_statistics", surface_api_get_draw_statistics },
       { "get_size", surface_api_get_size },
       { "fill_color", surface_api_fill_color },
       { "set_opacity", surface_api_set_opacity },
@@ -125,6 +127,52 @@ int LuaContext::surface_api_create(lua_State* l) {
   return 1;
 }
 
+/**
+ * \brief Implementation of sol.surface.get_cache_statistics().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::surface_api_get_cache_statistics(lua_State* l) {
+
+  const Surface::ImageCacheStatistics& statistics =
+      Surface::get_image_cache_statistics();
+
+  lua_createtable(l, 0, 5);
+  lua_pushinteger(l, statistics.num_images);
+  lua_setfield(l, -2, "images");
+  lua_pushinteger(l, statistics.num_unused_images);
+  lua_setfield(l, -2, "unused_images");
+  lua_pushnumber(l, double(statistics.num_bytes));
+  lua_setfield(l, -2, "bytes");
+  lua_pushinteger(l, statistics.num_hits);
+  lua_setfield(l, -2, "hits");
+  lua_pushinteger(l, statistics.num_misses);
+  lua_setfield(l, -2, "misses");
+  return 1;
+}
+
+/**
+ * \brief Implementation of sol.surface.get_draw_statistics().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::surface_api_get_draw_statistics(lua_State* l) {
+
+  const Surface::DrawStatistics& statistics =
+      Surface::get_draw_statistics();
+
+  lua_createtable(l, 0, 4);
+  lua_pushinteger(l, statistics.num_commands);
+  lua_setfield(l, -2, "commands");
+  lua_pushnumber(l, double(statistics.num_bytes));
+  lua_setfield(l, -2, "bytes");
+  lua_pushinteger(l, statistics.num_draw_calls);
+  lua_setfield(l, -2, "draw_calls");
+  lua_pushinteger(l, statistics.num_texture_switches);
+  lua_setfield(l, -2, "texture_switches");
+  return 1;
+}
+
 /**
  * \brief Implementation of surface:get_size().
  * \param l the Lua context that is calling this function
@@ -20,7 +20,9 @@
 #include "MainLoop.h"
 #include "Game.h"
 #include "Map.h"
+#include "lowlevel/System.h"
 #include <list>
+#include <algorithm>
 #include <lua.hpp>
 
 namespace solarus {
@@ -123,8 +125,10 @@ void LuaContext::add_timer(Timer* timer, int context_index, int callback_index)
   Debug::check_assertion(timers.find(timer) == timers.end(),
       "Duplicate timer in the system");
 
-  timers[timer].callback_ref = callback_ref;
-  timers[timer].context = context;
+  LuaTimerData& timer_data = timers[timer];
+  timer_data.callback_ref = callback_ref;
+  timer_data.context = context;
+  timer_data.schedule_id = 0;
 
   Game* game = main_loop.get_game();
   if (game != NULL) {
@@ -148,6 +152,8 @@ void LuaContext::add_timer(Timer* timer, int context_index, int callback_index)
     }
   }
   RefCountable::ref(timer);
+
+  reschedule_timer(timer);
 }
 
 /**
@@ -216,27 +222,76 @@ void LuaContext::destroy_timers() {
     RefCountable::unref(timer);
   }
   timers.clear();
+  timers_schedule = std::priority_queue<ScheduledTimer>();
+}
+
+/**
+ * \brief Puts a timer in the schedule again after a change of its dates.
+ *
+ * Any previous entry of this timer in the schedule becomes obsolete.
+ * This function must be called when a timer is created, resumed or when
+ * its clock sound is enabled.
+ *
+ * \param timer A timer.
+ */
+void LuaContext::reschedule_timer(Timer* timer) {
+
+  std::map<Timer*, LuaTimerData>::iterator it = timers.find(timer);
+  if (it == timers.end()
+      || it->second.callback_ref == LUA_REFNIL
+      || timer->is_finished()) {
+    return;
+  }
+
+  const uint32_t id = next_timer_schedule_id++;
+  it->second.schedule_id = id;
+  timers_schedule.push(ScheduledTimer(timer->get_next_update_date(), id, timer));
 }
 
 /**
  * \brief Updates all timers currently running for this script.
+ *
+ * Only timers whose date has come are updated, in the order of their dates.
  */
 void LuaContext::update_timers() {
 
-  // Update all timers.
+  const uint32_t now = System::now();
   std::map<Timer*, LuaTimerData>::iterator it;
-  for (it = timers.begin(); it != timers.end(); ++it) {
+  while (!timers_schedule.empty() && timers_schedule.top().date <= now) {
 
-    Timer* timer = it->first;
-    int callback_ref = it->second.callback_ref;
-    if (callback_ref != LUA_REFNIL) {
-      // The timer is not being removed: update it.
-      timer->update();
-      if (timer->is_finished()) {
-        do_callback(callback_ref);
-        it->second.callback_ref = LUA_REFNIL;
-        timers_to_remove.push_back(timer);
-      }
+    const ScheduledTimer scheduled_timer = timers_schedule.top();
+    timers_schedule.pop();
+
+    Timer* timer = scheduled_timer.timer;
+    it = timers.find(timer);
+    if (it == timers.end()
+        || it->second.callback_ref == LUA_REFNIL
+        || it->second.schedule_id != scheduled_timer.id) {
+      // Obsolete entry: the timer is being removed or was rescheduled.
+      continue;
+    }
+
+    // Note that callbacks may add timers but don't erase any, so the
+    // timer data remains valid.
+    LuaTimerData& timer_data = it->second;
+    timer->update();
+    if (timer->is_finished()) {
+      timer_data.schedule_id = 0;
+      int callback_ref = timer_data.callback_ref;
+      timer_data.callback_ref = LUA_REFNIL;
+      do_callback(callback_ref);
+      timers_to_remove.push_back(timer);
+    }
+    else if (timer->is_suspended()) {
+      // Don't schedule it until it gets resumed.
+      timer_data.schedule_id = 0;
+    }
+    else {
+      // The expiration date was delayed or a clock sound was played.
+      const uint32_t id = next_timer_schedule_id++;
+      timer_data.schedule_id = id;
+      timers_schedule.push(ScheduledTimer(
+          std::max(timer->get_next_update_date(), now + 1), id, timer));
     }
   }
 
@@ -272,6 +327,9 @@ void LuaContext::notify_timers_map_suspended(bool suspended) {
     Timer* timer = it->first;
     if (!suspended || timer->is_suspended_with_map()) {
       timer->notify_map_suspended(suspended);
+      if (!suspended) {
+        reschedule_timer(timer);
+      }
     }
   }
 }
@@ -387,6 +445,7 @@ int LuaContext::timer_api_set_with_sound(lua_State* l) {
   }
 
   timer.set_with_sound(with_sound);
+  get_lua_context(l).reschedule_timer(&timer);
 
   return 0;
 }
@@ -418,6 +477,7 @@ int LuaContext::timer_api_set_suspended(lua_State* l) {
   }
 
   timer.set_suspended(suspended);
+  get_lua_context(l).reschedule_timer(&timer);
 
   return 0;
 }
@@ -454,6 +514,7 @@ int LuaContext::timer_api_set_suspended_with_map(lua_State* l) {
 
   Game* game = lua_context.get_main_loop().get_game();
   timer.notify_map_suspended(game->get_current_map().is_suspended());
+  lua_context.reschedule_timer(&timer);
 
   return 0;
 }
@@ -52,6 +52,18 @@ void print_help(int argc, char **argv) {
     << std::endl
     << "  -no-video                     disables displaying"
     << std::endl
+    << "  -headless                     disables displaying and audio and runs as fast as possible"
+    << std::endl
+    << "  -no-throttle                  runs the simulation as fast as possible"
+    << std::endl
+    << "  -max-ticks=<n>                exits after <n> simulation steps"
+    << std::endl
+    << "  -workers=<n>                  sets the number of threads that load resources and apply software pixel filters"
+    << std::endl
+    << "  -sound-voices=<n>             sets the number of sounds that can play at the same time (default 32)"
+    << std::endl
+    << "  -filter-benchmark=<n>         records n frames in a software video mode and measures the pixel filters on them"
+    << std::endl
     << "  -video-acceleration=yes|no    enables or disables accelerated graphics (default yes)"
     << std::endl
     << "  -quest-size=<width>x<height>  sets the size of the drawing area (if compatible with the quest)"
@@ -78,6 +90,12 @@ void print_help(int argc, char **argv) {
  *   -help                             Shows a help message.
  *   -no-audio                         Disables sounds and musics.
  *   -no-video                         Disables displaying (used for unitary tests).
+ *   -headless                         Disables displaying and audio and runs as fast as possible.
+ *   -no-throttle                      Runs the simulation as fast as possible (used for benchmarks).
+ *   -max-ticks=<n>                    Exits after <n> simulation steps.
+ *   -workers=<n>                      Sets the number of threads that load resources and apply software pixel filters.
+ *   -sound-voices=<n>                 Sets the number of sounds that can play at the same time (default 32).
+ *   -filter-benchmark=<n>             Records <n> frames in a software video mode and measures the pixel filters on them.
  *   -video-acceleration=yes|no        Enables or disables 2D accelerated graphics if available (default yes).
  *   -quest-size=<width>x<height>      Sets the size of the drawing area (if compatible with the quest).
  *
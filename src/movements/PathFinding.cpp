@@ -16,11 +16,18 @@
  */
 #include "movements/PathFinding.h"
 #include "entities/MapEntity.h"
+#include "movements/PathFindingCache.h"
 #include "Map.h"
 #include "lowlevel/Debug.h"
+#include "lowlevel/StringConcat.h"
+#include <algorithm>
+#include <cstdlib>
 
 namespace solarus {
 
+std::vector<PathFinding::Node> PathFinding::nodes;
+uint32_t PathFinding::current_search = 0;
+
 const Rectangle PathFinding::neighbours_locations[] = {
   Rectangle( 8,  0, 16, 16 ),
   Rectangle( 8, -8, 16, 16 ),
@@ -49,17 +56,27 @@ const Rectangle PathFinding::transition_collision_boxes[] = {
  * \param source_entity the entity that will move from the starting point to the target
  * (its position must be aligned on the map grid)
  * \param target_entity the target entity (its size must be 16*16)
+ * \param max_distance maximum Manhattan distance in pixels between the
+ * target and the nodes to explore (no path is searched if the source is farther)
  */
 PathFinding::PathFinding(
-    const Map& map,
+    Map& map,
     const MapEntity& source_entity,
-    const MapEntity& target_entity):
+    const MapEntity& target_entity,
+    int max_distance):
   map(map),
   source_entity(source_entity),
-  target_entity(target_entity) {
+  target_entity(target_entity),
+  max_distance(max_distance),
+  squares_x8(0),
+  squares_y8(0),
+  squares_width8(0),
+  squares_height8(0) {
 
   Debug::check_assertion(source_entity.is_aligned_to_grid(),
       "The source must be aligned on the map grid");
+  Debug::check_assertion(max_distance >= 0,
+      StringConcat() << "Invalid maximum distance: " << max_distance);
 }
 
 /**
@@ -75,10 +92,6 @@ PathFinding::~PathFinding() {
  */
 std::string PathFinding::compute_path() {
 
-  //std::cout << "will compute a path from " << source_entity.get_top_left_x() << ","
-  //  << source_entity.get_top_left_y() << " to " << target_entity.get_top_left_x() << ","
-  //  << target_entity.get_top_left_y() << std::endl;
-
   const Rectangle& source = source_entity.get_bounding_box();
   Rectangle target = target_entity.get_bounding_box();
 
@@ -86,127 +99,181 @@ std::string PathFinding::compute_path() {
   target.add_x(-target.get_x() % 8);
   target.add_y(4);
   target.add_y(-target.get_y() % 8);
-  int target_index = get_square_index(target);
 
   Debug::check_assertion(target.get_x() % 8 == 0 && target.get_y() % 8 == 0,
       "Could not snap the target to the map grid");
 
   int total_mdistance = get_manhattan_distance(source, target);
-  if (total_mdistance > 200 || target_entity.get_layer() != source_entity.get_layer()) {
-    //std::cout << "too far, not computing a path\n";
+  if (total_mdistance > max_distance || target_entity.get_layer() != source_entity.get_layer()) {
     return ""; // too far to compute a path
   }
 
-  std::string path = "";
+  // Maybe another entity has just searched the same path.
+  PathFindingCache& cache = map.get_path_finding_cache();
+  std::string path;
+  if (!cache.get_path(source_entity, target, max_distance, path)) {
+    path = search_path(source, target, total_mdistance);
+    cache.add_path(source_entity, target, max_distance, path);
+  }
+
+  return path;
+}
+
+/**
+ * \brief Runs the A* algorithm between two nodes.
+ * \param source location of the starting node
+ * \param target location of the target node
+ * \param total_mdistance Manhattan distance between both nodes
+ * \return the path found, or an empty string if there is no path
+ */
+std::string PathFinding::search_path(
+    const Rectangle& source, const Rectangle& target, int total_mdistance) {
+
+  // Only the squares closer than max_distance to the target can be explored.
+  squares_x8 = std::max(0, (target.get_x() - max_distance) / 8);
+  squares_y8 = std::max(0, (target.get_y() - max_distance) / 8);
+  int last_x8 = std::min(map.get_width8() - 1, (target.get_x() + max_distance) / 8);
+  int last_y8 = std::min(map.get_height8() - 1, (target.get_y() + max_distance) / 8);
+  squares_width8 = last_x8 - squares_x8 + 1;
+  squares_height8 = last_y8 - squares_y8 + 1;
+
+  int source_index = get_square_index(source);
+  int target_index = get_square_index(target);
+  if (source_index == -1 || target_index == -1) {
+    return ""; // outside the map
+  }
+
+  // Start a new search without resetting all nodes.
+  const size_t num_nodes = squares_width8 * squares_height8;
+  if (nodes.size() < num_nodes) {
+    nodes.resize(num_nodes);
+  }
+  ++current_search;
+  if (current_search == 0) {
+    // The search number wrapped around: forget all previous searches.
+    nodes.assign(nodes.size(), Node());
+    current_search = 1;
+  }
+  open_list = std::priority_queue<OpenNode>();
+  int order = 0;
 
-  Node starting_node;
-  int index = get_square_index(source);
-  starting_node.location = source;
-  starting_node.index = index;
+  Node& starting_node = get_node(source_index);
   starting_node.previous_cost = 0;
   starting_node.heuristic = total_mdistance;
-  starting_node.total_cost = total_mdistance;
   starting_node.direction = ' ';
   starting_node.parent_index = -1;
+  starting_node.state = NODE_OPEN;
+  open_list.push(OpenNode(total_mdistance, order++, source_index));
 
-  open_list[index] = starting_node;
-  open_list_indices.push_front(index);
-
-  bool finished = false;
-  while (!finished) {
+  while (!open_list.empty()) {
 
     // pick the node with the lowest total cost in the open list
-    int index = open_list_indices.front();
-    Node* current_node = &open_list[index];
-    open_list_indices.pop_front();
-    closed_list[index] = *current_node;
-    open_list.erase(index);
-    current_node = &closed_list[index];
-
-    //std::cout << System::now() << " picking the lowest cost node in the open list ("
-    //  << (open_list_indices.size() + 1) << " elements): "
-    //  << current_node->location << ", index = " << current_node->index
-    //  << ", cost = " << current_node->previous_cost << " + " << current_node->heuristic << "\n";
+    const int index = open_list.top().index;
+    const int total_cost = open_list.top().total_cost;
+    open_list.pop();
+
+    Node& current_node = nodes[index];
+    if (current_node.state == NODE_CLOSED
+        || total_cost != current_node.previous_cost + current_node.heuristic) {
+      // obsolete element: this node was pushed again since then with a better cost
+      continue;
+    }
+    current_node.state = NODE_CLOSED;
 
     if (index == target_index) {
-      //std::cout << "target node was added to the closed list\n";
-      finished = true;
-      path = rebuild_path(current_node);
-      //std::cout << "rebuild done\n";
+      return rebuild_path(index);
     }
-    else {
-      // look at the accessible nodes from it
-      //std::cout << System::now() << " looking for accessible states\n";
-      for (int i = 0; i < 8; i++) {
-
-        Node new_node;
-        int immediate_cost = (i & 1) ? 11 : 8;
-        new_node.previous_cost = current_node->previous_cost + immediate_cost;
-        new_node.location = current_node->location;
-        new_node.location.add_xy(neighbours_locations[i]);
-        new_node.index = get_square_index(new_node.location);
-        //std::cout << "  node in direction " << i << ": index = " << new_node.index << std::endl;
-
-        bool in_closed_list = (closed_list.find(new_node.index) != closed_list.end());
-        if (!in_closed_list && get_manhattan_distance(new_node.location, target) < 200
-            && is_node_transition_valid(*current_node, i)) {
-          //std::cout << "  node in direction " << i << " is not in the closed list\n";
-          // not in the closed list: look in the open list
-
-          bool in_open_list = open_list.find(new_node.index) != open_list.end();
-
-          if (!in_open_list) {
-            // not in the open list: add it
-            new_node.heuristic = get_manhattan_distance(new_node.location, target);
-            new_node.total_cost = new_node.previous_cost + new_node.heuristic;
-            new_node.parent_index = index;
-            new_node.direction = '0' + i;
-            open_list[new_node.index] = new_node;
-            add_index_sorted(&open_list[new_node.index]);
-            //std::cout << "  node in direction " << i << " is not in the open list, adding it with cost "
-            //  << new_node.previous_cost << " (" << current_node->previous_cost << " + "
-            //  << immediate_cost << ") + " << new_node.heuristic << " and parent " << new_node.parent_index << "\n";
-          }
-          else {
-            //std::cout << "  node in direction " << i << " is already in the open list\n";
-            Node* existing_node = &open_list[new_node.index];
-            // already in the open list: see if the current path is better
-            if (new_node.previous_cost < existing_node->previous_cost) {
-              existing_node->previous_cost = new_node.previous_cost;
-              existing_node->total_cost = existing_node->previous_cost + existing_node->heuristic;
-              existing_node->parent_index = index;
-              open_list_indices.sort();
-            }
-          }
-        }
-        else {
-          //std::cout << "skipping node in direction " << i << ": already in closed list = "
-          //  << in_closed_list << ", too far from target = "
-          //  << (get_manhattan_distance(new_node.location, target) >= 200) << ", invalid transition = "
-          //  << (!is_node_transition_valid(*current_node, i)) << std::endl;
-        }
+
+    // look at the accessible nodes from it
+    const Rectangle& location = get_square_location(index);
+    for (int i = 0; i < 8; i++) {
+
+      Rectangle new_location = location;
+      new_location.add_xy(neighbours_locations[i]);
+      int new_index = get_square_index(new_location);
+      if (new_index == -1) {
+        continue;
+      }
+
+      Node& new_node = get_node(new_index);
+      if (new_node.state == NODE_CLOSED) {
+        continue;
+      }
+
+      int immediate_cost = (i & 1) ? 11 : 8;
+      int previous_cost = current_node.previous_cost + immediate_cost;
+      if (new_node.state == NODE_OPEN && previous_cost >= new_node.previous_cost) {
+        // already in the open list with a path at least as good
+        continue;
       }
-      if (open_list_indices.empty()) {
-        finished = true;
+
+      int heuristic = get_manhattan_distance(new_location, target);
+      if (heuristic >= max_distance || !is_node_transition_valid(location, i)) {
+        continue;
       }
+
+      // new node or better path to an open node
+      new_node.previous_cost = previous_cost;
+      new_node.heuristic = heuristic;
+      new_node.parent_index = index;
+      new_node.direction = '0' + i;
+      new_node.state = NODE_OPEN;
+      open_list.push(OpenNode(previous_cost + heuristic, order++, new_index));
     }
   }
 
-  //std::cout << "path found: " << path << ", open nodes: " << open_list.size() << ", closed nodes: " << closed_list.size() << std::endl;
-  return path;
+  return "";
+}
+
+/**
+ * \brief Returns a node for the current search.
+ *
+ * The node is reset if it was not reached yet by this search.
+ *
+ * \param index index of the node
+ * \return the node
+ */
+PathFinding::Node& PathFinding::get_node(int index) {
+
+  Node& node = nodes[index];
+  if (node.search != current_search) {
+    node = Node();
+    node.search = current_search;
+  }
+  return node;
 }
 
 /**
- * \brief Returns the index of the 8*8 square in the map
+ * \brief Returns the index in the nodes array of the 8*8 square
  * corresponding to the specified location.
  * \param location location of a node on the map
- * \return index of the square corresponding to the top-left part of the location
+ * \return index of the square corresponding to the top-left part of the
+ * location, or -1 if it is outside the squares that can be explored
  */
 int PathFinding::get_square_index(const Rectangle& location) const {
 
-  int x8 = location.get_x() / 8;
-  int y8 = location.get_y() / 8;
-  return y8 * map.get_width8() + x8;
+  if (location.get_x() < 0 || location.get_y() < 0) {
+    return -1;
+  }
+
+  int x8 = location.get_x() / 8 - squares_x8;
+  int y8 = location.get_y() / 8 - squares_y8;
+  if (x8 < 0 || x8 >= squares_width8 || y8 < 0 || y8 >= squares_height8) {
+    return -1;
+  }
+  return y8 * squares_width8 + x8;
+}
+
+/**
+ * \brief Returns the location of the node corresponding to a square.
+ * \param index index of a square in the nodes array
+ * \return location of the 16*16 node whose top-left part is this square
+ */
+Rectangle PathFinding::get_square_location(int index) const {
+
+  int x8 = squares_x8 + index % squares_width8;
+  int y8 = squares_y8 + index / squares_width8;
+  return Rectangle(x8 * 8, y8 * 8, 16, 16);
 }
 
 /**
@@ -222,69 +289,78 @@ int PathFinding::get_manhattan_distance(
   return distance;
 }
 
+/**
+ * \brief Creates a node not reached yet.
+ */
+PathFinding::Node::Node():
+  previous_cost(0),
+  heuristic(0),
+  parent_index(-1),
+  direction(' '),
+  state(NODE_UNKNOWN),
+  search(0) {
+
+}
 
 /**
- * \brief Compares two nodes according to their total estimated cost.
- * \param other the other node
+ * \brief Creates an element of the open list.
+ * \param total_cost total estimated cost of the node
+ * \param order sequence number of this element
+ * \param index index of the node
  */
-bool PathFinding::Node::operator<(const Node& other) const {
-  return total_cost < other.total_cost;
+PathFinding::OpenNode::OpenNode(int total_cost, int order, int index):
+  total_cost(total_cost),
+  order(order),
+  index(index) {
+
 }
 
 /**
- * \brief Adds the index of a node to the sorted list of indices of the open
- * list, making sure the list remains sorted.
- * \param node The node.
+ * \brief Compares two elements of the open list according to their priority.
+ *
+ * The top of the heap is the node with the lowest total estimated cost,
+ * and among them, the most recent one.
+ *
+ * \param other the other element
+ * \return true if this element has a lower priority than the other one
  */
-void PathFinding::add_index_sorted(Node* node) {
-
-  bool inserted = false;
-  std::list<int>::iterator i;
-  for (i = open_list_indices.begin();
-      i != open_list_indices.end() && !inserted;
-      ++i) {
-    int index = *i;
-    Node* current_node = &open_list[index];
-    if (current_node->total_cost >= node->total_cost) {
-      open_list_indices.insert(i, node->index);
-      inserted = true;
-    }
-  }
+bool PathFinding::OpenNode::operator<(const OpenNode& other) const {
 
-  if (!inserted) {
-    open_list_indices.push_back(node->index);
+  if (total_cost != other.total_cost) {
+    return total_cost > other.total_cost;
   }
+  return order < other.order;
 }
 
 /**
  * \brief Builds the string representation of the path found by the algorithm.
- * \param closed_list The closed list of A*.
- * \return final_node The final node of the path.
+ * \param final_index index of the final node of the path
+ * \return the path, as a sequence of directions ('0' to '7')
  */
-std::string PathFinding::rebuild_path(const Node* final_node) {
+std::string PathFinding::rebuild_path(int final_index) const {
 
-  const Node* current_node = final_node;
   std::string path = "";
+  const Node* current_node = &nodes[final_index];
   while (current_node->direction != ' ') {
-    path = current_node->direction + path;
-    current_node = &closed_list[current_node->parent_index];
-    //std::cout << "current_node: " << current_node->index << ", path = " << path << std::endl;
+    path += current_node->direction;
+    current_node = &nodes[current_node->parent_index];
   }
+  std::reverse(path.begin(), path.end());
   return path;
 }
 
 /**
  * \brief Returns whether a transition between two nodes is valid, i.e.
  * whether there is no collision with the map.
- * \param initial_node the first node
+ * \param initial_location location of the first node
  * \param direction the direction to take (0 to 7)
  * \return true if there is no collision for this transition
  */
 bool PathFinding::is_node_transition_valid(
-    const Node& initial_node, int direction) const {
+    const Rectangle& initial_location, int direction) const {
 
   Rectangle collision_box = transition_collision_boxes[direction];
-  collision_box.add_xy(initial_node.location);
+  collision_box.add_xy(initial_location);
 
   return !map.test_collision_with_obstacles(source_entity.get_layer(), collision_box, source_entity);
 }
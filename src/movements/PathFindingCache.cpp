@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2006-2013 Christopho, Solarus - http://www.solarus-games.org
+ * 
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "movements/PathFindingCache.h"
+#include "entities/MapEntity.h"
+#include "lowlevel/System.h"
+
+namespace solarus {
+
+/**
+ * \brief Creates an empty cache.
+ */
+PathFindingCache::PathFindingCache() {
+
+}
+
+/**
+ * \brief Destructor.
+ */
+PathFindingCache::~PathFindingCache() {
+
+}
+
+/**
+ * \brief Looks for a recent result of a path search.
+ * \param source_entity The entity to move (its position must be aligned on
+ * the map grid).
+ * \param target Location of the target node.
+ * \param max_distance Maximum distance of the search.
+ * \param[out] path The path found if the search is known.
+ * \return \c true if a path was recently found for this search.
+ */
+bool PathFindingCache::get_path(
+    const MapEntity& source_entity,
+    const Rectangle& target,
+    int max_distance,
+    std::string& path) {
+
+  const Entry search(source_entity, target, max_distance);
+  const uint32_t now = System::now();
+
+  std::list<Entry>::iterator it = entries.begin();
+  while (it != entries.end()) {
+
+    if (now >= it->expiration_date) {
+      it = entries.erase(it);
+      continue;
+    }
+
+    if (it->is_same_search(search)) {
+      path = it->path;
+      // Move it to the front.
+      entries.splice(entries.begin(), entries, it);
+      return true;
+    }
+    ++it;
+  }
+
+  return false;
+}
+
+/**
+ * \brief Stores the result of a path search.
+ *
+ * Failed searches are not stored since obstacles may disappear at any time.
+ *
+ * \param source_entity The entity to move.
+ * \param target Location of the target node.
+ * \param max_distance Maximum distance of the search.
+ * \param path The path found, or an empty string if no path was found.
+ */
+void PathFindingCache::add_path(
+    const MapEntity& source_entity,
+    const Rectangle& target,
+    int max_distance,
+    const std::string& path) {
+
+  if (path.empty()) {
+    return;
+  }
+
+  Entry entry(source_entity, target, max_distance);
+  entry.path = path;
+  entry.expiration_date = System::now() + path_lifetime;
+
+  entries.push_front(entry);
+  if (entries.size() > capacity) {
+    entries.pop_back();
+  }
+}
+
+/**
+ * \brief Forgets all paths.
+ */
+void PathFindingCache::clear() {
+
+  entries.clear();
+}
+
+/**
+ * \brief Returns a value that identifies which obstacles apply to an entity.
+ * \param entity An entity.
+ * \return A value that depends on the type of the entity and on the
+ * grounds it cannot traverse.
+ */
+int PathFindingCache::get_obstacle_profile(const MapEntity& entity) {
+
+  int grounds = 0;
+  grounds |= entity.is_low_wall_obstacle() ? 0x01 : 0;
+  grounds |= entity.is_shallow_water_obstacle() ? 0x02 : 0;
+  grounds |= entity.is_deep_water_obstacle() ? 0x04 : 0;
+  grounds |= entity.is_hole_obstacle() ? 0x08 : 0;
+  grounds |= entity.is_lava_obstacle() ? 0x10 : 0;
+  grounds |= entity.is_prickle_obstacle() ? 0x20 : 0;
+  grounds |= entity.is_ladder_obstacle() ? 0x40 : 0;
+
+  return (entity.get_type() << 8) | grounds;
+}
+
+/**
+ * \brief Creates an entry representing a path search.
+ * \param source_entity The entity to move.
+ * \param target Location of the target node.
+ * \param max_distance Maximum distance of the search.
+ */
+PathFindingCache::Entry::Entry(
+    const MapEntity& source_entity,
+    const Rectangle& target,
+    int max_distance):
+  layer(source_entity.get_layer()),
+  source_x(source_entity.get_top_left_x()),
+  source_y(source_entity.get_top_left_y()),
+  target_x(target.get_x()),
+  target_y(target.get_y()),
+  max_distance(max_distance),
+  obstacle_profile(get_obstacle_profile(source_entity)),
+  path(""),
+  expiration_date(0) {
+
+}
+
+/**
+ * \brief Returns whether two entries represent the same path search.
+ * \param other Another entry.
+ * \return \c true if both searches give the same result.
+ */
+bool PathFindingCache::Entry::is_same_search(const Entry& other) const {
+
+  return source_x == other.source_x
+      && source_y == other.source_y
+      && target_x == other.target_x
+      && target_y == other.target_y
+      && layer == other.layer
+      && max_distance == other.max_distance
+      && obstacle_profile == other.obstacle_profile;
+}
+
+}
+
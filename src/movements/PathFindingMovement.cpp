@@ -32,7 +32,8 @@ namespace solarus {
  */
 PathFindingMovement::PathFindingMovement(int speed):
   PathMovement("", speed, false, false, true),
-  target(NULL) {
+  target(NULL),
+  max_distance(PathFinding::default_max_distance) {
 
 }
 
@@ -54,6 +55,33 @@ void PathFindingMovement::set_target(MapEntity& target) {
   next_recomputation_date = System::now() + 100;
 }
 
+/**
+ * \brief Returns the maximum distance of the target.
+ * \return Maximum Manhattan distance in pixels between the entity and the
+ * target when searching a path.
+ */
+int PathFindingMovement::get_max_distance() const {
+  return max_distance;
+}
+
+/**
+ * \brief Sets the maximum distance of the target.
+ *
+ * If the target is farther, no path is searched and the entity walks
+ * randomly. Larger values allow to find paths across bigger rooms but make
+ * unsuccessful searches more costly.
+ *
+ * \param max_distance Maximum Manhattan distance in pixels between the
+ * entity and the target when searching a path.
+ */
+void PathFindingMovement::set_max_distance(int max_distance) {
+
+  Debug::check_assertion(max_distance >= 0,
+      StringConcat() << "Invalid maximum distance: " << max_distance);
+
+  this->max_distance = max_distance;
+}
+
 /**
  * \brief Updates the position.
  */
@@ -92,7 +120,8 @@ void PathFindingMovement::update() {
 void PathFindingMovement::recompute_movement() {
 
   if (target != NULL) {
-    PathFinding path_finding(get_entity()->get_map(), *get_entity(), *target);
+    PathFinding path_finding(get_entity()->get_map(), *get_entity(), *target,
+        max_distance);
     std::string path = path_finding.compute_path();
 
     uint32_t min_delay;
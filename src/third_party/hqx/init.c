@@ -19,20 +19,7 @@
 #include <stdint.h>
 #include "hqx/hqx.h"
 
-uint32_t   RGBtoYUV[16777216];
-uint32_t   YUV1, YUV2;
-
 HQX_API void HQX_CALLCONV hqxInit(void)
 {
-    /* Initalize RGB to YUV lookup table */
-    uint32_t c, r, g, b, y, u, v;
-    for (c = 0; c < 16777215; c++) {
-        r = (c & 0xFF0000) >> 16;
-        g = (c & 0x00FF00) >> 8;
-        b = c & 0x0000FF;
-        y = (uint32_t)(0.299*r + 0.587*g + 0.114*b);
-        u = (uint32_t)(-0.169*r - 0.331*g + 0.5*b) + 128;
-        v = (uint32_t)(0.5*r - 0.419*g - 0.081*b) + 128;
-        RGBtoYUV[c] = (y << 16) + (u << 8) + v;
-    }
+    /* Nothing to do: RGB to YUV conversions are computed on the fly. */
 }